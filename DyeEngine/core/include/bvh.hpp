@@ -0,0 +1,180 @@
+#ifndef _BVH_HPP_
+#define _BVH_HPP_
+
+// bounding volume hierarchy over a triangle mesh for ray queries.
+//
+// the build splits every node where the surface area heuristic says so,
+// evaluated at the bounds of 16 bins of the triangle centroids per axis
+// (wald, "on fast construction of sah-based bounding volume
+// hierarchies"). the large nodes near the root bin over the openmp
+// threads, then the subtrees below them are built one per thread and
+// joined in depth first order: the first child of a node follows it and
+// the second is at its offset, so a descent mostly reads on.
+//
+// the linear build instead sorts the centroids by 63 bit morton code (30
+// bits for small meshes) and splits each node where the highest differing
+// bit of the codes changes (lauterbach et al., "fast bvh construction on
+// gpus"), then fits the boxes from the leaves up. it builds several times
+// faster than sah and traces somewhat slower.
+//
+// a deforming mesh may keep its tree and refit() it to the new vertices,
+// which only moves the boxes: while sah_cost() stays close to
+// built_sah_cost() that is the cheapest update, past that a linear or sah
+// rebuild pays off.
+//
+// the rays go down one at a time or in packets of 8 that share a
+// traversal, nearer child first; the batch intersect() splits an array
+// of rays into packets over the threads.
+//
+// InstanceBvh is the second level: a tree over instances, each an
+// IRayTraceable with an affine transform, whose rays are moved into the
+// space of the object at the leaves. moving instances only takes a build()
+// of that tree, the objects stay as they are.
+
+#include <stddef.h>
+#include <vector>
+
+#include "geometry.hpp"
+#include "matrix.hpp"
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		enum bvh_build
+		{
+			bvh_build_sah,
+			bvh_build_linear
+		};
+
+		// 32 bytes, two to a cache line
+		struct bvh_node
+		{
+			float3 lower;
+
+			// the first triangle of a leaf, or the second child
+			unsigned int offset;
+
+			float3 upper;
+
+			// the triangles of a leaf, 0 for the others
+			unsigned short count;
+
+			// the axis the children were split on
+			unsigned short axis;
+		};
+
+		// a triangle in leaf order, as the intersection wants it
+		struct bvh_triangle
+		{
+			float3 v0;
+			float3 e1;
+			float3 e2;
+			unsigned int index;
+		};
+
+		class Bvh : public IRayTraceable
+		{
+		public:
+			Bvh();
+			Bvh(const vertex *vertices, size_t vertex_count, const unsigned int *indices, size_t index_count,
+				bvh_build method = bvh_build_sah);
+			explicit Bvh(const IMeshable &mesh, bvh_build method = bvh_build_sah);
+
+			void build(const vertex *vertices, size_t vertex_count, const unsigned int *indices, size_t index_count,
+				bvh_build method = bvh_build_sah);
+			void build(const IMeshable &mesh, bvh_build method = bvh_build_sah);
+
+			// the same tree over moved vertices of the same triangles
+			void refit(const vertex *vertices, size_t vertex_count, const unsigned int *indices);
+			void refit(const IMeshable &mesh);
+
+		public:
+			virtual aabb bounds() const;
+
+			virtual bool intersect(const ray &r, hit &h) const;
+			virtual bool occluded(const ray &r) const;
+
+			virtual void intersect(const ray8 &r, hit8 &h) const;
+			virtual int occluded(const ray8 &r) const;
+
+			// count rays over the threads, in packets
+			void intersect(const ray *rays, size_t count, hit *hits) const;
+			void occluded(const ray *rays, size_t count, bool *results) const;
+
+		public:
+			const bvh_node *nodes() const { return m_nodes.empty() ? 0 : &m_nodes[0]; }
+			size_t node_count() const { return m_nodes.size(); }
+
+			const bvh_triangle *triangles() const { return m_triangles.empty() ? 0 : &m_triangles[0]; }
+			size_t triangle_count() const { return m_triangles.size(); }
+
+			// the expected cost of a random ray, in triangle intersections
+			float sah_cost() const;
+			float built_sah_cost() const { return m_built_cost; }
+
+		private:
+			std::vector<bvh_node> m_nodes;
+			std::vector<bvh_triangle> m_triangles;
+			float m_built_cost;
+		};
+
+		struct bvh_instance
+		{
+			// object to world, and back
+			float3x4 transform;
+			float3x4 inverse;
+
+			const IRayTraceable *object;
+		};
+
+		// the hits name the instance by the order of add(); the objects are
+		// not owned and must outlive the tree
+		class InstanceBvh : public IRayTraceable
+		{
+		public:
+			InstanceBvh();
+
+			// the transforms are affine, a float4x4 with (0, 0, 0, 1) in
+			// its last column
+			unsigned int add(const IRayTraceable *object, const float3x4 &transform);
+			unsigned int add(const IRayTraceable *object, const float4x4 &transform);
+			void set_transform(unsigned int instance, const float3x4 &transform);
+			void set_transform(unsigned int instance, const float4x4 &transform);
+			void clear();
+
+			// the tree over the instances where they are now. refit() keeps
+			// the tree of the last build and only moves its boxes
+			void build(bvh_build method = bvh_build_sah);
+			void refit();
+
+		public:
+			virtual aabb bounds() const;
+
+			virtual bool intersect(const ray &r, hit &h) const;
+			virtual bool occluded(const ray &r) const;
+
+			virtual void intersect(const ray8 &r, hit8 &h) const;
+			virtual int occluded(const ray8 &r) const;
+
+			void intersect(const ray *rays, size_t count, hit *hits) const;
+			void occluded(const ray *rays, size_t count, bool *results) const;
+
+		public:
+			const bvh_instance &instance(unsigned int index) const { return m_instances[index]; }
+			size_t instance_count() const { return m_instances.size(); }
+
+			const bvh_node *nodes() const { return m_nodes.empty() ? 0 : &m_nodes[0]; }
+			size_t node_count() const { return m_nodes.size(); }
+
+		private:
+			std::vector<bvh_instance> m_instances;
+			std::vector<bvh_node> m_nodes;
+
+			// the instances in leaf order
+			std::vector<unsigned int> m_order;
+		};
+	}
+}
+
+#endif // _BVH_HPP_
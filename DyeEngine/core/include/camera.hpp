@@ -0,0 +1,54 @@
+#ifndef _CAMERA_HPP_
+#define _CAMERA_HPP_
+
+// the pinhole camera of the cpu renderers, path_tracer.hpp and
+// ray_marcher.hpp.
+
+#include <stddef.h>
+#include <cmath>
+
+#include "vector.hpp"
+
+namespace Dye
+{
+	namespace Render
+	{
+		struct camera
+		{
+			float3 eye;
+			float3 target;
+			float3 up;
+
+			// the vertical field of view in radians
+			float fov;
+		};
+
+		// the camera basis for an image of width by height pixels, with the
+		// image plane at distance 1 from the eye: the point sx, sy of the
+		// image, both in [-1, 1] from the top left, lies along
+		// forward + right * sx + down * sy
+		struct camera_frame
+		{
+			float3 forward;
+			float3 right;
+			float3 down;
+		};
+
+		inline camera_frame make_frame(const camera &view, size_t width, size_t height)
+		{
+			camera_frame frame;
+			const float3 to = view.target - view.eye;
+			frame.forward = normalize(to);
+			const float3 side = cross(view.up, frame.forward);
+			const float3 right = normalize(side);
+			const float3 up = cross(frame.forward, right);
+			const float half_height = std::tan(view.fov * 0.5f);
+			const float aspect = height == 0 ? 1 : static_cast<float>(width) / height;
+			frame.right = right * (half_height * aspect);
+			frame.down = up * -half_height;
+			return frame;
+		}
+	}
+}
+
+#endif // _CAMERA_HPP_
@@ -31,4 +31,35 @@
 	const_iterator begin() const {return const_iterator(addr);}		\
 	const_iterator end() const {return const_iterator(addr) + (n);}
 
+#if defined(DYE_EXPRESSION_TEMPLATES)
+#define DECLARE_EXPRESSION_EVALUATION(Class, Type, n)					\
+	template<typename Op, typename L, typename R>						\
+	Class(const expr_node<Class, Op, L, R> &expr)						\
+	{																	\
+		expr_assign<n>(ptr(), expr);									\
+	}																	\
+	template<typename Op, typename L, typename R>						\
+	Class& operator = (const expr_node<Class, Op, L, R> &expr)			\
+	{																	\
+		expr_assign<n>(ptr(), expr);									\
+		return *this;													\
+	}																	\
+	template<typename Op, typename L, typename R>						\
+	Class& operator += (const expr_node<Class, Op, L, R> &expr)		\
+	{																	\
+		Type *p = ptr();												\
+		for (size_t i = 0; i != (n); ++i) p[i] += expr[i];				\
+		return *this;													\
+	}																	\
+	template<typename Op, typename L, typename R>						\
+	Class& operator -= (const expr_node<Class, Op, L, R> &expr)		\
+	{																	\
+		Type *p = ptr();												\
+		for (size_t i = 0; i != (n); ++i) p[i] -= expr[i];				\
+		return *this;													\
+	}
+#else
+#define DECLARE_EXPRESSION_EVALUATION(Class, Type, n)
+#endif
+
 #endif // _COMMON_HELPER_H_
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifndef _CPU_DISPATCH_HPP_
+#define _CPU_DISPATCH_HPP_
+
+#include <stddef.h>
+
+namespace Dye
+{
+	//////////////////////////////////////////////////////////////////////////
+	// runtime cpu dispatch
+	//
+	// the batch kernels behind transform.hpp and the array overloads of
+	// matrix_aux.hpp exist once for the build flags (the baseline) and once
+	// more per wider instruction set, each in its own source compiled with
+	// that instruction set. the widest one the processor and the os support
+	// is detected with cpuid at startup and bound through batch_kernels.
+	//
+	// the DYE_CPU environment variable lowers the level, e.g. DYE_CPU=sse2
+	// runs the baseline on an avx2 machine. it can never raise it.
+	//////////////////////////////////////////////////////////////////////////
+	enum cpu_level
+	{
+		cpu_scalar,
+		cpu_sse2,
+		cpu_sse42,
+		cpu_avx,
+		cpu_avx2,	// with fma and f16c
+		cpu_avx512,
+		cpu_level_count
+	};
+
+	// widest level of this machine
+	cpu_level detected_cpu_level();
+
+	// level the kernels are bound for, the detected one unless lowered
+	cpu_level active_cpu_level();
+
+	// rebinds the kernels for the level, clamped to the detected one, and
+	// returns the level in effect. must not race with running kernels.
+	cpu_level set_cpu_level(cpu_level level);
+
+	const char *cpu_level_name(cpu_level level);
+
+	// inverse of cpu_level_name, case insensitive
+	bool cpu_level_from_name(const char *name, cpu_level &level);
+
+	//////////////////////////////////////////////////////////////////////////
+	// kernel table
+	//
+	// the kernels work on plain arrays, so that the per instruction set
+	// sources include none of the inline math headers: an inline function
+	// compiled there with vex encoding could be the copy the linker keeps for
+	// the whole program. matrices are 16 floats in float4x4 layout, strides
+	// are in bytes, and out may be in but must not overlap it otherwise.
+	//////////////////////////////////////////////////////////////////////////
+	struct batch_kernels
+	{
+		// out = mul(float4(in, w), mat).xyz on n float3, renormalized on request
+		void (*transform3)(const float *mat, float w, bool renormalize,
+			const char *in, size_t in_stride, char *out, size_t out_stride, size_t n);
+
+		// out = mul(in, mat) on n float4
+		void (*transform4)(const float *mat, const float *in, float *out, size_t n);
+
+		// out = in / max(length(in), sqrt(c_eps)) on n float3
+		void (*normalize3)(const float *in, float *out, size_t n);
+
+		// out = inv(in) on n float4x4
+		void (*inverse4x4)(const float *in, float *out, size_t n);
+
+		// binary16 bit patterns of n floats and back, see half.hpp
+		void (*float_to_half)(const float *in, unsigned short *out, size_t n);
+		void (*half_to_float)(const unsigned short *in, float *out, size_t n);
+
+		// n records of 8 floats to 8 streams of n floats and back
+		void (*aos_to_soa)(const float *in, float *const *streams, size_t n);
+		void (*soa_to_aos)(const float *const *streams, float *out, size_t n);
+	};
+
+	// the table bound for active_cpu_level()
+	const batch_kernels &kernels();
+
+	// the table of every implementation, null when missing from the build
+	const batch_kernels *baseline_kernels();
+	const batch_kernels *avx2_kernels();
+}
+
+#endif // _CPU_DISPATCH_HPP_
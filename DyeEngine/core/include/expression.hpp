@@ -0,0 +1,339 @@
+#ifndef _EXPRESSION_HPP_
+#define _EXPRESSION_HPP_
+
+// opt-in expression templates for the piecewise arithmetic of vectors and
+// matrices, included by vector.hpp only when DYE_EXPRESSION_TEMPLATES is
+// defined. the operators below replace the eager ones in vector.hpp and
+// matrix.hpp and return lazy expr_node objects instead, which are
+// evaluated element by element in a single pass when they are assigned to
+// (or used to construct) a vector or matrix, so no intermediate object is
+// ever built. a * b + c is evaluated with fused multiply-add when the
+// target supports it.
+//
+// nodes keep references to their vector and matrix operands, so they must
+// be consumed within the full expression that creates them, i.e. do not
+// store them with auto. use eval() where a real vector is required, e.g.
+// (a + b).eval().xy(). float4 keeps its sse operators, whose results are
+// a single instruction each and never become nodes.
+
+#include <boost/utility/enable_if.hpp>
+
+namespace Dye
+{
+	template<typename Type> class matrix_2x2t;
+	template<typename Type> class matrix_3x3t;
+	template<typename Type> class matrix_4x4t;
+
+	//////////////////////////////////////////////////////////////////////////
+	// fused multiply-add
+	template<typename Type>
+	inline Type madd(Type a, Type b, Type c)
+	{
+		return a * b + c;
+	}
+
+#if defined(__FMA__) || defined(__AVX2__)
+	inline float madd(float a, float b, float c)
+	{
+		return std::fma(a, b, c);
+	}
+
+	inline double madd(double a, double b, double c)
+	{
+		return std::fma(a, b, c);
+	}
+#endif
+
+	//////////////////////////////////////////////////////////////////////////
+	// operations
+	struct op_add { template<typename T> static T apply(T a, T b) { return a + b; } };
+	struct op_sub { template<typename T> static T apply(T a, T b) { return a - b; } };
+	struct op_mul { template<typename T> static T apply(T a, T b) { return a * b; } };
+	struct op_div { template<typename T> static T apply(T a, T b) { return a / b; } };
+	struct op_neg { template<typename T> static T apply(T a, T) { return -a; } };
+
+	//////////////////////////////////////////////////////////////////////////
+	// leaves
+	template<typename Obj>
+	struct expr_leaf
+	{
+		typedef typename Obj::value_type value_type;
+
+		expr_leaf(const Obj &obj)
+			: ref(obj)
+		{
+		}
+
+		value_type operator [] (size_t i) const
+		{
+			return ref.ptr()[i];
+		}
+
+		const Obj &ref;
+	};
+
+	template<typename Type>
+	struct expr_scalar
+	{
+		typedef Type value_type;
+
+		expr_scalar(Type s)
+			: value(s)
+		{
+		}
+
+		Type operator [] (size_t) const
+		{
+			return value;
+		}
+
+		Type value;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// traits of the objects that may appear in an expression
+	template<typename T>
+	struct expr_traits
+	{
+		static const bool is_operand = false;
+	};
+
+	template<typename Obj, size_t N>
+	struct expr_object_traits
+	{
+		static const bool is_operand = true;
+		static const size_t size = N;
+		typedef Obj object_type;
+		typedef expr_leaf<Obj> holder;
+	};
+
+	template<typename Type> struct expr_traits< vector_2t<Type> > : expr_object_traits<vector_2t<Type>, 2> {};
+	template<typename Type> struct expr_traits< vector_3t<Type> > : expr_object_traits<vector_3t<Type>, 3> {};
+	template<typename Type> struct expr_traits< vector_4t<Type> > : expr_object_traits<vector_4t<Type>, 4> {};
+	template<typename Type> struct expr_traits< matrix_2x2t<Type> > : expr_object_traits<matrix_2x2t<Type>, 2*2> {};
+	template<typename Type> struct expr_traits< matrix_3x3t<Type> > : expr_object_traits<matrix_3x3t<Type>, 3*3> {};
+	template<typename Type> struct expr_traits< matrix_4x4t<Type> > : expr_object_traits<matrix_4x4t<Type>, 4*4> {};
+
+	template<typename Obj, typename Op, typename L, typename R>
+	struct expr_traits< expr_node<Obj, Op, L, R> >
+	{
+		static const bool is_operand = true;
+		static const size_t size = expr_traits<Obj>::size;
+		typedef Obj object_type;
+		typedef expr_node<Obj, Op, L, R> holder;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// evaluation of one element, a * b + c and c + a * b are fused
+	template<typename Op, typename L, typename R>
+	struct expr_kernel
+	{
+		static typename L::value_type at(const L &lhs, const R &rhs, size_t i)
+		{
+			return Op::apply(lhs[i], rhs[i]);
+		}
+	};
+
+	template<typename Obj, typename A, typename B, typename R>
+	struct expr_kernel<op_add, expr_node<Obj, op_mul, A, B>, R>
+	{
+		static typename Obj::value_type at(const expr_node<Obj, op_mul, A, B> &lhs, const R &rhs, size_t i)
+		{
+			return madd(lhs.lhs[i], lhs.rhs[i], rhs[i]);
+		}
+	};
+
+	template<typename Obj, typename L, typename A, typename B>
+	struct expr_kernel<op_add, L, expr_node<Obj, op_mul, A, B> >
+	{
+		static typename Obj::value_type at(const L &lhs, const expr_node<Obj, op_mul, A, B> &rhs, size_t i)
+		{
+			return madd(rhs.lhs[i], rhs.rhs[i], lhs[i]);
+		}
+	};
+
+	template<typename Obj, typename A, typename B, typename C, typename D>
+	struct expr_kernel<op_add, expr_node<Obj, op_mul, A, B>, expr_node<Obj, op_mul, C, D> >
+	{
+		static typename Obj::value_type at(const expr_node<Obj, op_mul, A, B> &lhs, const expr_node<Obj, op_mul, C, D> &rhs, size_t i)
+		{
+			return madd(lhs.lhs[i], lhs.rhs[i], rhs.lhs[i] * rhs.rhs[i]);
+		}
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// expression node
+	template<typename Obj, typename Op, typename L, typename R>
+	struct expr_node
+	{
+		typedef typename Obj::value_type value_type;
+
+		expr_node(const L &l, const R &r)
+			: lhs(l)
+			, rhs(r)
+		{
+		}
+
+		value_type operator [] (size_t i) const
+		{
+			return expr_kernel<Op, L, R>::at(lhs, rhs, i);
+		}
+
+		Obj eval() const
+		{
+			return Obj(*this);
+		}
+
+		L lhs;
+		R rhs;
+	};
+
+	template<size_t N, typename Type, typename Expr>
+	inline void expr_assign(Type *dst, const Expr &expr)
+	{
+		for (size_t i = 0; i != N; ++i)
+		{
+			dst[i] = expr[i];
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// result types, only defined for valid operand combinations so that the
+	// operators below drop out of overload resolution for anything else
+	template<typename L, typename R, bool = expr_traits<L>::is_operand && expr_traits<R>::is_operand>
+	struct expr_compatible
+	{
+		static const bool value = false;
+	};
+
+	template<typename L, typename R>
+	struct expr_compatible<L, R, true>
+	{
+		static const bool value = boost::is_same<
+			typename expr_traits<L>::object_type,
+			typename expr_traits<R>::object_type>::value;
+	};
+
+	template<typename Op, typename L, typename R>
+	struct expr_binary
+	{
+		typedef expr_node<
+			typename expr_traits<L>::object_type, Op,
+			typename expr_traits<L>::holder,
+			typename expr_traits<R>::holder> type;
+	};
+
+	template<typename Op, typename L>
+	struct expr_scaled
+	{
+		typedef typename expr_traits<L>::object_type object_type;
+		typedef typename object_type::value_type value_type;
+		typedef expr_node<object_type, Op, typename expr_traits<L>::holder, expr_scalar<value_type> > type;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// negation
+	template<typename L>
+	typename boost::lazy_enable_if_c<expr_traits<L>::is_operand, expr_scaled<op_neg, L> >::type
+	operator - (const L &operand)
+	{
+		typedef typename expr_scaled<op_neg, L>::type node;
+		return node(operand, typename node::value_type());
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// addition
+	template<typename L, typename R>
+	typename boost::lazy_enable_if_c<expr_compatible<L, R>::value, expr_binary<op_add, L, R> >::type
+	operator + (const L &lhs, const R &rhs)
+	{
+		return typename expr_binary<op_add, L, R>::type(lhs, rhs);
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// subtraction
+	template<typename L, typename R>
+	typename boost::lazy_enable_if_c<expr_compatible<L, R>::value, expr_binary<op_sub, L, R> >::type
+	operator - (const L &lhs, const R &rhs)
+	{
+		return typename expr_binary<op_sub, L, R>::type(lhs, rhs);
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// multiplication : operand * scalar
+	template<typename L, typename S>
+	typename boost::lazy_enable_if_c<expr_traits<L>::is_operand && boost::is_arithmetic<S>::value, expr_scaled<op_mul, L> >::type
+	operator * (const L &lhs, const S& scale)
+	{
+		typedef typename expr_scaled<op_mul, L>::type node;
+		return node(lhs, static_cast<typename node::value_type>(scale));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// multiplication : scalar * operand
+	template<typename S, typename R>
+	typename boost::lazy_enable_if_c<expr_traits<R>::is_operand && boost::is_arithmetic<S>::value, expr_scaled<op_mul, R> >::type
+	operator * (const S& scale, const R &rhs)
+	{
+		typedef typename expr_scaled<op_mul, R>::type node;
+		return node(rhs, static_cast<typename node::value_type>(scale));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// division : operand / scalar
+	template<typename L, typename S>
+	typename boost::lazy_enable_if_c<expr_traits<L>::is_operand && boost::is_arithmetic<S>::value, expr_scaled<op_mul, L> >::type
+	operator / (const L &lhs, const S& scale)
+	{
+		typedef typename expr_scaled<op_mul, L>::type node;
+		BOOST_STATIC_ASSERT(is_real<typename node::value_type>::value);
+		return node(lhs, static_cast<typename node::value_type>(1) / scale);
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// piecewise multiplication : operand * operand
+	template<typename L, typename R>
+	typename boost::lazy_enable_if_c<expr_compatible<L, R>::value, expr_binary<op_mul, L, R> >::type
+	operator * (const L &lhs, const R &rhs)
+	{
+		return typename expr_binary<op_mul, L, R>::type(lhs, rhs);
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// piecewise division : operand / operand
+	template<typename L, typename R>
+	typename boost::lazy_enable_if_c<expr_compatible<L, R>::value, expr_binary<op_div, L, R> >::type
+	operator / (const L &lhs, const R &rhs)
+	{
+		return typename expr_binary<op_div, L, R>::type(lhs, rhs);
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// free functions on unevaluated vectors
+	template<typename Obj, typename Op, typename L, typename R>
+	Obj normalize(const expr_node<Obj, Op, L, R> &operand)
+	{
+		Obj vec(operand);
+		return vec.normalize();
+	}
+
+	template<typename Obj, typename Op, typename L, typename R>
+	typename Obj::value_type dot(const expr_node<Obj, Op, L, R> &lhs, const Obj &rhs)
+	{
+		return dot(lhs.eval(), rhs);
+	}
+
+	template<typename Obj, typename Op, typename L, typename R>
+	typename Obj::value_type dot(const Obj &lhs, const expr_node<Obj, Op, L, R> &rhs)
+	{
+		return dot(lhs, rhs.eval());
+	}
+
+	template<typename Obj, typename Op0, typename L0, typename R0, typename Op1, typename L1, typename R1>
+	typename Obj::value_type dot(const expr_node<Obj, Op0, L0, R0> &lhs, const expr_node<Obj, Op1, L1, R1> &rhs)
+	{
+		return dot(lhs.eval(), rhs.eval());
+	}
+}
+
+#endif // _EXPRESSION_HPP_
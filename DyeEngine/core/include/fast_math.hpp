@@ -0,0 +1,468 @@
+#ifndef _FAST_MATH_HPP_
+#define _FAST_MATH_HPP_
+
+// approximate float math, for the per pixel and per step code where the
+// exact functions dominate. three accuracy tiers, chosen per call site:
+//
+//   exact    std::sqrt, std::sin, ..., vector_Nt::length(), normalize()
+//   _fast    a few ulp, the measured bound is given next to each function
+//   _est     the raw hardware estimate of rcp and rsqrt, about 12 bits
+//
+// every function takes a float, a float4 (4 lanes) or a float8 (8 lanes,
+// see packet.hpp). the lanes are computed independently and without
+// branches, so the scalar results are the same as the batch ones. the
+// bounds are the largest errors measured over the stated domain, in ulp of
+// the correctly rounded result; outside the domain the result is
+// unspecified unless noted otherwise.
+
+#include <string.h>
+#include <cmath>
+
+#include "constant.hpp"
+#include "packet.hpp"
+
+namespace Dye
+{
+	//////////////////////////////////////////////////////////////////////////
+	// lane operations
+	//
+	// the kernels below are written once against these overloads and are
+	// instantiated for a plain float, an sse register and an avx register.
+	// masks are lanes with all bits set or clear.
+	//////////////////////////////////////////////////////////////////////////
+	template<typename Unit> Unit fm_set(float s);
+
+	template<> inline float fm_set<float>(float s) { return s; }
+
+	inline unsigned int fm_bits(float a)             { unsigned int u; memcpy(&u, &a, sizeof(u)); return u; }
+	inline float fm_float(unsigned int u)            { float a; memcpy(&a, &u, sizeof(a)); return a; }
+
+	inline float fm_add(float a, float b)            { return a + b; }
+	inline float fm_sub(float a, float b)            { return a - b; }
+	inline float fm_mul(float a, float b)            { return a * b; }
+	inline float fm_madd(float a, float b, float c)  { return a * b + c; }
+	inline float fm_min(float a, float b)            { return a < b ? a : b; }
+	inline float fm_max(float a, float b)            { return a > b ? a : b; }
+	inline float fm_and(float a, float b)            { return fm_float(fm_bits(a) & fm_bits(b)); }
+	inline float fm_xor(float a, float b)            { return fm_float(fm_bits(a) ^ fm_bits(b)); }
+	inline float fm_lt(float a, float b)             { return fm_float(a < b ? ~0u : 0u); }
+	inline float fm_select(float m, float a, float b) { return fm_bits(m) ? a : b; }
+
+	// 2^n for an integral n in [-126, 127]
+	inline float fm_pow2i(float n)                   { return fm_float(static_cast<unsigned int>(static_cast<int>(n) + 127) << 23); }
+
+	// x = mantissa * 2^exponent with the mantissa in [1, 2), x normal and positive
+	inline float fm_exponent(float x)                { return static_cast<float>(static_cast<int>((fm_bits(x) >> 23) & 0xff) - 127); }
+	inline float fm_mantissa(float x)                { return fm_float((fm_bits(x) & 0x007fffff) | 0x3f800000); }
+
+	// mask of the lanes where bit Bit of the integral q is set
+	template<int Bit>
+	inline float fm_bit(float q)                     { return fm_float((static_cast<int>(q) >> Bit) & 1 ? ~0u : 0u); }
+
+#if defined(DYE_SIMD_SSE)
+	inline float fm_round(float a)                   { return static_cast<float>(_mm_cvt_ss2si(_mm_set_ss(a))); }
+	inline float fm_rcp_est(float a)                 { return _mm_cvtss_f32(_mm_rcp_ss(_mm_set_ss(a))); }
+	inline float fm_rsqrt_est(float a)               { return _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(a))); }
+#else
+	// rounds to nearest even like the simd conversions for |a| < 2^22, the
+	// volatile keeps the compiler from folding the magic number away
+	inline float fm_round(float a)                   { volatile float t = a + 12582912.0f; return t - 12582912.0f; }
+
+	// no estimate instructions, the exact result is within any bound
+	inline float fm_rcp_est(float a)                 { return 1 / a; }
+	inline float fm_rsqrt_est(float a)               { return 1 / std::sqrt(a); }
+#endif
+
+#if defined(DYE_SIMD_SSE2)
+	template<> inline __m128 fm_set<__m128>(float s) { return _mm_set1_ps(s); }
+
+	inline __m128 fm_add(__m128 a, __m128 b)         { return _mm_add_ps(a, b); }
+	inline __m128 fm_sub(__m128 a, __m128 b)         { return _mm_sub_ps(a, b); }
+	inline __m128 fm_mul(__m128 a, __m128 b)         { return _mm_mul_ps(a, b); }
+	inline __m128 fm_madd(__m128 a, __m128 b, __m128 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	inline __m128 fm_min(__m128 a, __m128 b)         { return _mm_min_ps(a, b); }
+	inline __m128 fm_max(__m128 a, __m128 b)         { return _mm_max_ps(a, b); }
+	inline __m128 fm_and(__m128 a, __m128 b)         { return _mm_and_ps(a, b); }
+	inline __m128 fm_xor(__m128 a, __m128 b)         { return _mm_xor_ps(a, b); }
+	inline __m128 fm_lt(__m128 a, __m128 b)          { return _mm_cmplt_ps(a, b); }
+	inline __m128 fm_select(__m128 m, __m128 a, __m128 b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+	inline __m128 fm_rcp_est(__m128 a)               { return _mm_rcp_ps(a); }
+	inline __m128 fm_rsqrt_est(__m128 a)             { return _mm_rsqrt_ps(a); }
+
+	// rounds to nearest in the default rounding mode
+	inline __m128 fm_round(__m128 a)                 { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a)); }
+
+	inline __m128 fm_pow2i(__m128 n)
+	{
+		__m128i e = _mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127));
+		return _mm_castsi128_ps(_mm_slli_epi32(e, 23));
+	}
+
+	inline __m128 fm_exponent(__m128 x)
+	{
+		__m128i e = _mm_srli_epi32(_mm_castps_si128(x), 23);
+		return _mm_cvtepi32_ps(_mm_sub_epi32(e, _mm_set1_epi32(127)));
+	}
+
+	inline __m128 fm_mantissa(__m128 x)
+	{
+		__m128i m = _mm_and_si128(_mm_castps_si128(x), _mm_set1_epi32(0x007fffff));
+		return _mm_castsi128_ps(_mm_or_si128(m, _mm_set1_epi32(0x3f800000)));
+	}
+
+	template<int Bit>
+	inline __m128 fm_bit(__m128 q)
+	{
+		__m128i i = _mm_slli_epi32(_mm_cvtps_epi32(q), 31 - Bit);
+		return _mm_castsi128_ps(_mm_srai_epi32(i, 31));
+	}
+#endif
+
+#if defined(DYE_SIMD_AVX)
+	template<> inline __m256 fm_set<__m256>(float s) { return _mm256_set1_ps(s); }
+
+	inline __m256 fm_add(__m256 a, __m256 b)         { return _mm256_add_ps(a, b); }
+	inline __m256 fm_sub(__m256 a, __m256 b)         { return _mm256_sub_ps(a, b); }
+	inline __m256 fm_mul(__m256 a, __m256 b)         { return _mm256_mul_ps(a, b); }
+	inline __m256 fm_madd(__m256 a, __m256 b, __m256 c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+	inline __m256 fm_min(__m256 a, __m256 b)         { return _mm256_min_ps(a, b); }
+	inline __m256 fm_max(__m256 a, __m256 b)         { return _mm256_max_ps(a, b); }
+	inline __m256 fm_and(__m256 a, __m256 b)         { return _mm256_and_ps(a, b); }
+	inline __m256 fm_xor(__m256 a, __m256 b)         { return _mm256_xor_ps(a, b); }
+	inline __m256 fm_lt(__m256 a, __m256 b)          { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	inline __m256 fm_select(__m256 m, __m256 a, __m256 b) { return _mm256_blendv_ps(b, a, m); }
+	inline __m256 fm_rcp_est(__m256 a)               { return _mm256_rcp_ps(a); }
+	inline __m256 fm_rsqrt_est(__m256 a)             { return _mm256_rsqrt_ps(a); }
+	inline __m256 fm_round(__m256 a)                 { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+
+#if defined(__AVX2__)
+	inline __m256 fm_pow2i(__m256 n)
+	{
+		__m256i e = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127));
+		return _mm256_castsi256_ps(_mm256_slli_epi32(e, 23));
+	}
+
+	inline __m256 fm_exponent(__m256 x)
+	{
+		__m256i e = _mm256_srli_epi32(_mm256_castps_si256(x), 23);
+		return _mm256_cvtepi32_ps(_mm256_sub_epi32(e, _mm256_set1_epi32(127)));
+	}
+
+	inline __m256 fm_mantissa(__m256 x)
+	{
+		__m256i m = _mm256_and_si256(_mm256_castps_si256(x), _mm256_set1_epi32(0x007fffff));
+		return _mm256_castsi256_ps(_mm256_or_si256(m, _mm256_set1_epi32(0x3f800000)));
+	}
+
+	template<int Bit>
+	inline __m256 fm_bit(__m256 q)
+	{
+		__m256i i = _mm256_slli_epi32(_mm256_cvtps_epi32(q), 31 - Bit);
+		return _mm256_castsi256_ps(_mm256_srai_epi32(i, 31));
+	}
+#else
+	// avx1 has no 256-bit integer instructions, the two halves go through sse2
+	inline __m256 fm_join(__m128 lo, __m128 hi)      { return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1); }
+	inline __m128 fm_lo(__m256 a)                    { return _mm256_castps256_ps128(a); }
+	inline __m128 fm_hi(__m256 a)                    { return _mm256_extractf128_ps(a, 1); }
+
+	inline __m256 fm_pow2i(__m256 n)                 { return fm_join(fm_pow2i(fm_lo(n)), fm_pow2i(fm_hi(n))); }
+	inline __m256 fm_exponent(__m256 x)              { return fm_join(fm_exponent(fm_lo(x)), fm_exponent(fm_hi(x))); }
+	inline __m256 fm_mantissa(__m256 x)              { return fm_join(fm_mantissa(fm_lo(x)), fm_mantissa(fm_hi(x))); }
+
+	template<int Bit>
+	inline __m256 fm_bit(__m256 q)                   { return fm_join(fm_bit<Bit>(fm_lo(q)), fm_bit<Bit>(fm_hi(q))); }
+#endif
+#endif
+
+	//////////////////////////////////////////////////////////////////////////
+	// kernels
+	//////////////////////////////////////////////////////////////////////////
+	template<typename Unit>
+	inline Unit fm_rcp_kernel(Unit a)
+	{
+		// one newton step, r' = r + r * (1 - a * r)
+		Unit r = fm_rcp_est(a);
+		return fm_madd(r, fm_sub(fm_set<Unit>(1), fm_mul(a, r)), r);
+	}
+
+	template<typename Unit>
+	inline Unit fm_rsqrt_kernel(Unit a)
+	{
+		// one newton step, r' = r * (1.5 - 0.5 * a * r * r)
+		Unit r = fm_rsqrt_est(a);
+		Unit h = fm_mul(fm_mul(fm_set<Unit>(0.5f), a), fm_mul(r, r));
+		return fm_mul(r, fm_sub(fm_set<Unit>(1.5f), h));
+	}
+
+	template<typename Unit>
+	inline Unit fm_sqrt_kernel(Unit a)
+	{
+		// a * rsqrt(a), clamped so that 0 gives 0 instead of 0 * inf
+		Unit r = fm_rsqrt_kernel(fm_max(a, fm_set<Unit>(1.17549435e-38f)));
+		return fm_mul(a, r);
+	}
+
+	// sin(x + offset * pi / 2) with offset 0 or 1
+	template<typename Unit>
+	inline Unit fm_sincos_kernel(Unit x, float offset)
+	{
+		// x = q * pi / 2 + r, |r| <= pi / 4. pi / 2 is split in three parts
+		// with enough trailing zeros to keep q * part exact.
+		Unit q = fm_round(fm_mul(x, fm_set<Unit>(0.636619772f)));
+		Unit r = fm_sub(x, fm_mul(q, fm_set<Unit>(1.5703125f)));
+		r = fm_sub(r, fm_mul(q, fm_set<Unit>(4.837512969970703125e-4f)));
+		r = fm_sub(r, fm_mul(q, fm_set<Unit>(7.54978995489188216e-8f)));
+		q = fm_add(q, fm_set<Unit>(offset));
+
+		// minimax polynomials on [-pi / 4, pi / 4] (cephes)
+		Unit z = fm_mul(r, r);
+		Unit s = fm_madd(fm_set<Unit>(-1.9515295891e-4f), z, fm_set<Unit>(8.3321608736e-3f));
+		s = fm_madd(s, z, fm_set<Unit>(-1.6666654611e-1f));
+		s = fm_madd(fm_mul(s, z), r, r);
+
+		Unit c = fm_madd(fm_set<Unit>(2.443315711809948e-5f), z, fm_set<Unit>(-1.388731625493765e-3f));
+		c = fm_madd(c, z, fm_set<Unit>(4.166664568298827e-2f));
+		c = fm_madd(fm_mul(c, z), z, fm_madd(fm_set<Unit>(-0.5f), z, fm_set<Unit>(1)));
+
+		// odd quadrants use the cosine, quadrants 2 and 3 flip the sign
+		Unit y = fm_select(fm_bit<0>(q), c, s);
+		return fm_xor(y, fm_and(fm_bit<1>(q), fm_set<Unit>(-0.0f)));
+	}
+
+	template<typename Unit>
+	inline Unit fm_acos_kernel(Unit x)
+	{
+		// acos(a) = sqrt(1 - a) * p(a) for a = |x| (abramowitz and stegun
+		// 4.4.46), and acos(x) = pi - acos(-x) for negative x
+		Unit neg = fm_lt(x, fm_set<Unit>(0));
+		Unit a = fm_xor(x, fm_and(neg, fm_set<Unit>(-0.0f)));
+
+		Unit p = fm_madd(fm_set<Unit>(-0.0012624911f), a, fm_set<Unit>(0.0066700901f));
+		p = fm_madd(p, a, fm_set<Unit>(-0.0170881256f));
+		p = fm_madd(p, a, fm_set<Unit>(0.0308918810f));
+		p = fm_madd(p, a, fm_set<Unit>(-0.0501743046f));
+		p = fm_madd(p, a, fm_set<Unit>(0.0889789874f));
+		p = fm_madd(p, a, fm_set<Unit>(-0.2145988016f));
+		p = fm_madd(p, a, fm_set<Unit>(1.5707963050f));
+
+		Unit r = fm_mul(fm_sqrt_kernel(fm_sub(fm_set<Unit>(1), a)), p);
+		return fm_select(neg, fm_sub(fm_set<Unit>(c_pi), r), r);
+	}
+
+	template<typename Unit>
+	inline Unit fm_exp_kernel(Unit x)
+	{
+		// x = n * ln2 + r, |r| <= ln2 / 2, exp(x) = 2^n * exp(r)
+		x = fm_min(fm_max(x, fm_set<Unit>(-87.0f)), fm_set<Unit>(88.0f));
+		Unit n = fm_round(fm_mul(x, fm_set<Unit>(c_ln2_r)));
+		Unit r = fm_sub(x, fm_mul(n, fm_set<Unit>(0.693359375f)));
+		r = fm_sub(r, fm_mul(n, fm_set<Unit>(-2.12194440e-4f)));
+
+		Unit p = fm_madd(fm_set<Unit>(1.9875691500e-4f), r, fm_set<Unit>(1.3981999507e-3f));
+		p = fm_madd(p, r, fm_set<Unit>(8.3334519073e-3f));
+		p = fm_madd(p, r, fm_set<Unit>(4.1665795894e-2f));
+		p = fm_madd(p, r, fm_set<Unit>(1.6666665459e-1f));
+		p = fm_madd(p, r, fm_set<Unit>(5.0000001201e-1f));
+		p = fm_madd(p, fm_mul(r, r), fm_add(r, fm_set<Unit>(1)));
+
+		return fm_mul(p, fm_pow2i(n));
+	}
+
+	template<typename Unit>
+	inline Unit fm_log_kernel(Unit x)
+	{
+		// x = m * 2^e with m in [sqrt(1/2), sqrt(2)), log(x) = e * ln2 + log(m)
+		Unit e = fm_exponent(x);
+		Unit m = fm_mantissa(x);
+		Unit big = fm_lt(fm_set<Unit>(c_sqrt2), m);
+		m = fm_select(big, fm_mul(m, fm_set<Unit>(0.5f)), m);
+		e = fm_select(big, fm_add(e, fm_set<Unit>(1)), e);
+
+		Unit f = fm_sub(m, fm_set<Unit>(1));
+		Unit z = fm_mul(f, f);
+		Unit p = fm_madd(fm_set<Unit>(7.0376836292e-2f), f, fm_set<Unit>(-1.1514610310e-1f));
+		p = fm_madd(p, f, fm_set<Unit>(1.1676998740e-1f));
+		p = fm_madd(p, f, fm_set<Unit>(-1.2420140846e-1f));
+		p = fm_madd(p, f, fm_set<Unit>(1.4249322787e-1f));
+		p = fm_madd(p, f, fm_set<Unit>(-1.6668057665e-1f));
+		p = fm_madd(p, f, fm_set<Unit>(2.0000714765e-1f));
+		p = fm_madd(p, f, fm_set<Unit>(-2.4999993993e-1f));
+		p = fm_madd(p, f, fm_set<Unit>(3.3333331174e-1f));
+		p = fm_mul(fm_mul(p, f), z);
+
+		// ln2 is split in two parts as in the exponential
+		p = fm_madd(e, fm_set<Unit>(-2.12194440e-4f), p);
+		p = fm_madd(z, fm_set<Unit>(-0.5f), p);
+		return fm_madd(e, fm_set<Unit>(0.693359375f), fm_add(f, p));
+	}
+
+	template<typename Unit>
+	inline Unit fm_pow_kernel(Unit x, Unit y)
+	{
+		return fm_exp_kernel(fm_mul(y, fm_log_kernel(x)));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// float, float4 and float8 entry points of a unary kernel
+	//////////////////////////////////////////////////////////////////////////
+#if defined(DYE_SIMD_SSE2)
+	#define DYE_FAST_MATH_FLOAT4(Name, Kernel)										\
+		inline float4 Name (const float4 &x)										\
+		{																			\
+			return float4(Kernel(x.simd()));										\
+		}
+#else
+	#define DYE_FAST_MATH_FLOAT4(Name, Kernel)										\
+		inline float4 Name (const float4 &x)										\
+		{																			\
+			return float4(Kernel(x.x), Kernel(x.y), Kernel(x.z), Kernel(x.w));		\
+		}
+#endif
+
+#if defined(DYE_SIMD_SSE2) || !defined(DYE_SIMD_SSE)
+	#define DYE_FAST_MATH_FLOAT8(Name, Kernel)										\
+		inline float8 Name (const float8 &x)										\
+		{																			\
+			float8 r;																\
+			for (size_t i = 0; i != c_packet_units; ++i) r.u[i] = Kernel(x.u[i]);	\
+			return r;																\
+		}
+#else
+	#define DYE_FAST_MATH_FLOAT8(Name, Kernel)										\
+		inline float8 Name (const float8 &x)										\
+		{																			\
+			float8 r;																\
+			for (size_t i = 0; i != c_packet_width; ++i) r[i] = Kernel(x[i]);		\
+			return r;																\
+		}
+#endif
+
+	#define DYE_FAST_MATH_UNARY(Name, Kernel)										\
+		inline float Name (float x)													\
+		{																			\
+			return Kernel(x);														\
+		}																			\
+		DYE_FAST_MATH_FLOAT4(Name, Kernel)											\
+		DYE_FAST_MATH_FLOAT8(Name, Kernel)
+
+	//////////////////////////////////////////////////////////////////////////
+	// reciprocal and reciprocal square root
+	//////////////////////////////////////////////////////////////////////////
+	// 1 / x, relative error <= 1.5 * 2^-12 for 2^-126 <= |x| <= 2^126
+	DYE_FAST_MATH_UNARY(rcp_est, fm_rcp_est)
+
+	// 1 / sqrt(x), relative error <= 1.5 * 2^-12 for normal x > 0
+	DYE_FAST_MATH_UNARY(rsqrt_est, fm_rsqrt_est)
+
+	// 1 / x, <= 3 ulp for 2^-126 <= |x| <= 2^126
+	DYE_FAST_MATH_UNARY(rcp_fast, fm_rcp_kernel)
+
+	// 1 / sqrt(x), <= 4 ulp for normal x > 0
+	DYE_FAST_MATH_UNARY(rsqrt_fast, fm_rsqrt_kernel)
+
+	// sqrt(x), <= 4 ulp for normal x > 0, exactly 0 for x = 0
+	DYE_FAST_MATH_UNARY(sqrt_fast, fm_sqrt_kernel)
+
+	//////////////////////////////////////////////////////////////////////////
+	// trigonometric functions
+	//////////////////////////////////////////////////////////////////////////
+	template<typename Unit> inline Unit fm_sin_kernel(Unit x) { return fm_sincos_kernel(x, 0); }
+	template<typename Unit> inline Unit fm_cos_kernel(Unit x) { return fm_sincos_kernel(x, 1); }
+
+	// sin(x), <= 1.6 ulp for |x| <= 64. up to |x| = 8192 the absolute error
+	// stays <= 1e-7 but the ulp error near the zeros grows with |x|.
+	DYE_FAST_MATH_UNARY(sin_fast, fm_sin_kernel)
+
+	// cos(x), same bounds as sin_fast
+	DYE_FAST_MATH_UNARY(cos_fast, fm_cos_kernel)
+
+	// acos(x) for |x| <= 1, absolute error <= 7e-7, i.e. about 3 ulp near pi
+	DYE_FAST_MATH_UNARY(acos_fast, fm_acos_kernel)
+
+	//////////////////////////////////////////////////////////////////////////
+	// exponential and logarithm
+	//////////////////////////////////////////////////////////////////////////
+	// e^x, <= 1.3 ulp for x in [-87, 88], x is clamped to that range
+	DYE_FAST_MATH_UNARY(exp_fast, fm_exp_kernel)
+
+	// ln(x), <= 0.9 ulp for normal x > 0
+	DYE_FAST_MATH_UNARY(log_fast, fm_log_kernel)
+
+	#undef DYE_FAST_MATH_UNARY
+	#undef DYE_FAST_MATH_FLOAT8
+	#undef DYE_FAST_MATH_FLOAT4
+
+	// x^y = e^(y * ln(x)) for x > 0. the error grows with |y * ln(x)|, it is
+	// <= 32 ulp for x in [1e-3, 1e3] and y in [-4, 4].
+	inline float pow_fast(float x, float y)
+	{
+		return fm_pow_kernel(x, y);
+	}
+
+	inline float4 pow_fast(const float4 &x, const float4 &y)
+	{
+#if defined(DYE_SIMD_SSE2)
+		return float4(fm_pow_kernel(x.simd(), y.simd()));
+#else
+		return float4(fm_pow_kernel(x.x, y.x), fm_pow_kernel(x.y, y.y), fm_pow_kernel(x.z, y.z), fm_pow_kernel(x.w, y.w));
+#endif
+	}
+
+	inline float8 pow_fast(const float8 &x, const float8 &y)
+	{
+		float8 r;
+#if defined(DYE_SIMD_SSE2) || !defined(DYE_SIMD_SSE)
+		for (size_t i = 0; i != c_packet_units; ++i) r.u[i] = fm_pow_kernel(x.u[i], y.u[i]);
+#else
+		for (size_t i = 0; i != c_packet_width; ++i) r[i] = fm_pow_kernel(x[i], y[i]);
+#endif
+		return r;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// vector length and normalization through sqrt_fast and rsqrt_fast, for
+	// the element types float and float8
+	//////////////////////////////////////////////////////////////////////////
+	template<typename Type>
+	inline Type length_fast(const vector_2t<Type> &operand)
+	{
+		return sqrt_fast(operand.length_sqr());
+	}
+
+	template<typename Type>
+	inline Type length_fast(const vector_3t<Type> &operand)
+	{
+		return sqrt_fast(operand.length_sqr());
+	}
+
+	template<typename Type>
+	inline Type length_fast(const vector_4t<Type> &operand)
+	{
+		return sqrt_fast(operand.length_sqr());
+	}
+
+	// the zero vector gives non-finite components, as normalize() does
+	template<typename Type>
+	inline vector_2t<Type> normalize_fast(const vector_2t<Type> &operand)
+	{
+		vector_2t<Type> vec(operand);
+		return vec *= rsqrt_fast(operand.length_sqr());
+	}
+
+	template<typename Type>
+	inline vector_3t<Type> normalize_fast(const vector_3t<Type> &operand)
+	{
+		vector_3t<Type> vec(operand);
+		return vec *= rsqrt_fast(operand.length_sqr());
+	}
+
+	template<typename Type>
+	inline vector_4t<Type> normalize_fast(const vector_4t<Type> &operand)
+	{
+		vector_4t<Type> vec(operand);
+		return vec *= rsqrt_fast(operand.length_sqr());
+	}
+}
+
+#endif // _FAST_MATH_HPP_
@@ -0,0 +1,195 @@
+#ifndef _FIXED_HPP_
+#define _FIXED_HPP_
+
+// signed fixed point numbers of IntegerBits.FractionBits bits in an int,
+// e.g. fixed<16, 16> for a range of +-32768 in steps of 2^-16. unlike
+// half the arithmetic is integral and exact up to the rounding of * and /,
+// so results do not depend on the compiler or the instruction set. the
+// sum and the difference wrap around when they leave the range, values
+// converted from outside the range are undefined.
+//
+// fixed works as the element type of vector_Nt and matrix_NxNt, e.g.
+// fixed3. it converts from int, float and double implicitly but to float
+// only through to_float(), and convert() widens and narrows whole arrays.
+
+#include <stddef.h>
+#include <cmath>
+
+#include "vector.hpp"
+
+namespace Dye
+{
+	template<int IntegerBits, int FractionBits>
+	struct fixed
+	{
+		BOOST_STATIC_ASSERT(IntegerBits + FractionBits == 32 && FractionBits > 0 && FractionBits < 31);
+
+	public:
+		static const int one = 1 << FractionBits;
+
+	public:
+		fixed()
+			: raw(0)
+		{
+		}
+
+		fixed(int value)
+			: raw(value * one)
+		{
+		}
+
+		// rounded to nearest even
+		fixed(float value)
+			: raw(round(static_cast<double>(value) * one))
+		{
+		}
+
+		fixed(double value)
+			: raw(round(value * one))
+		{
+		}
+
+		static fixed from_raw(int raw)
+		{
+			fixed f;
+			f.raw = raw;
+			return f;
+		}
+
+		float to_float() const
+		{
+			return static_cast<float>(raw) * (1.0f / one);
+		}
+
+		double to_double() const
+		{
+			return static_cast<double>(raw) * (1.0 / one);
+		}
+
+	public:
+		fixed& operator += (const fixed &rhs)
+		{
+			raw = static_cast<int>(static_cast<unsigned int>(raw) + static_cast<unsigned int>(rhs.raw));
+			return *this;
+		}
+
+		fixed& operator -= (const fixed &rhs)
+		{
+			raw = static_cast<int>(static_cast<unsigned int>(raw) - static_cast<unsigned int>(rhs.raw));
+			return *this;
+		}
+
+		// rounded to nearest, ties away from zero
+		fixed& operator *= (const fixed &rhs)
+		{
+			long long p = static_cast<long long>(raw) * rhs.raw;
+			long long bias = p < 0 ? (one >> 1) - 1 : (one >> 1);
+			raw = static_cast<int>((p + bias) >> FractionBits);
+			return *this;
+		}
+
+		// truncated towards zero, rhs must not be 0
+		fixed& operator /= (const fixed &rhs)
+		{
+			raw = static_cast<int>(static_cast<long long>(raw) * one / rhs.raw);
+			return *this;
+		}
+
+	public:
+		friend fixed operator + (fixed lhs, const fixed &rhs) { return lhs += rhs; }
+		friend fixed operator - (fixed lhs, const fixed &rhs) { return lhs -= rhs; }
+		friend fixed operator * (fixed lhs, const fixed &rhs) { return lhs *= rhs; }
+		friend fixed operator / (fixed lhs, const fixed &rhs) { return lhs /= rhs; }
+		friend fixed operator - (const fixed &operand) { return from_raw(-operand.raw); }
+
+		friend bool operator == (const fixed &lhs, const fixed &rhs) { return lhs.raw == rhs.raw; }
+		friend bool operator != (const fixed &lhs, const fixed &rhs) { return lhs.raw != rhs.raw; }
+		friend bool operator <  (const fixed &lhs, const fixed &rhs) { return lhs.raw <  rhs.raw; }
+		friend bool operator <= (const fixed &lhs, const fixed &rhs) { return lhs.raw <= rhs.raw; }
+		friend bool operator >  (const fixed &lhs, const fixed &rhs) { return lhs.raw >  rhs.raw; }
+		friend bool operator >= (const fixed &lhs, const fixed &rhs) { return lhs.raw >= rhs.raw; }
+
+		// of operand >= 0, correctly rounded; 0 otherwise
+		friend fixed sqrt(const fixed &operand)
+		{
+			return operand.raw > 0 ? fixed(std::sqrt(operand.to_double())) : fixed();
+		}
+
+		friend fixed abs(const fixed &operand)
+		{
+			return operand.raw < 0 ? -operand : operand;
+		}
+
+	private:
+		static int round(double scaled)
+		{
+			double lower = std::floor(scaled);
+			double rest = scaled - lower;
+			int r = static_cast<int>(lower);
+			return r + ((rest > 0.5 || (rest == 0.5 && (r & 1))) ? 1 : 0);
+		}
+
+	public:
+		int raw;
+	};
+
+	template<int IntegerBits, int FractionBits>
+	struct is_real<fixed<IntegerBits, FractionBits> > : boost::true_type
+	{
+	};
+
+	typedef fixed<16, 16> fixed16;
+	typedef vector_2t<fixed16> fixed2;
+	typedef vector_3t<fixed16> fixed3;
+	typedef vector_4t<fixed16> fixed4;
+
+	//////////////////////////////////////////////////////////////////////////
+	// bulk conversion, rounded as the constructors; in and out must not
+	// overlap. sse2 moves four elements per step.
+	//////////////////////////////////////////////////////////////////////////
+	template<int IntegerBits, int FractionBits>
+	void convert(const float *in, fixed<IntegerBits, FractionBits> *out, size_t n)
+	{
+		typedef fixed<IntegerBits, FractionBits> fixed_type;
+		size_t i = 0;
+
+#if defined(DYE_SIMD_SSE2)
+		// the scale is a power of two, so the product is exact and
+		// cvtps2dq rounds it to nearest even like the constructor
+		__m128 scale = _mm_set1_ps(static_cast<float>(fixed_type::one));
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128i r = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i), scale));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(&out[i].raw), r);
+		}
+#endif
+
+		for (; i != n; ++i)
+		{
+			out[i] = fixed_type(in[i]);
+		}
+	}
+
+	template<int IntegerBits, int FractionBits>
+	void convert(const fixed<IntegerBits, FractionBits> *in, float *out, size_t n)
+	{
+		typedef fixed<IntegerBits, FractionBits> fixed_type;
+		size_t i = 0;
+
+#if defined(DYE_SIMD_SSE2)
+		__m128 scale = _mm_set1_ps(1.0f / fixed_type::one);
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&in[i].raw));
+			_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(r), scale));
+		}
+#endif
+
+		for (; i != n; ++i)
+		{
+			out[i] = in[i].to_float();
+		}
+	}
+}
+
+#endif // _FIXED_HPP_
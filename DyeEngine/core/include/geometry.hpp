@@ -2,6 +2,12 @@
 #ifndef _GEOMETRY_HPP_
 #define _GEOMETRY_HPP_
 
+#include <float.h>
+#include <stddef.h>
+
+#include "primitive.hpp"
+#include "ray.hpp"
+
 namespace Dye
 {
 	namespace Graphics
@@ -11,21 +17,92 @@ namespace Dye
 
 		};
 
+		// geometry that can be read as an indexed triangle list. the
+		// accessors copy ranges, so that a call covers many elements.
 		class IMeshable
 		{
+		public:
+			virtual ~IMeshable() {}
+
+			virtual size_t vertex_count() const = 0;
+			virtual size_t triangle_count() const = 0;
 
+			// count vertices from first on
+			virtual void get_vertices(size_t first, size_t count, vertex *out) const = 0;
+
+			// the 3 * count indices of count triangles from first on
+			virtual void get_triangles(size_t first, size_t count, unsigned int *out) const = 0;
 		};
 
+		// geometry that rays can hit. a hit is the closest one within
+		// [tmin, tmax] of the ray; the packet forms leave misses with
+		// triangle c_no_hit, and occluded() tells whether there is any.
 		class IRayTraceable
 		{
+		public:
+			virtual ~IRayTraceable() {}
+
+			virtual aabb bounds() const = 0;
 
+			virtual bool intersect(const ray &r, hit &h) const = 0;
+			virtual bool occluded(const ray &r) const = 0;
+
+			virtual void intersect(const ray8 &r, hit8 &h) const = 0;
+
+			// a bit per occluded lane
+			virtual int occluded(const ray8 &r) const = 0;
 		};
 
+		// geometry given by a signed distance, negative inside. the
+		// distance may fall short of the true one but never exceed it
+		// anywhere in space, so that a ball of that radius around the point
+		// holds no surface; bounds() encloses the surface.
 		class IRayMarchable
 		{
+		public:
+			virtual ~IRayMarchable() {}
+
+			virtual aabb bounds() const = 0;
+
+			virtual float distance(const float3 &p) const = 0;
+
+			// the distances of 8 points at once
+			virtual float8 distance(const float3x8 &p) const = 0;
+		};
+
+		// the points origin + spacing * (first + i) for i from 0 to count
+		// along each axis. the coordinates depend on the index alone, so
+		// that lattices that overlap share their points bitwise
+		struct lattice
+		{
+			float3 origin;
+			float spacing;
+			int first[3];
+			size_t count[3];
+
+			float coordinate(int axis, int index) const { return origin[axis] + spacing * index; }
+			size_t size() const { return count[0] * count[1] * count[2]; }
+		};
+
+		// a field of values in space, negative inside the surface, read a
+		// lattice at a time so that a call covers many points
+		class IScalarField
+		{
+		public:
+			virtual ~IScalarField() {}
+
+			// the values at the points of grid, x fastest
+			virtual void sample_grid(const lattice &grid, float *out) const = 0;
 
+			// bounds on the values within box, up to rounding, as far as the
+			// field tells them cheaply; none by default
+			virtual void range(const aabb &, float &lower, float &upper) const
+			{
+				lower = -FLT_MAX;
+				upper = FLT_MAX;
+			}
 		};
 	}
 }
 
-#endif // _GEOMETRY_HPP_
\ No newline at end of file
+#endif // _GEOMETRY_HPP_
@@ -0,0 +1,212 @@
+#ifndef _HALF_HPP_
+#define _HALF_HPP_
+
+// ieee 754 binary16. rounding is to nearest even, values beyond 65504
+// become infinity, nans stay quiet nans and denormals are kept on both
+// sides.
+//
+// half is a storage type: it converts to float implicitly, so arithmetic
+// on halves is done in float and rounded once when stored back. it works
+// as the element type of vector_Nt and matrix_NxNt, e.g. half3. large
+// arrays are widened and narrowed with convert(), which uses f16c where
+// the processor has it (see cpu_dispatch.hpp).
+
+#include <stddef.h>
+#include <string.h>
+#include <cmath>
+
+#include "vector.hpp"
+
+namespace Dye
+{
+	//////////////////////////////////////////////////////////////////////////
+	// bit pattern conversions
+	//////////////////////////////////////////////////////////////////////////
+	inline unsigned short half_from_float(float value)
+	{
+		const unsigned int c_f32_infinity = 255u << 23;
+		const unsigned int c_f16_overflow = (127u + 16) << 23;
+		const unsigned int c_f16_min_normal = (127u - 14) << 23;
+		const unsigned int c_denormal_magic = ((127u - 15) + (23 - 10) + 1) << 23;
+
+		unsigned int u;
+		memcpy(&u, &value, sizeof(u));
+		unsigned int sign = u & 0x80000000u;
+		u ^= sign;
+
+		unsigned int h;
+		if (u >= c_f16_overflow)
+		{
+			h = u > c_f32_infinity ? 0x7e00 : 0x7c00;
+		}
+		else if (u < c_f16_min_normal)
+		{
+			// the float add shifts the mantissa into place and rounds it
+			float f, magic;
+			memcpy(&f, &u, sizeof(f));
+			memcpy(&magic, &c_denormal_magic, sizeof(magic));
+			f += magic;
+			memcpy(&h, &f, sizeof(h));
+			h -= c_denormal_magic;
+		}
+		else
+		{
+			unsigned int odd = (u >> 13) & 1;
+			u += ((15u - 127) << 23) + 0xfff + odd;
+			h = u >> 13;
+		}
+		return static_cast<unsigned short>(h | (sign >> 16));
+	}
+
+	inline float half_to_float(unsigned short value)
+	{
+		const unsigned int c_shifted_exponent = 0x7c00u << 13;
+		const unsigned int c_denormal_magic = 113u << 23;
+
+		unsigned int u = (value & 0x7fffu) << 13;
+		unsigned int exponent = u & c_shifted_exponent;
+		u += (127u - 15) << 23;
+
+		if (exponent == c_shifted_exponent)
+		{
+			// infinity or nan
+			u += (128u - 16) << 23;
+		}
+		else if (exponent == 0)
+		{
+			// zero or denormal, renormalized by the float subtract
+			float f, magic;
+			u += 1 << 23;
+			memcpy(&f, &u, sizeof(f));
+			memcpy(&magic, &c_denormal_magic, sizeof(magic));
+			f -= magic;
+			memcpy(&u, &f, sizeof(u));
+		}
+
+		u |= static_cast<unsigned int>(value & 0x8000u) << 16;
+		float f;
+		memcpy(&f, &u, sizeof(f));
+		return f;
+	}
+
+#if defined(DYE_SIMD_SSE2)
+	// the same on the low 16 bits of four lanes, the high ones are zero
+	inline __m128 half_to_float(__m128i h)
+	{
+		const __m128i no_sign = _mm_set1_epi32(0x7fff);
+		const __m128i max_finite = _mm_set1_epi32(0x7bff);
+		const __m128i infinity = _mm_set1_epi32(255 << 23);
+		// 2^112, rebiases the exponent and normalizes the denormals
+		const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+
+		__m128i magnitude = _mm_and_si128(h, no_sign);
+		__m128i sign = _mm_slli_epi32(_mm_xor_si128(h, magnitude), 16);
+		__m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(magnitude, 13)), magic);
+		__m128i special = _mm_and_si128(_mm_cmpgt_epi32(magnitude, max_finite), infinity);
+		return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, special)));
+	}
+
+	inline __m128i half_from_float(__m128 f)
+	{
+		const __m128i overflow = _mm_set1_epi32((127 + 16) << 23);
+		const __m128i min_normal = _mm_set1_epi32((127 - 14) << 23);
+		const __m128i denormal_magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+		const __m128i normal_bias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+		const __m128i infinity = _mm_set1_epi32(0x7c00);
+		const __m128i quiet = _mm_set1_epi32(0x200);
+
+		__m128i bits = _mm_castps_si128(f);
+		__m128i sign = _mm_and_si128(bits, _mm_castps_si128(_mm_set1_ps(-0.0f)));
+		__m128i magnitude = _mm_xor_si128(bits, sign);
+		__m128 absf = _mm_castsi128_ps(magnitude);
+
+		__m128i nan = _mm_castps_si128(_mm_cmpunord_ps(absf, absf));
+		__m128i special = _mm_or_si128(infinity, _mm_and_si128(nan, quiet));
+
+		__m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absf, _mm_castsi128_ps(denormal_magic))), denormal_magic);
+		__m128i odd = _mm_and_si128(_mm_srli_epi32(magnitude, 13), _mm_set1_epi32(1));
+		__m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(magnitude, normal_bias), odd), 13);
+
+		__m128i is_denormal = _mm_cmpgt_epi32(min_normal, magnitude);
+		__m128i is_regular = _mm_cmpgt_epi32(overflow, magnitude);
+		__m128i h = _mm_or_si128(_mm_and_si128(is_denormal, denormal), _mm_andnot_si128(is_denormal, normal));
+		h = _mm_or_si128(_mm_and_si128(is_regular, h), _mm_andnot_si128(is_regular, special));
+		return _mm_or_si128(h, _mm_srli_epi32(sign, 16));
+	}
+#endif
+
+	//////////////////////////////////////////////////////////////////////////
+	// half
+	//////////////////////////////////////////////////////////////////////////
+	struct half
+	{
+	public:
+		half()
+			: bits(0)
+		{
+		}
+
+		half(float value)
+			: bits(half_from_float(value))
+		{
+		}
+
+		static half from_bits(unsigned short bits)
+		{
+			half h;
+			h.bits = bits;
+			return h;
+		}
+
+		operator float() const
+		{
+			return half_to_float(bits);
+		}
+
+	public:
+		half& operator += (const half &rhs) { return *this = float(*this) + float(rhs); }
+		half& operator -= (const half &rhs) { return *this = float(*this) - float(rhs); }
+		half& operator *= (const half &rhs) { return *this = float(*this) * float(rhs); }
+		half& operator /= (const half &rhs) { return *this = float(*this) / float(rhs); }
+
+	public:
+		unsigned short bits;
+	};
+
+	// exact matches for the mixed expressions, which the unconstrained
+	// scalar templates of the vector operators would make ambiguous
+	#define DYE_HALF_BINARY(Op)																			\
+		inline float operator Op (const half &lhs, const half &rhs)	{ return float(lhs) Op float(rhs); }	\
+		inline float operator Op (const half &lhs, float rhs)		{ return float(lhs) Op rhs; }			\
+		inline float operator Op (float lhs, const half &rhs)		{ return lhs Op float(rhs); }
+
+	DYE_HALF_BINARY(+)
+	DYE_HALF_BINARY(-)
+	DYE_HALF_BINARY(*)
+	DYE_HALF_BINARY(/)
+
+	#undef DYE_HALF_BINARY
+
+	template<>
+	struct is_real<half> : boost::true_type
+	{
+	};
+
+	// exact matches, so that they win over the std and float8 overloads
+	inline half sqrt(const half &operand) { return std::sqrt(float(operand)); }
+	inline half abs(const half &operand) { return half::from_bits(operand.bits & 0x7fff); }
+
+	typedef vector_2t<half> half2;
+	typedef vector_3t<half> half3;
+	typedef vector_4t<half> half4;
+
+	//////////////////////////////////////////////////////////////////////////
+	// bulk conversion
+	//
+	// n elements, split over the openmp threads. in and out must not overlap.
+	//////////////////////////////////////////////////////////////////////////
+	void convert(const float *in, half *out, size_t n);
+	void convert(const half *in, float *out, size_t n);
+}
+
+#endif // _HALF_HPP_
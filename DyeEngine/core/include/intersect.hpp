@@ -0,0 +1,506 @@
+#ifndef _INTERSECT_HPP_
+#define _INTERSECT_HPP_
+
+// ray intersection kernels for boxes, triangles and spheres, each for one
+// ray against one primitive, one ray against several side by side (4 or 8
+// boxes, 8 triangles or spheres) and a packet of 8 rays against one. all
+// hit in [tmin, tmax], t counted in lengths of the direction.
+//
+// boxes take the slab test with the reciprocal of the direction, computed
+// once per ray; an axis parallel ray divides to infinity and still comes
+// out right, unless its origin lies on a slab plane.
+//
+// triangles come two ways, both two sided, with u and v the weights of v1
+// and v2:
+// - moller and trumbore, "fast, minimum storage ray/triangle
+//   intersection", the fewest operations, but a ray through the edge two
+//   triangles share may miss both;
+// - woop, benthin and wald, "watertight ray/triangle intersection", which
+//   shears the ray onto the z axis once per ray, so that neighbours
+//   compute their common edge exactly alike and one of them is hit.
+//
+// spheres solve for the point of the ray closest to the center first,
+// which keeps the roots precise far from the origin (haines et al.,
+// "precision improvements for ray / sphere intersection").
+
+#include <algorithm>
+#include <cmath>
+
+#include "ray.hpp"
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		// four boxes side by side, as a 4 wide node keeps its children
+		struct DYE_ALIGN(16) aabb4
+		{
+			float lower[3][4];
+			float upper[3][4];
+		};
+
+		struct aabb8
+		{
+			float3x8 lower;
+			float3x8 upper;
+		};
+
+		struct triangle8
+		{
+			float3x8 v0;
+			float3x8 v1;
+			float3x8 v2;
+		};
+
+		struct sphere8
+		{
+			float3x8 center;
+			float8 radius;
+		};
+
+		// the axes that become x, y and z with the direction on z, and the
+		// shear that takes it there
+		struct ray_shear
+		{
+			int kx;
+			int ky;
+			int kz;
+			float sx;
+			float sy;
+			float sz;
+		};
+
+		// the same per lane, the axes as masks of the lanes where they are
+		// x (first) and y (second); z is where neither is
+		struct ray_shear8
+		{
+			float8 kx[2];
+			float8 ky[2];
+			float8 kz[2];
+			float8 sx;
+			float8 sy;
+			float8 sz;
+		};
+
+		//////////////////////////////////////////////////////////////////////////
+		// per ray
+		//////////////////////////////////////////////////////////////////////////
+		inline float3 reciprocal(const float3 &direction)
+		{
+			return float3(1 / direction.x, 1 / direction.y, 1 / direction.z);
+		}
+
+		inline float3x8 reciprocal(const float3x8 &direction)
+		{
+			float3x8 inv;
+			inv.x = float8(1.0f) / direction.x;
+			inv.y = float8(1.0f) / direction.y;
+			inv.z = float8(1.0f) / direction.z;
+			return inv;
+		}
+
+		inline ray_shear watertight_shear(const float3 &direction)
+		{
+			ray_shear s;
+			float ax = std::abs(direction.x);
+			float ay = std::abs(direction.y);
+			float az = std::abs(direction.z);
+			s.kz = ax >= ay && ax >= az ? 0 : ay >= az ? 1 : 2;
+			s.kx = s.kz == 2 ? 0 : s.kz + 1;
+			s.ky = s.kx == 2 ? 0 : s.kx + 1;
+
+			// keeps the winding, so the sign of the determinant
+			if (direction[s.kz] < 0)
+			{
+				std::swap(s.kx, s.ky);
+			}
+			s.sx = direction[s.kx] / direction[s.kz];
+			s.sy = direction[s.ky] / direction[s.kz];
+			s.sz = 1 / direction[s.kz];
+			return s;
+		}
+
+		inline ray_shear8 watertight_shear(const float3x8 &direction)
+		{
+			float8 axes[3];
+			ray_shear8 s;
+			for (size_t lane = 0; lane != c_packet_width; ++lane)
+			{
+				ray_shear one = watertight_shear(float3(direction.x[lane], direction.y[lane], direction.z[lane]));
+				axes[0][lane] = static_cast<float>(one.kx);
+				axes[1][lane] = static_cast<float>(one.ky);
+				axes[2][lane] = static_cast<float>(one.kz);
+				s.sx[lane] = one.sx;
+				s.sy[lane] = one.sy;
+				s.sz[lane] = one.sz;
+			}
+			const float8 zero(0.0f);
+			const float8 one(1.0f);
+			s.kx[0] = axes[0] == zero;
+			s.kx[1] = axes[0] == one;
+			s.ky[0] = axes[1] == zero;
+			s.ky[1] = axes[1] == one;
+			s.kz[0] = axes[2] == zero;
+			s.kz[1] = axes[2] == one;
+			return s;
+		}
+
+		// the component of each lane the masks name
+		inline float8 pick(const float3x8 &v, const float8 *k)
+		{
+			return select(k[0], v.x, select(k[1], v.y, v.z));
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// boxes
+		//////////////////////////////////////////////////////////////////////////
+
+		// entry receives where the ray goes in
+		inline bool intersect_box(const float3 &lower, const float3 &upper, const float3 &origin, const float3 &inv,
+			float tmin, float tmax, float &entry)
+		{
+			float x0 = (lower.x - origin.x) * inv.x;
+			float x1 = (upper.x - origin.x) * inv.x;
+			float y0 = (lower.y - origin.y) * inv.y;
+			float y1 = (upper.y - origin.y) * inv.y;
+			float z0 = (lower.z - origin.z) * inv.z;
+			float z1 = (upper.z - origin.z) * inv.z;
+			entry = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), tmin));
+			float exit = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), tmax));
+			return entry <= exit;
+		}
+
+		inline bool intersect_box(const aabb &box, const float3 &origin, const float3 &inv, float tmin, float tmax,
+			float &entry)
+		{
+			return intersect_box(box.lower, box.upper, origin, inv, tmin, tmax, entry);
+		}
+
+		// a bit per box hit
+		inline int intersect_boxes(const aabb4 &boxes, const float3 &origin, const float3 &inv, float tmin, float tmax,
+			float *entries)
+		{
+#if defined(DYE_SIMD_SSE)
+			__m128 entry = _mm_set1_ps(tmin);
+			__m128 exit = _mm_set1_ps(tmax);
+			for (int k = 0; k != 3; ++k)
+			{
+				__m128 o = _mm_set1_ps(origin[k]);
+				__m128 i = _mm_set1_ps(inv[k]);
+				__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxes.lower[k]), o), i);
+				__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxes.upper[k]), o), i);
+				entry = _mm_max_ps(entry, _mm_min_ps(t0, t1));
+				exit = _mm_min_ps(exit, _mm_max_ps(t0, t1));
+			}
+			_mm_storeu_ps(entries, entry);
+			return _mm_movemask_ps(_mm_cmple_ps(entry, exit));
+#else
+			int bits = 0;
+			for (int b = 0; b != 4; ++b)
+			{
+				float3 lower(boxes.lower[0][b], boxes.lower[1][b], boxes.lower[2][b]);
+				float3 upper(boxes.upper[0][b], boxes.upper[1][b], boxes.upper[2][b]);
+				bits |= intersect_box(lower, upper, origin, inv, tmin, tmax, entries[b]) << b;
+			}
+			return bits;
+#endif
+		}
+
+		inline int intersect_boxes(const aabb8 &boxes, const float3 &origin, const float3 &inv, float tmin, float tmax,
+			float8 &entry)
+		{
+			float8 x0 = (boxes.lower.x - float8(origin.x)) * float8(inv.x);
+			float8 x1 = (boxes.upper.x - float8(origin.x)) * float8(inv.x);
+			float8 y0 = (boxes.lower.y - float8(origin.y)) * float8(inv.y);
+			float8 y1 = (boxes.upper.y - float8(origin.y)) * float8(inv.y);
+			float8 z0 = (boxes.lower.z - float8(origin.z)) * float8(inv.z);
+			float8 z1 = (boxes.upper.z - float8(origin.z)) * float8(inv.z);
+			entry = max(max(min(x0, x1), min(y0, y1)), max(min(z0, z1), float8(tmin)));
+			float8 exit = min(min(max(x0, x1), max(y0, y1)), min(max(z0, z1), float8(tmax)));
+			return movemask(entry <= exit);
+		}
+
+		// a mask of the lanes hit
+		inline float8 intersect_box(const float3 &lower, const float3 &upper, const float3x8 &origin, const float3x8 &inv,
+			const float8 &tmin, const float8 &tmax, float8 &entry)
+		{
+			float8 x0 = (float8(lower.x) - origin.x) * inv.x;
+			float8 x1 = (float8(upper.x) - origin.x) * inv.x;
+			float8 y0 = (float8(lower.y) - origin.y) * inv.y;
+			float8 y1 = (float8(upper.y) - origin.y) * inv.y;
+			float8 z0 = (float8(lower.z) - origin.z) * inv.z;
+			float8 z1 = (float8(upper.z) - origin.z) * inv.z;
+			entry = max(max(min(x0, x1), min(y0, y1)), max(min(z0, z1), tmin));
+			float8 exit = min(min(max(x0, x1), max(y0, y1)), min(max(z0, z1), tmax));
+			return entry <= exit;
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// triangles, moller and trumbore
+		//////////////////////////////////////////////////////////////////////////
+		// with the edges from v0 to v1 and v2 kept beside the vertex
+		inline bool intersect_triangle_edges(const float3 &v0, const float3 &e1, const float3 &e2,
+			const float3 &origin, const float3 &direction, float tmin, float tmax, float &t, float &u, float &v)
+		{
+			float3 p = cross(direction, e2);
+			float det = dot(e1, p);
+			if (det == 0)
+			{
+				return false;
+			}
+			float inv_det = 1 / det;
+
+			float3 s = origin - v0;
+			u = dot(s, p) * inv_det;
+			if (u < 0 || u > 1)
+			{
+				return false;
+			}
+			float3 q = cross(s, e1);
+			v = dot(direction, q) * inv_det;
+			if (v < 0 || u + v > 1)
+			{
+				return false;
+			}
+			t = dot(e2, q) * inv_det;
+			return t >= tmin && t <= tmax;
+		}
+
+		inline bool intersect_triangle(const float3 &v0, const float3 &v1, const float3 &v2,
+			const float3 &origin, const float3 &direction, float tmin, float tmax, float &t, float &u, float &v)
+		{
+			const float3 e1 = v1 - v0;
+			const float3 e2 = v2 - v0;
+			return intersect_triangle_edges(v0, e1, e2, origin, direction, tmin, tmax, t, u, v);
+		}
+
+		// a mask of the lanes hit
+		inline float8 intersect_triangle_edges(const float3x8 &v0, const float3x8 &e1, const float3x8 &e2,
+			const float3x8 &origin, const float3x8 &d, const float8 &tmin, const float8 &tmax,
+			float8 &t, float8 &u, float8 &v)
+		{
+			float8 px = d.y * e2.z - d.z * e2.y;
+			float8 py = d.z * e2.x - d.x * e2.z;
+			float8 pz = d.x * e2.y - d.y * e2.x;
+			float8 det = e1.x * px + e1.y * py + e1.z * pz;
+			float8 inv_det = float8(1.0f) / det;
+
+			float8 sx = origin.x - v0.x;
+			float8 sy = origin.y - v0.y;
+			float8 sz = origin.z - v0.z;
+			u = (sx * px + sy * py + sz * pz) * inv_det;
+
+			float8 qx = sy * e1.z - sz * e1.y;
+			float8 qy = sz * e1.x - sx * e1.z;
+			float8 qz = sx * e1.y - sy * e1.x;
+			v = (d.x * qx + d.y * qy + d.z * qz) * inv_det;
+			t = (e2.x * qx + e2.y * qy + e2.z * qz) * inv_det;
+
+			const float8 zero(0.0f);
+			return (det != zero) & (u >= zero) & (v >= zero) & (u + v <= float8(1.0f)) & (t >= tmin) & (t <= tmax);
+		}
+
+		// a bit per triangle hit, t, u and v per lane
+		inline int intersect_triangles(const triangle8 &tris, const float3 &origin, const float3 &direction,
+			float tmin, float tmax, float8 &t, float8 &u, float8 &v)
+		{
+			float3x8 o(float8(origin.x), float8(origin.y), float8(origin.z));
+			float3x8 d(float8(direction.x), float8(direction.y), float8(direction.z));
+			float3x8 e1(tris.v1.x - tris.v0.x, tris.v1.y - tris.v0.y, tris.v1.z - tris.v0.z);
+			float3x8 e2(tris.v2.x - tris.v0.x, tris.v2.y - tris.v0.y, tris.v2.z - tris.v0.z);
+			return movemask(intersect_triangle_edges(tris.v0, e1, e2, o, d, float8(tmin), float8(tmax), t, u, v));
+		}
+
+		inline float8 intersect_triangle_edges(const float3 &v0, const float3 &e1, const float3 &e2,
+			const float3x8 &origin, const float3x8 &direction, const float8 &tmin, const float8 &tmax,
+			float8 &t, float8 &u, float8 &v)
+		{
+			float3x8 a(float8(v0.x), float8(v0.y), float8(v0.z));
+			float3x8 e1s(float8(e1.x), float8(e1.y), float8(e1.z));
+			float3x8 e2s(float8(e2.x), float8(e2.y), float8(e2.z));
+			return intersect_triangle_edges(a, e1s, e2s, origin, direction, tmin, tmax, t, u, v);
+		}
+
+		inline float8 intersect_triangle(const float3 &v0, const float3 &v1, const float3 &v2,
+			const float3x8 &origin, const float3x8 &direction, const float8 &tmin, const float8 &tmax,
+			float8 &t, float8 &u, float8 &v)
+		{
+			const float3 e1 = v1 - v0;
+			const float3 e2 = v2 - v0;
+			return intersect_triangle_edges(v0, e1, e2, origin, direction, tmin, tmax, t, u, v);
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// triangles, watertight
+		//////////////////////////////////////////////////////////////////////////
+		inline bool intersect_triangle(const float3 &v0, const float3 &v1, const float3 &v2,
+			const float3 &origin, const ray_shear &shear, float tmin, float tmax, float &t, float &u, float &v)
+		{
+			const float3 a = v0 - origin;
+			const float3 b = v1 - origin;
+			const float3 c = v2 - origin;
+			const float ax = a[shear.kx] - shear.sx * a[shear.kz];
+			const float ay = a[shear.ky] - shear.sy * a[shear.kz];
+			const float bx = b[shear.kx] - shear.sx * b[shear.kz];
+			const float by = b[shear.ky] - shear.sy * b[shear.kz];
+			const float cx = c[shear.kx] - shear.sx * c[shear.kz];
+			const float cy = c[shear.ky] - shear.sy * c[shear.kz];
+
+			// the edge functions in double, where the products are exact and
+			// the difference rounds once, so that a fused multiply add cannot
+			// make the two sides of an edge disagree
+			const float eu = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+			const float ev = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+			const float ew = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+			if ((eu < 0 || ev < 0 || ew < 0) && (eu > 0 || ev > 0 || ew > 0))
+			{
+				return false;
+			}
+			float det = eu + ev + ew;
+			if (det == 0)
+			{
+				return false;
+			}
+
+			float inv_det = 1 / det;
+			float tz = eu * a[shear.kz] + ev * b[shear.kz] + ew * c[shear.kz];
+			t = tz * shear.sz * inv_det;
+			u = ev * inv_det;
+			v = ew * inv_det;
+			return t >= tmin && t <= tmax;
+		}
+
+		// a * b - c * d with the sign always right (kahan), so that the two
+		// triangles of an edge agree on it also where fma would otherwise
+		// round one product and not the other
+		inline float8 difference_of_products(const float8 &a, const float8 &b, const float8 &c, const float8 &d)
+		{
+			const float8 cd = c * d;
+			const float8 error = madd(-c, d, cd);
+			return madd(a, b, -cd) + error;
+		}
+
+		inline int intersect_triangles(const triangle8 &tris, const float3 &origin, const ray_shear &shear,
+			float tmin, float tmax, float8 &t, float8 &u, float8 &v)
+		{
+			const float3x8 a(tris.v0.x - float8(origin.x), tris.v0.y - float8(origin.y), tris.v0.z - float8(origin.z));
+			const float3x8 b(tris.v1.x - float8(origin.x), tris.v1.y - float8(origin.y), tris.v1.z - float8(origin.z));
+			const float3x8 c(tris.v2.x - float8(origin.x), tris.v2.y - float8(origin.y), tris.v2.z - float8(origin.z));
+			const float8 sx(shear.sx);
+			const float8 sy(shear.sy);
+			const float8 ax = a[shear.kx] - sx * a[shear.kz];
+			const float8 ay = a[shear.ky] - sy * a[shear.kz];
+			const float8 bx = b[shear.kx] - sx * b[shear.kz];
+			const float8 by = b[shear.ky] - sy * b[shear.kz];
+			const float8 cx = c[shear.kx] - sx * c[shear.kz];
+			const float8 cy = c[shear.ky] - sy * c[shear.kz];
+
+			const float8 eu = difference_of_products(cx, by, cy, bx);
+			const float8 ev = difference_of_products(ax, cy, ay, cx);
+			const float8 ew = difference_of_products(bx, ay, by, ax);
+			const float8 zero(0.0f);
+			const float8 negative = (eu < zero) | (ev < zero) | (ew < zero);
+			const float8 positive = (eu > zero) | (ev > zero) | (ew > zero);
+			const float8 det = eu + ev + ew;
+
+			const float8 inv_det = float8(1.0f) / det;
+			t = (eu * a[shear.kz] + ev * b[shear.kz] + ew * c[shear.kz]) * float8(shear.sz) * inv_det;
+			u = ev * inv_det;
+			v = ew * inv_det;
+			return movemask(andnot(negative & positive, (det != zero) & (t >= float8(tmin)) & (t <= float8(tmax))));
+		}
+
+		inline float8 intersect_triangle(const float3 &v0, const float3 &v1, const float3 &v2,
+			const float3x8 &origin, const ray_shear8 &shear, const float8 &tmin, const float8 &tmax,
+			float8 &t, float8 &u, float8 &v)
+		{
+			const float3x8 a(float8(v0.x) - origin.x, float8(v0.y) - origin.y, float8(v0.z) - origin.z);
+			const float3x8 b(float8(v1.x) - origin.x, float8(v1.y) - origin.y, float8(v1.z) - origin.z);
+			const float3x8 c(float8(v2.x) - origin.x, float8(v2.y) - origin.y, float8(v2.z) - origin.z);
+			const float8 az = pick(a, shear.kz);
+			const float8 bz = pick(b, shear.kz);
+			const float8 cz = pick(c, shear.kz);
+			const float8 ax = pick(a, shear.kx) - shear.sx * az;
+			const float8 ay = pick(a, shear.ky) - shear.sy * az;
+			const float8 bx = pick(b, shear.kx) - shear.sx * bz;
+			const float8 by = pick(b, shear.ky) - shear.sy * bz;
+			const float8 cx = pick(c, shear.kx) - shear.sx * cz;
+			const float8 cy = pick(c, shear.ky) - shear.sy * cz;
+
+			const float8 eu = difference_of_products(cx, by, cy, bx);
+			const float8 ev = difference_of_products(ax, cy, ay, cx);
+			const float8 ew = difference_of_products(bx, ay, by, ax);
+			const float8 zero(0.0f);
+			const float8 negative = (eu < zero) | (ev < zero) | (ew < zero);
+			const float8 positive = (eu > zero) | (ev > zero) | (ew > zero);
+			const float8 det = eu + ev + ew;
+
+			const float8 inv_det = float8(1.0f) / det;
+			t = (eu * az + ev * bz + ew * cz) * shear.sz * inv_det;
+			u = ev * inv_det;
+			v = ew * inv_det;
+			return andnot(negative & positive, (det != zero) & (t >= tmin) & (t <= tmax));
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// spheres
+		//////////////////////////////////////////////////////////////////////////
+
+		// the nearer root in [tmin, tmax], or the farther one from inside
+		inline bool intersect_sphere(const float3 &center, float radius, const float3 &origin, const float3 &direction,
+			float tmin, float tmax, float &t)
+		{
+			const float3 f = origin - center;
+			const float a = dot(direction, direction);
+			const float closest = -dot(f, direction) / a;
+			const float3 l = f + direction * closest;
+			const float h = radius * radius - dot(l, l);
+			if (h < 0)
+			{
+				return false;
+			}
+			const float half_chord = std::sqrt(h / a);
+			t = closest - half_chord;
+			if (t < tmin)
+			{
+				t = closest + half_chord;
+			}
+			return t >= tmin && t <= tmax;
+		}
+
+		inline float8 intersect_sphere(const float3x8 &center, const float8 &radius, const float3x8 &origin,
+			const float3x8 &direction, const float8 &tmin, const float8 &tmax, float8 &t)
+		{
+			const float8 fx = origin.x - center.x;
+			const float8 fy = origin.y - center.y;
+			const float8 fz = origin.z - center.z;
+			const float8 a = direction.x * direction.x + direction.y * direction.y + direction.z * direction.z;
+			const float8 closest = -(fx * direction.x + fy * direction.y + fz * direction.z) / a;
+			const float8 lx = fx + direction.x * closest;
+			const float8 ly = fy + direction.y * closest;
+			const float8 lz = fz + direction.z * closest;
+			const float8 h = radius * radius - (lx * lx + ly * ly + lz * lz);
+			const float8 half_chord = sqrt(max(h, float8(0.0f)) / a);
+			const float8 t0 = closest - half_chord;
+			t = select(t0 < tmin, closest + half_chord, t0);
+			return (h >= float8(0.0f)) & (t >= tmin) & (t <= tmax);
+		}
+
+		inline int intersect_spheres(const sphere8 &spheres, const float3 &origin, const float3 &direction,
+			float tmin, float tmax, float8 &t)
+		{
+			float3x8 o(float8(origin.x), float8(origin.y), float8(origin.z));
+			float3x8 d(float8(direction.x), float8(direction.y), float8(direction.z));
+			return movemask(intersect_sphere(spheres.center, spheres.radius, o, d, float8(tmin), float8(tmax), t));
+		}
+
+		inline float8 intersect_sphere(const float3 &center, float radius, const float3x8 &origin,
+			const float3x8 &direction, const float8 &tmin, const float8 &tmax, float8 &t)
+		{
+			float3x8 c(float8(center.x), float8(center.y), float8(center.z));
+			return intersect_sphere(c, float8(radius), origin, direction, tmin, tmax, t);
+		}
+	}
+}
+
+#endif // _INTERSECT_HPP_
@@ -0,0 +1,100 @@
+#ifndef _MARCHING_CUBES_HPP_
+#define _MARCHING_CUBES_HPP_
+
+// marching cubes for Render::MarchingCube: the surface where a scalar
+// field crosses a value, as an indexed triangle list (lorensen and cline,
+// "marching cubes").
+//
+// the grid splits into chunks of c_mc_chunk cells along each side for the
+// openmp threads. a chunk samples its points through the field as one
+// lattice, with a point of margin around it for the gradients, so that
+// the field evaluates them in batches: SdfProgram 16 points per
+// instruction, SdfBlocks with the pruned program of each leaf. a chunk
+// whose range, as the field gives it, stays a cell clear of the value is
+// not sampled at all, and one whose points all fall on one side of it
+// stops there; the others take two passes:
+// - each places a vertex on the edges the surface crosses from its own
+//   points on, those of its low sides included and those of its high
+//   sides left to the chunks next to it, and keeps the index of each in a
+//   cache over its edges, 16 bits an edge,
+// - after a prefix sum over the vertices of the chunks, each emits the
+//   triangles of its cells, the edges on its high sides read from the
+//   caches of its neighbours,
+// so that an edge has one vertex, welded without a hash.
+//
+// the triangles of the 256 cases come from tracing the surface around the
+// faces of the cube rather than from a table typed in: on each face the
+// crossings pair up, where two opposite corners are inside they stay
+// apart, and the pieces chain into loops fanned into triangles. the cubes
+// on either side of a face pair it alike, so that the surface has no
+// cracks, and no fan draws a diagonal across a face, which the cube on the
+// other side might draw too. the triangles turn counter-clockwise seen from above the value,
+// and the normals follow the gradient, by central differences at the
+// points, interpolated along the edge.
+
+#include <stddef.h>
+#include <vector>
+
+#include "geometry.hpp"
+#include "mesh.hpp"
+
+namespace Dye
+{
+	namespace Render
+	{
+		// the cells of a chunk along each side
+		const size_t c_mc_chunk = 16;
+
+		struct mc_stats
+		{
+			// the chunks of the grid, and those the surface crosses
+			size_t chunks;
+			size_t surface_chunks;
+
+			size_t vertices;
+			size_t triangles;
+			double seconds;
+		};
+
+		class MarchingCubes
+		{
+		public:
+			// nx by ny by nz cells of cell_size from origin on; the field must
+			// outlive the extractor, and give a point the same value in any
+			// lattice
+			MarchingCubes(const Graphics::IScalarField &field, const float3 &origin, float cell_size,
+				size_t nx, size_t ny, size_t nz);
+
+			// the value of the surface, 0 by default; the points below it
+			// are inside
+			void set_iso(float iso) { m_iso = iso; }
+
+			mc_stats extract(std::vector<Graphics::vertex> &vertices, std::vector<unsigned int> &indices) const;
+			mc_stats extract(Graphics::Mesh &mesh) const;
+
+		public:
+			float iso() const { return m_iso; }
+			size_t cells(int axis) const { return m_cells[axis]; }
+			size_t chunks(int axis) const { return (m_cells[axis] + c_mc_chunk - 1) / c_mc_chunk; }
+
+		private:
+			struct chunk;
+
+			// the first cell of a chunk, its cells and whether it is the
+			// last along each axis
+			void locate(size_t index, size_t *first, size_t *cells, bool *last) const;
+
+			void place_vertices(size_t index, chunk &out) const;
+			void emit_triangles(size_t index, const std::vector<chunk> &parts, const std::vector<size_t> &offsets,
+				std::vector<unsigned int> &out) const;
+
+			const Graphics::IScalarField *m_field;
+			float3 m_origin;
+			float m_cell;
+			size_t m_cells[3];
+			float m_iso;
+		};
+	}
+}
+
+#endif // _MARCHING_CUBES_HPP_
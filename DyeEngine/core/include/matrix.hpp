@@ -12,10 +12,12 @@ namespace Dye
 	template<typename Type> class matrix_2x2t;
 	template<typename Type> class matrix_3x3t;
 	template<typename Type> class matrix_4x4t;
+	template<typename Type> class matrix_3x4t;
 
 	typedef matrix_2x2t<float> float2x2;
 	typedef matrix_3x3t<float> float3x3;
 	typedef matrix_4x4t<float> float4x4;
+	typedef matrix_3x4t<float> float3x4;
 
 	template<typename Type>
 	class matrix_2x2t
@@ -65,6 +67,7 @@ namespace Dye
 		DECLARE_CONVERSION_TO_POINTER(Type, &m_row0)
 		DECLARE_SUBSCRIPT_OPERATOR(vector_2t<Type>, &m_row0)
 		DECLARE_NATIVE_ITERATOR(Type, &m_row0, 2*2)
+		DECLARE_EXPRESSION_EVALUATION(matrix_2x2t, Type, 2*2)
 
 	public:
 		vector_2t<Type> col(size_t i) const
@@ -179,6 +182,7 @@ namespace Dye
 		DECLARE_CONVERSION_TO_POINTER(Type, &m_row0)
 		DECLARE_SUBSCRIPT_OPERATOR(vector_3t<Type>, &m_row0)
 		DECLARE_NATIVE_ITERATOR(Type, &m_row0, 3*3)
+		DECLARE_EXPRESSION_EVALUATION(matrix_3x3t, Type, 3*3)
 
 	public:
 		vector_3t<Type> col(size_t i) const
@@ -306,6 +310,7 @@ namespace Dye
 		DECLARE_CONVERSION_TO_POINTER(Type, &m_row0)
 		DECLARE_SUBSCRIPT_OPERATOR(vector_4t<Type>, &m_row0)
 		DECLARE_NATIVE_ITERATOR(Type, &m_row0, 4*4)
+		DECLARE_EXPRESSION_EVALUATION(matrix_4x4t, Type, 4*4)
 
 	public:
 		vector_4t<Type> col(size_t i) const
@@ -383,6 +388,109 @@ namespace Dye
 		vector_4t<Type> m_row3;
 	};
 
+	//////////////////////////////////////////////////////////////////////////
+	// matrix_3x4t : an affine transform without the constant row.
+	//
+	// the rows are the first three columns of the equivalent matrix_4x4t,
+	// whose last column is implicitly (0, 0, 0, 1), so row i holds the i-th
+	// axis coefficients followed by the i-th translation component. a point
+	// p is transformed as dot(row i, (p, 1)), which is the same as
+	// mul(vector_4t(p, 1), to_4x4()).
+	//////////////////////////////////////////////////////////////////////////
+	template<typename Type>
+	class matrix_3x4t
+	{
+	public:
+		matrix_3x4t()
+		{
+		}
+
+		matrix_3x4t(const Type &_00, const Type &_01, const Type &_02, const Type &_03,
+					const Type &_10, const Type &_11, const Type &_12, const Type &_13,
+					const Type &_20, const Type &_21, const Type &_22, const Type &_23)
+			: m_row0(_00, _01, _02, _03)
+			, m_row1(_10, _11, _12, _13)
+			, m_row2(_20, _21, _22, _23)
+		{
+		}
+
+		matrix_3x4t(const vector_4t<Type> &row0, 
+					const vector_4t<Type> &row1, 
+					const vector_4t<Type> &row2)
+			: m_row0(row0)
+			, m_row1(row1)
+			, m_row2(row2)
+		{
+		}
+
+		matrix_3x4t(const Type * elements)
+		{
+			memcpy((void *)&m_row0, (const void *)elements, sizeof(matrix_3x4t));
+		}
+
+		// mat must be affine, its last column is dropped
+		explicit matrix_3x4t(const matrix_4x4t<Type> &mat)
+			: m_row0(mat.col(0))
+			, m_row1(mat.col(1))
+			, m_row2(mat.col(2))
+		{
+		}
+
+	public:
+		static matrix_3x4t identity()
+		{
+			return matrix_3x4t(1, 0, 0, 0,
+							   0, 1, 0, 0,
+							   0, 0, 1, 0);
+		}
+
+		static matrix_3x4t translation(const vector_3t<Type> &offset)
+		{
+			return matrix_3x4t(1, 0, 0, offset.x,
+							   0, 1, 0, offset.y,
+							   0, 0, 1, offset.z);
+		}
+
+	public:
+		DECLARE_CONVERSION_TO_POINTER(Type, &m_row0)
+		DECLARE_SUBSCRIPT_OPERATOR(vector_4t<Type>, &m_row0)
+		DECLARE_NATIVE_ITERATOR(Type, &m_row0, 3*4)
+
+	public:
+		vector_3t<Type> col(size_t i) const
+		{
+			return vector_3t<Type>(m_row0[i], m_row1[i], m_row2[i]);
+		}
+
+		void set_col(size_t i, const vector_3t<Type> &col_vec)
+		{
+			m_row0[i] = col_vec[0];
+			m_row1[i] = col_vec[1];
+			m_row2[i] = col_vec[2];
+		}
+
+		// the rotation-scale part, laid out as in to_4x4()
+		matrix_3x3t<Type> linear() const
+		{
+			return matrix_3x3t<Type>(col(0), col(1), col(2));
+		}
+
+		matrix_4x4t<Type> to_4x4() const
+		{
+			return matrix_4x4t<Type>(
+				m_row0[0], m_row1[0], m_row2[0], 0,
+				m_row0[1], m_row1[1], m_row2[1], 0,
+				m_row0[2], m_row1[2], m_row2[2], 0,
+				m_row0[3], m_row1[3], m_row2[3], 1);
+		}
+
+	private:
+		vector_4t<Type> m_row0;
+		vector_4t<Type> m_row1;
+		vector_4t<Type> m_row2;
+	};
+
+#if !defined(DYE_EXPRESSION_TEMPLATES)
 	//////////////////////////////////////////////////////////////////////////
 	// negation
 	template<typename Type>
@@ -543,6 +651,8 @@ namespace Dye
 		return matrix_4x4t<Type> (lhs[0] / rhs[0], lhs[1] / rhs[1], lhs[2] / rhs[2], lhs[3] / rhs[3]);
 	}
 
+#endif // !DYE_EXPRESSION_TEMPLATES
+
 	//////////////////////////////////////////////////////////////////////////
 	// transposition
 	template<typename Type>
@@ -643,6 +753,40 @@ namespace Dye
 			dot(lhs[2], rhs_col0), dot(lhs[2], rhs_col1), dot(lhs[2], rhs_col2), dot(lhs[2], rhs_col3),
 			dot(lhs[3], rhs_col0), dot(lhs[3], rhs_col1), dot(lhs[3], rhs_col2), dot(lhs[3], rhs_col3));
 	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// affine transform : mul(lhs, rhs) applies lhs then rhs, as the
+	// matrix_4x4t product of the equivalent matrices does
+	template<typename Type>
+	matrix_3x4t<Type> mul (const matrix_3x4t<Type> &lhs, const matrix_3x4t<Type> &rhs)
+	{
+		matrix_3x4t<Type> result;
+		for (size_t i = 0; i != 3; ++i)
+		{
+			result[i] = lhs[0] * rhs[i][0] + lhs[1] * rhs[i][1] + lhs[2] * rhs[i][2];
+			result[i][3] += rhs[i][3];
+		}
+		return result;
+	}
+
+	template<typename Type>
+	vector_3t<Type> transform_point (const matrix_3x4t<Type> &mat, const vector_3t<Type> &point)
+	{
+		return vector_3t<Type> (
+			dot(mat[0].xyz(), point) + mat[0][3],
+			dot(mat[1].xyz(), point) + mat[1][3],
+			dot(mat[2].xyz(), point) + mat[2][3]);
+	}
+
+	template<typename Type>
+	vector_3t<Type> transform_vector (const matrix_3x4t<Type> &mat, const vector_3t<Type> &vec)
+	{
+		return vector_3t<Type> (dot(mat[0].xyz(), vec), dot(mat[1].xyz(), vec), dot(mat[2].xyz(), vec));
+	}
 }
 
+#if defined(DYE_SIMD_SSE)
+#include "matrix_sse.hpp"
+#endif
+
 #endif // _MATRIX_HPP_
\ No newline at end of file
@@ -1,8 +1,8 @@
-
 #ifndef _MATRIX_AUX_HPP_
 #define _MATRIX_AUX_HPP_
 
 #include "matrix.hpp"
+#include "packet.hpp"
 
 namespace Dye
 {
@@ -19,6 +19,51 @@ namespace Dye
 	float2x2 inv(const float2x2 &mat);
 	float3x3 inv(const float3x3 &mat);
 	float4x4 inv(const float4x4 &mat);
+
+	// out[i] = inv(in[i]), in and out may be the same array
+	void inv(const float4x4 *in, float4x4 *out, size_t n);
+
+	// mat is a 3x3 rotation-scale followed by a translation in the last row,
+	// i.e. the last column must be (0, 0, 0, 1).
+	float4x4 inv_affine(const float4x4 &mat);
+
+	// as inv_affine, but the 3x3 part must also be orthonormal (a pure
+	// rotation), so it is simply transposed.
+	float4x4 inv_orthonormal(const float4x4 &mat);
+
+	// inverse of the affine transform, mul(mat, inv(mat)) is the identity
+	float3x4 inv(const float3x4 &mat);
+
+	//////////////////////////////////////////////////////////////////////////
+	// decomposition
+	//
+	// jacobi iterations with a fixed number of sweeps and no data dependent
+	// branches, so every matrix costs the same. the products below are the
+	// plain matrix products, columns of u and v are the singular (eigen)
+	// vectors, and u, v and r are always rotations (det = 1).
+	//////////////////////////////////////////////////////////////////////////
+
+	// mat = u * diag(s) * trans(v), with s.x >= s.y >= abs(s.z); s.z is
+	// negative when det(mat) is.
+	void svd(const float3x3 &mat, float3x3 &u, float3 &s, float3x3 &v);
+
+	// mat = r * s with r the closest rotation and s symmetric
+	void polar(const float3x3 &mat, float3x3 &r, float3x3 &s);
+
+	// mat must be symmetric, mat = vectors * diag(values) * trans(vectors),
+	// values in decreasing order.
+	void eig_sym(const float3x3 &mat, float3 &values, float3x3 &vectors);
+
+	// the same on 8 matrices in structure-of-arrays form
+	void svd(const float3x3x8 &mat, float3x3x8 &u, float3x8 &s, float3x3x8 &v);
+	void polar(const float3x3x8 &mat, float3x3x8 &r, float3x3x8 &s);
+	void eig_sym(const float3x3x8 &mat, float3x8 &values, float3x3x8 &vectors);
+
+	// batches of n matrices, transposed into packets of 8 and multithreaded
+	// for large n. any output may be null when it is not needed.
+	void svd(const float3x3 *mat, float3x3 *u, float3 *s, float3x3 *v, size_t n);
+	void polar(const float3x3 *mat, float3x3 *r, float3x3 *s, size_t n);
+	void eig_sym(const float3x3 *mat, float3 *values, float3x3 *vectors, size_t n);
 }
 
-#endif // _MATRIX_AUX_HPP_
\ No newline at end of file
+#endif // _MATRIX_AUX_HPP_
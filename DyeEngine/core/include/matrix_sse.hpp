@@ -0,0 +1,119 @@
+#ifndef _MATRIX_SSE_HPP_
+#define _MATRIX_SSE_HPP_
+
+// sse/avx kernels for float4x4 and float3x4, included by matrix.hpp only
+// when DYE_SIMD_SSE is defined. the rows of both are aligned float4, so
+// these overloads simply take precedence over the generic templates.
+
+namespace Dye
+{
+	//////////////////////////////////////////////////////////////////////////
+	// transposition
+	inline float4x4 trans(const float4x4 &operand)
+	{
+		__m128 r0 = operand[0].simd();
+		__m128 r1 = operand[1].simd();
+		__m128 r2 = operand[2].simd();
+		__m128 r3 = operand[3].simd();
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+		float4x4 result;
+		result[0].set_simd(r0);
+		result[1].set_simd(r1);
+		result[2].set_simd(r2);
+		result[3].set_simd(r3);
+		return result;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// matrix multiplication : mul(row vector, matrix)
+	inline float4 mul (const float4 &lhs, const float4x4 &rhs)
+	{
+		__m128 v = lhs.simd();
+		__m128 r =    _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)), rhs[0].simd());
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), rhs[1].simd()));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), rhs[2].simd()));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), rhs[3].simd()));
+		return float4(r);
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// matrix multiplication : mul(matrix, col vector)
+	inline float4 mul (const float4x4 &lhs, const float4 &rhs)
+	{
+		__m128 v = rhs.simd();
+		__m128 p0 = _mm_mul_ps(lhs[0].simd(), v);
+		__m128 p1 = _mm_mul_ps(lhs[1].simd(), v);
+		__m128 p2 = _mm_mul_ps(lhs[2].simd(), v);
+		__m128 p3 = _mm_mul_ps(lhs[3].simd(), v);
+		_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+		return float4(_mm_add_ps(_mm_add_ps(p0, p1), _mm_add_ps(p2, p3)));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// matrix multiplication : mul(matrix, matrix)
+	//
+	// every row of the result is a linear combination of the rows of rhs,
+	// weighted by the corresponding row of lhs, so no column is ever built.
+#if defined(DYE_SIMD_AVX)
+	inline float4x4 mul (const float4x4 &lhs, const float4x4 &rhs)
+	{
+		// two rows of the result per 256-bit register
+		__m256 b0 = _mm256_broadcast_ps((const __m128 *)rhs[0].ptr());
+		__m256 b1 = _mm256_broadcast_ps((const __m128 *)rhs[1].ptr());
+		__m256 b2 = _mm256_broadcast_ps((const __m128 *)rhs[2].ptr());
+		__m256 b3 = _mm256_broadcast_ps((const __m128 *)rhs[3].ptr());
+
+		float4x4 result;
+		for (size_t i = 0; i != 4; i += 2)
+		{
+			__m256 a = _mm256_loadu_ps(lhs[i].ptr());
+			__m256 r =       _mm256_mul_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+			r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+			r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+			r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), b3));
+			_mm256_storeu_ps(result[i].ptr(), r);
+		}
+		return result;
+	}
+#else
+	inline float4x4 mul (const float4x4 &lhs, const float4x4 &rhs)
+	{
+		float4x4 result;
+		for (size_t i = 0; i != 4; ++i)
+		{
+			result[i] = mul(lhs[i], rhs);
+		}
+		return result;
+	}
+#endif
+
+	//////////////////////////////////////////////////////////////////////////
+	// affine transform : mul(float3x4, float3x4)
+	//
+	// row i of the result combines the rows of lhs weighted by row i of rhs,
+	// the implicit (0, 0, 0, 1) row of lhs only adds rhs[i][3] to lane 3.
+	// 9 multiplies and 9 adds per row against 16 and 12 for float4x4.
+	inline float3x4 mul (const float3x4 &lhs, const float3x4 &rhs)
+	{
+		__m128 a0 = lhs[0].simd();
+		__m128 a1 = lhs[1].simd();
+		__m128 a2 = lhs[2].simd();
+		__m128 zero = _mm_setzero_ps();
+
+		float3x4 result;
+		for (size_t i = 0; i != 3; ++i)
+		{
+			__m128 b = rhs[i].simd();
+			__m128 r =    _mm_mul_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 0, 0, 0)), a0);
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 1, 1, 1)), a1));
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 2, 2, 2)), a2));
+			__m128 t = _mm_unpackhi_ps(zero, b);
+			r = _mm_add_ps(r, _mm_shuffle_ps(zero, t, _MM_SHUFFLE(3, 2, 0, 0)));
+			result[i].set_simd(r);
+		}
+		return result;
+	}
+}
+
+#endif // _MATRIX_SSE_HPP_
@@ -0,0 +1,124 @@
+#ifndef _MESH_HPP_
+#define _MESH_HPP_
+
+// indexed triangle lists and the reorderings that make them cheap to draw:
+//
+//   weld_vertices()          merges vertices of equal position, normal and uv
+//   optimize_vertex_cache()  orders triangles for the post-transform cache
+//                            (forsyth, "linear-speed vertex cache
+//                            optimisation")
+//   optimize_overdraw()      splits that order into clusters at the cache
+//                            flushes and draws the outward facing clusters
+//                            first (sander, nehab and barczak, "fast
+//                            triangle reordering", the tipsify paper)
+//   optimize_vertex_fetch()  orders vertices by first use
+//
+// they run in this order in Mesh::optimize(). compute_acmr() measures the
+// result as the average cache miss ratio, the transformed vertices per
+// triangle of a fifo cache: 3 without reuse, about 0.5 at best.
+
+#include <stddef.h>
+#include <vector>
+
+#include "geometry.hpp"
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		const size_t c_vertex_cache_size = 16;
+
+		//////////////////////////////////////////////////////////////////////////
+		// welding
+		//////////////////////////////////////////////////////////////////////////
+
+		// remap[i] is the new index of vertex i, the first of the equal ones
+		// keeps its place and the count of the unique ones is returned. 0 and
+		// -0 are equal, the rest compares bitwise.
+		size_t weld_vertices(const vertex *vertices, size_t vertex_count, unsigned int *remap);
+
+		// out holds the returned count of weld_vertices(), may be vertices
+		void remap_vertices(const vertex *vertices, size_t vertex_count, const unsigned int *remap, vertex *out);
+
+		// in place
+		void remap_indices(unsigned int *indices, size_t index_count, const unsigned int *remap);
+
+		//////////////////////////////////////////////////////////////////////////
+		// reordering
+		//
+		// out holds index_count indices and must not overlap indices. the
+		// triangles keep their winding.
+		//////////////////////////////////////////////////////////////////////////
+		void optimize_vertex_cache(const unsigned int *indices, size_t index_count, size_t vertex_count, unsigned int *out);
+
+		// indices in vertex cache order; a cluster is cut where the misses of
+		// the ones before it drop below threshold times the average, so the
+		// ratio grows by about that factor at most
+		void optimize_overdraw(const unsigned int *indices, size_t index_count,
+			const vertex *vertices, size_t vertex_count, unsigned int *out, float threshold = 1.05f);
+
+		// rewrites the indices in place, out holds the returned count of the
+		// referenced vertices and must not overlap vertices
+		size_t optimize_vertex_fetch(unsigned int *indices, size_t index_count,
+			const vertex *vertices, size_t vertex_count, vertex *out);
+
+		//////////////////////////////////////////////////////////////////////////
+		// statistics
+		//////////////////////////////////////////////////////////////////////////
+		float compute_acmr(const unsigned int *indices, size_t index_count, size_t vertex_count,
+			size_t cache_size = c_vertex_cache_size);
+
+		struct mesh_report
+		{
+			size_t vertices_before;
+			size_t vertices_after;
+			float acmr_before;
+			float acmr_after;
+		};
+
+		//////////////////////////////////////////////////////////////////////////
+		// mesh
+		//
+		// a vertex array and triangle list indices into it, stored with 16
+		// bits while there are at most 65536 vertices.
+		//////////////////////////////////////////////////////////////////////////
+		class Mesh : public IMeshable
+		{
+		public:
+			Mesh();
+			Mesh(const vertex *vertices, size_t vertex_count, const unsigned int *indices, size_t index_count);
+			explicit Mesh(const IMeshable &source);
+
+			void assign(const vertex *vertices, size_t vertex_count, const unsigned int *indices, size_t index_count);
+			void assign(const IMeshable &source);
+
+			// weld, vertex cache, overdraw and vertex fetch
+			mesh_report optimize(float overdraw_threshold = 1.05f);
+
+		public:
+			virtual size_t vertex_count() const { return m_vertices.size(); }
+			virtual size_t triangle_count() const { return index_count() / 3; }
+			virtual void get_vertices(size_t first, size_t count, vertex *out) const;
+			virtual void get_triangles(size_t first, size_t count, unsigned int *out) const;
+
+		public:
+			const vertex *vertices() const { return m_vertices.empty() ? 0 : &m_vertices[0]; }
+			size_t index_count() const { return m_indices16.size() + m_indices32.size(); }
+			unsigned int index(size_t i) const { return m_indices32.empty() ? m_indices16[i] : m_indices32[i]; }
+
+			// one of them is 0
+			bool wide_indices() const { return !m_indices32.empty(); }
+			const unsigned short *indices16() const { return m_indices16.empty() ? 0 : &m_indices16[0]; }
+			const unsigned int *indices32() const { return m_indices32.empty() ? 0 : &m_indices32[0]; }
+
+		private:
+			void set_indices(const unsigned int *indices, size_t index_count);
+
+			std::vector<vertex> m_vertices;
+			std::vector<unsigned short> m_indices16;
+			std::vector<unsigned int> m_indices32;
+		};
+	}
+}
+
+#endif // _MESH_HPP_
@@ -0,0 +1,127 @@
+#ifndef _MESH_FILE_HPP_
+#define _MESH_FILE_HPP_
+
+// binary mesh container that is mapped into memory instead of parsed: the
+// vertices are used in place as Graphics::vertex, the indices as unsigned
+// int, and the pages are read by the os on first touch. opening a file only
+// checks its header, so the cost does not grow with the mesh.
+//
+//   header      mesh_file_header, c_mesh_file_header_size bytes
+//   vertices    vertex_count Graphics::vertex
+//   indices     index_count unsigned int, triangle lists
+//   lods        lod_count mesh_lod, finest first
+//
+// every section starts on a c_mesh_file_alignment boundary. the data is
+// stored little endian as the engine uses it, files of another byte order,
+// version or vertex size are rejected. write_mesh_file() makes them, and
+// the mesh_tool converts text meshes to them.
+
+#include <stddef.h>
+
+#include "primitive.hpp"
+#include "vertex_format.hpp"
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		const unsigned int c_mesh_file_version = 1;
+		const size_t c_mesh_file_alignment = 64;
+		const size_t c_mesh_file_header_size = 128;
+
+		// one level of detail, a range of the index stream
+		struct mesh_lod
+		{
+			unsigned int first_index;
+			unsigned int index_count;
+			float error;			// object space distance to the full mesh
+			unsigned int reserved;
+		};
+
+		// the sizes and offsets are in bytes from the start of the file
+		struct mesh_file_header
+		{
+			char magic[4];			// "DYEM"
+			unsigned int version;
+			unsigned int byte_order;	// 0x01020304 as written
+			unsigned int header_size;
+			unsigned long long file_size;
+
+			unsigned int vertex_size;
+			unsigned int vertex_count;
+			unsigned long long vertex_offset;
+
+			unsigned int index_count;
+			unsigned int lod_count;
+			unsigned long long index_offset;
+			unsigned long long lod_offset;
+
+			float bounds_lower[3];
+			float bounds_upper[3];
+		};
+
+		enum mesh_file_status
+		{
+			mesh_file_ok,
+			mesh_file_cannot_open,
+			mesh_file_bad_format,	// not a mesh file, or of another byte order
+			mesh_file_bad_version,
+			mesh_file_truncated,	// a section lies outside the file
+			mesh_file_cannot_write
+		};
+
+		const char *mesh_file_status_name(mesh_file_status status);
+
+		//////////////////////////////////////////////////////////////////////////
+		// writing
+		//////////////////////////////////////////////////////////////////////////
+		mesh_file_status write_mesh_file(const char *path,
+			const vertex *vertices, size_t vertex_count,
+			const unsigned int *indices, size_t index_count,
+			const mesh_lod *lods, size_t lod_count);
+
+		//////////////////////////////////////////////////////////////////////////
+		// mapped file
+		//
+		// the pointers stay valid until close() or destruction.
+		//////////////////////////////////////////////////////////////////////////
+		class MeshFile
+		{
+		public:
+			MeshFile();
+			~MeshFile();
+
+			// closes the current file first
+			mesh_file_status open(const char *path);
+			void close();
+
+		public:
+			bool is_open() const { return m_header != 0; }
+
+			const vertex *vertices() const;
+			size_t vertex_count() const { return m_header ? m_header->vertex_count : 0; }
+
+			const unsigned int *indices() const;
+			size_t index_count() const { return m_header ? m_header->index_count : 0; }
+
+			const mesh_lod *lods() const;
+			size_t lod_count() const { return m_header ? m_header->lod_count : 0; }
+
+			vertex_bounds bounds() const;
+
+			// the whole mapping
+			const void *data() const { return m_base; }
+			size_t byte_size() const { return m_size; }
+
+		private:
+			MeshFile(const MeshFile &);
+			MeshFile& operator = (const MeshFile &);
+
+			const char *m_base;
+			size_t m_size;
+			const mesh_file_header *m_header;
+		};
+	}
+}
+
+#endif // _MESH_FILE_HPP_
@@ -0,0 +1,55 @@
+#ifndef _MORTON_HPP_
+#define _MORTON_HPP_
+
+// morton (z-order) codes of 3d grid cells: the bits of x, y and z
+// interleaved with x highest, so cells close in the code are mostly close
+// in space and the codes sorted visit an octree depth first.
+//
+// 30 bit codes take 10 bits per axis and fit an unsigned int, 63 bit codes
+// take 21 bits per axis.
+
+namespace Dye
+{
+	// the low 10 bits of v spread to every third bit
+	inline unsigned int morton_spread(unsigned int v)
+	{
+		v &= 0x3ff;
+		v = (v | (v << 16)) & 0x030000ffu;
+		v = (v | (v << 8)) & 0x0300f00fu;
+		v = (v | (v << 4)) & 0x030c30c3u;
+		v = (v | (v << 2)) & 0x09249249u;
+		return v;
+	}
+
+	// the low 21 bits of v spread to every third bit
+	inline unsigned long long morton_spread(unsigned long long v)
+	{
+		v &= 0x1fffff;
+		v = (v | (v << 32)) & 0x001f00000000ffffull;
+		v = (v | (v << 16)) & 0x001f0000ff0000ffull;
+		v = (v | (v << 8)) & 0x100f00f00f00f00full;
+		v = (v | (v << 4)) & 0x10c30c30c30c30c3ull;
+		v = (v | (v << 2)) & 0x1249249249249249ull;
+		return v;
+	}
+
+	inline unsigned int morton_code30(unsigned int x, unsigned int y, unsigned int z)
+	{
+		return (morton_spread(x) << 2) | (morton_spread(y) << 1) | morton_spread(z);
+	}
+
+	inline unsigned long long morton_code63(unsigned int x, unsigned int y, unsigned int z)
+	{
+		return (morton_spread(static_cast<unsigned long long>(x)) << 2)
+			| (morton_spread(static_cast<unsigned long long>(y)) << 1)
+			| morton_spread(static_cast<unsigned long long>(z));
+	}
+
+	// the axis, 0 for x, that bit of a code belongs to
+	inline int morton_axis(int bit)
+	{
+		return 2 - bit % 3;
+	}
+}
+
+#endif // _MORTON_HPP_
@@ -0,0 +1,358 @@
+#ifndef _PACKET_HPP_
+#define _PACKET_HPP_
+
+#include <string.h>
+
+#include "matrix.hpp"
+
+namespace Dye
+{
+	//////////////////////////////////////////////////////////////////////////
+	// float8 : 8 independent floats processed together, stored in one avx
+	// register, two sse registers or 8 plain floats depending on the build.
+	//
+	// the structure-of-arrays packets are the usual vector templates over
+	// float8, i.e. float3x8 holds the x, y and z of 8 vectors in 3 registers
+	// and all the operators and free functions of vector_3t apply as is.
+	// comparisons return lane masks (all bits set or clear) to be consumed
+	// by select(), any() and all().
+	//////////////////////////////////////////////////////////////////////////
+	struct float8;
+
+	typedef vector_2t<float8> float2x8;
+	typedef vector_3t<float8> float3x8;
+	typedef vector_4t<float8> float4x8;
+	typedef matrix_3x3t<float8> float3x3x8;
+
+	static const size_t c_packet_width = 8;
+
+#if defined(DYE_SIMD_AVX)
+	typedef __m256 packet_unit;
+	static const size_t c_packet_units = 1;
+
+	inline __m256 packet_splat(float s)           { return _mm256_set1_ps(s); }
+	inline __m256 packet_add(__m256 a, __m256 b)  { return _mm256_add_ps(a, b); }
+	inline __m256 packet_sub(__m256 a, __m256 b)  { return _mm256_sub_ps(a, b); }
+	inline __m256 packet_mul(__m256 a, __m256 b)  { return _mm256_mul_ps(a, b); }
+	inline __m256 packet_div(__m256 a, __m256 b)  { return _mm256_div_ps(a, b); }
+	inline __m256 packet_min(__m256 a, __m256 b)  { return _mm256_min_ps(a, b); }
+	inline __m256 packet_max(__m256 a, __m256 b)  { return _mm256_max_ps(a, b); }
+	inline __m256 packet_and(__m256 a, __m256 b)  { return _mm256_and_ps(a, b); }
+	inline __m256 packet_or(__m256 a, __m256 b)   { return _mm256_or_ps(a, b); }
+	inline __m256 packet_xor(__m256 a, __m256 b)  { return _mm256_xor_ps(a, b); }
+	inline __m256 packet_andnot(__m256 a, __m256 b) { return _mm256_andnot_ps(a, b); }
+	inline __m256 packet_sqrt(__m256 a)           { return _mm256_sqrt_ps(a); }
+#if defined(__FMA__)
+	inline __m256 packet_madd(__m256 a, __m256 b, __m256 c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+	inline __m256 packet_madd(__m256 a, __m256 b, __m256 c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+	inline __m256 packet_lt(__m256 a, __m256 b)   { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	inline __m256 packet_le(__m256 a, __m256 b)   { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	inline __m256 packet_eq(__m256 a, __m256 b)   { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+	inline __m256 packet_neq(__m256 a, __m256 b)  { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+	inline __m256 packet_select(__m256 m, __m256 a, __m256 b) { return _mm256_blendv_ps(b, a, m); }
+	inline int packet_mask(__m256 m)              { return _mm256_movemask_ps(m); }
+#elif defined(DYE_SIMD_SSE)
+	typedef __m128 packet_unit;
+	static const size_t c_packet_units = 2;
+
+	inline __m128 packet_splat(float s)           { return _mm_set1_ps(s); }
+	inline __m128 packet_add(__m128 a, __m128 b)  { return _mm_add_ps(a, b); }
+	inline __m128 packet_sub(__m128 a, __m128 b)  { return _mm_sub_ps(a, b); }
+	inline __m128 packet_mul(__m128 a, __m128 b)  { return _mm_mul_ps(a, b); }
+	inline __m128 packet_div(__m128 a, __m128 b)  { return _mm_div_ps(a, b); }
+	inline __m128 packet_min(__m128 a, __m128 b)  { return _mm_min_ps(a, b); }
+	inline __m128 packet_max(__m128 a, __m128 b)  { return _mm_max_ps(a, b); }
+	inline __m128 packet_and(__m128 a, __m128 b)  { return _mm_and_ps(a, b); }
+	inline __m128 packet_or(__m128 a, __m128 b)   { return _mm_or_ps(a, b); }
+	inline __m128 packet_xor(__m128 a, __m128 b)  { return _mm_xor_ps(a, b); }
+	inline __m128 packet_andnot(__m128 a, __m128 b) { return _mm_andnot_ps(a, b); }
+	inline __m128 packet_sqrt(__m128 a)           { return _mm_sqrt_ps(a); }
+	inline __m128 packet_madd(__m128 a, __m128 b, __m128 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	inline __m128 packet_lt(__m128 a, __m128 b)   { return _mm_cmplt_ps(a, b); }
+	inline __m128 packet_le(__m128 a, __m128 b)   { return _mm_cmple_ps(a, b); }
+	inline __m128 packet_eq(__m128 a, __m128 b)   { return _mm_cmpeq_ps(a, b); }
+	inline __m128 packet_neq(__m128 a, __m128 b)  { return _mm_cmpneq_ps(a, b); }
+	inline __m128 packet_select(__m128 m, __m128 a, __m128 b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+	inline int packet_mask(__m128 m)              { return _mm_movemask_ps(m); }
+#else
+	typedef float packet_unit;
+	static const size_t c_packet_units = 8;
+
+	inline unsigned int packet_bits(float a)      { unsigned int u; memcpy(&u, &a, sizeof(u)); return u; }
+	inline float packet_float(unsigned int u)     { float a; memcpy(&a, &u, sizeof(a)); return a; }
+	inline float packet_bool(bool b)              { return packet_float(b ? ~0u : 0u); }
+
+	inline float packet_splat(float s)            { return s; }
+	inline float packet_add(float a, float b)     { return a + b; }
+	inline float packet_sub(float a, float b)     { return a - b; }
+	inline float packet_mul(float a, float b)     { return a * b; }
+	inline float packet_div(float a, float b)     { return a / b; }
+	inline float packet_min(float a, float b)     { return a < b ? a : b; }
+	inline float packet_max(float a, float b)     { return a > b ? a : b; }
+	inline float packet_and(float a, float b)     { return packet_float(packet_bits(a) & packet_bits(b)); }
+	inline float packet_or(float a, float b)      { return packet_float(packet_bits(a) | packet_bits(b)); }
+	inline float packet_xor(float a, float b)     { return packet_float(packet_bits(a) ^ packet_bits(b)); }
+	inline float packet_andnot(float a, float b)  { return packet_float(~packet_bits(a) & packet_bits(b)); }
+	inline float packet_sqrt(float a)             { return std::sqrt(a); }
+#if defined(__FMA__)
+	inline float packet_madd(float a, float b, float c) { return std::fma(a, b, c); }
+#else
+	inline float packet_madd(float a, float b, float c) { return a * b + c; }
+#endif
+	inline float packet_lt(float a, float b)      { return packet_bool(a < b); }
+	inline float packet_le(float a, float b)      { return packet_bool(a <= b); }
+	inline float packet_eq(float a, float b)      { return packet_bool(a == b); }
+	inline float packet_neq(float a, float b)     { return packet_bool(a != b); }
+	inline float packet_select(float m, float a, float b) { return packet_bits(m) ? a : b; }
+	inline int packet_mask(float m)               { return packet_bits(m) >> 31; }
+#endif
+
+	// lanes of one packet_unit
+	static const size_t c_packet_unit_width = c_packet_width / c_packet_units;
+
+	struct DYE_ALIGN(32) float8
+	{
+	public:
+		float8()
+		{
+			for (size_t i = 0; i != c_packet_units; ++i) u[i] = packet_splat(0);
+		}
+
+		float8(float s)
+		{
+			for (size_t i = 0; i != c_packet_units; ++i) u[i] = packet_splat(s);
+		}
+
+		static float8 load(const float *src)
+		{
+			float8 result;
+			memcpy(result.f, src, sizeof(result.f));
+			return result;
+		}
+
+		void store(float *dst) const
+		{
+			memcpy(dst, f, sizeof(f));
+		}
+
+	public:
+		DECLARE_SUBSCRIPT_OPERATOR(float, f)
+		DECLARE_NATIVE_ITERATOR(float, f, 8)
+
+	public:
+		float8& operator += (const float8 &rhs);
+		float8& operator -= (const float8 &rhs);
+		float8& operator *= (const float8 &rhs);
+		float8& operator /= (const float8 &rhs);
+
+	public:
+		union
+		{
+			packet_unit u[c_packet_units];
+			float f[c_packet_width];
+		};
+	};
+
+	template<>
+	struct is_real<float8> : boost::true_type
+	{
+	};
+
+	#define DYE_PACKET_BINARY(Name, Impl)											\
+		inline float8 Name (const float8 &lhs, const float8 &rhs)					\
+		{																			\
+			float8 r;																\
+			for (size_t i = 0; i != c_packet_units; ++i)							\
+				r.u[i] = Impl(lhs.u[i], rhs.u[i]);									\
+			return r;																\
+		}
+
+	//////////////////////////////////////////////////////////////////////////
+	// arithmetic
+	DYE_PACKET_BINARY(operator +, packet_add)
+	DYE_PACKET_BINARY(operator -, packet_sub)
+	DYE_PACKET_BINARY(operator *, packet_mul)
+	DYE_PACKET_BINARY(operator /, packet_div)
+	DYE_PACKET_BINARY(min, packet_min)
+	DYE_PACKET_BINARY(max, packet_max)
+
+	inline float8 operator - (const float8 &operand)
+	{
+		return float8() - operand;
+	}
+
+	inline float8& float8::operator += (const float8 &rhs) { return *this = *this + rhs; }
+	inline float8& float8::operator -= (const float8 &rhs) { return *this = *this - rhs; }
+	inline float8& float8::operator *= (const float8 &rhs) { return *this = *this * rhs; }
+	inline float8& float8::operator /= (const float8 &rhs) { return *this = *this / rhs; }
+
+	//////////////////////////////////////////////////////////////////////////
+	// lane masks
+	DYE_PACKET_BINARY(operator <, packet_lt)
+	DYE_PACKET_BINARY(operator <=, packet_le)
+	DYE_PACKET_BINARY(operator ==, packet_eq)
+	DYE_PACKET_BINARY(operator !=, packet_neq)
+	DYE_PACKET_BINARY(operator &, packet_and)
+	DYE_PACKET_BINARY(operator |, packet_or)
+	DYE_PACKET_BINARY(operator ^, packet_xor)
+	DYE_PACKET_BINARY(andnot, packet_andnot)
+
+	#undef DYE_PACKET_BINARY
+
+	inline float8 operator > (const float8 &lhs, const float8 &rhs)
+	{
+		return rhs < lhs;
+	}
+
+	inline float8 operator >= (const float8 &lhs, const float8 &rhs)
+	{
+		return rhs <= lhs;
+	}
+
+	// mask ? a : b, lane by lane
+	inline float8 select(const float8 &mask, const float8 &a, const float8 &b)
+	{
+		float8 r;
+		for (size_t i = 0; i != c_packet_units; ++i)
+			r.u[i] = packet_select(mask.u[i], a.u[i], b.u[i]);
+		return r;
+	}
+
+	// one bit per lane
+	inline int movemask(const float8 &mask)
+	{
+		int bits = 0;
+		for (size_t i = 0; i != c_packet_units; ++i)
+			bits |= packet_mask(mask.u[i]) << (i * c_packet_unit_width);
+		return bits;
+	}
+
+	inline bool any(const float8 &mask)
+	{
+		return movemask(mask) != 0;
+	}
+
+	inline bool all(const float8 &mask)
+	{
+		return movemask(mask) == 0xff;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// functions
+	inline float8 sqrt(const float8 &operand)
+	{
+		float8 r;
+		for (size_t i = 0; i != c_packet_units; ++i)
+			r.u[i] = packet_sqrt(operand.u[i]);
+		return r;
+	}
+
+	inline float8 abs(const float8 &operand)
+	{
+		return andnot(float8(-0.0f), operand);
+	}
+
+	// to the nearest whole number, ties to even
+	inline float8 round(const float8 &operand)
+	{
+		// adding and taking away 2^23 with the sign of the operand drops
+		// the fraction; from 2^23 on every float is whole already
+		const float8 big(8388608.0f);
+		const float8 magic = (operand & float8(-0.0f)) | big;
+		const float8 r = (operand + magic) - magic;
+		return select(abs(operand) < big, r, operand);
+	}
+
+	// a * b + c, rounded once where the build has fma
+	inline float8 madd(const float8 &a, const float8 &b, const float8 &c)
+	{
+		float8 r;
+		for (size_t i = 0; i != c_packet_units; ++i)
+			r.u[i] = packet_madd(a.u[i], b.u[i], c.u[i]);
+		return r;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// matrix multiplication with a matrix broadcast to all lanes
+	inline float4x8 mul(const float4x8 &lhs, const float4x4 &rhs)
+	{
+		float4x8 result;
+		for (size_t j = 0; j != 4; ++j)
+		{
+			result[j] = lhs.x * float8(rhs[0][j]) + lhs.y * float8(rhs[1][j])
+					  + lhs.z * float8(rhs[2][j]) + lhs.w * float8(rhs[3][j]);
+		}
+		return result;
+	}
+
+	inline float4x8 mul(const float4x4 &lhs, const float4x8 &rhs)
+	{
+		float4x8 result;
+		for (size_t i = 0; i != 4; ++i)
+		{
+			result[i] = rhs.x * float8(lhs[i][0]) + rhs.y * float8(lhs[i][1])
+					  + rhs.z * float8(lhs[i][2]) + rhs.w * float8(lhs[i][3]);
+		}
+		return result;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// conversion from and to arrays of structures
+	inline float3x8 load_packet(const float3 *src)
+	{
+		float3x8 result;
+		for (size_t i = 0; i != c_packet_width; ++i)
+		{
+			result.x[i] = src[i].x;
+			result.y[i] = src[i].y;
+			result.z[i] = src[i].z;
+		}
+		return result;
+	}
+
+	inline float4x8 load_packet(const float4 *src)
+	{
+		float4x8 result;
+		for (size_t i = 0; i != c_packet_width; ++i)
+		{
+			result.x[i] = src[i].x;
+			result.y[i] = src[i].y;
+			result.z[i] = src[i].z;
+			result.w[i] = src[i].w;
+		}
+		return result;
+	}
+
+	inline float3x8 gather_packet(const float3 *base, const int *indices)
+	{
+		float3x8 result;
+		for (size_t i = 0; i != c_packet_width; ++i)
+		{
+			const float3 &src = base[indices[i]];
+			result.x[i] = src.x;
+			result.y[i] = src.y;
+			result.z[i] = src.z;
+		}
+		return result;
+	}
+
+	inline void store_packet(const float3x8 &src, float3 *dst)
+	{
+		for (size_t i = 0; i != c_packet_width; ++i)
+		{
+			dst[i] = float3(src.x[i], src.y[i], src.z[i]);
+		}
+	}
+
+	inline void store_packet(const float4x8 &src, float4 *dst)
+	{
+		for (size_t i = 0; i != c_packet_width; ++i)
+		{
+			dst[i] = float4(src.x[i], src.y[i], src.z[i], src.w[i]);
+		}
+	}
+}
+
+#endif // _PACKET_HPP_
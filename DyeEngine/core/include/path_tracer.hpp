@@ -0,0 +1,216 @@
+#ifndef _PATH_TRACER_HPP_
+#define _PATH_TRACER_HPP_
+
+// headless path tracer for Render::RayTracing: a triangle scene of diffuse
+// and emitting surfaces under a uniform sky, rendered on the cpu into a
+// float framebuffer that each pass adds one sample per pixel to.
+//
+// a pass splits the image into 16x16 tiles and hands them to the openmp
+// threads as they come free. every path
+// - samples an emitting triangle at each bounce and adds its light if the
+//   shadow ray gets through (next event estimation), so that small lights
+//   converge quickly; hitting an emitter later adds nothing, as that light
+//   was counted already,
+// - leaves along a cosine weighted direction, and
+// - ends by russian roulette past a few bounces, with the survivors
+//   weighted up, so that the image stays unbiased.
+//
+// the random numbers are the 2d sobol sequence indexed by the pass, each
+// pair of dimensions scrambled by a hash of the pixel (kollig and keller,
+// "efficient multidimensional sampling"): any 2^k passes stratify each
+// pixel, neighbours do not correlate, and a pixel comes out the same
+// whichever thread traced it.
+
+#include <stddef.h>
+#include <vector>
+
+#include "bvh.hpp"
+#include "camera.hpp"
+
+namespace Dye
+{
+	namespace Render
+	{
+		//////////////////////////////////////////////////////////////////////////
+		// sampling
+		//////////////////////////////////////////////////////////////////////////
+
+		// a well mixed 32 bit hash
+		inline unsigned int hash_u32(unsigned int x)
+		{
+			x ^= x >> 16;
+			x *= 0x7feb352du;
+			x ^= x >> 15;
+			x *= 0x846ca68bu;
+			x ^= x >> 16;
+			return x;
+		}
+
+		// the first two dimensions of the sobol sequence as 32 bit fractions:
+		// the bits of the index reversed, and the second generator matrix
+		inline unsigned int sobol_bits0(unsigned int index)
+		{
+			unsigned int r = 0;
+			for (unsigned int v = 0x80000000u; index; index >>= 1, v >>= 1)
+			{
+				if (index & 1)
+				{
+					r ^= v;
+				}
+			}
+			return r;
+		}
+
+		inline unsigned int sobol_bits1(unsigned int index)
+		{
+			unsigned int r = 0;
+			for (unsigned int v = 0x80000000u; index; index >>= 1, v ^= v >> 1)
+			{
+				if (index & 1)
+				{
+					r ^= v;
+				}
+			}
+			return r;
+		}
+
+		// point index of the sequence with its digits flipped by scramble,
+		// in [0, 1)
+		inline void sobol_2d(unsigned int index, unsigned int scramble, float &u, float &v)
+		{
+			// 24 bits, so that the float does not round up to 1
+			const float c_scale = 1.0f / 16777216.0f;
+			u = static_cast<float>((sobol_bits0(index) ^ scramble) >> 8) * c_scale;
+			v = static_cast<float>((sobol_bits1(index) ^ hash_u32(scramble)) >> 8) * c_scale;
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// scene
+		//////////////////////////////////////////////////////////////////////////
+
+		// lambertian reflection of albedo, plus emitted radiance, on both sides
+		struct material
+		{
+			float3 albedo;
+			float3 emission;
+		};
+
+		class PathScene
+		{
+		public:
+			PathScene();
+
+			// the triangles of the indices, each with the material of
+			// triangle_materials into materials
+			void build(const Graphics::vertex *vertices, size_t vertex_count, const unsigned int *indices,
+				size_t index_count, const unsigned int *triangle_materials, const material *materials,
+				size_t material_count, Graphics::bvh_build method = Graphics::bvh_build_sah);
+
+			// the radiance of rays that leave the scene
+			void set_sky(const float3 &radiance) { m_sky = radiance; }
+
+		public:
+			const Graphics::Bvh &bvh() const { return m_bvh; }
+			const float3 &sky() const { return m_sky; }
+
+			size_t triangle_count() const { return m_triangle_materials.size(); }
+			size_t emitter_count() const { return m_emitters.size(); }
+
+			// the vertices of a triangle by its index in the build
+			const float3 &position(size_t triangle, int corner) const { return m_positions[triangle * 3 + corner]; }
+			const material &triangle_material(size_t triangle) const { return m_materials[m_triangle_materials[triangle]]; }
+
+			// picks an emitting triangle by its power for u in [0, 1), and
+			// returns the probability it was picked with
+			size_t pick_emitter(float u, float &probability) const;
+
+			// offset of secondary rays from the surface, scaled to the scene
+			float epsilon() const { return m_epsilon; }
+
+		private:
+			Graphics::Bvh m_bvh;
+			std::vector<float3> m_positions;
+			std::vector<unsigned int> m_triangle_materials;
+			std::vector<material> m_materials;
+
+			// the emitting triangles and the running sum of their power,
+			// normalized to end at 1
+			std::vector<unsigned int> m_emitters;
+			std::vector<float> m_emitter_cdf;
+
+			float3 m_sky;
+			float m_epsilon;
+		};
+
+		//////////////////////////////////////////////////////////////////////////
+		// tracer
+		//////////////////////////////////////////////////////////////////////////
+		struct path_settings
+		{
+			// bounces past the camera ray at most
+			int max_depth;
+
+			// bounces before russian roulette starts
+			int roulette_depth;
+
+			path_settings()
+				: max_depth(16), roulette_depth(3)
+			{
+			}
+		};
+
+		struct path_stats
+		{
+			// camera paths, and rays of any kind
+			size_t samples;
+			size_t rays;
+			double seconds;
+		};
+
+		const size_t c_tile_size = 16;
+
+		class PathTracer
+		{
+		public:
+			// the scene must outlive the tracer
+			PathTracer(const PathScene &scene, size_t width, size_t height);
+
+			// both restart the accumulation
+			void set_camera(const camera &view);
+			void set_settings(const path_settings &settings);
+			void reset();
+
+			// one sample per pixel added over all tiles
+			path_stats render_pass();
+
+		public:
+			size_t width() const { return m_width; }
+			size_t height() const { return m_height; }
+			unsigned int passes() const { return m_passes; }
+
+			// the sums of the samples, rgb per pixel in rows from the top
+			const float *accumulation() const { return m_sum.empty() ? 0 : &m_sum[0]; }
+
+			// the mean of the passes, 3 * width * height floats
+			void resolve(float *rgb) const;
+
+		private:
+			void render_tile(size_t tile, path_stats &stats);
+			float3 trace_path(size_t pixel, float x, float y, path_stats &stats) const;
+
+			const PathScene *m_scene;
+			size_t m_width;
+			size_t m_height;
+
+			camera m_camera;
+			path_settings m_settings;
+
+			camera_frame m_frame;
+
+			std::vector<float> m_sum;
+			unsigned int m_passes;
+		};
+	}
+}
+
+#endif // _PATH_TRACER_HPP_
@@ -0,0 +1,279 @@
+#ifndef _QUATERNION_HPP_
+#define _QUATERNION_HPP_
+
+#include "matrix.hpp"
+#include "fast_math.hpp"
+
+namespace Dye
+{
+	//////////////////////////////////////////////////////////////////////////
+	// quaternion_t : rotation as x * i + y * j + z * k + w.
+	//
+	// the conventions follow the row vectors of the matrices: rotate(q, v)
+	// equals mul(v, q.to_3x3()), and mul(a, b) applies a then b, as the
+	// matrix product does (it is the hamilton product b * a).
+	//
+	// quatx8 holds 8 quaternions in structure-of-arrays form, everything
+	// below works on it lane by lane.
+	//////////////////////////////////////////////////////////////////////////
+	template<typename Type>
+	struct quaternion_t
+	{
+	public:
+		typedef Type value_type;
+
+		quaternion_t()
+			: x(0)
+			, y(0)
+			, z(0)
+			, w(1)
+		{
+		}
+
+		quaternion_t(const Type &nx, const Type &ny, const Type &nz, const Type &nw)
+			: x(nx)
+			, y(ny)
+			, z(nz)
+			, w(nw)
+		{
+		}
+
+	public:
+		static quaternion_t identity()
+		{
+			return quaternion_t();
+		}
+
+		// rotation by angle radians around the unit vector axis
+		static quaternion_t rotation(const vector_3t<Type> &axis, const Type &angle)
+		{
+			using std::sin;
+			using std::cos;
+			Type s = sin(angle / 2);
+			return quaternion_t(axis.x * s, axis.y * s, axis.z * s, cos(angle / 2));
+		}
+
+		// mat must be a rotation, the result is normalized
+		static quaternion_t from_matrix(const matrix_3x3t<Type> &mat)
+		{
+			using std::sqrt;
+			const matrix_3x3t<Type> &m = mat;
+			Type trace = m[0][0] + m[1][1] + m[2][2];
+
+			// pick the largest of w, x, y, z to divide by
+			if (trace > 0)
+			{
+				Type s = sqrt(trace + 1) * 2;
+				return quaternion_t((m[1][2] - m[2][1]) / s, (m[2][0] - m[0][2]) / s, (m[0][1] - m[1][0]) / s, s / 4);
+			}
+			else if (m[0][0] > m[1][1] && m[0][0] > m[2][2])
+			{
+				Type s = sqrt(1 + m[0][0] - m[1][1] - m[2][2]) * 2;
+				return quaternion_t(s / 4, (m[0][1] + m[1][0]) / s, (m[2][0] + m[0][2]) / s, (m[1][2] - m[2][1]) / s);
+			}
+			else if (m[1][1] > m[2][2])
+			{
+				Type s = sqrt(1 + m[1][1] - m[0][0] - m[2][2]) * 2;
+				return quaternion_t((m[0][1] + m[1][0]) / s, s / 4, (m[1][2] + m[2][1]) / s, (m[2][0] - m[0][2]) / s);
+			}
+			else
+			{
+				Type s = sqrt(1 + m[2][2] - m[0][0] - m[1][1]) * 2;
+				return quaternion_t((m[2][0] + m[0][2]) / s, (m[1][2] + m[2][1]) / s, s / 4, (m[0][1] - m[1][0]) / s);
+			}
+		}
+
+		static quaternion_t from_matrix(const matrix_4x4t<Type> &mat)
+		{
+			return from_matrix(matrix_3x3t<Type>(mat[0].xyz(), mat[1].xyz(), mat[2].xyz()));
+		}
+
+	public:
+		DECLARE_CONVERSION_TO_POINTER(Type, &x)
+		DECLARE_SUBSCRIPT_OPERATOR(Type, &x)
+
+	public:
+		matrix_3x3t<Type> to_3x3() const
+		{
+			Type x2 = x + x, y2 = y + y, z2 = z + z;
+			Type xx = x * x2, yy = y * y2, zz = z * z2;
+			Type xy = x * y2, xz = x * z2, yz = y * z2;
+			Type wx = w * x2, wy = w * y2, wz = w * z2;
+
+			return matrix_3x3t<Type>(
+				1 - (yy + zz), xy + wz, xz - wy,
+				xy - wz, 1 - (xx + zz), yz + wx,
+				xz + wy, yz - wx, 1 - (xx + yy));
+		}
+
+		matrix_4x4t<Type> to_4x4() const
+		{
+			matrix_3x3t<Type> m = to_3x3();
+			return matrix_4x4t<Type>(
+				m[0][0], m[0][1], m[0][2], 0,
+				m[1][0], m[1][1], m[1][2], 0,
+				m[2][0], m[2][1], m[2][2], 0,
+				0, 0, 0, 1);
+		}
+
+	public:
+		Type x;
+		Type y;
+		Type z;
+		Type w;
+	};
+
+	typedef quaternion_t<float> quat;
+	typedef quaternion_t<float8> quatx8;
+
+	//////////////////////////////////////////////////////////////////////////
+	// arithmetic, as on 4d vectors
+	template<typename Type>
+	quaternion_t<Type> operator - (const quaternion_t<Type> &operand)
+	{
+		return quaternion_t<Type>(-operand.x, -operand.y, -operand.z, -operand.w);
+	}
+
+	template<typename Type>
+	quaternion_t<Type> operator + (const quaternion_t<Type> &lhs, const quaternion_t<Type> &rhs)
+	{
+		return quaternion_t<Type>(lhs.x + rhs.x, lhs.y + rhs.y, lhs.z + rhs.z, lhs.w + rhs.w);
+	}
+
+	template<typename Type>
+	quaternion_t<Type> operator - (const quaternion_t<Type> &lhs, const quaternion_t<Type> &rhs)
+	{
+		return quaternion_t<Type>(lhs.x - rhs.x, lhs.y - rhs.y, lhs.z - rhs.z, lhs.w - rhs.w);
+	}
+
+	template<typename Type>
+	quaternion_t<Type> operator * (const quaternion_t<Type> &lhs, const typename quaternion_t<Type>::value_type &scale)
+	{
+		return quaternion_t<Type>(lhs.x * scale, lhs.y * scale, lhs.z * scale, lhs.w * scale);
+	}
+
+	template<typename Type>
+	quaternion_t<Type> operator * (const typename quaternion_t<Type>::value_type &scale, const quaternion_t<Type> &rhs)
+	{
+		return rhs * scale;
+	}
+
+	template<typename Type>
+	Type dot(const quaternion_t<Type> &lhs, const quaternion_t<Type> &rhs)
+	{
+		return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z + lhs.w * rhs.w;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// rotations
+	template<typename Type>
+	quaternion_t<Type> conj(const quaternion_t<Type> &operand)
+	{
+		return quaternion_t<Type>(-operand.x, -operand.y, -operand.z, operand.w);
+	}
+
+	template<typename Type>
+	quaternion_t<Type> normalize(const quaternion_t<Type> &operand)
+	{
+		using std::sqrt;
+		return operand * (1 / sqrt(dot(operand, operand)));
+	}
+
+	// lhs then rhs
+	template<typename Type>
+	quaternion_t<Type> mul(const quaternion_t<Type> &lhs, const quaternion_t<Type> &rhs)
+	{
+		const quaternion_t<Type> &a = rhs;
+		const quaternion_t<Type> &b = lhs;
+		return quaternion_t<Type>(
+			a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+			a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+			a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+			a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z);
+	}
+
+	// q must be a unit quaternion
+	template<typename Type>
+	vector_3t<Type> rotate(const quaternion_t<Type> &q, const vector_3t<Type> &v)
+	{
+		// v + w * t + cross(q.xyz, t) with t = 2 * cross(q.xyz, v)
+		Type tx = 2 * (q.y * v.z - q.z * v.y);
+		Type ty = 2 * (q.z * v.x - q.x * v.z);
+		Type tz = 2 * (q.x * v.y - q.y * v.x);
+		return vector_3t<Type>(
+			v.x + q.w * tx + (q.y * tz - q.z * ty),
+			v.y + q.w * ty + (q.z * tx - q.x * tz),
+			v.z + q.w * tz + (q.x * ty - q.y * tx));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// interpolation, both take the shortest path
+	inline float shortest_path_sign(float d)
+	{
+		return d < 0 ? -1.0f : 1.0f;
+	}
+
+	inline float8 shortest_path_sign(const float8 &d)
+	{
+		return select(d < float8(0), float8(-1), float8(1));
+	}
+
+	// normalized lerp, cheap and good enough for close rotations such as
+	// neighbouring key frames
+	template<typename Type>
+	quaternion_t<Type> nlerp(const quaternion_t<Type> &from, const quaternion_t<Type> &to, const Type &t)
+	{
+		Type s = shortest_path_sign(dot(from, to));
+		quaternion_t<Type> q = from * (1 - t) + to * (s * t);
+		return q * rsqrt_fast(dot(q, q));
+	}
+
+	// spherical lerp, constant angular velocity
+	template<typename Type>
+	quaternion_t<Type> slerp(const quaternion_t<Type> &from, const quaternion_t<Type> &to, const Type &t)
+	{
+		Type d = dot(from, to);
+		Type s = shortest_path_sign(d);
+		d *= s;
+
+		// nearly parallel, sin(theta) would vanish
+		if (d > Type(0.9995))
+		{
+			return nlerp(from, to, t);
+		}
+
+		Type theta = std::acos(d);
+		Type sin_r = 1 / std::sin(theta);
+		return from * (std::sin((1 - t) * theta) * sin_r) + to * (s * std::sin(t * theta) * sin_r);
+	}
+
+	// branch-free form for the packets, through the fast math kernels
+	inline quatx8 slerp(const quatx8 &from, const quatx8 &to, const float8 &t)
+	{
+		float8 d = dot(from, to);
+		float8 s = shortest_path_sign(d);
+		d *= s;
+
+		float8 parallel = float8(0.9995f) < d;
+		float8 theta = acos_fast(d);
+		float8 sin_r = rcp_fast(select(parallel, float8(1), sin_fast(theta)));
+		float8 wa = select(parallel, 1 - t, sin_fast((1 - t) * theta) * sin_r);
+		float8 wb = select(parallel, t, sin_fast(t * theta) * sin_r) * s;
+
+		quatx8 q = from * wa + to * wb;
+		return q * rsqrt_fast(dot(q, q));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// batch interpolation of n rotations, out[i] = xlerp(from[i], to[i], t[i]).
+	// computed 8 at a time on quatx8 and multithreaded for large n; out may
+	// alias from or to.
+	void nlerp(const quat *from, const quat *to, const float *t, quat *out, size_t n);
+	void slerp(const quat *from, const quat *to, const float *t, quat *out, size_t n);
+
+	// same with one weight for all, e.g. to blend two sampled poses
+	void nlerp(const quat *from, const quat *to, float t, quat *out, size_t n);
+	void slerp(const quat *from, const quat *to, float t, quat *out, size_t n);
+}
+
+#endif // _QUATERNION_HPP_
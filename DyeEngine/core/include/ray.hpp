@@ -0,0 +1,93 @@
+#ifndef _RAY_HPP_
+#define _RAY_HPP_
+
+// rays, hits and their packets of 8 for IRayTraceable (see geometry.hpp).
+// a ray covers origin + t * direction for t in [tmin, tmax]; the direction
+// need not be normalized, t is measured in its length.
+
+#include "vector.hpp"
+#include "packet.hpp"
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		// hit::triangle of a miss, and hit::instance of a hit outside any
+		// instance
+		const unsigned int c_no_hit = ~0u;
+
+		struct aabb
+		{
+			float3 lower;
+			float3 upper;
+		};
+
+		struct ray
+		{
+			float3 origin;
+			float tmin;
+			float3 direction;
+			float tmax;
+		};
+
+		// the hit point is (1 - u - v) * v0 + u * v1 + v * v2 of the triangle,
+		// which belongs to the object of the instance in a two level tree
+		struct hit
+		{
+			float t;
+			float u;
+			float v;
+			unsigned int triangle;
+			unsigned int instance;
+		};
+
+		// lanes with tmin > tmax take no part
+		struct ray8
+		{
+			float3x8 origin;
+			float3x8 direction;
+			float8 tmin;
+			float8 tmax;
+		};
+
+		struct hit8
+		{
+			float8 t;
+			float8 u;
+			float8 v;
+			unsigned int triangle[c_packet_width];
+			unsigned int instance[c_packet_width];
+		};
+
+		// lane i of the packet from rays[i], the lanes from count on inactive
+		inline void load_packet(const ray *rays, size_t count, ray8 &packet)
+		{
+			for (size_t i = 0; i != c_packet_width; ++i)
+			{
+				const ray &r = rays[i < count ? i : 0];
+				packet.origin.x[i] = r.origin.x;
+				packet.origin.y[i] = r.origin.y;
+				packet.origin.z[i] = r.origin.z;
+				packet.direction.x[i] = r.direction.x;
+				packet.direction.y[i] = r.direction.y;
+				packet.direction.z[i] = r.direction.z;
+				packet.tmin[i] = i < count ? r.tmin : 1.0f;
+				packet.tmax[i] = i < count ? r.tmax : 0.0f;
+			}
+		}
+
+		inline void store_packet(const hit8 &packet, size_t count, hit *hits)
+		{
+			for (size_t i = 0; i != count; ++i)
+			{
+				hits[i].t = packet.t[i];
+				hits[i].u = packet.u[i];
+				hits[i].v = packet.v[i];
+				hits[i].triangle = packet.triangle[i];
+				hits[i].instance = packet.instance[i];
+			}
+		}
+	}
+}
+
+#endif // _RAY_HPP_
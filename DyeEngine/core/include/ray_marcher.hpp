@@ -0,0 +1,148 @@
+#ifndef _RAY_MARCHER_HPP_
+#define _RAY_MARCHER_HPP_
+
+// headless sphere tracer for Render::RayMarching: renders an IRayMarchable
+// on the cpu into a depth buffer and a shaded float framebuffer.
+//
+// a ray steps by the distance at its point, which no surface is closer
+// than (hart, "sphere tracing"), until the distance falls under the
+// footprint of its pixel there. the cost is the number of distance
+// evaluations, so
+// - the steps are over-relaxed by a factor above 1; when the balls of two
+//   steps stop overlapping the ray may have passed the surface, so it goes
+//   back to the safe step and carries on unrelaxed (keinert et al.,
+//   "enhanced sphere tracing"),
+// - the rays march in packets of 4x2 pixels, 8 lanes evaluated at once
+//   through the packet distance, and
+// - a pre-pass marches one cone per 8x8 pixel cell, wide enough to hold
+//   the rays of all its pixels, as far as the surface leaves the whole
+//   cone empty. the rays of the cell start where their cone stopped, and
+//   a cone that leaves the bounds misses for all of them.
+//
+// the image splits into the 8x8 cells for the openmp threads, both for
+// the pre-pass and for the rays. the rays march only through the bounds
+// of the geometry.
+
+#include <stddef.h>
+#include <vector>
+
+#include "camera.hpp"
+#include "geometry.hpp"
+
+namespace Dye
+{
+	namespace Render
+	{
+		struct march_settings
+		{
+			// steps per ray at most; a ray that runs out misses
+			int max_steps;
+
+			// a ray hits where the distance falls under this many times the
+			// footprint of its pixel
+			float hit_scale;
+
+			// the factor of the over-relaxed steps, 1 for plain sphere
+			// tracing
+			float relaxation;
+
+			// 8 rays at a time, and the cone pre-pass
+			bool packets;
+			bool cones;
+
+			// the shading: lambertian albedo under a directional light
+			// towards light, and the colour of the misses
+			float3 albedo;
+			float3 light;
+			float3 sky;
+
+			march_settings()
+				: max_steps(256), hit_scale(0.5f), relaxation(1.2f), packets(true), cones(true),
+				albedo(0.8f, 0.8f, 0.8f), light(0.4f, 0.8f, -0.45f), sky(0.4f, 0.5f, 0.7f)
+			{
+			}
+		};
+
+		struct march_stats
+		{
+			// camera rays, and those that hit
+			size_t rays;
+			size_t hits;
+
+			// distance evaluations per ray along the rays, and per cone
+			// along the cones of the pre-pass; the normals of the hits take
+			// 4 more each, counted in neither
+			size_t steps;
+			size_t cone_steps;
+			double seconds;
+
+			// the average cost of a ray, its share of the cones included
+			double steps_per_ray() const
+			{
+				return rays == 0 ? 0 : static_cast<double>(steps + cone_steps) / rays;
+			}
+		};
+
+		// the pixels of a pre-pass cell along each side
+		const size_t c_cone_cell = 8;
+
+		class RayMarcher
+		{
+		public:
+			// the geometry must outlive the marcher
+			RayMarcher(const Graphics::IRayMarchable &geometry, size_t width, size_t height);
+
+			void set_camera(const camera &view);
+			void set_settings(const march_settings &settings) { m_settings = settings; }
+
+			march_stats render();
+
+		public:
+			size_t width() const { return m_width; }
+			size_t height() const { return m_height; }
+
+			// the distance from the eye to the hit per pixel in rows from
+			// the top, FLT_MAX for a miss
+			const float *depth() const { return m_depth.empty() ? 0 : &m_depth[0]; }
+
+			// rgb per pixel
+			const float *image() const { return m_rgb.empty() ? 0 : &m_rgb[0]; }
+
+			// where the rays of each cell start, from the last render with
+			// the pre-pass: FLT_MAX if none of them can hit
+			size_t cone_columns() const { return (m_width + c_cone_cell - 1) / c_cone_cell; }
+			size_t cone_rows() const { return (m_height + c_cone_cell - 1) / c_cone_cell; }
+			const float *cone_starts() const { return m_cone_start.empty() ? 0 : &m_cone_start[0]; }
+
+		private:
+			float3 direction(float x, float y) const;
+
+			float march_cone(size_t column, size_t row, march_stats &stats) const;
+			void render_cell(size_t cell, march_stats &stats);
+			void march_single(size_t x, size_t y, float start, march_stats &stats);
+			void march_packet(size_t x0, size_t y0, float start, march_stats &stats);
+			float3 shade(const float3 &normal) const;
+
+			const Graphics::IRayMarchable *m_geometry;
+			size_t m_width;
+			size_t m_height;
+
+			camera m_camera;
+			camera_frame m_frame;
+			march_settings m_settings;
+
+			// the angle a pixel spans, as the tangent
+			float m_pixel_angle;
+
+			// the distances from the eye to the bounds, nearest and furthest
+			float m_near;
+			float m_far;
+
+			std::vector<float> m_cone_start;
+			std::vector<float> m_depth;
+			std::vector<float> m_rgb;
+		};
+	}
+}
+
+#endif // _RAY_MARCHER_HPP_
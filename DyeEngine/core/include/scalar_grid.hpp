@@ -0,0 +1,51 @@
+#ifndef _SCALAR_GRID_HPP_
+#define _SCALAR_GRID_HPP_
+
+// a scalar field stored as its values at the points of a dense lattice,
+// read back by trilinear interpolation, the positions past the lattice
+// clamped onto it. a lattice of the same origin and spacing reads the
+// values as they are, which is how marching cubes reads a grid it was
+// given samples in.
+
+#include <stddef.h>
+#include <vector>
+
+#include "geometry.hpp"
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		class ScalarGrid : public IScalarField
+		{
+		public:
+			ScalarGrid();
+
+			// nx by ny by nz values, x fastest, at the points spacing apart
+			// from origin on
+			ScalarGrid(const float *values, const float3 &origin, float spacing, size_t nx, size_t ny, size_t nz);
+
+			void assign(const float *values, const float3 &origin, float spacing, size_t nx, size_t ny, size_t nz);
+
+			// the values of field at those points
+			void assign(const IScalarField &field, const float3 &origin, float spacing, size_t nx, size_t ny, size_t nz);
+
+		public:
+			void sample_grid(const lattice &grid, float *out) const;
+
+		public:
+			const float3 &origin() const { return m_origin; }
+			float spacing() const { return m_spacing; }
+			size_t count(int axis) const { return m_count[axis]; }
+			const float *values() const { return m_values.empty() ? 0 : &m_values[0]; }
+
+		private:
+			std::vector<float> m_values;
+			float3 m_origin;
+			float m_spacing;
+			size_t m_count[3];
+		};
+	}
+}
+
+#endif // _SCALAR_GRID_HPP_
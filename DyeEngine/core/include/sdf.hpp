@@ -0,0 +1,266 @@
+#ifndef _SDF_HPP_
+#define _SDF_HPP_
+
+// signed distance scenes as trees of primitives and operations, and the
+// register bytecode they compile to.
+//
+// an SdfTree keeps its nodes in an array, and a node names its children
+// by index, so that a child may serve several parents. the primitives sit
+// at the origin; translate, scale and repeat move the space their child
+// sees. SdfTree::distance() walks the tree node by node, the reference the
+// compiled form must agree with.
+//
+// SdfProgram compiles a tree:
+// - every node becomes an instruction or a few, on registers that hold a
+//   value for each of the points evaluated together. the point comes in
+//   registers 0 to 2; the transforms compute their coordinates into
+//   registers of their own,
+// - instructions whose operands do not depend on the point fold into
+//   constants, and identities go away: a translation by zero, a scale by
+//   one, a union with an empty shape. the branches folding leaves unused
+//   are not emitted, nor are nodes the root does not reach,
+// - equal instructions on equal operands are emitted once,
+// - the registers are reused once their value is last read, the operand
+//   with the larger subtree evaluated first so that long chains of unions
+//   need few of them.
+// the interpreter runs each instruction over all the points before the
+// next: 16 points, two packets of 8, for the batches, 8 for the packet
+// distance and 1 for the scalar one, so that decoding an instruction is
+// paid once for all of them.
+//
+// the program also runs on intervals, a range per register that its value
+// stays in while the point stays in a box (moore's interval arithmetic).
+// where the ranges of the operands of a min do not overlap, the same one
+// is the smaller all over the box, and so for max, difference and smooth
+// min; prune() takes that operand and lets the other branch go as dead
+// code, which leaves a program that is exact in the box and often a
+// fraction of the size (keeter, "massively parallel rendering of complex
+// closed-form implicit surfaces"). the range of the distance tells
+// whether the box is all outside, all inside or may hold surface.
+//
+// the distances are lower bounds, as IRayMarchable asks, as long as
+// - smooth unions blend within k of both shapes, so that the result
+//   stays within k / 4 of the plain union,
+// - a repeated child fits in its cell: the distance is the one of the
+//   copy in the nearest cell, and
+// - scales are positive.
+
+#include <stddef.h>
+#include <vector>
+
+#include "geometry.hpp"
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		//////////////////////////////////////////////////////////////////////////
+		// tree
+		//////////////////////////////////////////////////////////////////////////
+		enum sdf_node_type
+		{
+			sdf_constant,
+			sdf_sphere,
+			sdf_box,
+			sdf_torus,
+			sdf_cylinder,
+			sdf_plane,
+			sdf_union,
+			sdf_intersection,
+			sdf_difference,
+			sdf_smooth_union,
+			sdf_translate,
+			sdf_scale,
+			sdf_repeat,
+		};
+
+		// a and b are the operands of the operations, a the child of the
+		// transforms; the parameters are those of the SdfTree function that
+		// made the node, in order
+		struct sdf_node
+		{
+			sdf_node_type type;
+			unsigned int a;
+			unsigned int b;
+			float parameters[6];
+		};
+
+		class SdfTree
+		{
+		public:
+			// a distance the same everywhere; empty() is so far that it
+			// drops out of any union
+			unsigned int constant(float distance);
+			unsigned int empty();
+
+			// the primitives, centered on the origin: a box of the half
+			// sizes, a torus around the y axis and a cylinder along it,
+			// capped at +-half_height, and the half space below the plane
+			// dot(p, normal) = offset for a normal of unit length
+			unsigned int sphere(float radius);
+			unsigned int box(const float3 &half_size);
+			unsigned int torus(float ring_radius, float tube_radius);
+			unsigned int cylinder(float radius, float half_height);
+			unsigned int plane(const float3 &normal, float offset);
+
+			// union, intersection, a without b, and the union blended over
+			// distance k > 0
+			unsigned int merge(unsigned int a, unsigned int b);
+			unsigned int intersect(unsigned int a, unsigned int b);
+			unsigned int subtract(unsigned int a, unsigned int b);
+			unsigned int smooth_merge(unsigned int a, unsigned int b, float k);
+
+			// the child moved by offset, scaled by factor > 0, and copied
+			// every spacing along each axis, limit copies each way of the
+			// middle one. a spacing of 0 leaves the axis alone, and a limit
+			// of FLT_MAX copies without end
+			unsigned int translate(unsigned int child, const float3 &offset);
+			unsigned int scale(unsigned int child, float factor);
+			unsigned int repeat(unsigned int child, const float3 &spacing, const float3 &limit);
+
+		public:
+			size_t size() const { return m_nodes.size(); }
+			const sdf_node &node(unsigned int index) const { return m_nodes[index]; }
+
+			// the distance of the subtree of node at p
+			float distance(unsigned int node, const float3 &p) const;
+
+			// a box around the surface of the subtree of node, unbounded
+			// along the axes a plane or an endless repetition leaves open
+			aabb bounds(unsigned int node) const;
+
+		private:
+			unsigned int add(sdf_node_type type, unsigned int a, unsigned int b, const float *parameters,
+				size_t count);
+
+			std::vector<sdf_node> m_nodes;
+		};
+
+		//////////////////////////////////////////////////////////////////////////
+		// program
+		//////////////////////////////////////////////////////////////////////////
+		enum sdf_opcode
+		{
+			// target = k0
+			sdf_op_constant,
+
+			// target = a - k0, a * k0, and a folded into its cell of
+			// spacing k0 (k1 = 1 / k0) with at most k2 cells each way
+			sdf_op_offset,
+			sdf_op_multiply,
+			sdf_op_repeat,
+
+			// the primitives at the point a, b, c, with the parameters of
+			// their SdfTree function as k
+			sdf_op_sphere,
+			sdf_op_box,
+			sdf_op_torus,
+			sdf_op_cylinder,
+			sdf_op_plane,
+
+			// target = min(a, b), max(a, b), max(a, -b), and the smooth
+			// minimum over k0 (k1 = 1 / k0)
+			sdf_op_min,
+			sdf_op_max,
+			sdf_op_difference,
+			sdf_op_smooth_min,
+
+			sdf_opcode_count
+		};
+
+		const char *sdf_opcode_name(sdf_opcode op);
+
+		// the constants of an instruction start at constant in the pool
+		// of the program
+		struct sdf_instruction
+		{
+			unsigned short op;
+			unsigned short target;
+			unsigned short a;
+			unsigned short b;
+			unsigned short c;
+			unsigned short constant;
+		};
+
+		// the range of a value over a box
+		struct sdf_interval
+		{
+			float lower;
+			float upper;
+
+			sdf_interval() {}
+			explicit sdf_interval(float value) : lower(value), upper(value) {}
+			sdf_interval(float lower, float upper) : lower(lower), upper(upper) {}
+		};
+
+		// registers a program may use at most
+		const unsigned int c_sdf_registers = 64;
+
+		class SdfProgram : public IRayMarchable, public IScalarField
+		{
+		public:
+			SdfProgram();
+
+			// false if the tree needs more than c_sdf_registers at once,
+			// which leaves the program empty. the bounds become those of
+			// the tree
+			bool compile(const SdfTree &tree, unsigned int root);
+
+			// narrows the bounds, e.g. to close off a floor plane
+			void set_bounds(const aabb &box) { m_bounds = box; }
+
+		public:
+			aabb bounds() const { return m_bounds; }
+			float distance(const float3 &p) const;
+			float8 distance(const float3x8 &p) const;
+
+			// the distances of count points, given as three arrays or as
+			// float3s
+			void distances(const float *x, const float *y, const float *z, size_t count, float *out) const;
+			void distances(const float3 *points, size_t count, float *out) const;
+
+			// the distances at the points of a lattice, a row at a time, as
+			// marching cubes samples them; the second form at nx by ny by nz
+			// points spacing apart from origin on
+			void sample_grid(const lattice &grid, float *out) const;
+			void sample_grid(const float3 &origin, float spacing, size_t nx, size_t ny, size_t nz, float *out) const;
+
+			// evaluate() as IScalarField asks for it
+			void range(const aabb &box, float &lower, float &upper) const;
+
+			// the distance at p and the unit direction away from the
+			// surface there, by differences over step, for collision
+			float contact(const float3 &p, float3 &normal, float step = 1e-3f) const;
+
+			// the range of the distance over region, up to rounding; region
+			// is outside the surface where it is above 0, inside below
+			sdf_interval evaluate(const aabb &region) const;
+
+			// the program with the choices region decides made, the same
+			// as this one inside region and bounded by it, and the range of
+			// the distance over region. pruned may be this program
+			sdf_interval prune(const aabb &region, SdfProgram &pruned) const;
+
+		public:
+			size_t instruction_count() const { return m_code.size(); }
+			unsigned int register_count() const { return m_registers; }
+			const sdf_instruction *instructions() const { return m_code.empty() ? 0 : &m_code[0]; }
+			const float *constants() const { return m_constants.empty() ? 0 : &m_constants[0]; }
+
+			// the register the distance ends up in
+			unsigned int result() const { return m_result; }
+
+		private:
+			template<typename Lane, size_t Width>
+			void run(Lane *registers) const;
+
+			std::vector<sdf_instruction> m_code;
+			std::vector<float> m_constants;
+			unsigned int m_registers;
+			unsigned int m_result;
+			aabb m_bounds;
+		};
+	}
+}
+
+#endif // _SDF_HPP_
@@ -0,0 +1,127 @@
+#ifndef _SDF_BLOCKS_HPP_
+#define _SDF_BLOCKS_HPP_
+
+// a signed distance program split over the blocks of a grid, each with the
+// part of the program that matters there.
+//
+// the box is covered by blocks of c_sdf_top_block cells along each side,
+// and the distance over each is evaluated on intervals. a block the
+// surface stays more than a cell away from is outside or inside and keeps
+// only the range of the distance there; the others keep the program pruned
+// to them and split into 8, which prune the program of their parent in
+// turn, down to blocks of c_sdf_leaf_block cells. the top blocks build on
+// the openmp threads.
+//
+// as an IScalarField the blocks sample a lattice a leaf at a time, each
+// with the program of its block, so that marching cubes pays for the
+// pruned programs alone and finds the lattices outside and inside
+// already settled. as an IRayMarchable the blocks give the distance of a point
+// by the program of its block, a fraction of the size of the whole. in a
+// block outside the distance rises to that to the block's side plus the
+// range there where that is more, as the way to the surface crosses the
+// side first, so that rays leave empty blocks in few steps; inside blocks
+// give that bound alone. the tetrahedron of a normal stays in surface
+// blocks, as those reach a cell past the surface.
+
+#include <stddef.h>
+#include <vector>
+
+#include "sdf.hpp"
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		// cells along the side of the largest and of the smallest blocks
+		const unsigned int c_sdf_top_block = 64;
+		const unsigned int c_sdf_leaf_block = 8;
+
+		enum sdf_block_type
+		{
+			sdf_block_outside,
+			sdf_block_inside,
+			sdf_block_surface,
+		};
+
+		struct sdf_block
+		{
+			// the first cell along each axis and the cells along each side
+			unsigned int cell[3];
+			unsigned int size;
+
+			sdf_block_type type;
+			sdf_interval range;
+
+			// the pruned program of a block outside or on the surface
+			unsigned int program;
+		};
+
+		// a leaf of the grid outside the blocks
+		const unsigned int c_no_block = ~0u;
+
+		class SdfBlocks : public IRayMarchable, public IScalarField
+		{
+		public:
+			SdfBlocks();
+
+			// blocks over box in cells of cell_size, from box.lower on. the
+			// blocks keep a copy of the program for points outside box
+			void build(const SdfProgram &program, const aabb &box, float cell_size);
+
+		public:
+			// the bounds of the program within box
+			aabb bounds() const { return m_bounds; }
+			float distance(const float3 &p) const;
+			float8 distance(const float3x8 &p) const;
+
+			// the distances as distance() gives them, and the ranges of the
+			// blocks box meets
+			void sample_grid(const lattice &grid, float *out) const;
+			void range(const aabb &box, float &lower, float &upper) const;
+
+		public:
+			float cell_size() const { return m_cell; }
+			const float3 &origin() const { return m_origin; }
+
+			// leaves along each axis, c_sdf_leaf_block cells each
+			unsigned int leaves(int axis) const { return m_leaves[axis]; }
+
+			// the blocks that did not split
+			size_t block_count() const { return m_blocks.size(); }
+			const sdf_block &block(size_t index) const { return m_blocks[index]; }
+			const SdfProgram &program(unsigned int index) const { return m_programs[index]; }
+
+			// the block p is in, c_no_block outside the grid
+			unsigned int find(const float3 &p) const;
+
+			// the blocks of a type, and the instructions of the surface
+			// programs on average
+			size_t count(sdf_block_type type) const;
+			double average_instructions() const;
+
+		private:
+			void split(const SdfProgram &parent, const unsigned int *cell, unsigned int size,
+				std::vector<sdf_block> &blocks, std::vector<SdfProgram> &programs) const;
+
+			// the bound for p in a block outside or inside
+			float bound(const sdf_block &block, const float3 &p) const;
+
+			SdfProgram m_program;
+			aabb m_bounds;
+			float3 m_origin;
+			float m_cell;
+			unsigned int m_leaves[3];
+
+			// 1 / the side of a leaf
+			float m_leaf_scale;
+
+			std::vector<sdf_block> m_blocks;
+			std::vector<SdfProgram> m_programs;
+
+			// the block of each leaf, x fastest
+			std::vector<unsigned int> m_lookup;
+		};
+	}
+}
+
+#endif // _SDF_BLOCKS_HPP_
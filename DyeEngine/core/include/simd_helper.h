@@ -0,0 +1,44 @@
+#ifndef _SIMD_HELPER_H_
+#define _SIMD_HELPER_H_
+
+//////////////////////////////////////////////////////////////////////////
+// compile-time simd switch
+//
+// DYE_SIMD_SSE / DYE_SIMD_SSE2 / DYE_SIMD_AVX / DYE_SIMD_F16C are derived from
+// the compiler flags. Define DYE_NO_SIMD before including any math header to fall back to
+// the plain scalar templates, so that the two implementations can be compared.
+//////////////////////////////////////////////////////////////////////////
+#if !defined(DYE_NO_SIMD)
+#	if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#		define DYE_SIMD_SSE
+#	endif
+#	if defined(DYE_SIMD_SSE) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#		define DYE_SIMD_SSE2
+#	endif
+#	if defined(DYE_SIMD_SSE) && defined(__AVX__)
+#		define DYE_SIMD_AVX
+#	endif
+#	if defined(DYE_SIMD_AVX) && (defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__)))
+#		define DYE_SIMD_F16C
+#	endif
+#endif
+
+#if defined(DYE_SIMD_SSE)
+#	include <xmmintrin.h>
+#endif
+
+#if defined(DYE_SIMD_SSE2)
+#	include <emmintrin.h>
+#endif
+
+#if defined(DYE_SIMD_AVX)
+#	include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#	define DYE_ALIGN(n) __declspec(align(n))
+#else
+#	define DYE_ALIGN(n) __attribute__((aligned(n)))
+#endif
+
+#endif // _SIMD_HELPER_H_
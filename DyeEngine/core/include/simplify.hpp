@@ -0,0 +1,76 @@
+#ifndef _SIMPLIFY_HPP_
+#define _SIMPLIFY_HPP_
+
+// triangle count reduction by edge collapses ordered by the quadric error
+// metric (garland and heckbert, "surface simplification using quadric
+// error metrics").
+//
+// a vertex collapses onto a neighbour and disappears, the neighbour stays
+// where it is, so every level indexes the vertices of the original mesh
+// and a whole lod chain shares one vertex buffer (see mesh_file.hpp).
+// open borders only collapse along themselves, and the two copies of a
+// vertex on an attribute seam (same position, other normal or uv)
+// collapse together along the seam, so neither tears. vertices where more
+// than two attribute copies or several borders meet are kept.
+//
+// the collapses run in passes: all candidate edges go into a heap, the
+// cheapest are taken while they do not share vertices or flip triangles,
+// and the next pass starts on the result.
+
+#include <stddef.h>
+#include <vector>
+
+#include "geometry.hpp"
+#include "mesh_file.hpp"
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		struct lod_options
+		{
+			lod_options()
+				: reduction(0.5f)
+				, max_levels(8)
+				, min_triangles(64)
+				, max_error(1e30f)
+			{
+			}
+
+			// triangles of a level over those of the one before
+			float reduction;
+
+			// including the full mesh
+			size_t max_levels;
+
+			// the levels stop at about min_triangles, or where the error
+			// would exceed max_error, in object space units
+			size_t min_triangles;
+			float max_error;
+		};
+
+		// out holds index_count indices; returns how many it got, at least
+		// target_index_count unless the error limit or the topology stops
+		// it first. error receives the object space error of the result.
+		size_t simplify(const vertex *vertices, size_t vertex_count,
+			const unsigned int *indices, size_t index_count,
+			size_t target_index_count, unsigned int *out,
+			float max_error = 1e30f, float *error = 0);
+
+		// the full mesh as it is and the levels down from it in vertex cache
+		// order, one after the other in lod_indices. lods[0] is the full mesh.
+		void build_lods(const vertex *vertices, size_t vertex_count,
+			const unsigned int *indices, size_t index_count, const lod_options &options,
+			std::vector<unsigned int> &lod_indices, std::vector<mesh_lod> &lods);
+
+		void build_lods(const IMeshable &mesh, const lod_options &options,
+			std::vector<vertex> &vertices, std::vector<unsigned int> &lod_indices, std::vector<mesh_lod> &lods);
+
+		// the coarsest level whose error, seen from distance, stays within
+		// threshold per unit of distance, e.g. the size of a pixel at
+		// distance 1. lods are finest first, as build_lods() makes them.
+		size_t select_lod(const mesh_lod *lods, size_t lod_count, float distance, float threshold);
+	}
+}
+
+#endif // _SIMPLIFY_HPP_
@@ -0,0 +1,166 @@
+#ifndef _SPARSE_VOLUME_HPP_
+#define _SPARSE_VOLUME_HPP_
+
+// a scalar field kept only in a narrow band around its surface, as a two
+// level brick map: a dense map over bricks of c_brick_cells cells along
+// each side, and the values of the bricks the band reaches. a dense 1024^3
+// field of floats takes 4 gb, while the band around a surface meets a few
+// percent of the bricks.
+//
+// a brick stores the c_brick_points^3 points of its cells, its high sides
+// repeating the low sides of the next, so that a cell reads its 8 corners
+// from one brick at fixed offsets. the rest of the map are tiles, all
+// outside or all inside, whose value is plus or minus the band. the
+// values are kept as floats, halves, or bytes scaled to the band, which
+// round them by 1 / 254 of it; map lookups and the decoding are O(1).
+//
+// every path reads the volume:
+// - as an IScalarField it samples lattices, reading its own points as
+//   they are, and gives the range of the bricks a box meets, so that
+//   marching cubes skips the chunks the band misses,
+// - as an IRayMarchable the trilinear value is the distance. in an
+//   outside tile it rises by the distance to the sides of the tile, as the
+//   surface is beyond them (cf. SdfBlocks), and by the bricks to the
+//   nearest that is not such a tile, kept per tile, so that a march
+//   crosses empty space in long steps. the band wants to be wider than
+//   the distance at which the march takes a hit, or the tiles next to it
+//   pass for the surface,
+// - as an IRayTraceable a ray walks the map a brick at a time (amanatides
+//   and woo, "a fast voxel traversal algorithm"), passes over the tiles
+//   and finds the sign change in a brick by steps of half a cell and
+//   bisection. a hit names the entry of the map it falls in as the
+//   triangle, and the normal there comes from normal().
+
+#include <stddef.h>
+#include <vector>
+
+#include "geometry.hpp"
+#include "half.hpp"
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		// cells along the side of a brick, and the points
+		const unsigned int c_brick_cells = 8;
+		const unsigned int c_brick_points = c_brick_cells + 1;
+		const size_t c_brick_values = c_brick_points * c_brick_points * c_brick_points;
+
+		// the map entries that are tiles, the others index the bricks
+		const unsigned int c_tile_outside = ~0u;
+		const unsigned int c_tile_inside = ~0u - 1;
+
+		enum volume_precision
+		{
+			volume_float,
+			volume_half,
+			volume_byte,
+		};
+
+		class SparseVolume : public IScalarField, public IRayMarchable, public IRayTraceable
+		{
+		public:
+			SparseVolume();
+
+			// the field over box in cells of cell_size, from box.lower on. a
+			// brick is kept where one of its points is within band of the
+			// surface or the sign changes; the bricks the range of the
+			// field keeps clear of the band are not sampled. the bricks
+			// build on the openmp threads
+			void build(const IScalarField &field, const aabb &box, float cell_size, float band,
+				volume_precision precision = volume_float);
+
+		public:
+			// the trilinear value at p, clamped to the points of the map
+			float value(const float3 &p) const;
+			float8 value(const float3x8 &p) const;
+
+			// the unit gradient of the value at p
+			float3 normal(const float3 &p) const;
+
+		public:
+			void sample_grid(const lattice &grid, float *out) const;
+			void range(const aabb &box, float &lower, float &upper) const;
+
+		public:
+			aabb bounds() const { return m_box; }
+			float distance(const float3 &p) const;
+			float8 distance(const float3x8 &p) const;
+
+			bool intersect(const ray &r, hit &h) const;
+			bool occluded(const ray &r) const;
+
+			// a lane at a time
+			void intersect(const ray8 &r, hit8 &h) const;
+			int occluded(const ray8 &r) const;
+
+		public:
+			const float3 &origin() const { return m_origin; }
+			float cell_size() const { return m_cell; }
+			float band() const { return m_band; }
+			volume_precision precision() const { return m_precision; }
+
+			// cells and bricks along each axis
+			unsigned int cells(int axis) const { return m_cells[axis]; }
+			unsigned int bricks(int axis) const { return m_bricks[axis]; }
+
+			// the entry of the map for brick x, y, z
+			unsigned int entry(unsigned int x, unsigned int y, unsigned int z) const
+			{
+				return m_map[(z * m_bricks[1] + y) * m_bricks[0] + x];
+			}
+
+			// the bricks kept: the first cell along each axis, the range of
+			// the values and the c_brick_values values, x fastest
+			size_t brick_count() const { return m_brick_cells.size() / 3; }
+			const unsigned int *brick_cell(size_t index) const { return &m_brick_cells[index * 3]; }
+			float brick_lower(size_t index) const { return m_brick_ranges[index * 2]; }
+			float brick_upper(size_t index) const { return m_brick_ranges[index * 2 + 1]; }
+			void decode(size_t index, float *out) const;
+
+			// the bytes of the map and the bricks
+			size_t memory() const;
+
+		private:
+			// the value of point index of a brick, and that of a tile
+			float fetch(unsigned int brick, size_t index) const;
+			float tile(unsigned int entry) const { return entry == c_tile_inside ? -m_band : m_band; }
+
+			// the 8 corners of the cell at point index of a brick, x lowest
+			void corners(unsigned int brick, size_t index, float *out) const;
+
+			// the cell p is in along each axis, clamped to the map, and the
+			// weights of the high points of the cell
+			void locate(const float3 &p, unsigned int *cell, float *weight) const;
+
+			// the value at point x, y, z of the map
+			float point(unsigned int x, unsigned int y, unsigned int z) const;
+
+			bool cast(const ray &r, hit *h) const;
+
+			float3 m_origin;
+			float m_cell;
+			float m_band;
+			aabb m_box;
+			unsigned int m_cells[3];
+			unsigned int m_bricks[3];
+			volume_precision m_precision;
+
+			std::vector<unsigned int> m_map;
+
+			// for each tile outside the bricks to the nearest entry that is
+			// not, along the axis of the most, up to 255; 0 for the others
+			std::vector<unsigned char> m_clearance;
+
+			std::vector<unsigned int> m_brick_cells;
+			std::vector<float> m_brick_ranges;
+
+			// the values of the bricks, one of them filled
+			std::vector<float> m_floats;
+			std::vector<half> m_halves;
+			std::vector<signed char> m_bytes;
+		};
+	}
+}
+
+#endif // _SPARSE_VOLUME_HPP_
@@ -0,0 +1,36 @@
+#ifndef _TRANSFORM_HPP_
+#define _TRANSFORM_HPP_
+
+#include "matrix.hpp"
+#include "primitive.hpp"
+
+namespace Dye
+{
+	//////////////////////////////////////////////////////////////////////////
+	// batch transformation
+	//
+	// all functions follow the row vector convention of mul(vector, matrix),
+	// i.e. the translation lives in the last row of mat. in and out may be
+	// the same array, but must not overlap otherwise. large arrays are
+	// split into batches and processed in parallel when openmp is enabled,
+	// on the kernels of the widest instruction set of the machine (see
+	// cpu_dispatch.hpp).
+	//////////////////////////////////////////////////////////////////////////
+
+	// out[i] = mul(in[i], mat)
+	void transform(const float4x4 &mat, const float4 *in, float4 *out, size_t n);
+
+	// out[i] = mul(float4(in[i], 1), mat).xyz, no perspective division
+	void transform_points(const float4x4 &mat, const float3 *in, float3 *out, size_t n);
+
+	// out[i] = normalize(mul(in[i], inverse transpose of the upper 3x3 of mat))
+	void transform_normals(const float4x4 &mat, const float3 *in, float3 *out, size_t n);
+
+	// rewrites pos and normal of every vertex in place, tex is untouched
+	void transform_vertices(const float4x4 &mat, Graphics::vertex *vertices, size_t n);
+
+	// out[i] = normalize(in[i]), zero vectors stay zero
+	void normalize(const float3 *in, float3 *out, size_t n);
+}
+
+#endif // _TRANSFORM_HPP_
@@ -7,6 +7,7 @@
 #include <boost/static_assert.hpp>
 
 #include "common_helper.h"
+#include "simd_helper.h"
 #include "vector_helper.hpp"
 
 namespace Dye
@@ -19,11 +20,23 @@ namespace Dye
 	typedef vector_3t<float> float3;
 	typedef vector_4t<float> float4;
 
+	// element types that behave as real numbers, i.e. that support division
+	// and sqrt. specialized by the non built-in element types.
+	template<typename Type>
+	struct is_real : boost::is_floating_point<Type>
+	{
+	};
+
+#if defined(DYE_EXPRESSION_TEMPLATES)
+	template<typename Obj, typename Op, typename L, typename R> struct expr_node;
+	template<size_t N, typename Type, typename Expr> void expr_assign(Type *dst, const Expr &expr);
+#endif
+
 	template<typename Type>
 	struct vector_2t
 	{
 	public:
-		vector_2t(Type nx = Type(), Type ny = Type())
+		vector_2t(const Type &nx = Type(), const Type &ny = Type())
 			: x(nx)
 			, y(ny)
 		{
@@ -34,6 +47,7 @@ namespace Dye
 		DECLARE_SUBSCRIPT_OPERATOR(Type, &x)
 		DECLARE_NATIVE_ITERATOR(Type, &x, 2)
 		DECLARE_SWIZZLING_FOR_VECTOR_2T()
+		DECLARE_EXPRESSION_EVALUATION(vector_2t, Type, 2)
 
 	public:
 		Type length_sqr() const
@@ -43,13 +57,14 @@ namespace Dye
 
 		Type length() const
 		{
-			BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
-			return std::sqrt(length_sqr());
+			BOOST_STATIC_ASSERT(is_real<Type>::value);
+			using std::sqrt;
+			return sqrt(length_sqr());
 		}
 
 		vector_2t& normalize()
 		{
-			BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
+			BOOST_STATIC_ASSERT(is_real<Type>::value);
 			return (*this) /= length();
 		}
 
@@ -68,16 +83,16 @@ namespace Dye
 			return *this;
 		}
 
-		vector_2t& operator *= (Type scale)
+		vector_2t& operator *= (const Type &scale)
 		{
 			x *= scale;
 			y *= scale;
 			return *this;
 		}
 
-		vector_2t& operator /= (Type scale)
+		vector_2t& operator /= (const Type &scale)
 		{
-			BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
+			BOOST_STATIC_ASSERT(is_real<Type>::value);
 			Type scale_r = 1 / scale;
 			return (*this) *= scale_r;
 		}
@@ -91,7 +106,7 @@ namespace Dye
 
 		vector_2t& operator /= (const vector_2t &rhs)
 		{
-			BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
+			BOOST_STATIC_ASSERT(is_real<Type>::value);
 			x /= rhs.x;
 			y /= rhs.y;
 			return *this;
@@ -106,7 +121,7 @@ namespace Dye
 	struct vector_3t
 	{
 	public:
-		vector_3t(Type nx = Type(), Type ny = Type(),Type nz = Type())
+		vector_3t(const Type &nx = Type(), const Type &ny = Type(),const Type &nz = Type())
 			: x(nx)
 			, y(ny)
 			, z(nz)
@@ -118,6 +133,7 @@ namespace Dye
 		DECLARE_SUBSCRIPT_OPERATOR(Type, &x)
 		DECLARE_NATIVE_ITERATOR(Type, &x, 3)
 		DECLARE_SWIZZLING_FOR_VECTOR_3T()
+		DECLARE_EXPRESSION_EVALUATION(vector_3t, Type, 3)
 
 	public:
 		Type length_sqr() const
@@ -127,13 +143,14 @@ namespace Dye
 
 		Type length() const
 		{
-			BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
-			return std::sqrt(length_sqr());
+			BOOST_STATIC_ASSERT(is_real<Type>::value);
+			using std::sqrt;
+			return sqrt(length_sqr());
 		}
 
 		vector_3t& normalize()
 		{
-			BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
+			BOOST_STATIC_ASSERT(is_real<Type>::value);
 			return (*this) /= length();
 		}
 
@@ -154,7 +171,7 @@ namespace Dye
 			return *this;
 		}
 
-		vector_3t& operator *= (Type scale)
+		vector_3t& operator *= (const Type &scale)
 		{
 			x *= scale;
 			y *= scale;
@@ -162,9 +179,9 @@ namespace Dye
 			return *this;
 		}
 
-		vector_3t& operator /= (Type scale)
+		vector_3t& operator /= (const Type &scale)
 		{
-			BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
+			BOOST_STATIC_ASSERT(is_real<Type>::value);
 			Type scale_r = 1 / scale;
 			return (*this) *= scale_r;
 		}
@@ -179,7 +196,7 @@ namespace Dye
 
 		vector_3t& operator /= (const vector_3t &rhs)
 		{
-			BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
+			BOOST_STATIC_ASSERT(is_real<Type>::value);
 			x /= rhs.x;
 			y /= rhs.y;
 			z /= rhs.z;
@@ -196,7 +213,7 @@ namespace Dye
 	struct vector_4t
 	{
 	public:
-		vector_4t(Type nx = Type(), Type ny = Type(), Type nz = Type(), Type nw = Type())
+		vector_4t(const Type &nx = Type(), const Type &ny = Type(), const Type &nz = Type(), const Type &nw = Type())
 			: x(nx)
 			, y(ny)
 			, z(nz)
@@ -209,6 +226,7 @@ namespace Dye
 		DECLARE_SUBSCRIPT_OPERATOR(Type, &x)
 		DECLARE_NATIVE_ITERATOR(Type, &x, 4)
 		DECLARE_SWIZZLING_FOR_VECTOR_4T()
+		DECLARE_EXPRESSION_EVALUATION(vector_4t, Type, 4)
 
 	public:
 		Type length_sqr() const
@@ -218,13 +236,14 @@ namespace Dye
 
 		Type length() const
 		{
-			BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
-			return std::sqrt(length_sqr());
+			BOOST_STATIC_ASSERT(is_real<Type>::value);
+			using std::sqrt;
+			return sqrt(length_sqr());
 		}
 
 		vector_4t& normalize()
 		{
-			BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
+			BOOST_STATIC_ASSERT(is_real<Type>::value);
 			return (*this) /= length();
 		}
 
@@ -243,11 +262,11 @@ namespace Dye
 			x -= rhs.x;
 			y -= rhs.y;
 			z -= rhs.z;
-			z -= rhs.w;
+			w -= rhs.w;
 			return *this;
 		}
 
-		vector_4t& operator *= (Type scale)
+		vector_4t& operator *= (const Type &scale)
 		{
 			x *= scale;
 			y *= scale;
@@ -256,9 +275,9 @@ namespace Dye
 			return *this;
 		}
 
-		vector_4t& operator /= (Type scale)
+		vector_4t& operator /= (const Type &scale)
 		{
-			BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
+			BOOST_STATIC_ASSERT(is_real<Type>::value);
 			Type scale_r = 1 / scale;
 			return (*this) *= scale_r;
 		}
@@ -274,7 +293,7 @@ namespace Dye
 
 		vector_4t& operator /= (const vector_4t &rhs)
 		{
-			BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
+			BOOST_STATIC_ASSERT(is_real<Type>::value);
 			x /= rhs.x;
 			y /= rhs.y;
 			z /= rhs.z;
@@ -289,6 +308,7 @@ namespace Dye
 		Type w;
 	};
 
+#if !defined(DYE_EXPRESSION_TEMPLATES)
 	//////////////////////////////////////////////////////////////////////////
 	// negation
 	template<typename Type>
@@ -394,7 +414,7 @@ namespace Dye
 	template<typename Type, typename S>
 	vector_2t<Type> operator / (const vector_2t<Type> &lhs, const S& scale)
 	{
-		BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
+		BOOST_STATIC_ASSERT(is_real<Type>::value);
 		Type scale_r = static_cast<Type>(1) / scale;
 		return lhs * scale_r;
 	}
@@ -402,7 +422,7 @@ namespace Dye
 	template<typename Type, typename S>
 	vector_3t<Type> operator / (const vector_3t<Type> &lhs, const S& scale)
 	{
-		BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
+		BOOST_STATIC_ASSERT(is_real<Type>::value);
 		Type scale_r = static_cast<Type>(1) / scale;
 		return lhs * scale_r;
 	}
@@ -410,7 +430,7 @@ namespace Dye
 	template<typename Type, typename S>
 	vector_4t<Type> operator / (const vector_4t<Type> &lhs, const S& scale)
 	{
-		BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
+		BOOST_STATIC_ASSERT(is_real<Type>::value);
 		Type scale_r = static_cast<Type>(1) / scale;
 		return lhs * scale_r;
 	}
@@ -440,24 +460,26 @@ namespace Dye
 	template<typename Type>
 	vector_2t<Type> operator / (const vector_2t<Type> &lhs, const vector_2t<Type> &rhs)
 	{
-		BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
+		BOOST_STATIC_ASSERT(is_real<Type>::value);
 		return vector_2t<Type> (lhs.x / rhs.x, lhs.y / rhs.y);
 	}
 
 	template<typename Type>
 	vector_3t<Type> operator / (const vector_3t<Type> &lhs, const vector_3t<Type> &rhs)
 	{
-		BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
+		BOOST_STATIC_ASSERT(is_real<Type>::value);
 		return vector_3t<Type> (lhs.x / rhs.x, lhs.y / rhs.y, lhs.z / rhs.z);
 	}
 
 	template<typename Type>
 	vector_4t<Type> operator / (const vector_4t<Type> &lhs, const vector_4t<Type> &rhs)
 	{
-		BOOST_STATIC_ASSERT(boost::is_floating_point<Type>::value);
+		BOOST_STATIC_ASSERT(is_real<Type>::value);
 		return vector_4t<Type> (lhs.x / rhs.x, lhs.y / rhs.y, lhs.z / rhs.z, lhs.w / rhs.w);
 	}
 
+#endif // !DYE_EXPRESSION_TEMPLATES
+
 	//////////////////////////////////////////////////////////////////////////
 	// normalization
 	template<typename Type>
@@ -519,6 +541,14 @@ namespace Dye
 	}
 }
 
+#if defined(DYE_SIMD_SSE)
+#include "vector_sse.hpp"
+#endif
+
+#if defined(DYE_EXPRESSION_TEMPLATES)
+#include "expression.hpp"
+#endif
+
 #include "vector_helper.hpp"
 
 #endif // _VECTOR_HPP_
\ No newline at end of file
@@ -0,0 +1,205 @@
+#ifndef _VECTOR_SSE_HPP_
+#define _VECTOR_SSE_HPP_
+
+// sse specialization of vector_4t<float>, included by vector.hpp only
+// when DYE_SIMD_SSE is defined. the public interface is kept identical
+// to the generic vector_4t, only the storage is aligned to 16 bytes so
+// that the whole vector can be moved in and out of an xmm register.
+
+namespace Dye
+{
+	//////////////////////////////////////////////////////////////////////////
+	// sse helpers
+	inline __m128 sse_splat(float s)
+	{
+		return _mm_set1_ps(s);
+	}
+
+	// returns the 4-component dot product in all lanes
+	inline __m128 sse_dot4(__m128 lhs, __m128 rhs)
+	{
+		__m128 m = _mm_mul_ps(lhs, rhs);
+		m = _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+	}
+
+	template<>
+	struct DYE_ALIGN(16) vector_4t<float>
+	{
+	private:
+		typedef float Type;
+
+	public:
+		vector_4t(float nx = 0, float ny = 0, float nz = 0, float nw = 0)
+			: x(nx)
+			, y(ny)
+			, z(nz)
+			, w(nw)
+		{
+		}
+
+		explicit vector_4t(__m128 v)
+		{
+			_mm_store_ps(&x, v);
+		}
+
+	public:
+		DECLARE_CONVERSION_TO_POINTER(float, &x)
+		DECLARE_SUBSCRIPT_OPERATOR(float, &x)
+		DECLARE_NATIVE_ITERATOR(float, &x, 4)
+		DECLARE_SWIZZLING_FOR_VECTOR_4T()
+		DECLARE_EXPRESSION_EVALUATION(vector_4t, float, 4)
+
+	public:
+		__m128 simd() const
+		{
+			return _mm_load_ps(&x);
+		}
+
+		void set_simd(__m128 v)
+		{
+			_mm_store_ps(&x, v);
+		}
+
+	public:
+		float length_sqr() const
+		{
+			__m128 v = simd();
+			return _mm_cvtss_f32(sse_dot4(v, v));
+		}
+
+		float length() const
+		{
+			__m128 v = simd();
+			return _mm_cvtss_f32(_mm_sqrt_ss(sse_dot4(v, v)));
+		}
+
+		vector_4t& normalize()
+		{
+			__m128 v = simd();
+			__m128 len = _mm_sqrt_ps(sse_dot4(v, v));
+			set_simd(_mm_mul_ps(v, _mm_div_ps(_mm_set1_ps(1.0f), len)));
+			return *this;
+		}
+
+	public:
+		vector_4t& operator += (const vector_4t &rhs)
+		{
+			set_simd(_mm_add_ps(simd(), rhs.simd()));
+			return *this;
+		}
+
+		vector_4t& operator -= (const vector_4t &rhs)
+		{
+			set_simd(_mm_sub_ps(simd(), rhs.simd()));
+			return *this;
+		}
+
+		vector_4t& operator *= (float scale)
+		{
+			set_simd(_mm_mul_ps(simd(), sse_splat(scale)));
+			return *this;
+		}
+
+		vector_4t& operator /= (float scale)
+		{
+			float scale_r = 1 / scale;
+			return (*this) *= scale_r;
+		}
+
+		vector_4t& operator *= (const vector_4t &rhs)
+		{
+			set_simd(_mm_mul_ps(simd(), rhs.simd()));
+			return *this;
+		}
+
+		vector_4t& operator /= (const vector_4t &rhs)
+		{
+			set_simd(_mm_div_ps(simd(), rhs.simd()));
+			return *this;
+		}
+
+	public:
+		float x;
+		float y;
+		float z;
+		float w;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// negation
+	inline float4 operator - (const float4 &operand)
+	{
+		return float4(_mm_sub_ps(_mm_setzero_ps(), operand.simd()));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// addition
+	inline float4 operator + (const float4 &lhs, const float4 &rhs)
+	{
+		return float4(_mm_add_ps(lhs.simd(), rhs.simd()));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// subtraction
+	inline float4 operator - (const float4 &lhs, const float4 &rhs)
+	{
+		return float4(_mm_sub_ps(lhs.simd(), rhs.simd()));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// multiplication : vector * scalar
+	template<typename S>
+	float4 operator * (const float4 &lhs, const S& scale)
+	{
+		return float4(_mm_mul_ps(lhs.simd(), sse_splat(static_cast<float>(scale))));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// multiplication : scalar * vector
+	template<typename S>
+	float4 operator * (const S& scale, const float4 &rhs)
+	{
+		return float4(_mm_mul_ps(rhs.simd(), sse_splat(static_cast<float>(scale))));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// division : vector / scalar
+	template<typename S>
+	float4 operator / (const float4 &lhs, const S& scale)
+	{
+		float scale_r = 1.0f / scale;
+		return float4(_mm_mul_ps(lhs.simd(), sse_splat(scale_r)));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// piecewise multiplication : vector * vector
+	inline float4 operator * (const float4 &lhs, const float4 &rhs)
+	{
+		return float4(_mm_mul_ps(lhs.simd(), rhs.simd()));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// piecewise division : vector / vector
+	inline float4 operator / (const float4 &lhs, const float4 &rhs)
+	{
+		return float4(_mm_div_ps(lhs.simd(), rhs.simd()));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// normalization
+	inline float4 normalize(const float4 &operand)
+	{
+		float4 vec(operand);
+		return vec.normalize();
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// dot product
+	inline float dot(const float4 &lhs, const float4 &rhs)
+	{
+		return _mm_cvtss_f32(sse_dot4(lhs.simd(), rhs.simd()));
+	}
+}
+
+#endif // _VECTOR_SSE_HPP_
@@ -0,0 +1,165 @@
+#ifndef _VERTEX_FORMAT_HPP_
+#define _VERTEX_FORMAT_HPP_
+
+// compressed variants of Graphics::vertex (32 bytes) for the vertex buffers
+// that are read far more often than written:
+//
+//   packed_vertex16   16 bytes, 16 bit positions
+//   packed_vertex12   12 bytes, 11-11-10 bit positions
+//
+// positions are unorm integers inside the bounds of their mesh, normals
+// two snorm16 of the octahedral encoding and uvs half floats. the batch
+// pack() and unpack() run four vertices per step with sse2 and split large
+// arrays over the openmp threads. code templated on the vertex type (see
+// vertex_array) also takes the plain vertex, for which both are a copy.
+
+#include <stddef.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "primitive.hpp"
+#include "half.hpp"
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		//////////////////////////////////////////////////////////////////////////
+		// encodings
+		//////////////////////////////////////////////////////////////////////////
+
+		// axis aligned box the positions are quantized in
+		struct vertex_bounds
+		{
+			float3 lower;
+			float3 upper;
+		};
+
+		vertex_bounds compute_bounds(const vertex *vertices, size_t n);
+
+		// the unit sphere is projected onto the octahedron |x| + |y| + |z| = 1
+		// and its lower half folded over the upper one. with 16 bits per
+		// component the direction is kept to 0.004 degrees (6.4e-5 radians).
+		inline void oct_encode(const float3 &normal, short &x, short &y)
+		{
+			float r = 1 / std::max(std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z), 1e-30f);
+			float u = normal.x * r;
+			float v = normal.y * r;
+			if (normal.z < 0)
+			{
+				float fu = (1 - std::abs(v)) * (u >= 0 ? 1 : -1);
+				float fv = (1 - std::abs(u)) * (v >= 0 ? 1 : -1);
+				u = fu;
+				v = fv;
+			}
+
+			// rounded half away from zero, as the sse2 kernels do
+			u = std::min(std::max(u, -1.0f), 1.0f) * 32767;
+			v = std::min(std::max(v, -1.0f), 1.0f) * 32767;
+			x = static_cast<short>(u + (u >= 0 ? 0.5f : -0.5f));
+			y = static_cast<short>(v + (v >= 0 ? 0.5f : -0.5f));
+		}
+
+		inline float3 oct_decode(short x, short y)
+		{
+			float u = std::max(x / 32767.0f, -1.0f);
+			float v = std::max(y / 32767.0f, -1.0f);
+			float z = 1 - std::abs(u) - std::abs(v);
+			float t = std::max(-z, 0.0f);
+			u += u >= 0 ? -t : t;
+			v += v >= 0 ? -t : t;
+			return normalize(float3(u, v, z));
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// formats
+		//////////////////////////////////////////////////////////////////////////
+
+		// position error about 1 / 131070 of the bounds per axis
+		struct packed_vertex16
+		{
+			unsigned short pos[3];
+			unsigned short reserved;
+			short normal[2];
+			unsigned short tex[2];
+		};
+
+		// position error about 1 / 4094 of the bounds on x and y, 1 / 2046 on z
+		struct packed_vertex12
+		{
+			unsigned int pos;	// x in bits 0-10, y in 11-21, z in 22-31
+			short normal[2];
+			unsigned short tex[2];
+		};
+
+		// in and out may be the same array for vertex, must not overlap otherwise
+		void pack(const vertex *in, vertex *out, size_t n, const vertex_bounds &bounds);
+		void pack(const vertex *in, packed_vertex16 *out, size_t n, const vertex_bounds &bounds);
+		void pack(const vertex *in, packed_vertex12 *out, size_t n, const vertex_bounds &bounds);
+
+		void unpack(const vertex *in, vertex *out, size_t n, const vertex_bounds &bounds);
+		void unpack(const packed_vertex16 *in, vertex *out, size_t n, const vertex_bounds &bounds);
+		void unpack(const packed_vertex12 *in, vertex *out, size_t n, const vertex_bounds &bounds);
+
+		//////////////////////////////////////////////////////////////////////////
+		// vertex array
+		//
+		// vertices stored as Vertex, one of the formats above, together with
+		// the bounds they were packed in.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename Vertex>
+		class vertex_array
+		{
+		public:
+			typedef Vertex vertex_type;
+
+			vertex_array()
+			{
+				m_bounds.lower = m_bounds.upper = float3(0, 0, 0);
+			}
+
+			vertex_array(const vertex *vertices, size_t n)
+			{
+				assign(vertices, n);
+			}
+
+			void assign(const vertex *vertices, size_t n)
+			{
+				m_bounds = compute_bounds(vertices, n);
+				m_data.resize(n);
+				if (n)
+				{
+					pack(vertices, &m_data[0], n, m_bounds);
+				}
+			}
+
+			// unpacks count vertices from first on
+			void decode(size_t first, size_t count, vertex *out) const
+			{
+				if (count)
+				{
+					unpack(&m_data[first], out, count, m_bounds);
+				}
+			}
+
+			vertex operator [] (size_t i) const
+			{
+				vertex v;
+				decode(i, 1, &v);
+				return v;
+			}
+
+			size_t size() const { return m_data.size(); }
+			size_t byte_size() const { return m_data.size() * sizeof(Vertex); }
+			const Vertex *data() const { return m_data.empty() ? 0 : &m_data[0]; }
+			const vertex_bounds &bounds() const { return m_bounds; }
+
+		private:
+			std::vector<Vertex> m_data;
+			vertex_bounds m_bounds;
+		};
+	}
+}
+
+#endif // _VERTEX_FORMAT_HPP_
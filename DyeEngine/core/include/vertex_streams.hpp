@@ -0,0 +1,115 @@
+#ifndef _VERTEX_STREAMS_HPP_
+#define _VERTEX_STREAMS_HPP_
+
+// Graphics::vertex arrays split into one float stream per component
+// (structure of arrays), for the kernels that process a component of many
+// vertices at once.
+//
+// the streams of n vertices live in one buffer, back to back, each one
+// starting on a c_stream_alignment boundary; VertexStreamsSoA owns such a
+// buffer, VertexStreamsView reads one without owning it, e.g. from a
+// mapped file. to_soa() and to_aos() transpose in registers, 8 vertices
+// at a time with avx2 (see cpu_dispatch.hpp), in cache sized blocks that
+// are spread over the openmp threads.
+
+#include <stddef.h>
+#include <vector>
+
+#include "primitive.hpp"
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		// in the order of the vertex members
+		enum vertex_stream
+		{
+			stream_pos_x,
+			stream_pos_y,
+			stream_pos_z,
+			stream_normal_x,
+			stream_normal_y,
+			stream_normal_z,
+			stream_tex_u,
+			stream_tex_v,
+			stream_count
+		};
+
+		// bytes
+		const size_t c_stream_alignment = 64;
+
+		// floats from the start of one stream to the next, for n vertices
+		size_t stream_stride(size_t n);
+
+		// bytes of the buffer of n vertices
+		size_t streams_byte_size(size_t n);
+
+		//////////////////////////////////////////////////////////////////////////
+		// view
+		//////////////////////////////////////////////////////////////////////////
+		class VertexStreamsView
+		{
+		public:
+			VertexStreamsView();
+			VertexStreamsView(const float *const streams[stream_count], size_t n);
+
+			// over a buffer in the layout above, aligned to c_stream_alignment
+			VertexStreamsView(const void *buffer, size_t n);
+
+		public:
+			const float *stream(vertex_stream s) const { return m_streams[s]; }
+			const float *const *streams() const { return m_streams; }
+			size_t size() const { return m_size; }
+
+			vertex operator [] (size_t i) const;
+
+		private:
+			const float *m_streams[stream_count];
+			size_t m_size;
+		};
+
+		//////////////////////////////////////////////////////////////////////////
+		// owning streams
+		//////////////////////////////////////////////////////////////////////////
+		class VertexStreamsSoA
+		{
+		public:
+			VertexStreamsSoA();
+			explicit VertexStreamsSoA(size_t n);
+			explicit VertexStreamsSoA(const std::vector<vertex> &vertices);
+			VertexStreamsSoA(const VertexStreamsSoA &other);
+			VertexStreamsSoA& operator = (const VertexStreamsSoA &other);
+
+			// the contents are undefined afterwards
+			void resize(size_t n);
+			void swap(VertexStreamsSoA &other);
+
+		public:
+			float *stream(vertex_stream s) { return m_base + s * stream_stride(m_size); }
+			const float *stream(vertex_stream s) const { return m_base + s * stream_stride(m_size); }
+			size_t size() const { return m_size; }
+
+			// the whole buffer, streams_byte_size(size()) bytes
+			const void *data() const { return m_base; }
+
+			VertexStreamsView view() const { return VertexStreamsView(m_base, m_size); }
+
+		private:
+			std::vector<float> m_storage;
+			float *m_base;
+			size_t m_size;
+		};
+
+		//////////////////////////////////////////////////////////////////////////
+		// conversion
+		//////////////////////////////////////////////////////////////////////////
+		void to_soa(const vertex *in, size_t n, VertexStreamsSoA &out);
+		void to_soa(const std::vector<vertex> &in, VertexStreamsSoA &out);
+
+		// out holds in.size() vertices
+		void to_aos(const VertexStreamsView &in, vertex *out);
+		void to_aos(const VertexStreamsView &in, std::vector<vertex> &out);
+	}
+}
+
+#endif // _VERTEX_STREAMS_HPP_
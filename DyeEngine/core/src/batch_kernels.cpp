@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <cpu_dispatch.hpp>
+#include <matrix_aux.hpp>
+#include <half.hpp>
+#include <constant.hpp>
+
+namespace Dye
+{
+	//////////////////////////////////////////////////////////////////////////
+	// baseline kernels, as wide as the build flags allow
+	//////////////////////////////////////////////////////////////////////////
+	namespace
+	{
+		void transform3(const float *elements, float w, bool renormalize,
+			const char *in, size_t in_stride, char *out, size_t out_stride, size_t n)
+		{
+			float4x4 mat(elements);
+			size_t i = 0;
+
+#if defined(DYE_SIMD_SSE)
+			// 4 elements per iteration: each one is loaded as a full float4,
+			// so the kernel reads and writes back (unchanged) the 4 bytes that
+			// follow it. with a tight float3 stride those belong to the next
+			// element, which must therefore stay inside the range.
+			size_t guard = (in_stride < sizeof(float4) || out_stride < sizeof(float4)) ? 1 : 0;
+
+			__m128 m0 = mat[0].simd();
+			__m128 m1 = mat[1].simd();
+			__m128 m2 = mat[2].simd();
+			__m128 m3 = _mm_mul_ps(mat[3].simd(), _mm_set1_ps(w));
+
+			__m128 m00 = _mm_shuffle_ps(m0, m0, _MM_SHUFFLE(0, 0, 0, 0));
+			__m128 m01 = _mm_shuffle_ps(m0, m0, _MM_SHUFFLE(1, 1, 1, 1));
+			__m128 m02 = _mm_shuffle_ps(m0, m0, _MM_SHUFFLE(2, 2, 2, 2));
+			__m128 m10 = _mm_shuffle_ps(m1, m1, _MM_SHUFFLE(0, 0, 0, 0));
+			__m128 m11 = _mm_shuffle_ps(m1, m1, _MM_SHUFFLE(1, 1, 1, 1));
+			__m128 m12 = _mm_shuffle_ps(m1, m1, _MM_SHUFFLE(2, 2, 2, 2));
+			__m128 m20 = _mm_shuffle_ps(m2, m2, _MM_SHUFFLE(0, 0, 0, 0));
+			__m128 m21 = _mm_shuffle_ps(m2, m2, _MM_SHUFFLE(1, 1, 1, 1));
+			__m128 m22 = _mm_shuffle_ps(m2, m2, _MM_SHUFFLE(2, 2, 2, 2));
+			__m128 m30 = _mm_shuffle_ps(m3, m3, _MM_SHUFFLE(0, 0, 0, 0));
+			__m128 m31 = _mm_shuffle_ps(m3, m3, _MM_SHUFFLE(1, 1, 1, 1));
+			__m128 m32 = _mm_shuffle_ps(m3, m3, _MM_SHUFFLE(2, 2, 2, 2));
+
+			for (; i + 4 + guard <= n; i += 4)
+			{
+				const char *src = in + i * in_stride;
+				__m128 x = _mm_loadu_ps((const float *)(src));
+				__m128 y = _mm_loadu_ps((const float *)(src + in_stride));
+				__m128 z = _mm_loadu_ps((const float *)(src + in_stride * 2));
+				__m128 t = _mm_loadu_ps((const float *)(src + in_stride * 3));
+				_MM_TRANSPOSE4_PS(x, y, z, t);
+
+				__m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m10)), _mm_add_ps(_mm_mul_ps(z, m20), m30));
+				__m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m01), _mm_mul_ps(y, m11)), _mm_add_ps(_mm_mul_ps(z, m21), m31));
+				__m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m02), _mm_mul_ps(y, m12)), _mm_add_ps(_mm_mul_ps(z, m22), m32));
+
+				if (renormalize)
+				{
+					__m128 len_sqr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)), _mm_mul_ps(rz, rz));
+					__m128 len_r = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_max_ps(len_sqr, _mm_set1_ps(c_eps))));
+					rx = _mm_mul_ps(rx, len_r);
+					ry = _mm_mul_ps(ry, len_r);
+					rz = _mm_mul_ps(rz, len_r);
+				}
+
+				// t still holds the trailing 4 bytes of every element
+				_MM_TRANSPOSE4_PS(rx, ry, rz, t);
+				char *dst = out + i * out_stride;
+				_mm_storeu_ps((float *)(dst), rx);
+				_mm_storeu_ps((float *)(dst + out_stride), ry);
+				_mm_storeu_ps((float *)(dst + out_stride * 2), rz);
+				_mm_storeu_ps((float *)(dst + out_stride * 3), t);
+			}
+#endif
+
+			for (; i < n; ++i)
+			{
+				const float3 &src = *(const float3 *)(in + i * in_stride);
+				float3 &dst = *(float3 *)(out + i * out_stride);
+
+				float4 result = mul(float4(src.x, src.y, src.z, w), mat);
+				dst = result.xyz();
+				if (renormalize)
+				{
+					dst /= std::sqrt(std::max(dst.length_sqr(), c_eps));
+				}
+			}
+		}
+
+		void transform4(const float *elements, const float *in, float *out, size_t n)
+		{
+			float4x4 mat(elements);
+			const float4 *src = (const float4 *)in;
+			float4 *dst = (float4 *)out;
+
+			for (size_t i = 0; i != n; ++i)
+			{
+				dst[i] = mul(src[i], mat);
+			}
+		}
+
+		void normalize3(const float *in, float *out, size_t n)
+		{
+			size_t i = 0;
+
+#if defined(DYE_SIMD_SSE)
+			// as in transform3, the 4 bytes after the last element of an
+			// iteration are read and written back, so it is never the last one
+			for (; i + 5 <= n; i += 4)
+			{
+				const float *src = in + i * 3;
+				__m128 x = _mm_loadu_ps(src);
+				__m128 y = _mm_loadu_ps(src + 3);
+				__m128 z = _mm_loadu_ps(src + 6);
+				__m128 t = _mm_loadu_ps(src + 9);
+				_MM_TRANSPOSE4_PS(x, y, z, t);
+
+				__m128 len_sqr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+				__m128 len_r = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_max_ps(len_sqr, _mm_set1_ps(c_eps))));
+				x = _mm_mul_ps(x, len_r);
+				y = _mm_mul_ps(y, len_r);
+				z = _mm_mul_ps(z, len_r);
+
+				_MM_TRANSPOSE4_PS(x, y, z, t);
+				float *dst = out + i * 3;
+				_mm_storeu_ps(dst, x);
+				_mm_storeu_ps(dst + 3, y);
+				_mm_storeu_ps(dst + 6, z);
+				_mm_storeu_ps(dst + 9, t);
+			}
+#endif
+
+			for (; i < n; ++i)
+			{
+				float3 v(in[i * 3], in[i * 3 + 1], in[i * 3 + 2]);
+				v /= std::sqrt(std::max(v.length_sqr(), c_eps));
+				out[i * 3] = v.x;
+				out[i * 3 + 1] = v.y;
+				out[i * 3 + 2] = v.z;
+			}
+		}
+
+		void inverse4x4(const float *in, float *out, size_t n)
+		{
+			const float4x4 *src = (const float4x4 *)in;
+			float4x4 *dst = (float4x4 *)out;
+
+			for (size_t i = 0; i != n; ++i)
+			{
+				dst[i] = inv(src[i]);
+			}
+		}
+
+		void float_to_half(const float *in, unsigned short *out, size_t n)
+		{
+			size_t i = 0;
+
+#if defined(DYE_SIMD_SSE2)
+			for (; i + 8 <= n; i += 8)
+			{
+				__m128i lo = half_from_float(_mm_loadu_ps(in + i));
+				__m128i hi = half_from_float(_mm_loadu_ps(in + i + 4));
+
+				// sign extended, so that the signed saturation keeps the bits
+				lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+				hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packs_epi32(lo, hi));
+			}
+#endif
+
+			for (; i < n; ++i)
+			{
+				out[i] = half_from_float(in[i]);
+			}
+		}
+
+		void half_to_float(const unsigned short *in, float *out, size_t n)
+		{
+			size_t i = 0;
+
+#if defined(DYE_SIMD_SSE2)
+			for (; i + 8 <= n; i += 8)
+			{
+				__m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+				_mm_storeu_ps(out + i, Dye::half_to_float(_mm_unpacklo_epi16(h, _mm_setzero_si128())));
+				_mm_storeu_ps(out + i + 4, Dye::half_to_float(_mm_unpackhi_epi16(h, _mm_setzero_si128())));
+			}
+#endif
+
+			for (; i < n; ++i)
+			{
+				out[i] = Dye::half_to_float(in[i]);
+			}
+		}
+
+		void aos_to_soa(const float *in, float *const *streams, size_t n)
+		{
+			size_t i = 0;
+
+#if defined(DYE_SIMD_SSE)
+			// the two halves of 4 records transposed separately
+			for (; i + 4 <= n; i += 4)
+			{
+				const float *src = in + i * 8;
+				__m128 r[8];
+				for (size_t k = 0; k != 4; ++k)
+				{
+					r[k] = _mm_loadu_ps(src + k * 8);
+					r[k + 4] = _mm_loadu_ps(src + k * 8 + 4);
+				}
+				_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+				_MM_TRANSPOSE4_PS(r[4], r[5], r[6], r[7]);
+				for (size_t k = 0; k != 8; ++k)
+				{
+					_mm_storeu_ps(streams[k] + i, r[k]);
+				}
+			}
+#endif
+
+			for (; i < n; ++i)
+			{
+				for (size_t k = 0; k != 8; ++k)
+				{
+					streams[k][i] = in[i * 8 + k];
+				}
+			}
+		}
+
+		void soa_to_aos(const float *const *streams, float *out, size_t n)
+		{
+			size_t i = 0;
+
+#if defined(DYE_SIMD_SSE)
+			for (; i + 4 <= n; i += 4)
+			{
+				__m128 r[8];
+				for (size_t k = 0; k != 8; ++k)
+				{
+					r[k] = _mm_loadu_ps(streams[k] + i);
+				}
+				_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+				_MM_TRANSPOSE4_PS(r[4], r[5], r[6], r[7]);
+
+				float *dst = out + i * 8;
+				for (size_t k = 0; k != 4; ++k)
+				{
+					_mm_storeu_ps(dst + k * 8, r[k]);
+					_mm_storeu_ps(dst + k * 8 + 4, r[k + 4]);
+				}
+			}
+#endif
+
+			for (; i < n; ++i)
+			{
+				for (size_t k = 0; k != 8; ++k)
+				{
+					out[i * 8 + k] = streams[k][i];
+				}
+			}
+		}
+	}
+
+	const batch_kernels *baseline_kernels()
+	{
+		static const batch_kernels table = { transform3, transform4, normalize3, inverse4x4, float_to_half, half_to_float,
+			aos_to_soa, soa_to_aos };
+		return &table;
+	}
+}
@@ -0,0 +1,544 @@
+#include <cpu_dispatch.hpp>
+#include <constant.hpp>
+
+// built with the avx2 instruction set (/arch:AVX2, -mavx2 -mfma -mf16c),
+// without it the table is simply missing and the dispatch stays on the
+// baseline
+#if defined(__AVX2__) && (defined(__F16C__) || defined(_MSC_VER)) && !defined(DYE_NO_SIMD)
+#	include <immintrin.h>
+#	define DYE_KERNELS_AVX2
+#endif
+
+namespace Dye
+{
+#if defined(DYE_KERNELS_AVX2)
+	//////////////////////////////////////////////////////////////////////////
+	// avx2 + fma kernels, 8 elements per iteration, transposed in registers
+	// and gathered only for the tails. intrinsics only, see batch_kernels.
+	//////////////////////////////////////////////////////////////////////////
+	namespace
+	{
+		inline size_t packet_count(size_t i, size_t n)
+		{
+			return n - i < 8 ? n - i : 8;
+		}
+
+		// lanes below count set
+		inline __m256 lane_mask(size_t count)
+		{
+			__m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+			return _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(count)), lanes));
+		}
+
+		// lane i = i * stride
+		inline __m256i lane_offsets(size_t stride)
+		{
+			__m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+			return _mm256_mullo_epi32(lanes, _mm256_set1_epi32(static_cast<int>(stride)));
+		}
+
+		// byte offsets, scale 1
+		inline __m256 gather(const char *base, __m256i offsets, __m256 mask)
+		{
+			return _mm256_mask_i32gather_ps(_mm256_setzero_ps(), (const float *)base, offsets, mask, 1);
+		}
+
+		inline __m256 normalize_scale(__m256 x, __m256 y, __m256 z)
+		{
+			__m256 len_sqr = _mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_mul_ps(z, z)));
+			return _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(_mm256_max_ps(len_sqr, _mm256_set1_ps(c_eps))));
+		}
+
+		// writes the first count lanes of x, y, z as strided float3
+		inline void scatter(__m256 x, __m256 y, __m256 z, char *out, size_t stride, size_t count)
+		{
+			float fx[8], fy[8], fz[8];
+			_mm256_storeu_ps(fx, x);
+			_mm256_storeu_ps(fy, y);
+			_mm256_storeu_ps(fz, z);
+
+			for (size_t j = 0; j != count; ++j)
+			{
+				float *dst = (float *)(out + j * stride);
+				dst[0] = fx[j];
+				dst[1] = fy[j];
+				dst[2] = fz[j];
+			}
+		}
+
+		// 4 floats of each of 8 strided elements as (x, y, z, t), lane i
+		// holding element i
+		inline void load_transposed(const char *src, size_t stride, __m256 &x, __m256 &y, __m256 &z, __m256 &t)
+		{
+			__m256 a[4];
+			for (size_t k = 0; k != 4; ++k)
+			{
+				__m128 lo = _mm_loadu_ps((const float *)(src + k * stride));
+				__m128 hi = _mm_loadu_ps((const float *)(src + (k + 4) * stride));
+				a[k] = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+			}
+
+			__m256 t0 = _mm256_unpacklo_ps(a[0], a[1]);
+			__m256 t1 = _mm256_unpacklo_ps(a[2], a[3]);
+			__m256 t2 = _mm256_unpackhi_ps(a[0], a[1]);
+			__m256 t3 = _mm256_unpackhi_ps(a[2], a[3]);
+			x = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+			y = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+			z = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+			t = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+		}
+
+		// inverse of load_transposed
+		inline void store_transposed(char *dst, size_t stride, __m256 x, __m256 y, __m256 z, __m256 t)
+		{
+			__m256 t0 = _mm256_unpacklo_ps(x, y);
+			__m256 t1 = _mm256_unpacklo_ps(z, t);
+			__m256 t2 = _mm256_unpackhi_ps(x, y);
+			__m256 t3 = _mm256_unpackhi_ps(z, t);
+
+			__m256 a[4];
+			a[0] = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+			a[1] = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+			a[2] = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+			a[3] = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+			// in order, each store spills onto the next element
+			for (size_t k = 0; k != 4; ++k)
+			{
+				_mm_storeu_ps((float *)(dst + k * stride), _mm256_castps256_ps128(a[k]));
+			}
+			for (size_t k = 0; k != 4; ++k)
+			{
+				_mm_storeu_ps((float *)(dst + (k + 4) * stride), _mm256_extractf128_ps(a[k], 1));
+			}
+		}
+
+		// 8 tightly packed float3, 24 floats, deinterleaved by 128 bit lane
+		inline void load_packed(const float *src, __m256 &x, __m256 &y, __m256 &z)
+		{
+			__m256 m03 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(src)), _mm_loadu_ps(src + 12), 1);
+			__m256 m14 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(src + 4)), _mm_loadu_ps(src + 16), 1);
+			__m256 m25 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(src + 8)), _mm_loadu_ps(src + 20), 1);
+
+			__m256 xy = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+			__m256 yz = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+			x = _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+			y = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+			z = _mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+		}
+
+		// inverse of load_packed
+		inline void store_packed(float *dst, __m256 x, __m256 y, __m256 z)
+		{
+			__m256 xy = _mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));
+			__m256 yz = _mm256_shuffle_ps(y, z, _MM_SHUFFLE(3, 1, 3, 1));
+			__m256 zx = _mm256_shuffle_ps(z, x, _MM_SHUFFLE(3, 1, 2, 0));
+			__m256 m03 = _mm256_shuffle_ps(xy, zx, _MM_SHUFFLE(2, 0, 2, 0));
+			__m256 m14 = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+			__m256 m25 = _mm256_shuffle_ps(zx, yz, _MM_SHUFFLE(3, 1, 3, 1));
+
+			_mm256_storeu_ps(dst, _mm256_permute2f128_ps(m03, m14, 0x20));
+			_mm256_storeu_ps(dst + 8, _mm256_permute2f128_ps(m25, m03, 0x30));
+			_mm256_storeu_ps(dst + 16, _mm256_permute2f128_ps(m14, m25, 0x31));
+		}
+
+		inline bool packed(size_t in_stride, size_t out_stride)
+		{
+			return in_stride == 3 * sizeof(float) && out_stride == 3 * sizeof(float);
+		}
+
+		// elements, from the first, read and written 8 at a time without
+		// gathers: tightly packed float3 in whole packets, otherwise as in the
+		// baseline, where every element is read and written back as a float4.
+		// with a stride below 16 bytes the element after the last one of an
+		// iteration must then still be inside the range.
+		inline size_t head_count(size_t n, size_t in_stride, size_t out_stride)
+		{
+			if (packed(in_stride, out_stride))
+				return n & ~size_t(7);
+
+			size_t guard = (in_stride < 16 || out_stride < 16) ? 1 : 0;
+			return n > guard ? (n - guard) & ~size_t(7) : 0;
+		}
+
+		inline void load_head(bool packed, const char *src, size_t stride, __m256 &x, __m256 &y, __m256 &z, __m256 &t)
+		{
+			if (packed)
+				load_packed((const float *)src, x, y, z);
+			else
+				load_transposed(src, stride, x, y, z, t);
+		}
+
+		// t still holds the trailing 4 bytes of every element
+		inline void store_head(bool packed, char *dst, size_t stride, __m256 x, __m256 y, __m256 z, __m256 t)
+		{
+			if (packed)
+				store_packed((float *)dst, x, y, z);
+			else
+				store_transposed(dst, stride, x, y, z, t);
+		}
+
+		void transform3(const float *mat, float w, bool renormalize,
+			const char *in, size_t in_stride, char *out, size_t out_stride, size_t n)
+		{
+			__m256 m[4][3];
+			for (size_t c = 0; c != 3; ++c)
+			{
+				m[0][c] = _mm256_set1_ps(mat[c]);
+				m[1][c] = _mm256_set1_ps(mat[4 + c]);
+				m[2][c] = _mm256_set1_ps(mat[8 + c]);
+				m[3][c] = _mm256_set1_ps(mat[12 + c] * w);
+			}
+			bool tight = packed(in_stride, out_stride);
+			size_t head = head_count(n, in_stride, out_stride);
+			__m256i offsets = lane_offsets(in_stride);
+
+			for (size_t i = 0; i < n; i += 8)
+			{
+				size_t count = packet_count(i, n);
+				__m256 x, y, z, t = _mm256_setzero_ps();
+				if (i < head)
+				{
+					load_head(tight, in + i * in_stride, in_stride, x, y, z, t);
+				}
+				else
+				{
+					__m256 mask = lane_mask(count);
+					const char *src = in + i * in_stride;
+					x = gather(src, offsets, mask);
+					y = gather(src + 4, offsets, mask);
+					z = gather(src + 8, offsets, mask);
+				}
+
+				__m256 rx = _mm256_fmadd_ps(x, m[0][0], _mm256_fmadd_ps(y, m[1][0], _mm256_fmadd_ps(z, m[2][0], m[3][0])));
+				__m256 ry = _mm256_fmadd_ps(x, m[0][1], _mm256_fmadd_ps(y, m[1][1], _mm256_fmadd_ps(z, m[2][1], m[3][1])));
+				__m256 rz = _mm256_fmadd_ps(x, m[0][2], _mm256_fmadd_ps(y, m[1][2], _mm256_fmadd_ps(z, m[2][2], m[3][2])));
+
+				if (renormalize)
+				{
+					__m256 len_r = normalize_scale(rx, ry, rz);
+					rx = _mm256_mul_ps(rx, len_r);
+					ry = _mm256_mul_ps(ry, len_r);
+					rz = _mm256_mul_ps(rz, len_r);
+				}
+
+				if (i < head)
+				{
+					store_head(tight, out + i * out_stride, out_stride, rx, ry, rz, t);
+				}
+				else
+				{
+					scatter(rx, ry, rz, out + i * out_stride, out_stride, count);
+				}
+			}
+		}
+
+		// two float4 per register, the rows broadcast to both halves
+		void transform4(const float *mat, const float *in, float *out, size_t n)
+		{
+			__m256 r0 = _mm256_broadcast_ps((const __m128 *)(mat));
+			__m256 r1 = _mm256_broadcast_ps((const __m128 *)(mat + 4));
+			__m256 r2 = _mm256_broadcast_ps((const __m128 *)(mat + 8));
+			__m256 r3 = _mm256_broadcast_ps((const __m128 *)(mat + 12));
+
+			size_t i = 0;
+			for (; i + 2 <= n; i += 2)
+			{
+				__m256 v = _mm256_loadu_ps(in + i * 4);
+				__m256 r = _mm256_mul_ps(_mm256_permute_ps(v, 0x00), r0);
+				r = _mm256_fmadd_ps(_mm256_permute_ps(v, 0x55), r1, r);
+				r = _mm256_fmadd_ps(_mm256_permute_ps(v, 0xaa), r2, r);
+				r = _mm256_fmadd_ps(_mm256_permute_ps(v, 0xff), r3, r);
+				_mm256_storeu_ps(out + i * 4, r);
+			}
+
+			if (i < n)
+			{
+				__m128 v = _mm_loadu_ps(in + i * 4);
+				__m128 r = _mm_mul_ps(_mm_permute_ps(v, 0x00), _mm256_castps256_ps128(r0));
+				r = _mm_fmadd_ps(_mm_permute_ps(v, 0x55), _mm256_castps256_ps128(r1), r);
+				r = _mm_fmadd_ps(_mm_permute_ps(v, 0xaa), _mm256_castps256_ps128(r2), r);
+				r = _mm_fmadd_ps(_mm_permute_ps(v, 0xff), _mm256_castps256_ps128(r3), r);
+				_mm_storeu_ps(out + i * 4, r);
+			}
+		}
+
+		void normalize3(const float *in, float *out, size_t n)
+		{
+			const size_t stride = 3 * sizeof(float);
+			size_t head = n & ~size_t(7);
+			__m256i offsets = lane_offsets(stride);
+
+			for (size_t i = 0; i < n; i += 8)
+			{
+				size_t count = packet_count(i, n);
+				const char *src = (const char *)(in + i * 3);
+				char *dst = (char *)(out + i * 3);
+				__m256 x, y, z;
+				if (i < head)
+				{
+					load_packed((const float *)src, x, y, z);
+				}
+				else
+				{
+					__m256 mask = lane_mask(count);
+					x = gather(src, offsets, mask);
+					y = gather(src + 4, offsets, mask);
+					z = gather(src + 8, offsets, mask);
+				}
+
+				__m256 len_r = normalize_scale(x, y, z);
+				x = _mm256_mul_ps(x, len_r);
+				y = _mm256_mul_ps(y, len_r);
+				z = _mm256_mul_ps(z, len_r);
+
+				if (i < head)
+				{
+					store_packed((float *)dst, x, y, z);
+				}
+				else
+				{
+					scatter(x, y, z, dst, stride, count);
+				}
+			}
+		}
+
+		// a * b - c * d
+		inline __m256 det2(__m256 a, __m256 b, __m256 c, __m256 d)
+		{
+			return _mm256_fmsub_ps(a, b, _mm256_mul_ps(c, d));
+		}
+
+		// (a * x - b * y + c * z) * scale
+		inline __m256 cofactor(__m256 a, __m256 x, __m256 b, __m256 y, __m256 c, __m256 z, __m256 scale)
+		{
+			return _mm256_mul_ps(_mm256_fmadd_ps(c, z, det2(a, x, b, y)), scale);
+		}
+
+		// rows of the 8x8 block, in place
+		inline void transpose8(__m256 *r)
+		{
+			__m256 t[8], u[8];
+			for (size_t k = 0; k != 8; k += 2)
+			{
+				t[k] = _mm256_unpacklo_ps(r[k], r[k + 1]);
+				t[k + 1] = _mm256_unpackhi_ps(r[k], r[k + 1]);
+			}
+			for (size_t k = 0; k != 8; k += 4)
+			{
+				u[k] = _mm256_shuffle_ps(t[k], t[k + 2], _MM_SHUFFLE(1, 0, 1, 0));
+				u[k + 1] = _mm256_shuffle_ps(t[k], t[k + 2], _MM_SHUFFLE(3, 2, 3, 2));
+				u[k + 2] = _mm256_shuffle_ps(t[k + 1], t[k + 3], _MM_SHUFFLE(1, 0, 1, 0));
+				u[k + 3] = _mm256_shuffle_ps(t[k + 1], t[k + 3], _MM_SHUFFLE(3, 2, 3, 2));
+			}
+			for (size_t k = 0; k != 4; ++k)
+			{
+				r[k] = _mm256_permute2f128_ps(u[k], u[k + 4], 0x20);
+				r[k + 4] = _mm256_permute2f128_ps(u[k], u[k + 4], 0x31);
+			}
+		}
+
+		// 8 matrices side by side, element by element as the scalar inv of
+		// matrix_aux.cpp
+		void inverse8(const float *in, float *out)
+		{
+			// the first and last 8 elements of each matrix, transposed to one
+			// element of the 8 matrices per register
+			__m256 lo[8], hi[8];
+			for (size_t j = 0; j != 8; ++j)
+			{
+				lo[j] = _mm256_loadu_ps(in + j * 16);
+				hi[j] = _mm256_loadu_ps(in + j * 16 + 8);
+			}
+			transpose8(lo);
+			transpose8(hi);
+
+			__m256 m[4][4];
+			for (size_t k = 0; k != 8; ++k)
+			{
+				m[k / 4][k % 4] = lo[k];
+				m[k / 4 + 2][k % 4] = hi[k];
+			}
+
+			// 2x2 sub-determinants of the upper (s) and lower (c) two rows
+			__m256 s[6], c[6];
+			s[0] = det2(m[0][0], m[1][1], m[1][0], m[0][1]);
+			s[1] = det2(m[0][0], m[1][2], m[1][0], m[0][2]);
+			s[2] = det2(m[0][0], m[1][3], m[1][0], m[0][3]);
+			s[3] = det2(m[0][1], m[1][2], m[1][1], m[0][2]);
+			s[4] = det2(m[0][1], m[1][3], m[1][1], m[0][3]);
+			s[5] = det2(m[0][2], m[1][3], m[1][2], m[0][3]);
+
+			c[0] = det2(m[2][0], m[3][1], m[3][0], m[2][1]);
+			c[1] = det2(m[2][0], m[3][2], m[3][0], m[2][2]);
+			c[2] = det2(m[2][0], m[3][3], m[3][0], m[2][3]);
+			c[3] = det2(m[2][1], m[3][2], m[3][1], m[2][2]);
+			c[4] = det2(m[2][1], m[3][3], m[3][1], m[2][3]);
+			c[5] = det2(m[2][2], m[3][3], m[3][2], m[2][3]);
+
+			__m256 det = _mm256_add_ps(
+				_mm256_add_ps(det2(s[0], c[5], s[1], c[4]), det2(s[2], c[3], s[4], c[1])),
+				_mm256_fmadd_ps(s[3], c[2], _mm256_mul_ps(s[5], c[0])));
+			__m256 p = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+			__m256 q = _mm256_sub_ps(_mm256_setzero_ps(), p);
+
+			__m256 r[16];
+			r[ 0] = cofactor(m[1][1], c[5], m[1][2], c[4], m[1][3], c[3], p);
+			r[ 1] = cofactor(m[0][1], c[5], m[0][2], c[4], m[0][3], c[3], q);
+			r[ 2] = cofactor(m[3][1], s[5], m[3][2], s[4], m[3][3], s[3], p);
+			r[ 3] = cofactor(m[2][1], s[5], m[2][2], s[4], m[2][3], s[3], q);
+
+			r[ 4] = cofactor(m[1][0], c[5], m[1][2], c[2], m[1][3], c[1], q);
+			r[ 5] = cofactor(m[0][0], c[5], m[0][2], c[2], m[0][3], c[1], p);
+			r[ 6] = cofactor(m[3][0], s[5], m[3][2], s[2], m[3][3], s[1], q);
+			r[ 7] = cofactor(m[2][0], s[5], m[2][2], s[2], m[2][3], s[1], p);
+
+			r[ 8] = cofactor(m[1][0], c[4], m[1][1], c[2], m[1][3], c[0], p);
+			r[ 9] = cofactor(m[0][0], c[4], m[0][1], c[2], m[0][3], c[0], q);
+			r[10] = cofactor(m[3][0], s[4], m[3][1], s[2], m[3][3], s[0], p);
+			r[11] = cofactor(m[2][0], s[4], m[2][1], s[2], m[2][3], s[0], q);
+
+			r[12] = cofactor(m[1][0], c[3], m[1][1], c[1], m[1][2], c[0], q);
+			r[13] = cofactor(m[0][0], c[3], m[0][1], c[1], m[0][2], c[0], p);
+			r[14] = cofactor(m[3][0], s[3], m[3][1], s[1], m[3][2], s[0], q);
+			r[15] = cofactor(m[2][0], s[3], m[2][1], s[1], m[2][2], s[0], p);
+
+			transpose8(r);
+			transpose8(r + 8);
+			for (size_t j = 0; j != 8; ++j)
+			{
+				_mm256_storeu_ps(out + j * 16, r[j]);
+				_mm256_storeu_ps(out + j * 16 + 8, r[j + 8]);
+			}
+		}
+
+		void inverse4x4(const float *in, float *out, size_t n)
+		{
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8)
+			{
+				inverse8(in + i * 16, out + i * 16);
+			}
+
+			if (i < n)
+			{
+				// the tail through a buffer padded with identities
+				float buffer[8 * 16] = { 0 };
+				for (size_t j = 0; j != 8; ++j)
+				{
+					for (size_t k = 0; k != 16; ++k)
+					{
+						buffer[j * 16 + k] = (i + j < n) ? in[(i + j) * 16 + k] : (k % 5 == 0 ? 1.0f : 0.0f);
+					}
+				}
+				inverse8(buffer, buffer);
+				for (size_t k = 0; k != (n - i) * 16; ++k)
+				{
+					out[i * 16 + k] = buffer[k];
+				}
+			}
+		}
+
+		void float_to_half(const float *in, unsigned short *out, size_t n)
+		{
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8)
+			{
+				__m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), h);
+			}
+
+			if (i < n)
+			{
+				float buffer[8] = { 0 };
+				unsigned short result[8];
+				for (size_t j = 0; j != n - i; ++j) buffer[j] = in[i + j];
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(result), _mm256_cvtps_ph(_mm256_loadu_ps(buffer), _MM_FROUND_TO_NEAREST_INT));
+				for (size_t j = 0; j != n - i; ++j) out[i + j] = result[j];
+			}
+		}
+
+		void half_to_float(const unsigned short *in, float *out, size_t n)
+		{
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8)
+			{
+				__m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+				_mm256_storeu_ps(out + i, _mm256_cvtph_ps(h));
+			}
+
+			if (i < n)
+			{
+				unsigned short buffer[8] = { 0 };
+				float result[8];
+				for (size_t j = 0; j != n - i; ++j) buffer[j] = in[i + j];
+				_mm256_storeu_ps(result, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(buffer))));
+				for (size_t j = 0; j != n - i; ++j) out[i + j] = result[j];
+			}
+		}
+
+		void aos_to_soa(const float *in, float *const *streams, size_t n)
+		{
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8)
+			{
+				__m256 r[8];
+				for (size_t k = 0; k != 8; ++k)
+				{
+					r[k] = _mm256_loadu_ps(in + (i + k) * 8);
+				}
+				transpose8(r);
+				for (size_t k = 0; k != 8; ++k)
+				{
+					_mm256_storeu_ps(streams[k] + i, r[k]);
+				}
+			}
+
+			for (; i < n; ++i)
+			{
+				for (size_t k = 0; k != 8; ++k)
+				{
+					streams[k][i] = in[i * 8 + k];
+				}
+			}
+		}
+
+		void soa_to_aos(const float *const *streams, float *out, size_t n)
+		{
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8)
+			{
+				__m256 r[8];
+				for (size_t k = 0; k != 8; ++k)
+				{
+					r[k] = _mm256_loadu_ps(streams[k] + i);
+				}
+				transpose8(r);
+				for (size_t k = 0; k != 8; ++k)
+				{
+					_mm256_storeu_ps(out + (i + k) * 8, r[k]);
+				}
+			}
+
+			for (; i < n; ++i)
+			{
+				for (size_t k = 0; k != 8; ++k)
+				{
+					out[i * 8 + k] = streams[k][i];
+				}
+			}
+		}
+	}
+#endif
+
+	const batch_kernels *avx2_kernels()
+	{
+#if defined(DYE_KERNELS_AVX2)
+		static const batch_kernels table = { transform3, transform4, normalize3, inverse4x4, float_to_half, half_to_float,
+			aos_to_soa, soa_to_aos };
+		return &table;
+#else
+		return 0;
+#endif
+	}
+}
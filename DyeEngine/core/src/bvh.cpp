@@ -0,0 +1,1712 @@
+#include <float.h>
+#include <algorithm>
+#include <omp.h>
+#include <bvh.hpp>
+#include <intersect.hpp>
+#include <matrix_aux.hpp>
+#include <morton.hpp>
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		namespace
+		{
+			const int c_bins = 16;
+
+			// a leaf holds at most that many triangles
+			const size_t c_max_leaf_size = 8;
+
+			// a leaf of the linear build holds at most that many
+			const size_t c_linear_leaf_size = 4;
+
+			// up to that many centroids take 30 bit morton codes, more take
+			// 63 bits so that they rarely share a cell
+			const size_t c_morton_30_limit = 1 << 16;
+
+			// fewer keys sort on one thread
+			const size_t c_parallel_sort = 1 << 16;
+
+			// a node visit against a triangle intersection
+			const float c_traversal_cost = 1.0f;
+
+			// below that depth the sah may split off single triangles, past
+			// it nodes are halved, so that a traversal stack of c_stack_size
+			// always suffices
+			const int c_max_sah_depth = 64;
+			const int c_stack_size = 128;
+
+			// nodes with fewer triangles fill their bins on one thread
+			const size_t c_parallel_binning = 1 << 16;
+
+			// the smallest subtree that gets a thread of its own
+			const size_t c_min_subtree = 1 << 12;
+
+			// a node at the top of the tree that stands for a subtree
+			const unsigned short c_subtree = 0xffff;
+
+			//////////////////////////////////////////////////////////////////////////
+			// boxes
+			//////////////////////////////////////////////////////////////////////////
+			// a box as the build keeps it, the corners padded to four floats
+			// for min and max in one instruction each
+			struct box4
+			{
+				float lower[4];
+				float upper[4];
+			};
+
+			struct point4
+			{
+				float v[4];
+			};
+
+			void reset(box4 &box)
+			{
+				for (int k = 0; k != 4; ++k)
+				{
+					box.lower[k] = FLT_MAX;
+					box.upper[k] = -FLT_MAX;
+				}
+			}
+
+			inline void grow(box4 &box, const float *lower, const float *upper)
+			{
+#if defined(DYE_SIMD_SSE)
+				_mm_storeu_ps(box.lower, _mm_min_ps(_mm_loadu_ps(box.lower), _mm_loadu_ps(lower)));
+				_mm_storeu_ps(box.upper, _mm_max_ps(_mm_loadu_ps(box.upper), _mm_loadu_ps(upper)));
+#else
+				for (int k = 0; k != 3; ++k)
+				{
+					box.lower[k] = std::min(box.lower[k], lower[k]);
+					box.upper[k] = std::max(box.upper[k], upper[k]);
+				}
+#endif
+			}
+
+			inline void grow(box4 &box, const box4 &other)
+			{
+				grow(box, other.lower, other.upper);
+			}
+
+			inline void grow(box4 &box, const float *p)
+			{
+				grow(box, p, p);
+			}
+
+			// half the surface, 0 for an empty box
+			float half_area(const float *lower, const float *upper)
+			{
+				float dx = upper[0] - lower[0];
+				float dy = upper[1] - lower[1];
+				float dz = upper[2] - lower[2];
+				return dx < 0 ? 0 : dx * dy + dy * dz + dz * dx;
+			}
+
+			float half_area(const box4 &box)
+			{
+				return half_area(box.lower, box.upper);
+			}
+
+			float half_area(const float3 &lower, const float3 &upper)
+			{
+				const float l[3] = { lower.x, lower.y, lower.z };
+				const float u[3] = { upper.x, upper.y, upper.z };
+				return half_area(l, u);
+			}
+
+			box4 node_box(const bvh_node &node)
+			{
+				box4 box = { { node.lower.x, node.lower.y, node.lower.z, 0 }, { node.upper.x, node.upper.y, node.upper.z, 0 } };
+				return box;
+			}
+
+			void set_box(bvh_node &node, const box4 &box)
+			{
+				node.lower = float3(box.lower[0], box.lower[1], box.lower[2]);
+				node.upper = float3(box.upper[0], box.upper[1], box.upper[2]);
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			// binned sah build
+			//////////////////////////////////////////////////////////////////////////
+			struct bin
+			{
+				box4 bounds;
+				unsigned int count;
+			};
+
+			// where the centroids of a node fall into bins
+			struct binning
+			{
+				float lower[3];
+				float scale[3];
+
+				explicit binning(const box4 &centroids)
+				{
+					for (int axis = 0; axis != 3; ++axis)
+					{
+						float extent = centroids.upper[axis] - centroids.lower[axis];
+						lower[axis] = centroids.lower[axis];
+						scale[axis] = extent > 0 ? c_bins * (1 - 1e-5f) / extent : 0;
+					}
+				}
+
+				int operator () (const point4 &center, int axis) const
+				{
+					int b = static_cast<int>((center.v[axis] - lower[axis]) * scale[axis]);
+					return std::min(std::max(b, 0), c_bins - 1);
+				}
+			};
+
+			struct split_below
+			{
+				split_below(const std::vector<point4> &centers, const binning &bins, int axis, int split)
+					: centers(centers), bins(bins), axis(axis), split(split)
+				{
+				}
+
+				bool operator () (unsigned int t) const
+				{
+					return bins(centers[t], axis) < split;
+				}
+
+				const std::vector<point4> &centers;
+				const binning &bins;
+				int axis;
+				int split;
+			};
+
+			struct center_less
+			{
+				center_less(const std::vector<point4> &centers, int axis)
+					: centers(centers), axis(axis)
+				{
+				}
+
+				bool operator () (unsigned int a, unsigned int b) const
+				{
+					return centers[a].v[axis] < centers[b].v[axis];
+				}
+
+				const std::vector<point4> &centers;
+				int axis;
+			};
+
+			// a subtree to build on a thread of its own
+			struct subtree
+			{
+				unsigned int begin;
+				unsigned int end;
+				box4 bounds;
+				box4 centroids;
+				std::vector<bvh_node> nodes;
+			};
+
+			class builder
+			{
+			public:
+				builder(const std::vector<box4> &boxes, const std::vector<point4> &centers, std::vector<unsigned int> &order,
+					const box4 &bounds, const box4 &centroids)
+					: m_boxes(boxes)
+					, m_centers(centers)
+					, m_order(order)
+					, m_bounds(bounds)
+					, m_centroids(centroids)
+				{
+				}
+
+				void build_root(std::vector<bvh_node> &nodes, std::vector<subtree> *subtrees, size_t subtree_size)
+				{
+					build(0, static_cast<unsigned int>(m_order.size()), m_bounds, m_centroids, 0, nodes, subtrees, subtree_size);
+				}
+
+				// the triangles order[begin, end) into nodes, depth first.
+				// with subtrees, the nodes of at most subtree_size triangles
+				// are left to build_subtree() in their place.
+				void build(unsigned int begin, unsigned int end, const box4 &bounds, const box4 &centroids, int depth,
+					std::vector<bvh_node> &nodes, std::vector<subtree> *subtrees, size_t subtree_size);
+
+				void build_subtree(subtree &s)
+				{
+					build(s.begin, s.end, s.bounds, s.centroids, 0, s.nodes, 0, 0);
+				}
+
+			private:
+				// the cheapest split by sah, in triangle intersections, or
+				// false if the centroids are all the same
+				bool find_split(unsigned int begin, unsigned int end, const box4 &bounds, const binning &bins,
+					int &axis, int &split, float &cost) const;
+
+				const std::vector<box4> &m_boxes;
+				const std::vector<point4> &m_centers;
+				std::vector<unsigned int> &m_order;
+				box4 m_bounds;
+				box4 m_centroids;
+			};
+
+			bool builder::find_split(unsigned int begin, unsigned int end, const box4 &bounds, const binning &bins,
+				int &axis, int &split, float &cost) const
+			{
+				bin b[3][c_bins];
+				for (int a = 0; a != 3; ++a)
+				{
+					for (int i = 0; i != c_bins; ++i)
+					{
+						reset(b[a][i].bounds);
+						b[a][i].count = 0;
+					}
+				}
+
+				const int n = static_cast<int>(end - begin);
+				if (static_cast<size_t>(n) < c_parallel_binning)
+				{
+					for (unsigned int i = begin; i != end; ++i)
+					{
+						unsigned int t = m_order[i];
+						for (int a = 0; a != 3; ++a)
+						{
+							bin &target = b[a][bins(m_centers[t], a)];
+							grow(target.bounds, m_boxes[t]);
+							++target.count;
+						}
+					}
+				}
+				else
+				{
+					// a set of bins per thread, merged after
+					std::vector<bin> local(omp_get_max_threads() * 3 * c_bins);
+					for (size_t i = 0; i != local.size(); ++i)
+					{
+						reset(local[i].bounds);
+						local[i].count = 0;
+					}
+					#pragma omp parallel for
+					for (int i = 0; i < n; ++i)
+					{
+						bin *own = &local[omp_get_thread_num() * 3 * c_bins];
+						unsigned int t = m_order[begin + i];
+						for (int a = 0; a != 3; ++a)
+						{
+							bin &target = own[a * c_bins + bins(m_centers[t], a)];
+							grow(target.bounds, m_boxes[t]);
+							++target.count;
+						}
+					}
+					for (size_t i = 0; i != local.size(); ++i)
+					{
+						bin &target = b[(i / c_bins) % 3][i % c_bins];
+						grow(target.bounds, local[i].bounds);
+						target.count += local[i].count;
+					}
+				}
+
+				// the bins left of each split swept one way, the right ones
+				// the other
+				float best = FLT_MAX;
+				for (int a = 0; a != 3; ++a)
+				{
+					if (bins.scale[a] == 0)
+					{
+						continue;
+					}
+
+					float right_area[c_bins];
+					unsigned int right_count[c_bins];
+					box4 right;
+					reset(right);
+					unsigned int count = 0;
+					for (int i = c_bins - 1; i > 0; --i)
+					{
+						grow(right, b[a][i].bounds);
+						count += b[a][i].count;
+						right_area[i] = half_area(right);
+						right_count[i] = count;
+					}
+
+					box4 left;
+					reset(left);
+					count = 0;
+					for (int i = 1; i != c_bins; ++i)
+					{
+						grow(left, b[a][i - 1].bounds);
+						count += b[a][i - 1].count;
+						if (count == 0 || right_count[i] == 0)
+						{
+							continue;
+						}
+						float c = half_area(left) * count + right_area[i] * right_count[i];
+						if (c < best)
+						{
+							best = c;
+							axis = a;
+							split = i;
+						}
+					}
+				}
+
+				float area = half_area(bounds);
+				cost = c_traversal_cost + (area > 0 ? best / area : static_cast<float>(end - begin));
+				return best != FLT_MAX;
+			}
+
+			void builder::build(unsigned int begin, unsigned int end, const box4 &bounds, const box4 &centroids, int depth,
+				std::vector<bvh_node> &nodes, std::vector<subtree> *subtrees, size_t subtree_size)
+			{
+				const unsigned int index = static_cast<unsigned int>(nodes.size());
+				const size_t n = end - begin;
+				bvh_node node;
+				set_box(node, bounds);
+				node.offset = begin;
+				node.count = 0;
+				node.axis = 0;
+
+				if (subtrees && n <= subtree_size)
+				{
+					node.offset = static_cast<unsigned int>(subtrees->size());
+					node.axis = c_subtree;
+					nodes.push_back(node);
+
+					subtree s;
+					s.begin = begin;
+					s.end = end;
+					s.bounds = bounds;
+					s.centroids = centroids;
+					subtrees->push_back(s);
+					return;
+				}
+
+				binning bins(centroids);
+				int axis = 0;
+				int split = 0;
+				float cost = 0;
+				bool found = n > 1 && find_split(begin, end, bounds, bins, axis, split, cost);
+				if (n <= c_max_leaf_size && (!found || cost >= n))
+				{
+					node.count = static_cast<unsigned short>(n);
+					nodes.push_back(node);
+					return;
+				}
+
+				unsigned int middle = begin + static_cast<unsigned int>(n / 2);
+				if (found && depth < c_max_sah_depth)
+				{
+					middle = static_cast<unsigned int>(std::partition(m_order.begin() + begin, m_order.begin() + end,
+						split_below(m_centers, bins, axis, split)) - m_order.begin());
+				}
+				else
+				{
+					// halved along the longest side of the centroids
+					float extent[3];
+					for (int k = 0; k != 3; ++k)
+					{
+						extent[k] = centroids.upper[k] - centroids.lower[k];
+					}
+					axis = extent[0] >= extent[1] && extent[0] >= extent[2] ? 0 : extent[1] >= extent[2] ? 1 : 2;
+					std::nth_element(m_order.begin() + begin, m_order.begin() + middle, m_order.begin() + end,
+						center_less(m_centers, axis));
+				}
+				node.axis = static_cast<unsigned short>(axis);
+				nodes.push_back(node);
+
+				box4 child_bounds[2];
+				box4 child_centroids[2];
+				for (int c = 0; c != 2; ++c)
+				{
+					reset(child_bounds[c]);
+					reset(child_centroids[c]);
+					for (unsigned int i = c == 0 ? begin : middle; i != (c == 0 ? middle : end); ++i)
+					{
+						grow(child_bounds[c], m_boxes[m_order[i]]);
+						grow(child_centroids[c], m_centers[m_order[i]].v);
+					}
+				}
+
+				build(begin, middle, child_bounds[0], child_centroids[0], depth + 1, nodes, subtrees, subtree_size);
+				nodes[index].offset = static_cast<unsigned int>(nodes.size());
+				build(middle, end, child_bounds[1], child_centroids[1], depth + 1, nodes, subtrees, subtree_size);
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			// linear build
+			//////////////////////////////////////////////////////////////////////////
+			int highest_bit(unsigned long long v)
+			{
+				int bit = 0;
+				for (int step = 32; step != 0; step /= 2)
+				{
+					if (v >> step)
+					{
+						v >>= step;
+						bit += step;
+					}
+				}
+				return bit;
+			}
+
+			// the keys sorted on their low bits, the values moved along. a
+			// pass per byte, where each thread counts and then scatters a
+			// slice of its own; passes whose byte is the same in all keys
+			// are skipped.
+			void radix_sort(std::vector<unsigned long long> &keys, std::vector<unsigned int> &values, int bits)
+			{
+				const size_t n = keys.size();
+				const int threads = n < c_parallel_sort ? 1 : omp_get_max_threads();
+				std::vector<unsigned long long> key_buffer(n);
+				std::vector<unsigned int> value_buffer(n);
+				std::vector<size_t> counts(threads * 256);
+
+				for (int shift = 0; shift < bits; shift += 8)
+				{
+					const unsigned long long *from_keys = &keys[0];
+					const unsigned int *from_values = &values[0];
+					unsigned long long *to_keys = &key_buffer[0];
+					unsigned int *to_values = &value_buffer[0];
+					bool skip = false;
+
+					#pragma omp parallel num_threads(threads)
+					{
+						const int team = omp_get_num_threads();
+						const int thread = omp_get_thread_num();
+						const size_t first = n * thread / team;
+						const size_t last = n * (thread + 1) / team;
+						size_t *count = &counts[thread * 256];
+						std::fill(count, count + 256, static_cast<size_t>(0));
+						for (size_t i = first; i != last; ++i)
+						{
+							++count[(from_keys[i] >> shift) & 255];
+						}
+
+						#pragma omp barrier
+						#pragma omp single
+						{
+							// where each thread starts writing a digit: all
+							// the smaller digits, then the earlier threads
+							size_t sum = 0;
+							for (int digit = 0; digit != 256; ++digit)
+							{
+								size_t start = sum;
+								for (int t = 0; t != team; ++t)
+								{
+									size_t c = counts[t * 256 + digit];
+									counts[t * 256 + digit] = sum;
+									sum += c;
+								}
+								skip = skip || sum - start == n;
+							}
+						}
+
+						if (!skip)
+						{
+							for (size_t i = first; i != last; ++i)
+							{
+								size_t at = count[(from_keys[i] >> shift) & 255]++;
+								to_keys[at] = from_keys[i];
+								to_values[at] = from_values[i];
+							}
+						}
+					}
+
+					if (!skip)
+					{
+						keys.swap(key_buffer);
+						values.swap(value_buffer);
+					}
+				}
+			}
+
+			// nodes split where the highest differing bit of the sorted
+			// morton codes changes, without boxes yet
+			class linear_builder
+			{
+			public:
+				explicit linear_builder(const std::vector<unsigned long long> &codes)
+					: m_codes(codes)
+				{
+				}
+
+				void build_root(std::vector<bvh_node> &nodes, std::vector<subtree> *subtrees, size_t subtree_size)
+				{
+					build(0, static_cast<unsigned int>(m_codes.size()), nodes, subtrees, subtree_size);
+				}
+
+				void build_subtree(subtree &s)
+				{
+					build(s.begin, s.end, s.nodes, 0, 0);
+				}
+
+			private:
+				void build(unsigned int begin, unsigned int end, std::vector<bvh_node> &nodes,
+					std::vector<subtree> *subtrees, size_t subtree_size);
+
+				const std::vector<unsigned long long> &m_codes;
+			};
+
+			void linear_builder::build(unsigned int begin, unsigned int end, std::vector<bvh_node> &nodes,
+				std::vector<subtree> *subtrees, size_t subtree_size)
+			{
+				const unsigned int index = static_cast<unsigned int>(nodes.size());
+				const size_t n = end - begin;
+				bvh_node node;
+				node.lower = node.upper = float3(0, 0, 0);
+				node.offset = begin;
+				node.count = 0;
+				node.axis = 0;
+
+				if (subtrees && n <= subtree_size)
+				{
+					node.offset = static_cast<unsigned int>(subtrees->size());
+					node.axis = c_subtree;
+					nodes.push_back(node);
+
+					// the boxes come after, from the leaves
+					subtree s;
+					s.begin = begin;
+					s.end = end;
+					reset(s.bounds);
+					reset(s.centroids);
+					subtrees->push_back(s);
+					return;
+				}
+
+				if (n <= c_linear_leaf_size)
+				{
+					node.count = static_cast<unsigned short>(n);
+					nodes.push_back(node);
+					return;
+				}
+
+				// the codes share the bits above the highest differing one,
+				// so those with it set follow the others; equal codes are
+				// halved
+				unsigned long long first = m_codes[begin];
+				unsigned long long last = m_codes[end - 1];
+				unsigned int middle = begin + static_cast<unsigned int>(n / 2);
+				if (first != last)
+				{
+					int bit = highest_bit(first ^ last);
+					unsigned long long below = first | ((1ull << bit) - 1);
+					middle = static_cast<unsigned int>(std::upper_bound(m_codes.begin() + begin, m_codes.begin() + end, below)
+						- m_codes.begin());
+					node.axis = static_cast<unsigned short>(morton_axis(bit));
+				}
+				nodes.push_back(node);
+
+				build(begin, middle, nodes, subtrees, subtree_size);
+				nodes[index].offset = static_cast<unsigned int>(nodes.size());
+				build(middle, end, nodes, subtrees, subtree_size);
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			// threads
+			//////////////////////////////////////////////////////////////////////////
+			// the top of the tree with the subtrees put in place of their
+			// nodes, depth first
+			void flatten(const std::vector<bvh_node> &top, unsigned int index, const std::vector<subtree> &subtrees,
+				std::vector<bvh_node> &out)
+			{
+				const bvh_node &node = top[index];
+				if (node.axis == c_subtree)
+				{
+					const std::vector<bvh_node> &nodes = subtrees[node.offset].nodes;
+					unsigned int base = static_cast<unsigned int>(out.size());
+					for (size_t i = 0; i != nodes.size(); ++i)
+					{
+						out.push_back(nodes[i]);
+						if (nodes[i].count == 0)
+						{
+							out.back().offset += base;
+						}
+					}
+					return;
+				}
+
+				size_t at = out.size();
+				out.push_back(node);
+				if (node.count == 0)
+				{
+					flatten(top, index + 1, subtrees, out);
+					out[at].offset = static_cast<unsigned int>(out.size());
+					flatten(top, node.offset, subtrees, out);
+				}
+			}
+
+			// the tree by a builder, on one thread, or with the top of the
+			// tree shared and a thread per subtree below
+			template<typename Builder>
+			void build_nodes(Builder &b, size_t n, std::vector<bvh_node> &nodes)
+			{
+				const size_t threads = omp_get_max_threads();
+				if (threads == 1)
+				{
+					b.build_root(nodes, 0, 0);
+					return;
+				}
+
+				std::vector<bvh_node> top;
+				std::vector<subtree> subtrees;
+				size_t subtree_size = std::max(c_min_subtree, n / (threads * 16));
+				b.build_root(top, &subtrees, subtree_size);
+
+				const int count = static_cast<int>(subtrees.size());
+				#pragma omp parallel for schedule(dynamic)
+				for (int i = 0; i < count; ++i)
+				{
+					b.build_subtree(subtrees[i]);
+				}
+
+				size_t total = top.size();
+				for (int i = 0; i != count; ++i)
+				{
+					total += subtrees[i].nodes.size();
+				}
+				nodes.reserve(total);
+				flatten(top, 0, subtrees, nodes);
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			// refit
+			//////////////////////////////////////////////////////////////////////////
+
+			// the boxes of the nodes from those of their leaves. the
+			// subtrees a few levels down, several to a thread, are fitted in
+			// parallel and the nodes above them after.
+			template<typename LeafBounds>
+			class refitter
+			{
+			public:
+				refitter(std::vector<bvh_node> &nodes, const LeafBounds &leaf_bounds)
+					: m_nodes(nodes)
+					, m_leaf_bounds(leaf_bounds)
+				{
+				}
+
+				void run()
+				{
+					if (m_nodes.empty())
+					{
+						return;
+					}
+
+					int cut = 0;
+					const int threads = omp_get_max_threads();
+					while (threads > 1 && (1 << cut) < threads * 8)
+					{
+						++cut;
+					}
+					std::vector<unsigned int> roots;
+					collect(0, 0, cut, roots);
+
+					const int count = static_cast<int>(roots.size());
+					#pragma omp parallel for schedule(dynamic) if (count > 1)
+					for (int i = 0; i < count; ++i)
+					{
+						fit(roots[i]);
+					}
+					fit_above(0, 0, cut);
+				}
+
+			private:
+				box4 fit(unsigned int index)
+				{
+					bvh_node &node = m_nodes[index];
+					box4 box;
+					if (node.count != 0)
+					{
+						box = m_leaf_bounds(node.offset, node.count);
+					}
+					else
+					{
+						box = fit(index + 1);
+						grow(box, fit(node.offset));
+					}
+					set_box(node, box);
+					return box;
+				}
+
+				void collect(unsigned int index, int depth, int cut, std::vector<unsigned int> &roots) const
+				{
+					const bvh_node &node = m_nodes[index];
+					if (depth == cut || node.count != 0)
+					{
+						roots.push_back(index);
+						return;
+					}
+					collect(index + 1, depth + 1, cut, roots);
+					collect(node.offset, depth + 1, cut, roots);
+				}
+
+				box4 fit_above(unsigned int index, int depth, int cut)
+				{
+					bvh_node &node = m_nodes[index];
+					if (depth == cut || node.count != 0)
+					{
+						return node_box(node);
+					}
+					box4 box = fit_above(index + 1, depth + 1, cut);
+					grow(box, fit_above(node.offset, depth + 1, cut));
+					set_box(node, box);
+					return box;
+				}
+
+				std::vector<bvh_node> &m_nodes;
+				const LeafBounds &m_leaf_bounds;
+			};
+
+			// the leaves of items in leaf order
+			struct order_bounds
+			{
+				order_bounds(const std::vector<box4> &boxes, const std::vector<unsigned int> &order)
+					: boxes(boxes), order(order)
+				{
+				}
+
+				box4 operator () (unsigned int first, unsigned int count) const
+				{
+					box4 box = boxes[order[first]];
+					for (unsigned int i = first + 1; i != first + count; ++i)
+					{
+						grow(box, boxes[order[i]]);
+					}
+					return box;
+				}
+
+				const std::vector<box4> &boxes;
+				const std::vector<unsigned int> &order;
+			};
+
+			struct triangle_bounds
+			{
+				explicit triangle_bounds(const bvh_triangle *triangles)
+					: triangles(triangles)
+				{
+				}
+
+				box4 operator () (unsigned int first, unsigned int count) const
+				{
+					box4 box;
+					reset(box);
+					for (unsigned int i = first; i != first + count; ++i)
+					{
+						const bvh_triangle &tri = triangles[i];
+						const float3 v1 = tri.v0 + tri.e1;
+						const float3 v2 = tri.v0 + tri.e2;
+						const float p[3][4] = { { tri.v0.x, tri.v0.y, tri.v0.z, 0 }, { v1.x, v1.y, v1.z, 0 }, { v2.x, v2.y, v2.z, 0 } };
+						for (int k = 0; k != 3; ++k)
+						{
+							grow(box, p[k]);
+						}
+					}
+					return box;
+				}
+
+				const bvh_triangle *triangles;
+			};
+
+			//////////////////////////////////////////////////////////////////////////
+			// either build
+			//////////////////////////////////////////////////////////////////////////
+
+			// the nodes over boxes with the given centers, order receiving
+			// the boxes in leaf order
+			void build_tree(const std::vector<box4> &boxes, const std::vector<point4> &centers, bvh_build method,
+				std::vector<unsigned int> &order, std::vector<bvh_node> &nodes)
+			{
+				const int n = static_cast<int>(boxes.size());
+				order.resize(n);
+				nodes.clear();
+				if (n == 0)
+				{
+					return;
+				}
+
+				box4 bounds;
+				box4 centroids;
+				reset(bounds);
+				reset(centroids);
+				for (int i = 0; i != n; ++i)
+				{
+					grow(bounds, boxes[i]);
+					grow(centroids, centers[i].v);
+				}
+
+				if (method == bvh_build_sah)
+				{
+					for (int i = 0; i != n; ++i)
+					{
+						order[i] = static_cast<unsigned int>(i);
+					}
+					builder b(boxes, centers, order, bounds, centroids);
+					build_nodes(b, n, nodes);
+					return;
+				}
+
+				// the centroids on a grid of 2^10 or 2^21 cells a side
+				const bool wide = static_cast<size_t>(n) > c_morton_30_limit;
+				const float cells = wide ? 2097152.0f : 1024.0f;
+				float scale[3];
+				for (int k = 0; k != 3; ++k)
+				{
+					float extent = centroids.upper[k] - centroids.lower[k];
+					scale[k] = extent > 0 ? cells * (1 - 1e-6f) / extent : 0;
+				}
+
+				std::vector<unsigned long long> codes(n);
+				#pragma omp parallel for if (n > 1 << 12)
+				for (int i = 0; i < n; ++i)
+				{
+					unsigned int cell[3];
+					for (int k = 0; k != 3; ++k)
+					{
+						float c = (centers[i].v[k] - centroids.lower[k]) * scale[k];
+						cell[k] = std::min(static_cast<unsigned int>(std::max(c, 0.0f)), static_cast<unsigned int>(cells) - 1);
+					}
+					codes[i] = wide ? morton_code63(cell[0], cell[1], cell[2]) : morton_code30(cell[0], cell[1], cell[2]);
+					order[i] = static_cast<unsigned int>(i);
+				}
+				radix_sort(codes, order, wide ? 63 : 30);
+
+				linear_builder b(codes);
+				build_nodes(b, n, nodes);
+
+				order_bounds leaf_bounds(boxes, order);
+				refitter<order_bounds>(nodes, leaf_bounds).run();
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			// intersection
+			//
+			// the kernels of intersect.hpp on the nodes and triangles as laid
+			// out here; the triangles keep moller and trumbore, which the
+			// stored edges make the cheaper
+			//////////////////////////////////////////////////////////////////////////
+			inline bool hit_box(const bvh_node &node, const float3 &origin, const float3 &inv,
+				float tmin, float tmax, float &entry)
+			{
+				return intersect_box(node.lower, node.upper, origin, inv, tmin, tmax, entry);
+			}
+
+			inline bool hit_triangle(const bvh_triangle &tri, const float3 &origin, const float3 &direction,
+				float tmin, float tmax, float &t, float &u, float &v)
+			{
+				return intersect_triangle_edges(tri.v0, tri.e1, tri.e2, origin, direction, tmin, tmax, t, u, v);
+			}
+
+			// the same for the lanes of a packet, the mask of those hit
+			inline float8 hit_box(const bvh_node &node, const float3x8 &origin, const float3x8 &inv,
+				const float8 &tmin, const float8 &tmax)
+			{
+				float8 entry;
+				return intersect_box(node.lower, node.upper, origin, inv, tmin, tmax, entry);
+			}
+
+			inline float8 hit_triangle(const bvh_triangle &tri, const ray8 &r, const float8 &tmax,
+				float8 &t, float8 &u, float8 &v)
+			{
+				return intersect_triangle_edges(tri.v0, tri.e1, tri.e2, r.origin, r.direction, r.tmin, tmax, t, u, v);
+			}
+
+			// the lanes are ordered by the direction of the first active one
+			inline void direction_signs(const ray8 &r, int active, int *negative)
+			{
+				int lane = 0;
+				while (lane != static_cast<int>(c_packet_width) - 1 && !(active & (1 << lane)))
+				{
+					++lane;
+				}
+				negative[0] = r.direction.x[lane] < 0;
+				negative[1] = r.direction.y[lane] < 0;
+				negative[2] = r.direction.z[lane] < 0;
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			// leaves
+			//
+			// the traversals below call on them for the items of a leaf: each
+			// intersect() narrows tmax, or the t of the packet, to the hits it
+			// finds, each occluded() reports the rays it blocks.
+			//////////////////////////////////////////////////////////////////////////
+			struct triangle_leaves
+			{
+				explicit triangle_leaves(const bvh_triangle *triangles)
+					: triangles(triangles)
+				{
+				}
+
+				bool intersect(unsigned int first, unsigned int count, const ray &r, float &tmax, hit &h) const
+				{
+					bool found = false;
+					for (unsigned int i = first; i != first + count; ++i)
+					{
+						float t, u, v;
+						if (hit_triangle(triangles[i], r.origin, r.direction, r.tmin, tmax, t, u, v))
+						{
+							tmax = t;
+							h.t = t;
+							h.u = u;
+							h.v = v;
+							h.triangle = triangles[i].index;
+							h.instance = c_no_hit;
+							found = true;
+						}
+					}
+					return found;
+				}
+
+				bool occluded(unsigned int first, unsigned int count, const ray &r) const
+				{
+					for (unsigned int i = first; i != first + count; ++i)
+					{
+						float t, u, v;
+						if (hit_triangle(triangles[i], r.origin, r.direction, r.tmin, r.tmax, t, u, v))
+						{
+							return true;
+						}
+					}
+					return false;
+				}
+
+				void intersect(unsigned int first, unsigned int count, const ray8 &r, hit8 &h) const
+				{
+					for (unsigned int i = first; i != first + count; ++i)
+					{
+						float8 t, u, v;
+						float8 mask = hit_triangle(triangles[i], r, h.t, t, u, v);
+						int bits = movemask(mask);
+						if (bits != 0)
+						{
+							h.t = select(mask, t, h.t);
+							h.u = select(mask, u, h.u);
+							h.v = select(mask, v, h.v);
+							for (size_t lane = 0; lane != c_packet_width; ++lane)
+							{
+								if (bits & (1 << lane))
+								{
+									h.triangle[lane] = triangles[i].index;
+								}
+							}
+						}
+					}
+				}
+
+				int occluded(unsigned int first, unsigned int count, const ray8 &r, const float8 &tmax) const
+				{
+					int bits = 0;
+					for (unsigned int i = first; i != first + count; ++i)
+					{
+						float8 t, u, v;
+						bits |= movemask(hit_triangle(triangles[i], r, tmax, t, u, v));
+					}
+					return bits;
+				}
+
+				const bvh_triangle *triangles;
+			};
+
+			// the rays in the space of an object
+			ray to_object(const bvh_instance &instance, const ray &r)
+			{
+				ray local;
+				local.origin = transform_point(instance.inverse, r.origin);
+				local.direction = transform_vector(instance.inverse, r.direction);
+				local.tmin = r.tmin;
+				local.tmax = r.tmax;
+				return local;
+			}
+
+			inline float8 dot_row(const float4 &row, const float3x8 &v)
+			{
+				return float8(row[0]) * v.x + float8(row[1]) * v.y + float8(row[2]) * v.z;
+			}
+
+			ray8 to_object(const bvh_instance &instance, const ray8 &r)
+			{
+				const float3x4 &m = instance.inverse;
+				ray8 local;
+				local.origin.x = dot_row(m[0], r.origin) + float8(m[0][3]);
+				local.origin.y = dot_row(m[1], r.origin) + float8(m[1][3]);
+				local.origin.z = dot_row(m[2], r.origin) + float8(m[2][3]);
+				local.direction.x = dot_row(m[0], r.direction);
+				local.direction.y = dot_row(m[1], r.direction);
+				local.direction.z = dot_row(m[2], r.direction);
+				local.tmin = r.tmin;
+				local.tmax = r.tmax;
+				return local;
+			}
+
+			// the affine map keeps t, so the hits of the objects compare as
+			// they are
+			struct instance_leaves
+			{
+				instance_leaves(const std::vector<bvh_instance> &instances, const std::vector<unsigned int> &order)
+					: instances(instances.empty() ? 0 : &instances[0])
+					, order(order.empty() ? 0 : &order[0])
+				{
+				}
+
+				bool intersect(unsigned int first, unsigned int count, const ray &r, float &tmax, hit &h) const
+				{
+					bool found = false;
+					for (unsigned int i = first; i != first + count; ++i)
+					{
+						const bvh_instance &instance = instances[order[i]];
+						ray local = to_object(instance, r);
+						local.tmax = tmax;
+						hit object_hit;
+						if (instance.object->intersect(local, object_hit))
+						{
+							h = object_hit;
+							h.instance = order[i];
+							tmax = h.t;
+							found = true;
+						}
+					}
+					return found;
+				}
+
+				bool occluded(unsigned int first, unsigned int count, const ray &r) const
+				{
+					for (unsigned int i = first; i != first + count; ++i)
+					{
+						const bvh_instance &instance = instances[order[i]];
+						if (instance.object->occluded(to_object(instance, r)))
+						{
+							return true;
+						}
+					}
+					return false;
+				}
+
+				void intersect(unsigned int first, unsigned int count, const ray8 &r, hit8 &h) const
+				{
+					for (unsigned int i = first; i != first + count; ++i)
+					{
+						const bvh_instance &instance = instances[order[i]];
+						ray8 local = to_object(instance, r);
+						local.tmax = h.t;
+						hit8 object_hit;
+						instance.object->intersect(local, object_hit);
+						for (size_t lane = 0; lane != c_packet_width; ++lane)
+						{
+							if (object_hit.triangle[lane] != c_no_hit)
+							{
+								h.t[lane] = object_hit.t[lane];
+								h.u[lane] = object_hit.u[lane];
+								h.v[lane] = object_hit.v[lane];
+								h.triangle[lane] = object_hit.triangle[lane];
+								h.instance[lane] = order[i];
+							}
+						}
+					}
+				}
+
+				int occluded(unsigned int first, unsigned int count, const ray8 &r, const float8 &tmax) const
+				{
+					int bits = 0;
+					for (unsigned int i = first; i != first + count; ++i)
+					{
+						const bvh_instance &instance = instances[order[i]];
+						ray8 local = to_object(instance, r);
+						local.tmax = tmax;
+						bits |= instance.object->occluded(local);
+					}
+					return bits;
+				}
+
+				const bvh_instance *instances;
+				const unsigned int *order;
+			};
+
+			//////////////////////////////////////////////////////////////////////////
+			// traversal
+			//////////////////////////////////////////////////////////////////////////
+
+			// nearer child first with the farther ones on a stack, with
+			// where the ray enters them so that those behind the closest
+			// hit are skipped
+			template<typename Leaves>
+			bool intersect_nodes(const std::vector<bvh_node> &nodes, const Leaves &leaves, const ray &r, hit &h)
+			{
+				float entry;
+				const float3 inv = reciprocal(r.direction);
+				if (nodes.empty() || !hit_box(nodes[0], r.origin, inv, r.tmin, r.tmax, entry))
+				{
+					return false;
+				}
+
+				unsigned int stack[c_stack_size];
+				float entries[c_stack_size];
+				int top = 0;
+				unsigned int index = 0;
+				float tmax = r.tmax;
+				bool found = false;
+				for (;;)
+				{
+					const bvh_node &node = nodes[index];
+					if (node.count != 0)
+					{
+						found |= leaves.intersect(node.offset, node.count, r, tmax, h);
+					}
+					else
+					{
+						unsigned int closer = index + 1;
+						unsigned int farther = node.offset;
+						float closer_entry, farther_entry;
+						bool closer_hit = hit_box(nodes[closer], r.origin, inv, r.tmin, tmax, closer_entry);
+						bool farther_hit = hit_box(nodes[farther], r.origin, inv, r.tmin, tmax, farther_entry);
+						if (closer_hit && farther_hit)
+						{
+							if (farther_entry < closer_entry)
+							{
+								std::swap(closer, farther);
+								std::swap(closer_entry, farther_entry);
+							}
+							stack[top] = farther;
+							entries[top++] = farther_entry;
+							index = closer;
+							continue;
+						}
+						if (closer_hit || farther_hit)
+						{
+							index = closer_hit ? closer : farther;
+							continue;
+						}
+					}
+
+					do
+					{
+						if (top == 0)
+						{
+							return found;
+						}
+						--top;
+					}
+					while (entries[top] > tmax);
+					index = stack[top];
+				}
+			}
+
+			// any hit, in no particular order
+			template<typename Leaves>
+			bool occluded_nodes(const std::vector<bvh_node> &nodes, const Leaves &leaves, const ray &r)
+			{
+				float entry;
+				const float3 inv = reciprocal(r.direction);
+				if (nodes.empty() || !hit_box(nodes[0], r.origin, inv, r.tmin, r.tmax, entry))
+				{
+					return false;
+				}
+
+				unsigned int stack[c_stack_size];
+				int top = 0;
+				unsigned int index = 0;
+				for (;;)
+				{
+					const bvh_node &node = nodes[index];
+					if (node.count != 0)
+					{
+						if (leaves.occluded(node.offset, node.count, r))
+						{
+							return true;
+						}
+					}
+					else
+					{
+						unsigned int first = index + 1;
+						unsigned int second = node.offset;
+						bool first_hit = hit_box(nodes[first], r.origin, inv, r.tmin, r.tmax, entry);
+						bool second_hit = hit_box(nodes[second], r.origin, inv, r.tmin, r.tmax, entry);
+						if (first_hit && second_hit)
+						{
+							stack[top++] = second;
+							index = first;
+							continue;
+						}
+						if (first_hit || second_hit)
+						{
+							index = first_hit ? first : second;
+							continue;
+						}
+					}
+
+					if (top == 0)
+					{
+						return false;
+					}
+					index = stack[--top];
+				}
+			}
+
+			// the packet visits a node when any of its rays does, and takes
+			// the children in the order of its first ray
+			template<typename Leaves>
+			void intersect_nodes(const std::vector<bvh_node> &nodes, const Leaves &leaves, const ray8 &r, hit8 &h)
+			{
+				h.t = r.tmax;
+				h.u = h.v = float8(0.0f);
+				for (size_t i = 0; i != c_packet_width; ++i)
+				{
+					h.triangle[i] = c_no_hit;
+					h.instance[i] = c_no_hit;
+				}
+
+				int active = movemask(r.tmin <= r.tmax);
+				if (nodes.empty() || active == 0)
+				{
+					return;
+				}
+
+				int negative[3];
+				direction_signs(r, active, negative);
+				float3x8 inv = reciprocal(r.direction);
+
+				unsigned int stack[c_stack_size];
+				int top = 0;
+				unsigned int index = 0;
+				for (;;)
+				{
+					const bvh_node &node = nodes[index];
+					if (any(hit_box(node, r.origin, inv, r.tmin, h.t)))
+					{
+						if (node.count == 0)
+						{
+							unsigned int closer = index + 1;
+							unsigned int farther = node.offset;
+							if (negative[node.axis])
+							{
+								std::swap(closer, farther);
+							}
+							stack[top++] = farther;
+							index = closer;
+							continue;
+						}
+						leaves.intersect(node.offset, node.count, r, h);
+					}
+
+					if (top == 0)
+					{
+						return;
+					}
+					index = stack[--top];
+				}
+			}
+
+			template<typename Leaves>
+			int occluded_nodes(const std::vector<bvh_node> &nodes, const Leaves &leaves, const ray8 &r)
+			{
+				const int all_lanes = (1 << c_packet_width) - 1;
+				int active = movemask(r.tmin <= r.tmax);
+				if (nodes.empty() || active == 0)
+				{
+					return 0;
+				}
+
+				int negative[3];
+				direction_signs(r, active, negative);
+				float3x8 inv = reciprocal(r.direction);
+
+				// occluded lanes drop out of the box tests with tmax at -inf
+				float8 tmax = r.tmax;
+				int done = 0;
+				unsigned int stack[c_stack_size];
+				int top = 0;
+				unsigned int index = 0;
+				for (;;)
+				{
+					const bvh_node &node = nodes[index];
+					if (any(hit_box(node, r.origin, inv, r.tmin, tmax)))
+					{
+						if (node.count == 0)
+						{
+							unsigned int closer = index + 1;
+							unsigned int farther = node.offset;
+							if (negative[node.axis])
+							{
+								std::swap(closer, farther);
+							}
+							stack[top++] = farther;
+							index = closer;
+							continue;
+						}
+
+						int bits = leaves.occluded(node.offset, node.count, r, tmax) & ~done;
+						if (bits != 0)
+						{
+							done |= bits;
+							for (size_t lane = 0; lane != c_packet_width; ++lane)
+							{
+								if (bits & (1 << lane))
+								{
+									tmax[lane] = -FLT_MAX;
+								}
+							}
+							if (((done | ~active) & all_lanes) == all_lanes)
+							{
+								return done;
+							}
+						}
+					}
+
+					if (top == 0)
+					{
+						return done;
+					}
+					index = stack[--top];
+				}
+			}
+
+			// count rays over the threads, in packets
+			template<typename Traceable>
+			void intersect_batch(const Traceable &traceable, const ray *rays, size_t count, hit *hits)
+			{
+				const int packets = static_cast<int>((count + c_packet_width - 1) / c_packet_width);
+				#pragma omp parallel for schedule(dynamic, 64) if (packets > 1)
+				for (int p = 0; p < packets; ++p)
+				{
+					size_t first = p * c_packet_width;
+					size_t n = std::min(c_packet_width, count - first);
+					ray8 packet;
+					hit8 result;
+					load_packet(rays + first, n, packet);
+					traceable.intersect(packet, result);
+					store_packet(result, n, hits + first);
+				}
+			}
+
+			template<typename Traceable>
+			void occluded_batch(const Traceable &traceable, const ray *rays, size_t count, bool *results)
+			{
+				const int packets = static_cast<int>((count + c_packet_width - 1) / c_packet_width);
+				#pragma omp parallel for schedule(dynamic, 64) if (packets > 1)
+				for (int p = 0; p < packets; ++p)
+				{
+					size_t first = p * c_packet_width;
+					size_t n = std::min(c_packet_width, count - first);
+					ray8 packet;
+					load_packet(rays + first, n, packet);
+					int bits = traceable.occluded(packet);
+					for (size_t i = 0; i != n; ++i)
+					{
+						results[first + i] = (bits & (1 << i)) != 0;
+					}
+				}
+			}
+
+			// the box of a box after an affine transform
+			box4 transformed_box(const aabb &box, const float3x4 &transform)
+			{
+				box4 result;
+				reset(result);
+				for (int corner = 0; corner != 8; ++corner)
+				{
+					float3 p(corner & 1 ? box.upper.x : box.lower.x, corner & 2 ? box.upper.y : box.lower.y,
+						corner & 4 ? box.upper.z : box.lower.z);
+					float3 q = transform_point(transform, p);
+					const float v[4] = { q.x, q.y, q.z, 0 };
+					grow(result, v);
+				}
+				return result;
+			}
+
+			aabb root_bounds(const std::vector<bvh_node> &nodes)
+			{
+				aabb box;
+				if (nodes.empty())
+				{
+					box.lower = box.upper = float3(0, 0, 0);
+				}
+				else
+				{
+					box.lower = nodes[0].lower;
+					box.upper = nodes[0].upper;
+				}
+				return box;
+			}
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// build
+		//////////////////////////////////////////////////////////////////////////
+		Bvh::Bvh()
+			: m_built_cost(0)
+		{
+		}
+
+		Bvh::Bvh(const vertex *vertices, size_t vertex_count, const unsigned int *indices, size_t index_count,
+			bvh_build method)
+			: m_built_cost(0)
+		{
+			build(vertices, vertex_count, indices, index_count, method);
+		}
+
+		Bvh::Bvh(const IMeshable &mesh, bvh_build method)
+			: m_built_cost(0)
+		{
+			build(mesh, method);
+		}
+
+		void Bvh::build(const IMeshable &mesh, bvh_build method)
+		{
+			std::vector<vertex> vertices(mesh.vertex_count());
+			std::vector<unsigned int> indices(mesh.triangle_count() * 3);
+			if (!vertices.empty())
+			{
+				mesh.get_vertices(0, vertices.size(), &vertices[0]);
+			}
+			if (!indices.empty())
+			{
+				mesh.get_triangles(0, mesh.triangle_count(), &indices[0]);
+			}
+			build(vertices.empty() ? 0 : &vertices[0], vertices.size(), indices.empty() ? 0 : &indices[0], indices.size(),
+				method);
+		}
+
+		void Bvh::build(const vertex *vertices, size_t vertex_count, const unsigned int *indices, size_t index_count,
+			bvh_build method)
+		{
+			m_nodes.clear();
+			m_triangles.clear();
+			m_built_cost = 0;
+
+			const int n = static_cast<int>(index_count / 3);
+			if (n == 0 || vertex_count == 0)
+			{
+				return;
+			}
+
+			std::vector<box4> boxes(n);
+			std::vector<point4> centers(n);
+			#pragma omp parallel for if (n > 1 << 12)
+			for (int t = 0; t < n; ++t)
+			{
+				reset(boxes[t]);
+				for (int k = 0; k != 3; ++k)
+				{
+					const float3 &p = vertices[indices[t * 3 + k]].pos;
+					const float v[4] = { p.x, p.y, p.z, 0 };
+					grow(boxes[t], v);
+				}
+				for (int k = 0; k != 4; ++k)
+				{
+					centers[t].v[k] = (boxes[t].lower[k] + boxes[t].upper[k]) * 0.5f;
+				}
+			}
+
+			std::vector<unsigned int> order;
+			build_tree(boxes, centers, method, order, m_nodes);
+
+			m_triangles.resize(n);
+			#pragma omp parallel for if (n > 1 << 12)
+			for (int i = 0; i < n; ++i)
+			{
+				unsigned int t = order[i];
+				const float3 &v0 = vertices[indices[t * 3 + 0]].pos;
+				const float3 &v1 = vertices[indices[t * 3 + 1]].pos;
+				const float3 &v2 = vertices[indices[t * 3 + 2]].pos;
+				bvh_triangle &tri = m_triangles[i];
+				tri.v0 = v0;
+				tri.e1 = v1 - v0;
+				tri.e2 = v2 - v0;
+				tri.index = t;
+			}
+			m_built_cost = sah_cost();
+		}
+
+		void Bvh::refit(const IMeshable &mesh)
+		{
+			std::vector<vertex> vertices(mesh.vertex_count());
+			std::vector<unsigned int> indices(mesh.triangle_count() * 3);
+			if (!vertices.empty())
+			{
+				mesh.get_vertices(0, vertices.size(), &vertices[0]);
+			}
+			if (!indices.empty())
+			{
+				mesh.get_triangles(0, mesh.triangle_count(), &indices[0]);
+			}
+			refit(vertices.empty() ? 0 : &vertices[0], vertices.size(), indices.empty() ? 0 : &indices[0]);
+		}
+
+		void Bvh::refit(const vertex *vertices, size_t vertex_count, const unsigned int *indices)
+		{
+			if (m_nodes.empty() || vertex_count == 0)
+			{
+				return;
+			}
+
+			const int n = static_cast<int>(m_triangles.size());
+			#pragma omp parallel for if (n > 1 << 12)
+			for (int i = 0; i < n; ++i)
+			{
+				bvh_triangle &tri = m_triangles[i];
+				const float3 &v0 = vertices[indices[tri.index * 3 + 0]].pos;
+				const float3 &v1 = vertices[indices[tri.index * 3 + 1]].pos;
+				const float3 &v2 = vertices[indices[tri.index * 3 + 2]].pos;
+				tri.v0 = v0;
+				tri.e1 = v1 - v0;
+				tri.e2 = v2 - v0;
+			}
+
+			triangle_bounds leaf_bounds(&m_triangles[0]);
+			refitter<triangle_bounds>(m_nodes, leaf_bounds).run();
+		}
+
+		aabb Bvh::bounds() const
+		{
+			return root_bounds(m_nodes);
+		}
+
+		float Bvh::sah_cost() const
+		{
+			if (m_nodes.empty())
+			{
+				return 0;
+			}
+
+			float cost = 0;
+			for (size_t i = 0; i != m_nodes.size(); ++i)
+			{
+				const bvh_node &node = m_nodes[i];
+				float weight = node.count == 0 ? c_traversal_cost : static_cast<float>(node.count);
+				cost += weight * half_area(node.lower, node.upper);
+			}
+			float area = half_area(m_nodes[0].lower, m_nodes[0].upper);
+			return area > 0 ? cost / area : cost;
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// rays
+		//////////////////////////////////////////////////////////////////////////
+		bool Bvh::intersect(const ray &r, hit &h) const
+		{
+			return intersect_nodes(m_nodes, triangle_leaves(triangles()), r, h);
+		}
+
+		bool Bvh::occluded(const ray &r) const
+		{
+			return occluded_nodes(m_nodes, triangle_leaves(triangles()), r);
+		}
+
+		void Bvh::intersect(const ray8 &r, hit8 &h) const
+		{
+			intersect_nodes(m_nodes, triangle_leaves(triangles()), r, h);
+		}
+
+		int Bvh::occluded(const ray8 &r) const
+		{
+			return occluded_nodes(m_nodes, triangle_leaves(triangles()), r);
+		}
+
+		void Bvh::intersect(const ray *rays, size_t count, hit *hits) const
+		{
+			intersect_batch(*this, rays, count, hits);
+		}
+
+		void Bvh::occluded(const ray *rays, size_t count, bool *results) const
+		{
+			occluded_batch(*this, rays, count, results);
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// instances
+		//////////////////////////////////////////////////////////////////////////
+		InstanceBvh::InstanceBvh()
+		{
+		}
+
+		unsigned int InstanceBvh::add(const IRayTraceable *object, const float3x4 &transform)
+		{
+			bvh_instance instance;
+			instance.object = object;
+			m_instances.push_back(instance);
+			unsigned int index = static_cast<unsigned int>(m_instances.size() - 1);
+			set_transform(index, transform);
+			return index;
+		}
+
+		unsigned int InstanceBvh::add(const IRayTraceable *object, const float4x4 &transform)
+		{
+			return add(object, float3x4(transform));
+		}
+
+		void InstanceBvh::set_transform(unsigned int instance, const float3x4 &transform)
+		{
+			m_instances[instance].transform = transform;
+			m_instances[instance].inverse = inv(transform);
+		}
+
+		void InstanceBvh::set_transform(unsigned int instance, const float4x4 &transform)
+		{
+			set_transform(instance, float3x4(transform));
+		}
+
+		void InstanceBvh::clear()
+		{
+			m_instances.clear();
+			m_nodes.clear();
+			m_order.clear();
+		}
+
+		void InstanceBvh::build(bvh_build method)
+		{
+			const size_t n = m_instances.size();
+			std::vector<box4> boxes(n);
+			std::vector<point4> centers(n);
+			for (size_t i = 0; i != n; ++i)
+			{
+				boxes[i] = transformed_box(m_instances[i].object->bounds(), m_instances[i].transform);
+				for (int k = 0; k != 4; ++k)
+				{
+					centers[i].v[k] = (boxes[i].lower[k] + boxes[i].upper[k]) * 0.5f;
+				}
+			}
+			build_tree(boxes, centers, method, m_order, m_nodes);
+		}
+
+		void InstanceBvh::refit()
+		{
+			std::vector<box4> boxes(m_instances.size());
+			for (size_t i = 0; i != boxes.size(); ++i)
+			{
+				boxes[i] = transformed_box(m_instances[i].object->bounds(), m_instances[i].transform);
+			}
+			order_bounds leaf_bounds(boxes, m_order);
+			refitter<order_bounds>(m_nodes, leaf_bounds).run();
+		}
+
+		aabb InstanceBvh::bounds() const
+		{
+			return root_bounds(m_nodes);
+		}
+
+		bool InstanceBvh::intersect(const ray &r, hit &h) const
+		{
+			return intersect_nodes(m_nodes, instance_leaves(m_instances, m_order), r, h);
+		}
+
+		bool InstanceBvh::occluded(const ray &r) const
+		{
+			return occluded_nodes(m_nodes, instance_leaves(m_instances, m_order), r);
+		}
+
+		void InstanceBvh::intersect(const ray8 &r, hit8 &h) const
+		{
+			intersect_nodes(m_nodes, instance_leaves(m_instances, m_order), r, h);
+		}
+
+		int InstanceBvh::occluded(const ray8 &r) const
+		{
+			return occluded_nodes(m_nodes, instance_leaves(m_instances, m_order), r);
+		}
+
+		void InstanceBvh::intersect(const ray *rays, size_t count, hit *hits) const
+		{
+			intersect_batch(*this, rays, count, hits);
+		}
+
+		void InstanceBvh::occluded(const ray *rays, size_t count, bool *results) const
+		{
+			occluded_batch(*this, rays, count, results);
+		}
+	}
+}
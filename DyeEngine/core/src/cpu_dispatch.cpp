@@ -0,0 +1,187 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <cpu_dispatch.hpp>
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#	include <intrin.h>
+#	define DYE_CPUID
+#elif defined(__i386__) || defined(__x86_64__)
+#	include <cpuid.h>
+#	define DYE_CPUID
+#endif
+
+namespace Dye
+{
+	namespace
+	{
+		const char *const c_level_names[cpu_level_count] =
+		{
+			"scalar", "sse2", "sse42", "avx", "avx2", "avx512"
+		};
+
+#if defined(DYE_CPUID)
+		// eax, ebx, ecx, edx of the leaf
+		void cpuid(unsigned leaf, unsigned regs[4])
+		{
+#if defined(_MSC_VER)
+			int r[4];
+			__cpuidex(r, static_cast<int>(leaf), 0);
+			for (size_t i = 0; i != 4; ++i) regs[i] = static_cast<unsigned>(r[i]);
+#else
+			__cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+		}
+
+		// the register states the os saves on context switches
+		unsigned long long xcr0()
+		{
+#if defined(_MSC_VER)
+			return _xgetbv(0);
+#else
+			unsigned lo, hi;
+			__asm__ __volatile__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+			return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+		}
+
+		bool has(unsigned reg, int bit)
+		{
+			return (reg & (1u << bit)) != 0;
+		}
+#endif
+
+		cpu_level detect()
+		{
+#if defined(DYE_CPUID)
+			unsigned regs[4];
+			cpuid(0, regs);
+			unsigned max_leaf = regs[0];
+
+			cpuid(1, regs);
+			unsigned ecx1 = regs[2];
+			unsigned edx1 = regs[3];
+
+			unsigned ebx7 = 0;
+			if (max_leaf >= 7)
+			{
+				cpuid(7, regs);
+				ebx7 = regs[1];
+			}
+
+			// avx needs the ymm state saved (xcr0 bits 1, 2), avx512 also
+			// the opmask and zmm states (bits 5 to 7)
+			unsigned long long os = has(ecx1, 27) ? xcr0() : 0;
+
+			if (!has(edx1, 26))
+				return cpu_scalar;
+			if (!has(ecx1, 20))
+				return cpu_sse2;
+			if (!has(ecx1, 28) || (os & 0x06) != 0x06)
+				return cpu_sse42;
+			if (!has(ebx7, 5) || !has(ecx1, 12) || !has(ecx1, 29))
+				return cpu_avx;
+			if (!has(ebx7, 16) || (os & 0xe6) != 0xe6)
+				return cpu_avx2;
+			return cpu_avx512;
+#else
+			return cpu_scalar;
+#endif
+		}
+
+		// the detected level, lowered by DYE_CPU
+		cpu_level startup_level()
+		{
+			cpu_level level = detected_cpu_level();
+			cpu_level requested;
+			const char *name = getenv("DYE_CPU");
+			if (name && cpu_level_from_name(name, requested) && requested < level)
+			{
+				level = requested;
+			}
+			return level;
+		}
+
+		cpu_level g_active = cpu_scalar;
+		batch_kernels g_kernels;
+
+		void bind(cpu_level level)
+		{
+			const batch_kernels *table = 0;
+			if (level >= cpu_avx2)
+			{
+				table = avx2_kernels();
+			}
+			if (!table)
+			{
+				table = baseline_kernels();
+			}
+
+			g_kernels = *table;
+			g_active = level;
+		}
+
+		// binds during static initialization, so kernels() is a plain read
+		// once main runs
+		struct startup_binding
+		{
+			startup_binding()
+			{
+				kernels();
+			}
+		} g_startup_binding;
+	}
+
+	cpu_level detected_cpu_level()
+	{
+		static const cpu_level level = detect();
+		return level;
+	}
+
+	cpu_level active_cpu_level()
+	{
+		kernels();
+		return g_active;
+	}
+
+	cpu_level set_cpu_level(cpu_level level)
+	{
+		cpu_level detected = detected_cpu_level();
+		bind(level < detected ? level : detected);
+		return g_active;
+	}
+
+	const char *cpu_level_name(cpu_level level)
+	{
+		return level < cpu_level_count ? c_level_names[level] : "unknown";
+	}
+
+	bool cpu_level_from_name(const char *name, cpu_level &level)
+	{
+		for (int i = 0; i != cpu_level_count; ++i)
+		{
+			const char *a = name;
+			const char *b = c_level_names[i];
+			while (*a && tolower(static_cast<unsigned char>(*a)) == *b)
+			{
+				++a;
+				++b;
+			}
+			if (*a == 0 && *b == 0)
+			{
+				level = static_cast<cpu_level>(i);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	const batch_kernels &kernels()
+	{
+		// before the startup binding when called from another static initializer
+		if (!g_kernels.transform3)
+		{
+			bind(startup_level());
+		}
+		return g_kernels;
+	}
+}
@@ -0,0 +1,47 @@
+#include <algorithm>
+#include <half.hpp>
+#include <cpu_dispatch.hpp>
+
+namespace Dye
+{
+	namespace
+	{
+		// number of elements handed to one thread at a time, larger than
+		// for the transforms as a conversion is one load and one store
+		const size_t c_batch_size = 16384;
+
+		template<typename Func>
+		void for_each_batch(size_t n, const Func &func)
+		{
+			int num_batches = static_cast<int>((n + c_batch_size - 1) / c_batch_size);
+
+			#pragma omp parallel for if (num_batches > 1)
+			for (int b = 0; b < num_batches; ++b)
+			{
+				size_t begin = b * c_batch_size;
+				size_t end = std::min(begin + c_batch_size, n);
+				func(begin, end);
+			}
+		}
+	}
+
+	void convert(const float *in, half *out, size_t n)
+	{
+		const batch_kernels &k = kernels();
+
+		for_each_batch(n, [&](size_t begin, size_t end)
+		{
+			k.float_to_half(in + begin, &out[begin].bits, end - begin);
+		});
+	}
+
+	void convert(const half *in, float *out, size_t n)
+	{
+		const batch_kernels &k = kernels();
+
+		for_each_batch(n, [&](size_t begin, size_t end)
+		{
+			k.half_to_float(&in[begin].bits, out + begin, end - begin);
+		});
+	}
+}
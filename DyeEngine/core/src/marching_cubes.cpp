@@ -0,0 +1,437 @@
+#include <algorithm>
+#include <omp.h>
+#include <marching_cubes.hpp>
+
+namespace Dye
+{
+	namespace Render
+	{
+		using namespace Graphics;
+
+		namespace
+		{
+			// triangles a case has at most
+			const size_t c_case_triangles = 5;
+
+			// an edge without a vertex in a cache
+			const unsigned short c_no_vertex = 0xffff;
+
+			// the corners of a cube are numbered by their bits, x the lowest,
+			// and its 12 edges by axis, 4 each, then by the bits of the other
+			// two axes of their first corner
+			void edge_start(unsigned int edge, unsigned int &corner, unsigned int &axis)
+			{
+				axis = edge / 4;
+				corner = (edge & 1) << (axis + 1) % 3 | (edge >> 1 & 1) << (axis + 2) % 3;
+			}
+
+			unsigned int edge_between(unsigned int a, unsigned int b)
+			{
+				const unsigned int bit = a ^ b;
+				const unsigned int axis = bit == 1 ? 0 : bit == 2 ? 1 : 2;
+				const unsigned int corner = a & b;
+				return axis * 4 + (corner >> (axis + 1) % 3 & 1) + 2 * (corner >> (axis + 2) % 3 & 1);
+			}
+
+			struct mc_case
+			{
+				unsigned int triangles;
+				unsigned char edges[3 * c_case_triangles];
+			};
+
+			// the triangles of each case, a bit per corner inside
+			class CaseTable
+			{
+			public:
+				CaseTable()
+				{
+					for (unsigned int inside = 0; inside != 256; ++inside)
+					{
+						build(inside, m_cases[inside]);
+					}
+				}
+
+				const mc_case &operator[](unsigned int inside) const { return m_cases[inside]; }
+
+			private:
+				static void build(unsigned int inside, mc_case &out)
+				{
+					// the crossing that follows each one around the surface
+					int next[12];
+					std::fill(next, next + 12, -1);
+					unsigned int sides[6];
+					for (unsigned int face = 0; face != 6; ++face)
+					{
+						// the corners counter-clockwise seen from outside the cube
+						const unsigned int axis = face / 2;
+						const unsigned int base = (face & 1) << axis;
+						const unsigned int u = 1 << (axis + 1) % 3;
+						const unsigned int v = 1 << (axis + 2) % 3;
+						unsigned int ring[4] = { base, base | u, base | u | v, base | v };
+						if ((face & 1) == 0)
+						{
+							std::swap(ring[1], ring[3]);
+						}
+
+						// each crossing into the inside leads to the next one out,
+						// which keeps the inside corners of a face apart
+						unsigned int edges[4];
+						bool enters[4];
+						size_t count = 0;
+						sides[face] = 0;
+						for (size_t i = 0; i != 4; ++i)
+						{
+							const unsigned int a = ring[i];
+							const unsigned int b = ring[(i + 1) % 4];
+							sides[face] |= 1 << edge_between(a, b);
+							if ((inside >> a & 1) != (inside >> b & 1))
+							{
+								edges[count] = edge_between(a, b);
+								enters[count] = (inside >> b & 1) != 0;
+								++count;
+							}
+						}
+						for (size_t i = 0; i != count; ++i)
+						{
+							if (enters[i])
+							{
+								next[edges[i]] = static_cast<int>(edges[(i + 1) % count]);
+							}
+						}
+					}
+
+					// the loops, fanned from a crossing none of whose diagonals
+					// lies in a face, as the cube next to it would draw the same
+					// one; there is always one
+					out.triangles = 0;
+					bool done[12] = { false };
+					for (int edge = 0; edge != 12; ++edge)
+					{
+						if (next[edge] < 0 || done[edge])
+						{
+							continue;
+						}
+						unsigned char loop[12];
+						size_t length = 0;
+						for (int at = edge; !done[at]; at = next[at])
+						{
+							done[at] = true;
+							loop[length++] = static_cast<unsigned char>(at);
+						}
+						size_t first = 0;
+						while (first + 1 < length && !off_faces(loop, length, first, sides))
+						{
+							++first;
+						}
+						for (size_t i = 1; i + 1 < length; ++i)
+						{
+							unsigned char *triangle = out.edges + 3 * out.triangles++;
+							triangle[0] = loop[first];
+							triangle[1] = loop[(first + i) % length];
+							triangle[2] = loop[(first + i + 1) % length];
+						}
+					}
+				}
+
+				// whether the fan from loop[first] keeps its diagonals off the
+				// faces, each a mask of its edges
+				static bool off_faces(const unsigned char *loop, size_t length, size_t first, const unsigned int *sides)
+				{
+					for (size_t i = 2; i + 1 < length; ++i)
+					{
+						const unsigned int ends = 1 << loop[first] | 1 << loop[(first + i) % length];
+						for (int face = 0; face != 6; ++face)
+						{
+							if ((sides[face] & ends) == ends)
+							{
+								return false;
+							}
+						}
+					}
+					return true;
+				}
+
+				mc_case m_cases[256];
+			};
+
+			const CaseTable g_cases;
+		}
+
+		struct MarchingCubes::chunk
+		{
+			// the case of each cell and the vertex of each edge of each point,
+			// 3 a point, x fastest; empty where the surface does not cross
+			std::vector<unsigned char> cases;
+			std::vector<unsigned short> edges;
+
+			std::vector<vertex> vertices;
+			std::vector<unsigned int> indices;
+		};
+
+		MarchingCubes::MarchingCubes(const IScalarField &field, const float3 &origin, float cell_size,
+			size_t nx, size_t ny, size_t nz)
+			: m_field(&field), m_origin(origin), m_cell(cell_size), m_iso(0)
+		{
+			m_cells[0] = nx;
+			m_cells[1] = ny;
+			m_cells[2] = nz;
+		}
+
+		void MarchingCubes::locate(size_t index, size_t *first, size_t *cells, bool *last) const
+		{
+			const size_t at[3] = { index % chunks(0), index / chunks(0) % chunks(1), index / (chunks(0) * chunks(1)) };
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				first[axis] = at[axis] * c_mc_chunk;
+				cells[axis] = std::min(c_mc_chunk, m_cells[axis] - first[axis]);
+				last[axis] = at[axis] + 1 == chunks(axis);
+			}
+		}
+
+		void MarchingCubes::place_vertices(size_t index, chunk &out) const
+		{
+			size_t first[3], cells[3];
+			bool last[3];
+			locate(index, first, cells, last);
+
+			// a chunk the field keeps clear of the value is done unsampled,
+			// with a cell of margin for the rounding of the range
+			aabb box;
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				box.lower[axis] = m_origin[axis] + m_cell * first[axis];
+				box.upper[axis] = m_origin[axis] + m_cell * (first[axis] + cells[axis]);
+			}
+			float lower, upper;
+			m_field->range(box, lower, upper);
+			if (lower > m_iso + m_cell || upper < m_iso - m_cell)
+			{
+				return;
+			}
+
+			// the points of the chunk with a point of margin on every side
+			lattice grid = { m_origin, m_cell, { 0, 0, 0 }, { 0, 0, 0 } };
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				grid.first[axis] = static_cast<int>(first[axis]) - 1;
+				grid.count[axis] = cells[axis] + 3;
+			}
+			std::vector<float> samples(grid.size());
+			m_field->sample_grid(grid, &samples[0]);
+			const size_t stride[3] = { 1, grid.count[0], grid.count[0] * grid.count[1] };
+
+			// the points inside, without the margin
+			const size_t points[3] = { cells[0] + 1, cells[1] + 1, cells[2] + 1 };
+			std::vector<unsigned char> inside(points[0] * points[1] * points[2]);
+			size_t below = 0;
+			for (size_t k = 0, n = 0; k != points[2]; ++k)
+			{
+				for (size_t j = 0; j != points[1]; ++j)
+				{
+					const float *row = &samples[0] + (k + 1) * stride[2] + (j + 1) * stride[1] + 1;
+					for (size_t i = 0; i != points[0]; ++i, ++n)
+					{
+						inside[n] = row[i] < m_iso;
+						below += inside[n];
+					}
+				}
+			}
+			if (below == 0 || below == inside.size())
+			{
+				return;
+			}
+
+			const size_t point_stride[3] = { 1, points[0], points[0] * points[1] };
+			out.cases.resize(cells[0] * cells[1] * cells[2]);
+			for (size_t k = 0, n = 0; k != cells[2]; ++k)
+			{
+				for (size_t j = 0; j != cells[1]; ++j)
+				{
+					for (size_t i = 0; i != cells[0]; ++i, ++n)
+					{
+						const unsigned char *corner = &inside[0] + k * point_stride[2] + j * point_stride[1] + i;
+						const unsigned char *up = corner + point_stride[1];
+						out.cases[n] = static_cast<unsigned char>(corner[0] | corner[1] << 1 | up[0] << 2 | up[1] << 3
+							| corner[point_stride[2]] << 4 | corner[point_stride[2] + 1] << 5
+							| up[point_stride[2]] << 6 | up[point_stride[2] + 1] << 7);
+					}
+				}
+			}
+
+			// the points on the high sides belong to the next chunk, unless
+			// this is the last one
+			size_t owned[3];
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				owned[axis] = last[axis] ? points[axis] : cells[axis];
+			}
+			out.edges.assign(inside.size() * 3, c_no_vertex);
+			for (size_t k = 0; k != owned[2]; ++k)
+			{
+				for (size_t j = 0; j != owned[1]; ++j)
+				{
+					for (size_t i = 0; i != owned[0]; ++i)
+					{
+						const size_t point[3] = { i, j, k };
+						const size_t n = k * point_stride[2] + j * point_stride[1] + i;
+						const size_t at = (k + 1) * stride[2] + (j + 1) * stride[1] + i + 1;
+						for (int axis = 0; axis != 3; ++axis)
+						{
+							if (point[axis] == cells[axis] || inside[n] == inside[n + point_stride[axis]])
+							{
+								continue;
+							}
+							const size_t to = at + stride[axis];
+							const float t = (m_iso - samples[at]) / (samples[to] - samples[at]);
+
+							vertex v;
+							for (int other = 0; other != 3; ++other)
+							{
+								v.pos[other] = grid.coordinate(other, static_cast<int>(first[other] + point[other]));
+							}
+							const float end = grid.coordinate(axis, static_cast<int>(first[axis] + point[axis] + 1));
+							v.pos[axis] += (end - v.pos[axis]) * t;
+
+							const float3 from(samples[at + 1] - samples[at - 1], samples[at + stride[1]] - samples[at - stride[1]],
+								samples[at + stride[2]] - samples[at - stride[2]]);
+							const float3 gradient(samples[to + 1] - samples[to - 1], samples[to + stride[1]] - samples[to - stride[1]],
+								samples[to + stride[2]] - samples[to - stride[2]]);
+							v.normal = from + (gradient - from) * t;
+							const float length = v.normal.length();
+							v.normal = length > 0 ? v.normal / length : float3(0, 0, 0);
+							v.tex = float2(0, 0);
+
+							out.edges[n * 3 + axis] = static_cast<unsigned short>(out.vertices.size());
+							out.vertices.push_back(v);
+						}
+					}
+				}
+			}
+		}
+
+		void MarchingCubes::emit_triangles(size_t index, const std::vector<chunk> &parts,
+			const std::vector<size_t> &offsets, std::vector<unsigned int> &out) const
+		{
+			size_t first[3], cells[3];
+			bool last[3];
+			locate(index, first, cells, last);
+			const chunk &own = parts[index];
+			const size_t at[3] = { first[0] / c_mc_chunk, first[1] / c_mc_chunk, first[2] / c_mc_chunk };
+
+			for (size_t k = 0, n = 0; k != cells[2]; ++k)
+			{
+				for (size_t j = 0; j != cells[1]; ++j)
+				{
+					for (size_t i = 0; i != cells[0]; ++i, ++n)
+					{
+						const mc_case &cube = g_cases[own.cases[n]];
+						const size_t cell[3] = { i, j, k };
+						for (unsigned int t = 0; t != cube.triangles; ++t)
+						{
+							unsigned int triangle[3];
+							bool whole = true;
+							for (int e = 0; e != 3; ++e)
+							{
+								unsigned int corner, axis;
+								edge_start(cube.edges[3 * t + e], corner, axis);
+
+								// a point on a high side is the first of the next chunk
+								size_t neighbour[3], point[3];
+								for (int side = 0; side != 3; ++side)
+								{
+									point[side] = cell[side] + (corner >> side & 1);
+									neighbour[side] = at[side];
+									if (point[side] == cells[side] && !last[side])
+									{
+										++neighbour[side];
+										point[side] = 0;
+									}
+								}
+								const size_t owner = (neighbour[2] * chunks(1) + neighbour[1]) * chunks(0) + neighbour[0];
+								size_t owner_first[3], owner_cells[3];
+								bool owner_last[3];
+								locate(owner, owner_first, owner_cells, owner_last);
+								const std::vector<unsigned short> &edges = parts[owner].edges;
+								const size_t slot = ((point[2] * (owner_cells[1] + 1) + point[1]) * (owner_cells[0] + 1)
+									+ point[0]) * 3 + axis;
+
+								// a field that gives a point two values leaves a hole
+								if (edges.empty() || edges[slot] == c_no_vertex)
+								{
+									whole = false;
+									break;
+								}
+								triangle[e] = static_cast<unsigned int>(offsets[owner] + edges[slot]);
+							}
+							if (whole)
+							{
+								out.insert(out.end(), triangle, triangle + 3);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		mc_stats MarchingCubes::extract(std::vector<vertex> &vertices, std::vector<unsigned int> &indices) const
+		{
+			const double start = omp_get_wtime();
+			const size_t count = m_cells[0] == 0 || m_cells[1] == 0 || m_cells[2] == 0 ? 0
+				: chunks(0) * chunks(1) * chunks(2);
+			std::vector<chunk> parts(count);
+			const int chunk_count = static_cast<int>(count);
+
+			#pragma omp parallel for schedule(dynamic, 1)
+			for (int i = 0; i < chunk_count; ++i)
+			{
+				place_vertices(i, parts[i]);
+			}
+
+			// the first vertex of each chunk
+			std::vector<size_t> offsets(count + 1, 0);
+			size_t surface = 0;
+			for (size_t i = 0; i != count; ++i)
+			{
+				offsets[i + 1] = offsets[i] + parts[i].vertices.size();
+				surface += !parts[i].cases.empty();
+			}
+
+			#pragma omp parallel for schedule(dynamic, 1)
+			for (int i = 0; i < chunk_count; ++i)
+			{
+				if (!parts[i].cases.empty())
+				{
+					emit_triangles(i, parts, offsets, parts[i].indices);
+				}
+			}
+
+			std::vector<size_t> index_offsets(count + 1, 0);
+			for (size_t i = 0; i != count; ++i)
+			{
+				index_offsets[i + 1] = index_offsets[i] + parts[i].indices.size();
+			}
+			vertices.resize(offsets[count]);
+			indices.resize(index_offsets[count]);
+
+			#pragma omp parallel for schedule(dynamic, 1)
+			for (int i = 0; i < chunk_count; ++i)
+			{
+				std::copy(parts[i].vertices.begin(), parts[i].vertices.end(), vertices.begin() + offsets[i]);
+				std::copy(parts[i].indices.begin(), parts[i].indices.end(), indices.begin() + index_offsets[i]);
+			}
+
+			mc_stats stats = { count, surface, vertices.size(), indices.size() / 3, omp_get_wtime() - start };
+			return stats;
+		}
+
+		mc_stats MarchingCubes::extract(Mesh &mesh) const
+		{
+			std::vector<vertex> vertices;
+			std::vector<unsigned int> indices;
+			const mc_stats stats = extract(vertices, indices);
+			mesh.assign(vertices.empty() ? 0 : &vertices[0], vertices.size(), indices.empty() ? 0 : &indices[0],
+				indices.size());
+			return stats;
+		}
+	}
+}
@@ -1,7 +1,710 @@
-
+#include <algorithm>
 #include <matrix_aux.hpp>
+#include <fast_math.hpp>
+#include <cpu_dispatch.hpp>
 
 namespace Dye
 {
+	namespace
+	{
+		// 2x2 sub-determinants of the upper (s) and lower (c) two rows,
+		// shared by the scalar det and inv of float4x4.
+		struct sub_dets
+		{
+			float s[6];
+			float c[6];
+
+			explicit sub_dets(const float4x4 &m)
+			{
+				s[0] = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+				s[1] = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+				s[2] = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+				s[3] = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+				s[4] = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+				s[5] = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+
+				c[0] = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+				c[1] = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+				c[2] = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+				c[3] = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+				c[4] = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+				c[5] = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+			}
+
+			float det() const
+			{
+				return s[0] * c[5] - s[1] * c[4] + s[2] * c[3] + s[3] * c[2] - s[4] * c[1] + s[5] * c[0];
+			}
+		};
+
+#if defined(DYE_SIMD_SSE)
+		// lane-order shuffles: the result is (a[x], a[y], b[z], b[w])
+		#define SSE_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+		#define SSE_SWIZZLE(a, x, y, z, w) SSE_SHUFFLE(a, a, x, y, z, w)
+
+		// row-major 2x2 matrices packed in one register as (00, 01, 10, 11)
+
+		// lhs * rhs
+		inline __m128 mat2_mul(__m128 lhs, __m128 rhs)
+		{
+			return _mm_add_ps(_mm_mul_ps(lhs, SSE_SWIZZLE(rhs, 0, 3, 0, 3)),
+				_mm_mul_ps(SSE_SWIZZLE(lhs, 1, 0, 3, 2), SSE_SWIZZLE(rhs, 2, 1, 2, 1)));
+		}
+
+		// adj(lhs) * rhs
+		inline __m128 mat2_adj_mul(__m128 lhs, __m128 rhs)
+		{
+			return _mm_sub_ps(_mm_mul_ps(SSE_SWIZZLE(lhs, 3, 3, 0, 0), rhs),
+				_mm_mul_ps(SSE_SWIZZLE(lhs, 1, 1, 2, 2), SSE_SWIZZLE(rhs, 2, 3, 0, 1)));
+		}
+
+		// lhs * adj(rhs)
+		inline __m128 mat2_mul_adj(__m128 lhs, __m128 rhs)
+		{
+			return _mm_sub_ps(_mm_mul_ps(lhs, SSE_SWIZZLE(rhs, 3, 0, 3, 0)),
+				_mm_mul_ps(SSE_SWIZZLE(lhs, 1, 0, 3, 2), SSE_SWIZZLE(rhs, 2, 1, 2, 1)));
+		}
+
+		// cross product of the xyz lanes, w of the result is 0 when w of
+		// both operands is 0
+		inline __m128 sse_cross3(__m128 lhs, __m128 rhs)
+		{
+			__m128 l = SSE_SWIZZLE(lhs, 1, 2, 0, 3);
+			__m128 r = SSE_SWIZZLE(rhs, 1, 2, 0, 3);
+			__m128 c = _mm_sub_ps(_mm_mul_ps(lhs, r), _mm_mul_ps(l, rhs));
+			return SSE_SWIZZLE(c, 1, 2, 0, 3);
+		}
+
+		// -(t.x * r0 + t.y * r1 + t.z * r2) with w set to 1
+		inline __m128 sse_inv_translation(__m128 t, __m128 r0, __m128 r1, __m128 r2)
+		{
+			__m128 v = _mm_mul_ps(SSE_SWIZZLE(t, 0, 0, 0, 0), r0);
+			v = _mm_add_ps(v, _mm_mul_ps(SSE_SWIZZLE(t, 1, 1, 1, 1), r1));
+			v = _mm_add_ps(v, _mm_mul_ps(SSE_SWIZZLE(t, 2, 2, 2, 2), r2));
+			v = _mm_sub_ps(_mm_setzero_ps(), v);
+			// (v.z, v.z, 1, 1) then (v.x, v.y, v.z, 1)
+			__m128 zw = _mm_shuffle_ps(v, _mm_set_ss(1.0f), _MM_SHUFFLE(0, 0, 2, 2));
+			return _mm_shuffle_ps(v, zw, _MM_SHUFFLE(2, 0, 1, 0));
+		}
+
+		inline __m128 sse_affine_mask()
+		{
+			static const DYE_ALIGN(16) float mask[4] = {1, 1, 1, 0};
+			return _mm_load_ps(mask);
+		}
+#endif
+
+		//////////////////////////////////////////////////////////////////////////
+		// jacobi decomposition, written once for float and float8. conditions
+		// are computed as masks and resolved with choose(), never branched on.
+		template<typename Type>
+		struct lane_mask
+		{
+			typedef bool type;
+		};
+
+		template<>
+		struct lane_mask<float8>
+		{
+			typedef float8 type;
+		};
+
+		inline float choose(bool mask, float a, float b)
+		{
+			return mask ? a : b;
+		}
+
+		inline float8 choose(const float8 &mask, const float8 &a, const float8 &b)
+		{
+			return select(mask, a, b);
+		}
+
+		// 4 sweeps of the 3 off-diagonal pairs reach float precision
+		static const int c_jacobi_sweeps = 4;
+
+		// (a, b) = (c * a + s * b, c * b - s * a)
+		template<typename Type>
+		void givens(const Type &c, const Type &s, Type &a, Type &b)
+		{
+			Type t = a;
+			a = c * t + s * b;
+			b = c * b - s * t;
+		}
+
+		// conjugates the symmetric m by the rotation of the (p, q) plane that
+		// (nearly) zeroes m[p][q], and accumulates it into the columns of v.
+		// the half angle is approximated as in mcadams et al., "computing the
+		// singular value decomposition of 3x3 matrices with minimal branching
+		// and elementary floating point operations", falling back to pi / 8
+		// where the approximation would not converge.
+		template<typename Type>
+		void jacobi_rotate(matrix_3x3t<Type> &m, matrix_3x3t<Type> &v, size_t p, size_t q)
+		{
+			const float gamma = 5.82842712f; // 3 + 2 * sqrt(2)
+			const float c_star = 0.923879533f; // cos(pi / 8)
+			const float s_star = 0.382683432f; // sin(pi / 8)
+
+			size_t r = 3 - p - q;
+			Type a = m[p][p];
+			Type b = m[p][q];
+			Type d = m[q][q];
+
+			Type ch = 2 * (a - d);
+			Type sh = b;
+			typename lane_mask<Type>::type accurate = gamma * sh * sh < ch * ch;
+			Type w = rsqrt_fast(ch * ch + sh * sh);
+			ch = choose(accurate, w * ch, Type(c_star));
+			sh = choose(accurate, w * sh, Type(s_star));
+
+			Type c = ch * ch - sh * sh;
+			Type s = 2 * ch * sh;
+			Type cc = c * c;
+			Type ss = s * s;
+			Type cs = c * s;
+
+			m[p][p] = cc * a + 2 * cs * b + ss * d;
+			m[q][q] = ss * a - 2 * cs * b + cc * d;
+			m[p][q] = m[q][p] = (cc - ss) * b - cs * (a - d);
+			givens(c, s, m[p][r], m[q][r]);
+			m[r][p] = m[p][r];
+			m[r][q] = m[q][r];
+
+			for (size_t i = 0; i != 3; ++i)
+			{
+				givens(c, s, v[i][p], v[i][q]);
+			}
+		}
+
+		// diagonalizes the symmetric m, v receives the eigenvectors
+		template<typename Type>
+		void jacobi(matrix_3x3t<Type> &m, matrix_3x3t<Type> &v)
+		{
+			v = matrix_3x3t<Type>::identity();
+			for (int sweep = 0; sweep != c_jacobi_sweeps; ++sweep)
+			{
+				jacobi_rotate(m, v, 0, 1);
+				jacobi_rotate(m, v, 0, 2);
+				jacobi_rotate(m, v, 1, 2);
+			}
+		}
+
+		// where key[p] < key[q], swaps the columns p and q of the matrices
+		// and negates one of them so that the determinants are kept
+		template<typename Type>
+		void swap_columns(const typename lane_mask<Type>::type &swap, matrix_3x3t<Type> &m, size_t p, size_t q)
+		{
+			for (size_t i = 0; i != 3; ++i)
+			{
+				Type t = m[i][p];
+				m[i][p] = choose(swap, m[i][q], t);
+				m[i][q] = choose(swap, -t, m[i][q]);
+			}
+		}
+
+		template<typename Type>
+		void sort_columns(Type *key, matrix_3x3t<Type> &a, matrix_3x3t<Type> *b, size_t p, size_t q)
+		{
+			typename lane_mask<Type>::type swap = key[p] < key[q];
+			Type k = key[p];
+			key[p] = choose(swap, key[q], k);
+			key[q] = choose(swap, k, key[q]);
+
+			swap_columns(swap, a, p, q);
+			if (b)
+			{
+				swap_columns(swap, *b, p, q);
+			}
+		}
+
+		// decreasing keys
+		template<typename Type>
+		void sort_columns(Type *key, matrix_3x3t<Type> &a, matrix_3x3t<Type> *b)
+		{
+			sort_columns(key, a, b, 0, 1);
+			sort_columns(key, a, b, 0, 2);
+			sort_columns(key, a, b, 1, 2);
+		}
+
+		// rotates rows p and q of r so that r[q][p] vanishes, accumulating
+		// the rotation into the columns of u
+		template<typename Type>
+		void qr_rotate(matrix_3x3t<Type> &r, matrix_3x3t<Type> &u, size_t p, size_t q)
+		{
+			const float tiny = 1.0e-30f;
+
+			Type a = r[p][p];
+			Type b = r[q][p];
+			Type len_sqr = a * a + b * b;
+			typename lane_mask<Type>::type valid = Type(tiny) < len_sqr;
+			Type w = rsqrt_fast(len_sqr);
+			Type c = choose(valid, a * w, Type(1));
+			Type s = choose(valid, b * w, Type(0));
+
+			for (size_t j = 0; j != 3; ++j)
+			{
+				givens(c, s, r[p][j], r[q][j]);
+				givens(c, s, u[j][p], u[j][q]);
+			}
+		}
+
+		template<typename Type>
+		void svd_kernel(const matrix_3x3t<Type> &mat, matrix_3x3t<Type> &u, vector_3t<Type> &sigma, matrix_3x3t<Type> &v)
+		{
+			// eigenvectors of trans(mat) * mat are the right singular vectors
+			matrix_3x3t<Type> ata;
+			for (size_t i = 0; i != 3; ++i)
+			{
+				for (size_t j = i; j != 3; ++j)
+				{
+					ata[i][j] = ata[j][i] = mat[0][i] * mat[0][j] + mat[1][i] * mat[1][j] + mat[2][i] * mat[2][j];
+				}
+			}
+			jacobi(ata, v);
+
+			// b = mat * v has orthogonal columns, ordered by decreasing length
+			matrix_3x3t<Type> b;
+			for (size_t i = 0; i != 3; ++i)
+			{
+				for (size_t j = 0; j != 3; ++j)
+				{
+					b[i][j] = mat[i][0] * v[0][j] + mat[i][1] * v[1][j] + mat[i][2] * v[2][j];
+				}
+			}
+			Type len_sqr[3];
+			for (size_t j = 0; j != 3; ++j)
+			{
+				len_sqr[j] = b[0][j] * b[0][j] + b[1][j] * b[1][j] + b[2][j] * b[2][j];
+			}
+			sort_columns(len_sqr, b, &v);
+
+			// b = u * r by givens qr, r is diagonal up to rounding
+			u = matrix_3x3t<Type>::identity();
+			qr_rotate(b, u, 0, 1);
+			qr_rotate(b, u, 0, 2);
+			qr_rotate(b, u, 1, 2);
+			sigma = vector_3t<Type>(b[0][0], b[1][1], b[2][2]);
+		}
+
+		template<typename Type>
+		void polar_kernel(const matrix_3x3t<Type> &mat, matrix_3x3t<Type> &r, matrix_3x3t<Type> &s)
+		{
+			matrix_3x3t<Type> u, v;
+			vector_3t<Type> sigma;
+			svd_kernel(mat, u, sigma, v);
+
+			// r = u * trans(v), s = v * diag(sigma) * trans(v)
+			for (size_t i = 0; i != 3; ++i)
+			{
+				for (size_t j = 0; j != 3; ++j)
+				{
+					r[i][j] = u[i][0] * v[j][0] + u[i][1] * v[j][1] + u[i][2] * v[j][2];
+				}
+				for (size_t j = i; j != 3; ++j)
+				{
+					s[i][j] = s[j][i] = v[i][0] * sigma.x * v[j][0] + v[i][1] * sigma.y * v[j][1] + v[i][2] * sigma.z * v[j][2];
+				}
+			}
+		}
+
+		template<typename Type>
+		void eig_sym_kernel(const matrix_3x3t<Type> &mat, vector_3t<Type> &values, matrix_3x3t<Type> &vectors)
+		{
+			matrix_3x3t<Type> m = mat;
+			jacobi(m, vectors);
+
+			Type diag[3] = { m[0][0], m[1][1], m[2][2] };
+			sort_columns(diag, vectors, (matrix_3x3t<Type> *)0);
+			values = vector_3t<Type>(diag[0], diag[1], diag[2]);
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// transposition of up to 8 matrices to and from a packet, the missing
+		// lanes are the identity
+		float3x3x8 load_matrices(const float3x3 *src, size_t count)
+		{
+			float3x3x8 result = float3x3x8::identity();
+			for (size_t k = 0; k != count; ++k)
+			{
+				for (size_t i = 0; i != 3; ++i)
+				{
+					for (size_t j = 0; j != 3; ++j)
+					{
+						result[i][j][k] = src[k][i][j];
+					}
+				}
+			}
+			return result;
+		}
+
+		void store_matrices(const float3x3x8 &src, float3x3 *dst, size_t count)
+		{
+			for (size_t k = 0; k != count && dst; ++k)
+			{
+				for (size_t i = 0; i != 3; ++i)
+				{
+					for (size_t j = 0; j != 3; ++j)
+					{
+						dst[k][i][j] = src[i][j][k];
+					}
+				}
+			}
+		}
+
+		void store_vectors(const float3x8 &src, float3 *dst, size_t count)
+		{
+			for (size_t k = 0; k != count && dst; ++k)
+			{
+				dst[k] = float3(src.x[k], src.y[k], src.z[k]);
+			}
+		}
+
+		int num_packets(size_t n)
+		{
+			return static_cast<int>((n + c_packet_width - 1) / c_packet_width);
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// determinant
+	//////////////////////////////////////////////////////////////////////////
+	float det(const float2x2 &mat)
+	{
+		return cross(mat[0], mat[1]);
+	}
+
+	float det(const float3x3 &mat)
+	{
+		return dot(mat[0], cross(mat[1], mat[2]));
+	}
+
+	float det(const float4x4 &mat)
+	{
+		return sub_dets(mat).det();
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// inversion
+	//////////////////////////////////////////////////////////////////////////
+	float2x2 inv(const float2x2 &mat)
+	{
+		float det_r = 1 / det(mat);
+		return float2x2( mat[1][1] * det_r, -mat[0][1] * det_r,
+						-mat[1][0] * det_r,  mat[0][0] * det_r);
+	}
+
+	float3x3 inv(const float3x3 &mat)
+	{
+		// the rows of the cofactor matrix are the columns of the adjugate
+		float3 c0 = cross(mat[1], mat[2]);
+		float3 c1 = cross(mat[2], mat[0]);
+		float3 c2 = cross(mat[0], mat[1]);
+		float det_r = 1 / dot(mat[0], c0);
+
+		return trans(float3x3(c0, c1, c2)) * det_r;
+	}
+
+#if defined(DYE_SIMD_SSE)
+	float4x4 inv(const float4x4 &mat)
+	{
+		// block-wise inversion on the four 2x2 sub-matrices
+		//   mat = | A B |     inv(mat) = 1/|mat| * | X Y |
+		//         | C D |                          | Z W |
+		__m128 r0 = mat[0].simd();
+		__m128 r1 = mat[1].simd();
+		__m128 r2 = mat[2].simd();
+		__m128 r3 = mat[3].simd();
+
+		__m128 A = _mm_movelh_ps(r0, r1);
+		__m128 B = _mm_movehl_ps(r1, r0);
+		__m128 C = _mm_movelh_ps(r2, r3);
+		__m128 D = _mm_movehl_ps(r3, r2);
+
+		// (|A|, |B|, |C|, |D|)
+		__m128 det_sub = _mm_sub_ps(
+			_mm_mul_ps(SSE_SHUFFLE(r0, r2, 0, 2, 0, 2), SSE_SHUFFLE(r1, r3, 1, 3, 1, 3)),
+			_mm_mul_ps(SSE_SHUFFLE(r0, r2, 1, 3, 1, 3), SSE_SHUFFLE(r1, r3, 0, 2, 0, 2)));
+		__m128 det_a = SSE_SWIZZLE(det_sub, 0, 0, 0, 0);
+		__m128 det_b = SSE_SWIZZLE(det_sub, 1, 1, 1, 1);
+		__m128 det_c = SSE_SWIZZLE(det_sub, 2, 2, 2, 2);
+		__m128 det_d = SSE_SWIZZLE(det_sub, 3, 3, 3, 3);
+
+		__m128 d_c = mat2_adj_mul(D, C);
+		__m128 a_b = mat2_adj_mul(A, B);
+
+		// adjugates of the result blocks
+		__m128 X = _mm_sub_ps(_mm_mul_ps(det_d, A), mat2_mul(B, d_c));
+		__m128 W = _mm_sub_ps(_mm_mul_ps(det_a, D), mat2_mul(C, a_b));
+		__m128 Y = _mm_sub_ps(_mm_mul_ps(det_b, C), mat2_mul_adj(D, a_b));
+		__m128 Z = _mm_sub_ps(_mm_mul_ps(det_c, B), mat2_mul_adj(A, d_c));
+
+		// |mat| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+		__m128 tr = _mm_mul_ps(a_b, SSE_SWIZZLE(d_c, 0, 2, 1, 3));
+		tr = _mm_add_ps(tr, SSE_SWIZZLE(tr, 1, 0, 3, 2));
+		tr = _mm_add_ps(tr, SSE_SWIZZLE(tr, 2, 3, 0, 1));
+		__m128 det_m = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c)), tr);
+
+		__m128 det_r = _mm_div_ps(_mm_setr_ps(1, -1, -1, 1), det_m);
+		X = _mm_mul_ps(X, det_r);
+		Y = _mm_mul_ps(Y, det_r);
+		Z = _mm_mul_ps(Z, det_r);
+		W = _mm_mul_ps(W, det_r);
+
+		// the adjugate shuffle and the block interleave in one go
+		float4x4 result;
+		result[0].set_simd(SSE_SHUFFLE(X, Y, 3, 1, 3, 1));
+		result[1].set_simd(SSE_SHUFFLE(X, Y, 2, 0, 2, 0));
+		result[2].set_simd(SSE_SHUFFLE(Z, W, 3, 1, 3, 1));
+		result[3].set_simd(SSE_SHUFFLE(Z, W, 2, 0, 2, 0));
+		return result;
+	}
+
+	float4x4 inv_affine(const float4x4 &mat)
+	{
+		__m128 mask = sse_affine_mask();
+		__m128 r0 = _mm_mul_ps(mat[0].simd(), mask);
+		__m128 r1 = _mm_mul_ps(mat[1].simd(), mask);
+		__m128 r2 = _mm_mul_ps(mat[2].simd(), mask);
+
+		__m128 c0 = sse_cross3(r1, r2);
+		__m128 c1 = sse_cross3(r2, r0);
+		__m128 c2 = sse_cross3(r0, r1);
+		__m128 det_r = _mm_div_ps(_mm_set1_ps(1.0f), sse_dot4(r0, c0));
+
+		c0 = _mm_mul_ps(c0, det_r);
+		c1 = _mm_mul_ps(c1, det_r);
+		c2 = _mm_mul_ps(c2, det_r);
+		__m128 c3 = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+		float4x4 result;
+		result[0].set_simd(c0);
+		result[1].set_simd(c1);
+		result[2].set_simd(c2);
+		result[3].set_simd(sse_inv_translation(mat[3].simd(), c0, c1, c2));
+		return result;
+	}
+
+	float4x4 inv_orthonormal(const float4x4 &mat)
+	{
+		__m128 mask = sse_affine_mask();
+		__m128 r0 = _mm_mul_ps(mat[0].simd(), mask);
+		__m128 r1 = _mm_mul_ps(mat[1].simd(), mask);
+		__m128 r2 = _mm_mul_ps(mat[2].simd(), mask);
+		__m128 r3 = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+		float4x4 result;
+		result[0].set_simd(r0);
+		result[1].set_simd(r1);
+		result[2].set_simd(r2);
+		result[3].set_simd(sse_inv_translation(mat[3].simd(), r0, r1, r2));
+		return result;
+	}
+
+	float3x4 inv(const float3x4 &mat)
+	{
+		// the rows hold the columns of the rotation-scale part, so the
+		// cross products are the rows of its inverse and only the final
+		// transpose differs from inv_affine
+		__m128 mask = sse_affine_mask();
+		__m128 r0 = _mm_mul_ps(mat[0].simd(), mask);
+		__m128 r1 = _mm_mul_ps(mat[1].simd(), mask);
+		__m128 r2 = _mm_mul_ps(mat[2].simd(), mask);
+
+		__m128 c0 = sse_cross3(r1, r2);
+		__m128 c1 = sse_cross3(r2, r0);
+		__m128 c2 = sse_cross3(r0, r1);
+		__m128 det_r = _mm_div_ps(_mm_set1_ps(1.0f), sse_dot4(r0, c0));
+
+		c0 = _mm_mul_ps(c0, det_r);
+		c1 = _mm_mul_ps(c1, det_r);
+		c2 = _mm_mul_ps(c2, det_r);
+
+		// (t0, t1, t2, t2) gathered from the last lane of each row
+		__m128 hi = _mm_unpackhi_ps(mat[0].simd(), mat[1].simd());
+		__m128 t = SSE_SHUFFLE(hi, mat[2].simd(), 2, 3, 3, 3);
+		__m128 c3 = sse_inv_translation(t, c0, c1, c2);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+		float3x4 result;
+		result[0].set_simd(c0);
+		result[1].set_simd(c1);
+		result[2].set_simd(c2);
+		return result;
+	}
+
+	#undef SSE_SWIZZLE
+	#undef SSE_SHUFFLE
+#else
+	float4x4 inv(const float4x4 &mat)
+	{
+		const float4x4 &m = mat;
+		sub_dets sd(mat);
+		const float *s = sd.s;
+		const float *c = sd.c;
+		float det_r = 1 / sd.det();
+
+		return float4x4(
+			( m[1][1] * c[5] - m[1][2] * c[4] + m[1][3] * c[3]) * det_r,
+			(-m[0][1] * c[5] + m[0][2] * c[4] - m[0][3] * c[3]) * det_r,
+			( m[3][1] * s[5] - m[3][2] * s[4] + m[3][3] * s[3]) * det_r,
+			(-m[2][1] * s[5] + m[2][2] * s[4] - m[2][3] * s[3]) * det_r,
+
+			(-m[1][0] * c[5] + m[1][2] * c[2] - m[1][3] * c[1]) * det_r,
+			( m[0][0] * c[5] - m[0][2] * c[2] + m[0][3] * c[1]) * det_r,
+			(-m[3][0] * s[5] + m[3][2] * s[2] - m[3][3] * s[1]) * det_r,
+			( m[2][0] * s[5] - m[2][2] * s[2] + m[2][3] * s[1]) * det_r,
+
+			( m[1][0] * c[4] - m[1][1] * c[2] + m[1][3] * c[0]) * det_r,
+			(-m[0][0] * c[4] + m[0][1] * c[2] - m[0][3] * c[0]) * det_r,
+			( m[3][0] * s[4] - m[3][1] * s[2] + m[3][3] * s[0]) * det_r,
+			(-m[2][0] * s[4] + m[2][1] * s[2] - m[2][3] * s[0]) * det_r,
+
+			(-m[1][0] * c[3] + m[1][1] * c[1] - m[1][2] * c[0]) * det_r,
+			( m[0][0] * c[3] - m[0][1] * c[1] + m[0][2] * c[0]) * det_r,
+			(-m[3][0] * s[3] + m[3][1] * s[1] - m[3][2] * s[0]) * det_r,
+			( m[2][0] * s[3] - m[2][1] * s[1] + m[2][2] * s[0]) * det_r);
+	}
+
+	float4x4 inv_affine(const float4x4 &mat)
+	{
+		float3x3 rs(mat[0].xyz(), mat[1].xyz(), mat[2].xyz());
+		float3x3 rs_inv = inv(rs);
+		float3 t = -mul(mat[3].xyz(), rs_inv);
+
+		return float4x4(
+			rs_inv[0][0], rs_inv[0][1], rs_inv[0][2], 0,
+			rs_inv[1][0], rs_inv[1][1], rs_inv[1][2], 0,
+			rs_inv[2][0], rs_inv[2][1], rs_inv[2][2], 0,
+			t.x, t.y, t.z, 1);
+	}
+
+	float4x4 inv_orthonormal(const float4x4 &mat)
+	{
+		float3 r0 = mat[0].xyz();
+		float3 r1 = mat[1].xyz();
+		float3 r2 = mat[2].xyz();
+		float3 t = mat[3].xyz();
+
+		return float4x4(
+			r0.x, r1.x, r2.x, 0,
+			r0.y, r1.y, r2.y, 0,
+			r0.z, r1.z, r2.z, 0,
+			-dot(t, r0), -dot(t, r1), -dot(t, r2), 1);
+	}
+
+	float3x4 inv(const float3x4 &mat)
+	{
+		float3x3 rs = inv(float3x3(mat[0].xyz(), mat[1].xyz(), mat[2].xyz()));
+		float3 t = -mul(rs, mat.col(3));
+
+		return float3x4(
+			rs[0][0], rs[0][1], rs[0][2], t.x,
+			rs[1][0], rs[1][1], rs[1][2], t.y,
+			rs[2][0], rs[2][1], rs[2][2], t.z);
+	}
+#endif
+
+	void inv(const float4x4 *in, float4x4 *out, size_t n)
+	{
+		// matrices handed to one thread at a time
+		const size_t batch_size = 4096;
+		const batch_kernels &k = kernels();
+		int num_batches = static_cast<int>((n + batch_size - 1) / batch_size);
+
+		#pragma omp parallel for if (num_batches > 1)
+		for (int b = 0; b < num_batches; ++b)
+		{
+			size_t begin = b * batch_size;
+			size_t count = std::min(batch_size, n - begin);
+			k.inverse4x4(in[begin].ptr(), out[begin].ptr(), count);
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// decomposition
+	//////////////////////////////////////////////////////////////////////////
+	void svd(const float3x3 &mat, float3x3 &u, float3 &s, float3x3 &v)
+	{
+		svd_kernel(mat, u, s, v);
+	}
+
+	void polar(const float3x3 &mat, float3x3 &r, float3x3 &s)
+	{
+		polar_kernel(mat, r, s);
+	}
+
+	void eig_sym(const float3x3 &mat, float3 &values, float3x3 &vectors)
+	{
+		eig_sym_kernel(mat, values, vectors);
+	}
+
+	void svd(const float3x3x8 &mat, float3x3x8 &u, float3x8 &s, float3x3x8 &v)
+	{
+		svd_kernel(mat, u, s, v);
+	}
+
+	void polar(const float3x3x8 &mat, float3x3x8 &r, float3x3x8 &s)
+	{
+		polar_kernel(mat, r, s);
+	}
+
+	void eig_sym(const float3x3x8 &mat, float3x8 &values, float3x3x8 &vectors)
+	{
+		eig_sym_kernel(mat, values, vectors);
+	}
+
+	void svd(const float3x3 *mat, float3x3 *u, float3 *s, float3x3 *v, size_t n)
+	{
+		int packets = num_packets(n);
+
+		#pragma omp parallel for if (packets > 512)
+		for (int p = 0; p < packets; ++p)
+		{
+			size_t begin = p * c_packet_width;
+			size_t count = std::min(c_packet_width, n - begin);
+
+			float3x3x8 pu, pv;
+			float3x8 ps;
+			svd(load_matrices(mat + begin, count), pu, ps, pv);
+			store_matrices(pu, u ? u + begin : 0, count);
+			store_vectors(ps, s ? s + begin : 0, count);
+			store_matrices(pv, v ? v + begin : 0, count);
+		}
+	}
+
+	void polar(const float3x3 *mat, float3x3 *r, float3x3 *s, size_t n)
+	{
+		int packets = num_packets(n);
+
+		#pragma omp parallel for if (packets > 512)
+		for (int p = 0; p < packets; ++p)
+		{
+			size_t begin = p * c_packet_width;
+			size_t count = std::min(c_packet_width, n - begin);
+
+			float3x3x8 pr, ps;
+			polar(load_matrices(mat + begin, count), pr, ps);
+			store_matrices(pr, r ? r + begin : 0, count);
+			store_matrices(ps, s ? s + begin : 0, count);
+		}
+	}
+
+	void eig_sym(const float3x3 *mat, float3 *values, float3x3 *vectors, size_t n)
+	{
+		int packets = num_packets(n);
+
+		#pragma omp parallel for if (packets > 512)
+		for (int p = 0; p < packets; ++p)
+		{
+			size_t begin = p * c_packet_width;
+			size_t count = std::min(c_packet_width, n - begin);
 
-}
\ No newline at end of file
+			float3x8 pvalues;
+			float3x3x8 pvectors;
+			eig_sym(load_matrices(mat + begin, count), pvalues, pvectors);
+			store_vectors(pvalues, values ? values + begin : 0, count);
+			store_matrices(pvectors, vectors ? vectors + begin : 0, count);
+		}
+	}
+}
@@ -0,0 +1,553 @@
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <mesh.hpp>
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		namespace
+		{
+			const unsigned int c_invalid = ~0u;
+
+			//////////////////////////////////////////////////////////////////////////
+			// welding
+			//////////////////////////////////////////////////////////////////////////
+			const size_t c_key_size = sizeof(vertex) / sizeof(unsigned int);
+
+			// the bits of the vertex with -0 made 0
+			void vertex_key(const vertex &v, unsigned int *key)
+			{
+				memcpy(key, &v, sizeof(vertex));
+				for (size_t i = 0; i != c_key_size; ++i)
+				{
+					key[i] = key[i] == 0x80000000u ? 0 : key[i];
+				}
+			}
+
+			unsigned int hash_key(const unsigned int *key)
+			{
+				unsigned int h = 0x811c9dc5u;
+				for (size_t i = 0; i != c_key_size; ++i)
+				{
+					h = (h ^ key[i]) * 0x5bd1e995u;
+					h ^= h >> 15;
+				}
+				return h;
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			// forsyth's scoring, with his constants
+			//////////////////////////////////////////////////////////////////////////
+			const int c_forsyth_cache_size = 32;
+			const int c_forsyth_max_valence = 64;
+
+			struct forsyth_scores
+			{
+				float cache[c_forsyth_cache_size];
+				float valence[c_forsyth_max_valence];
+
+				forsyth_scores()
+				{
+					const float c_last_triangle_score = 0.75f;
+					const float c_cache_decay_power = 1.5f;
+					const float c_valence_boost_scale = 2.0f;
+					const float c_valence_boost_power = 0.5f;
+
+					for (int i = 0; i != c_forsyth_cache_size; ++i)
+					{
+						// the last triangle's vertices score the same, so that
+						// its direction does not matter
+						cache[i] = i < 3 ? c_last_triangle_score
+							: std::pow(1 - static_cast<float>(i - 3) / (c_forsyth_cache_size - 3), c_cache_decay_power);
+					}
+					valence[0] = 0;
+					for (int i = 1; i != c_forsyth_max_valence; ++i)
+					{
+						valence[i] = c_valence_boost_scale * std::pow(static_cast<float>(i), -c_valence_boost_power);
+					}
+				}
+
+				// of a vertex with valence triangles left, at position in the cache
+				float operator () (int position, unsigned int remaining) const
+				{
+					if (remaining == 0)
+					{
+						return -1;
+					}
+					float score = position >= 0 ? cache[position] : 0;
+					return score + valence[std::min(remaining, static_cast<unsigned int>(c_forsyth_max_valence - 1))];
+				}
+			};
+
+			// fifo cache by time stamps: a vertex is in it while fewer than
+			// cache_size misses happened since it was loaded
+			class fifo_cache
+			{
+			public:
+				fifo_cache(size_t vertex_count, size_t cache_size)
+					: m_stamps(vertex_count, 0)
+					, m_clock(static_cast<unsigned int>(cache_size) + 1)
+					, m_size(static_cast<unsigned int>(cache_size))
+				{
+				}
+
+				// 1 on a miss
+				unsigned int load(unsigned int v)
+				{
+					if (m_clock - m_stamps[v] > m_size)
+					{
+						m_stamps[v] = m_clock++;
+						return 1;
+					}
+					return 0;
+				}
+
+				void flush()
+				{
+					m_clock += m_size + 1;
+				}
+
+			private:
+				std::vector<unsigned int> m_stamps;
+				unsigned int m_clock;
+				unsigned int m_size;
+			};
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// welding
+		//////////////////////////////////////////////////////////////////////////
+		size_t weld_vertices(const vertex *vertices, size_t vertex_count, unsigned int *remap)
+		{
+			// open addressing at a load below 0.8
+			size_t buckets = 1;
+			while (buckets < vertex_count + vertex_count / 4 + 1)
+			{
+				buckets *= 2;
+			}
+			std::vector<unsigned int> table(buckets, c_invalid);
+
+			unsigned int unique = 0;
+			unsigned int key[c_key_size];
+			unsigned int other[c_key_size];
+			for (size_t i = 0; i != vertex_count; ++i)
+			{
+				vertex_key(vertices[i], key);
+				size_t bucket = hash_key(key) & (buckets - 1);
+				for (;;)
+				{
+					unsigned int first = table[bucket];
+					if (first == c_invalid)
+					{
+						table[bucket] = static_cast<unsigned int>(i);
+						remap[i] = unique++;
+						break;
+					}
+
+					vertex_key(vertices[first], other);
+					if (memcmp(key, other, sizeof(key)) == 0)
+					{
+						remap[i] = remap[first];
+						break;
+					}
+					bucket = (bucket + 1) & (buckets - 1);
+				}
+			}
+			return unique;
+		}
+
+		void remap_vertices(const vertex *vertices, size_t vertex_count, const unsigned int *remap, vertex *out)
+		{
+			// remap[i] <= i, so this works in place
+			for (size_t i = 0; i != vertex_count; ++i)
+			{
+				out[remap[i]] = vertices[i];
+			}
+		}
+
+		void remap_indices(unsigned int *indices, size_t index_count, const unsigned int *remap)
+		{
+			for (size_t i = 0; i != index_count; ++i)
+			{
+				indices[i] = remap[indices[i]];
+			}
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// reordering
+		//////////////////////////////////////////////////////////////////////////
+		void optimize_vertex_cache(const unsigned int *indices, size_t index_count, size_t vertex_count, unsigned int *out)
+		{
+			static const forsyth_scores score;
+
+			const size_t triangle_count = index_count / 3;
+			if (triangle_count == 0)
+			{
+				return;
+			}
+
+			// the triangles of each vertex; the first remaining[v] are not
+			// drawn yet
+			std::vector<unsigned int> remaining(vertex_count, 0);
+			for (size_t i = 0; i != triangle_count * 3; ++i)
+			{
+				++remaining[indices[i]];
+			}
+			std::vector<unsigned int> offsets(vertex_count + 1, 0);
+			for (size_t v = 0; v != vertex_count; ++v)
+			{
+				offsets[v + 1] = offsets[v] + remaining[v];
+			}
+			std::vector<unsigned int> adjacency(triangle_count * 3);
+			{
+				std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+				for (size_t i = 0; i != triangle_count * 3; ++i)
+				{
+					adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+				}
+			}
+
+			std::vector<int> position(vertex_count, -1);
+			std::vector<float> vertex_score(vertex_count);
+			for (size_t v = 0; v != vertex_count; ++v)
+			{
+				vertex_score[v] = score(-1, remaining[v]);
+			}
+
+			std::vector<float> triangle_score(triangle_count);
+			std::vector<char> drawn(triangle_count, 0);
+			unsigned int best = 0;
+			for (size_t t = 0; t != triangle_count; ++t)
+			{
+				const unsigned int *tri = indices + t * 3;
+				triangle_score[t] = vertex_score[tri[0]] + vertex_score[tri[1]] + vertex_score[tri[2]];
+				best = triangle_score[t] > triangle_score[best] ? static_cast<unsigned int>(t) : best;
+			}
+
+			// room for the triangle in front of the cache
+			unsigned int cache[c_forsyth_cache_size + 3];
+			unsigned int next_cache[c_forsyth_cache_size + 3];
+			int cache_count = 0;
+			size_t cursor = 0;
+
+			for (size_t emitted = 0; emitted != triangle_count; ++emitted)
+			{
+				if (best == c_invalid)
+				{
+					// nothing in the cache has triangles left: the next undrawn one
+					while (drawn[cursor])
+					{
+						++cursor;
+					}
+					best = static_cast<unsigned int>(cursor);
+				}
+
+				const unsigned int *tri = indices + best * 3;
+				out[emitted * 3 + 0] = tri[0];
+				out[emitted * 3 + 1] = tri[1];
+				out[emitted * 3 + 2] = tri[2];
+				drawn[best] = 1;
+
+				// the triangle leaves the lists of its vertices
+				int next_count = 0;
+				for (int k = 0; k != 3; ++k)
+				{
+					unsigned int v = tri[k];
+					unsigned int *list = &adjacency[offsets[v]];
+					unsigned int *last = list + remaining[v] - 1;
+					*std::find(list, last, best) = *last;
+					--remaining[v];
+
+					if (std::find(next_cache, next_cache + next_count, v) == next_cache + next_count)
+					{
+						next_cache[next_count++] = v;
+					}
+				}
+				const int front = next_count;
+				for (int i = 0; i != cache_count; ++i)
+				{
+					if (std::find(next_cache, next_cache + front, cache[i]) == next_cache + front)
+					{
+						next_cache[next_count++] = cache[i];
+					}
+				}
+
+				// the ones pushed out score without the cache
+				for (int i = c_forsyth_cache_size; i < next_count; ++i)
+				{
+					unsigned int v = next_cache[i];
+					position[v] = -1;
+					vertex_score[v] = score(-1, remaining[v]);
+				}
+				cache_count = std::min(next_count, c_forsyth_cache_size);
+				std::copy(next_cache, next_cache + cache_count, cache);
+
+				for (int i = 0; i != cache_count; ++i)
+				{
+					unsigned int v = cache[i];
+					position[v] = i;
+					vertex_score[v] = score(i, remaining[v]);
+				}
+
+				// the triangles around the cache are rescored, the best is next
+				best = c_invalid;
+				float best_score = -1;
+				for (int i = 0; i != next_count; ++i)
+				{
+					unsigned int v = next_cache[i];
+					const unsigned int *list = &adjacency[offsets[v]];
+					for (unsigned int j = 0; j != remaining[v]; ++j)
+					{
+						unsigned int t = list[j];
+						const unsigned int *other = indices + t * 3;
+						float s = vertex_score[other[0]] + vertex_score[other[1]] + vertex_score[other[2]];
+						triangle_score[t] = s;
+						if (s > best_score)
+						{
+							best_score = s;
+							best = t;
+						}
+					}
+				}
+			}
+		}
+
+		void optimize_overdraw(const unsigned int *indices, size_t index_count,
+			const vertex *vertices, size_t vertex_count, unsigned int *out, float threshold)
+		{
+			const size_t triangle_count = index_count / 3;
+			if (triangle_count == 0)
+			{
+				return;
+			}
+
+			float acmr = compute_acmr(indices, index_count, vertex_count);
+
+			// clusters start at the flushes of the cache, where a triangle
+			// misses all its vertices, and where the cluster so far is good
+			// enough to pay for one
+			std::vector<size_t> starts(1, 0);
+			{
+				fifo_cache cache(vertex_count, c_vertex_cache_size);
+				unsigned int misses = 0;
+				size_t count = 0;
+				for (size_t t = 0; t != triangle_count; ++t)
+				{
+					const unsigned int *tri = indices + t * 3;
+					if (count && misses <= threshold * acmr * count)
+					{
+						cache.flush();
+						starts.push_back(t);
+						misses = 0;
+						count = 0;
+					}
+
+					unsigned int m = cache.load(tri[0]) + cache.load(tri[1]) + cache.load(tri[2]);
+					if (count && m == 3)
+					{
+						starts.push_back(t);
+						misses = 0;
+						count = 0;
+					}
+					misses += m;
+					++count;
+				}
+			}
+			starts.push_back(triangle_count);
+
+			// the area weighted centroids and normals of the clusters; drawing
+			// the ones that face away from the center of the mesh first makes
+			// them occlude the rest
+			const size_t cluster_count = starts.size() - 1;
+			std::vector<float3> centroids(cluster_count, float3(0, 0, 0));
+			std::vector<float3> normals(cluster_count, float3(0, 0, 0));
+			std::vector<float> areas(cluster_count, 0.0f);
+			float3 center(0, 0, 0);
+			float total_area = 0;
+			for (size_t c = 0; c != cluster_count; ++c)
+			{
+				for (size_t t = starts[c]; t != starts[c + 1]; ++t)
+				{
+					const unsigned int *tri = indices + t * 3;
+					const float3 &p0 = vertices[tri[0]].pos;
+					const float3 &p1 = vertices[tri[1]].pos;
+					const float3 &p2 = vertices[tri[2]].pos;
+					float3 e1 = p1 - p0;
+					float3 e2 = p2 - p0;
+					float3 n = cross(e1, e2);
+					float area = std::sqrt(dot(n, n));
+					float3 sum = p0 + p1 + p2;
+					centroids[c] += sum * (area / 3);
+					normals[c] += n;
+					areas[c] += area;
+				}
+				center += centroids[c];
+				total_area += areas[c];
+			}
+			if (total_area > 0)
+			{
+				center *= 1 / total_area;
+			}
+
+			std::vector<std::pair<float, size_t> > order(cluster_count);
+			for (size_t c = 0; c != cluster_count; ++c)
+			{
+				float3 centroid = areas[c] > 0 ? centroids[c] * (1 / areas[c]) : centroids[c];
+				float3 offset = centroid - center;
+				order[c] = std::make_pair(-dot(offset, normals[c]), c);
+			}
+			std::stable_sort(order.begin(), order.end());
+
+			unsigned int *dest = out;
+			for (size_t i = 0; i != cluster_count; ++i)
+			{
+				size_t c = order[i].second;
+				dest = std::copy(indices + starts[c] * 3, indices + starts[c + 1] * 3, dest);
+			}
+		}
+
+		size_t optimize_vertex_fetch(unsigned int *indices, size_t index_count,
+			const vertex *vertices, size_t vertex_count, vertex *out)
+		{
+			std::vector<unsigned int> remap(vertex_count, c_invalid);
+			unsigned int next = 0;
+			for (size_t i = 0; i != index_count; ++i)
+			{
+				unsigned int &r = remap[indices[i]];
+				if (r == c_invalid)
+				{
+					out[next] = vertices[indices[i]];
+					r = next++;
+				}
+				indices[i] = r;
+			}
+			return next;
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// statistics
+		//////////////////////////////////////////////////////////////////////////
+		float compute_acmr(const unsigned int *indices, size_t index_count, size_t vertex_count, size_t cache_size)
+		{
+			const size_t triangle_count = index_count / 3;
+			if (triangle_count == 0)
+			{
+				return 0;
+			}
+
+			fifo_cache cache(vertex_count, cache_size);
+			size_t misses = 0;
+			for (size_t i = 0; i != triangle_count * 3; ++i)
+			{
+				misses += cache.load(indices[i]);
+			}
+			return static_cast<float>(misses) / triangle_count;
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// mesh
+		//////////////////////////////////////////////////////////////////////////
+		Mesh::Mesh()
+		{
+		}
+
+		Mesh::Mesh(const vertex *vertices, size_t vertex_count, const unsigned int *indices, size_t index_count)
+		{
+			assign(vertices, vertex_count, indices, index_count);
+		}
+
+		Mesh::Mesh(const IMeshable &source)
+		{
+			assign(source);
+		}
+
+		void Mesh::assign(const vertex *vertices, size_t vertex_count, const unsigned int *indices, size_t index_count)
+		{
+			m_vertices.assign(vertices, vertices + vertex_count);
+			set_indices(indices, index_count);
+		}
+
+		void Mesh::assign(const IMeshable &source)
+		{
+			std::vector<unsigned int> indices(source.triangle_count() * 3);
+			m_vertices.resize(source.vertex_count());
+			if (!m_vertices.empty())
+			{
+				source.get_vertices(0, m_vertices.size(), &m_vertices[0]);
+			}
+			if (!indices.empty())
+			{
+				source.get_triangles(0, source.triangle_count(), &indices[0]);
+			}
+			set_indices(indices.empty() ? 0 : &indices[0], indices.size());
+		}
+
+		mesh_report Mesh::optimize(float overdraw_threshold)
+		{
+			std::vector<unsigned int> indices(index_count());
+			if (!indices.empty())
+			{
+				get_triangles(0, triangle_count(), &indices[0]);
+			}
+
+			mesh_report report;
+			report.vertices_before = m_vertices.size();
+			report.acmr_before = compute_acmr(indices.empty() ? 0 : &indices[0], indices.size(), m_vertices.size());
+
+			if (!indices.empty())
+			{
+				std::vector<unsigned int> remap(m_vertices.size());
+				size_t unique = weld_vertices(&m_vertices[0], m_vertices.size(), &remap[0]);
+				remap_vertices(&m_vertices[0], m_vertices.size(), &remap[0], &m_vertices[0]);
+				m_vertices.resize(unique);
+				remap_indices(&indices[0], indices.size(), &remap[0]);
+
+				std::vector<unsigned int> ordered(indices.size());
+				optimize_vertex_cache(&indices[0], indices.size(), unique, &ordered[0]);
+				optimize_overdraw(&ordered[0], ordered.size(), &m_vertices[0], unique, &indices[0], overdraw_threshold);
+
+				std::vector<vertex> fetched(unique);
+				fetched.resize(optimize_vertex_fetch(&indices[0], indices.size(), &m_vertices[0], unique, &fetched[0]));
+				m_vertices.swap(fetched);
+				set_indices(&indices[0], indices.size());
+			}
+
+			report.vertices_after = m_vertices.size();
+			report.acmr_after = compute_acmr(indices.empty() ? 0 : &indices[0], indices.size(), m_vertices.size());
+			return report;
+		}
+
+		void Mesh::get_vertices(size_t first, size_t count, vertex *out) const
+		{
+			std::copy(m_vertices.begin() + first, m_vertices.begin() + first + count, out);
+		}
+
+		void Mesh::get_triangles(size_t first, size_t count, unsigned int *out) const
+		{
+			if (wide_indices())
+			{
+				std::copy(m_indices32.begin() + first * 3, m_indices32.begin() + (first + count) * 3, out);
+			}
+			else
+			{
+				std::copy(m_indices16.begin() + first * 3, m_indices16.begin() + (first + count) * 3, out);
+			}
+		}
+
+		void Mesh::set_indices(const unsigned int *indices, size_t index_count)
+		{
+			m_indices16.clear();
+			m_indices32.clear();
+			if (m_vertices.size() <= 65536)
+			{
+				m_indices16.assign(indices, indices + index_count);
+			}
+			else
+			{
+				m_indices32.assign(indices, indices + index_count);
+			}
+		}
+	}
+}
@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <string.h>
+#include <boost/static_assert.hpp>
+#include <mesh_file.hpp>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		BOOST_STATIC_ASSERT(sizeof(mesh_file_header) <= c_mesh_file_header_size);
+		BOOST_STATIC_ASSERT(sizeof(mesh_lod) == 16);
+
+		namespace
+		{
+			const char c_magic[4] = { 'D', 'Y', 'E', 'M' };
+			const unsigned int c_byte_order = 0x01020304;
+
+			unsigned long long align(unsigned long long offset)
+			{
+				return (offset + c_mesh_file_alignment - 1) / c_mesh_file_alignment * c_mesh_file_alignment;
+			}
+
+			// in the file and aligned
+			bool section_valid(unsigned long long offset, unsigned long long count, size_t element_size, unsigned long long file_size)
+			{
+				if (count == 0)
+				{
+					return true;
+				}
+				return offset % c_mesh_file_alignment == 0
+					&& offset >= c_mesh_file_header_size
+					&& offset <= file_size
+					&& count <= (file_size - offset) / element_size;
+			}
+
+			mesh_file_status check_header(const mesh_file_header &header, size_t size)
+			{
+				if (memcmp(header.magic, c_magic, sizeof(c_magic)) != 0 || header.byte_order != c_byte_order)
+				{
+					return mesh_file_bad_format;
+				}
+				if (header.version != c_mesh_file_version
+					|| header.header_size != c_mesh_file_header_size
+					|| header.vertex_size != sizeof(vertex))
+				{
+					return mesh_file_bad_version;
+				}
+				if (header.file_size > size
+					|| !section_valid(header.vertex_offset, header.vertex_count, sizeof(vertex), header.file_size)
+					|| !section_valid(header.index_offset, header.index_count, sizeof(unsigned int), header.file_size)
+					|| !section_valid(header.lod_offset, header.lod_count, sizeof(mesh_lod), header.file_size))
+				{
+					return mesh_file_truncated;
+				}
+				return mesh_file_ok;
+			}
+
+			// zero padded from position up to offset
+			bool write_section(FILE *file, unsigned long long &position, unsigned long long offset, const void *data, size_t size)
+			{
+				static const char zeros[c_mesh_file_alignment] = {};
+
+				size_t padding = static_cast<size_t>(offset - position);
+				position = offset + size;
+				return fwrite(zeros, 1, padding, file) == padding
+					&& (size == 0 || fwrite(data, 1, size, file) == size);
+			}
+		}
+
+		const char *mesh_file_status_name(mesh_file_status status)
+		{
+			switch (status)
+			{
+			case mesh_file_ok:				return "ok";
+			case mesh_file_cannot_open:		return "cannot open";
+			case mesh_file_bad_format:		return "bad format";
+			case mesh_file_bad_version:		return "bad version";
+			case mesh_file_truncated:		return "truncated";
+			case mesh_file_cannot_write:	return "cannot write";
+			}
+			return "unknown";
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// writing
+		//////////////////////////////////////////////////////////////////////////
+		mesh_file_status write_mesh_file(const char *path,
+			const vertex *vertices, size_t vertex_count,
+			const unsigned int *indices, size_t index_count,
+			const mesh_lod *lods, size_t lod_count)
+		{
+			mesh_file_header header;
+			memset(&header, 0, sizeof(header));
+			memcpy(header.magic, c_magic, sizeof(c_magic));
+			header.version = c_mesh_file_version;
+			header.byte_order = c_byte_order;
+			header.header_size = c_mesh_file_header_size;
+
+			header.vertex_size = sizeof(vertex);
+			header.vertex_count = static_cast<unsigned int>(vertex_count);
+			header.vertex_offset = c_mesh_file_header_size;
+
+			header.index_count = static_cast<unsigned int>(index_count);
+			header.index_offset = align(header.vertex_offset + vertex_count * sizeof(vertex));
+
+			header.lod_count = static_cast<unsigned int>(lod_count);
+			header.lod_offset = align(header.index_offset + index_count * sizeof(unsigned int));
+			header.file_size = header.lod_offset + lod_count * sizeof(mesh_lod);
+
+			vertex_bounds bounds = compute_bounds(vertices, vertex_count);
+			const float lower[3] = { bounds.lower.x, bounds.lower.y, bounds.lower.z };
+			const float upper[3] = { bounds.upper.x, bounds.upper.y, bounds.upper.z };
+			memcpy(header.bounds_lower, lower, sizeof(lower));
+			memcpy(header.bounds_upper, upper, sizeof(upper));
+
+			FILE *file = fopen(path, "wb");
+			if (!file)
+			{
+				return mesh_file_cannot_write;
+			}
+
+			char header_block[c_mesh_file_header_size] = {};
+			memcpy(header_block, &header, sizeof(header));
+
+			unsigned long long position = 0;
+			bool written = write_section(file, position, 0, header_block, sizeof(header_block))
+				&& write_section(file, position, header.vertex_offset, vertices, vertex_count * sizeof(vertex))
+				&& write_section(file, position, header.index_offset, indices, index_count * sizeof(unsigned int))
+				&& write_section(file, position, header.lod_offset, lods, lod_count * sizeof(mesh_lod));
+
+			written &= fclose(file) == 0;
+			return written ? mesh_file_ok : mesh_file_cannot_write;
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// mapped file
+		//////////////////////////////////////////////////////////////////////////
+		MeshFile::MeshFile()
+			: m_base(0)
+			, m_size(0)
+			, m_header(0)
+		{
+		}
+
+		MeshFile::~MeshFile()
+		{
+			close();
+		}
+
+		mesh_file_status MeshFile::open(const char *path)
+		{
+			close();
+
+#if defined(_WIN32)
+			// the view keeps the mapping alive, the handles are not needed
+			HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				return mesh_file_cannot_open;
+			}
+
+			LARGE_INTEGER size;
+			size.QuadPart = 0;
+			HANDLE mapping = 0;
+			if (GetFileSizeEx(file, &size) && size.QuadPart >= static_cast<LONGLONG>(c_mesh_file_header_size))
+			{
+				mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+			}
+			CloseHandle(file);
+			if (!mapping)
+			{
+				return size.QuadPart < static_cast<LONGLONG>(c_mesh_file_header_size) ? mesh_file_truncated : mesh_file_cannot_open;
+			}
+
+			void *base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+			if (!base)
+			{
+				return mesh_file_cannot_open;
+			}
+			m_size = static_cast<size_t>(size.QuadPart);
+#else
+			int file = ::open(path, O_RDONLY);
+			if (file < 0)
+			{
+				return mesh_file_cannot_open;
+			}
+
+			struct stat info;
+			if (fstat(file, &info) != 0 || info.st_size < static_cast<off_t>(c_mesh_file_header_size))
+			{
+				::close(file);
+				return mesh_file_truncated;
+			}
+
+			void *base = mmap(0, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			::close(file);
+			if (base == MAP_FAILED)
+			{
+				return mesh_file_cannot_open;
+			}
+			m_size = static_cast<size_t>(info.st_size);
+#endif
+
+			m_base = static_cast<const char *>(base);
+			mesh_file_status status = check_header(*reinterpret_cast<const mesh_file_header *>(m_base), m_size);
+			if (status != mesh_file_ok)
+			{
+				close();
+				return status;
+			}
+
+			m_header = reinterpret_cast<const mesh_file_header *>(m_base);
+			return mesh_file_ok;
+		}
+
+		void MeshFile::close()
+		{
+			if (m_base)
+			{
+#if defined(_WIN32)
+				UnmapViewOfFile(m_base);
+#else
+				munmap(const_cast<char *>(m_base), m_size);
+#endif
+			}
+			m_base = 0;
+			m_size = 0;
+			m_header = 0;
+		}
+
+		const vertex *MeshFile::vertices() const
+		{
+			return m_header && m_header->vertex_count ? reinterpret_cast<const vertex *>(m_base + m_header->vertex_offset) : 0;
+		}
+
+		const unsigned int *MeshFile::indices() const
+		{
+			return m_header && m_header->index_count ? reinterpret_cast<const unsigned int *>(m_base + m_header->index_offset) : 0;
+		}
+
+		const mesh_lod *MeshFile::lods() const
+		{
+			return m_header && m_header->lod_count ? reinterpret_cast<const mesh_lod *>(m_base + m_header->lod_offset) : 0;
+		}
+
+		vertex_bounds MeshFile::bounds() const
+		{
+			vertex_bounds bounds;
+			bounds.lower = bounds.upper = float3(0, 0, 0);
+			if (m_header)
+			{
+				bounds.lower = float3(m_header->bounds_lower[0], m_header->bounds_lower[1], m_header->bounds_lower[2]);
+				bounds.upper = float3(m_header->bounds_upper[0], m_header->bounds_upper[1], m_header->bounds_upper[2]);
+			}
+			return bounds;
+		}
+	}
+}
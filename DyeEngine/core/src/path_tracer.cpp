@@ -0,0 +1,343 @@
+#include <float.h>
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+#include <path_tracer.hpp>
+
+namespace Dye
+{
+	namespace Render
+	{
+		using namespace Graphics;
+
+		namespace
+		{
+			const float c_pi = 3.14159265f;
+
+			// secondary rays start that far off the surface, relative to the
+			// extent of the scene
+			const float c_relative_epsilon = 1e-5f;
+
+			// the pairs of sobol dimensions: the pixel position, then per
+			// bounce the emitter and the roulette, the point on the emitter
+			// and the direction of the bounce
+			const unsigned int c_pixel_pair = 0;
+			const unsigned int c_pairs_per_bounce = 3;
+
+			float max_component(const float3 &v)
+			{
+				return std::max(std::max(v.x, v.y), v.z);
+			}
+
+			// an orthonormal basis around a unit normal (duff et al.,
+			// "building an orthonormal basis, revisited")
+			void basis(const float3 &n, float3 &t, float3 &b)
+			{
+				const float sign = n.z >= 0 ? 1.0f : -1.0f;
+				const float a = -1 / (sign + n.z);
+				const float c = n.x * n.y * a;
+				t = float3(1 + sign * n.x * n.x * a, sign * c, -sign * n.x);
+				b = float3(c, sign + n.y * n.y * a, -n.y);
+			}
+
+			// the random numbers of one pixel in one pass
+			class pixel_sampler
+			{
+			public:
+				pixel_sampler(size_t pixel, unsigned int pass)
+					: m_seed(hash_u32(static_cast<unsigned int>(pixel) ^ 0x2c1b3c6du)), m_pass(pass)
+				{
+				}
+
+				void get(unsigned int pair, float &u, float &v) const
+				{
+					sobol_2d(m_pass, hash_u32(m_seed + pair * 0x9e3779b9u), u, v);
+				}
+
+			private:
+				unsigned int m_seed;
+				unsigned int m_pass;
+			};
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// scene
+		//////////////////////////////////////////////////////////////////////////
+		PathScene::PathScene()
+			: m_sky(0, 0, 0), m_epsilon(0)
+		{
+		}
+
+		void PathScene::build(const vertex *vertices, size_t vertex_count, const unsigned int *indices,
+			size_t index_count, const unsigned int *triangle_materials, const material *materials,
+			size_t material_count, bvh_build method)
+		{
+			const size_t n = index_count / 3;
+			m_bvh.build(vertices, vertex_count, indices, index_count, method);
+			m_materials.assign(materials, materials + material_count);
+			m_triangle_materials.assign(triangle_materials, triangle_materials + n);
+			m_positions.resize(n * 3);
+			for (size_t i = 0; i != n * 3; ++i)
+			{
+				m_positions[i] = vertices[indices[i]].pos;
+			}
+
+			// the power of a triangle is its area times the brightest
+			// channel of its emission
+			m_emitters.clear();
+			m_emitter_cdf.clear();
+			float total = 0;
+			for (size_t t = 0; t != n; ++t)
+			{
+				const float power = max_component(triangle_material(t).emission);
+				if (power > 0)
+				{
+					const float3 e1 = m_positions[t * 3 + 1] - m_positions[t * 3];
+					const float3 e2 = m_positions[t * 3 + 2] - m_positions[t * 3];
+					const float area = 0.5f * cross(e1, e2).length();
+					if (area > 0)
+					{
+						total += power * area;
+						m_emitters.push_back(static_cast<unsigned int>(t));
+						m_emitter_cdf.push_back(total);
+					}
+				}
+			}
+			for (size_t i = 0; i != m_emitter_cdf.size(); ++i)
+			{
+				m_emitter_cdf[i] /= total;
+			}
+
+			m_epsilon = 0;
+			if (n != 0)
+			{
+				const aabb box = m_bvh.bounds();
+				const float3 extent = box.upper - box.lower;
+				m_epsilon = c_relative_epsilon * max_component(extent);
+			}
+		}
+
+		size_t PathScene::pick_emitter(float u, float &probability) const
+		{
+			size_t i = std::upper_bound(m_emitter_cdf.begin(), m_emitter_cdf.end(), u) - m_emitter_cdf.begin();
+			i = std::min(i, m_emitter_cdf.size() - 1);
+			probability = m_emitter_cdf[i] - (i == 0 ? 0 : m_emitter_cdf[i - 1]);
+			return m_emitters[i];
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// tracer
+		//////////////////////////////////////////////////////////////////////////
+		PathTracer::PathTracer(const PathScene &scene, size_t width, size_t height)
+			: m_scene(&scene), m_width(width), m_height(height), m_sum(width * height * 3), m_passes(0)
+		{
+			camera view;
+			view.eye = float3(0, 0, -1);
+			view.target = float3(0, 0, 0);
+			view.up = float3(0, 1, 0);
+			view.fov = c_pi / 3;
+			set_camera(view);
+		}
+
+		void PathTracer::set_camera(const camera &view)
+		{
+			m_camera = view;
+			m_frame = make_frame(view, m_width, m_height);
+			reset();
+		}
+
+		void PathTracer::set_settings(const path_settings &settings)
+		{
+			m_settings = settings;
+			reset();
+		}
+
+		void PathTracer::reset()
+		{
+			std::fill(m_sum.begin(), m_sum.end(), 0.0f);
+			m_passes = 0;
+		}
+
+		path_stats PathTracer::render_pass()
+		{
+			const size_t columns = (m_width + c_tile_size - 1) / c_tile_size;
+			const size_t rows = (m_height + c_tile_size - 1) / c_tile_size;
+			const int tiles = static_cast<int>(columns * rows);
+
+			path_stats stats = { 0, 0, 0 };
+			size_t samples = 0;
+			size_t rays = 0;
+			const double start = omp_get_wtime();
+
+			// the tiles differ in cost, so they go to whichever thread is free
+			#pragma omp parallel for schedule(dynamic, 1) reduction(+ : samples, rays)
+			for (int tile = 0; tile < tiles; ++tile)
+			{
+				path_stats own = { 0, 0, 0 };
+				render_tile(tile, own);
+				samples += own.samples;
+				rays += own.rays;
+			}
+
+			++m_passes;
+			stats.samples = samples;
+			stats.rays = rays;
+			stats.seconds = omp_get_wtime() - start;
+			return stats;
+		}
+
+		void PathTracer::resolve(float *rgb) const
+		{
+			const float scale = m_passes == 0 ? 0 : 1.0f / m_passes;
+			for (size_t i = 0; i != m_sum.size(); ++i)
+			{
+				rgb[i] = m_sum[i] * scale;
+			}
+		}
+
+		void PathTracer::render_tile(size_t tile, path_stats &stats)
+		{
+			const size_t columns = (m_width + c_tile_size - 1) / c_tile_size;
+			const size_t x0 = tile % columns * c_tile_size;
+			const size_t y0 = tile / columns * c_tile_size;
+			const size_t x1 = std::min(x0 + c_tile_size, m_width);
+			const size_t y1 = std::min(y0 + c_tile_size, m_height);
+			for (size_t y = y0; y != y1; ++y)
+			{
+				for (size_t x = x0; x != x1; ++x)
+				{
+					const size_t pixel = y * m_width + x;
+					const float3 radiance = trace_path(pixel, static_cast<float>(x), static_cast<float>(y), stats);
+					m_sum[pixel * 3] += radiance.x;
+					m_sum[pixel * 3 + 1] += radiance.y;
+					m_sum[pixel * 3 + 2] += radiance.z;
+					++stats.samples;
+				}
+			}
+		}
+
+		float3 PathTracer::trace_path(size_t pixel, float x, float y, path_stats &stats) const
+		{
+			const PathScene &scene = *m_scene;
+			const Bvh &bvh = scene.bvh();
+			const pixel_sampler sampler(pixel, m_passes);
+			const float epsilon = scene.epsilon();
+
+			float jx, jy;
+			sampler.get(c_pixel_pair, jx, jy);
+			const float sx = (x + jx) / m_width * 2 - 1;
+			const float sy = (y + jy) / m_height * 2 - 1;
+			const float3 direction = m_frame.forward + m_frame.right * sx + m_frame.down * sy;
+
+			ray r = { m_camera.eye, 0, direction, FLT_MAX };
+			float3 radiance(0, 0, 0);
+			float3 throughput(1, 1, 1);
+			for (int depth = 0; ; ++depth)
+			{
+				hit h;
+				++stats.rays;
+				if (!bvh.intersect(r, h))
+				{
+					radiance += throughput * scene.sky();
+					break;
+				}
+
+				// emitters reached by a bounce were counted by the light
+				// sample before it
+				const material &surface = scene.triangle_material(h.triangle);
+				if (depth == 0)
+				{
+					radiance += throughput * surface.emission;
+				}
+				if (depth == m_settings.max_depth)
+				{
+					break;
+				}
+
+				// the normal on the side the ray came from
+				const float3 &p0 = scene.position(h.triangle, 0);
+				const float3 e1 = scene.position(h.triangle, 1) - p0;
+				const float3 e2 = scene.position(h.triangle, 2) - p0;
+				float3 normal = normalize(cross(e1, e2));
+				if (dot(normal, r.direction) > 0)
+				{
+					normal = -normal;
+				}
+				const float3 point = r.origin + r.direction * h.t;
+				const float3 origin = point + normal * epsilon;
+				const float3 brdf = surface.albedo * (1 / c_pi);
+
+				const unsigned int pair = c_pixel_pair + 1 + depth * c_pairs_per_bounce;
+				float u_emitter, u_roulette;
+				sampler.get(pair, u_emitter, u_roulette);
+
+				// next event estimation, a point on an emitter picked by its
+				// power, uniform in its area
+				if (scene.emitter_count() != 0)
+				{
+					float probability;
+					const size_t emitter = scene.pick_emitter(u_emitter, probability);
+					float a, b;
+					sampler.get(pair + 1, a, b);
+					const float root = std::sqrt(a);
+					const float3 &q0 = scene.position(emitter, 0);
+					const float3 f1 = scene.position(emitter, 1) - q0;
+					const float3 f2 = scene.position(emitter, 2) - q0;
+					const float3 target = q0 + f1 * (root * (1 - b)) + f2 * (root * b);
+					const float3 area_normal = cross(f1, f2);
+
+					const float3 to = target - origin;
+					const float distance2 = dot(to, to);
+					const float cos_surface = dot(normal, to);
+					const float cos_emitter = std::abs(dot(area_normal, to));
+					if (cos_surface > 0 && cos_emitter > 0)
+					{
+						// the cosines over the squared distance, all of to and
+						// area_normal unnormalized, times the area over the
+						// probability of the pick: half the area normal's
+						// length cancels
+						const float geometry = cos_surface * cos_emitter * 0.5f / (distance2 * distance2 * probability);
+						const ray shadow = { origin, 0, to, 1 - 1e-4f };
+						++stats.rays;
+						if (!bvh.occluded(shadow))
+						{
+							const float3 light = brdf * scene.triangle_material(emitter).emission;
+							radiance += throughput * light * geometry;
+						}
+					}
+				}
+
+				// the cosine weighted bounce carries albedo, as the cosine and
+				// pi cancel against its density
+				throughput *= surface.albedo;
+				if (depth >= m_settings.roulette_depth)
+				{
+					const float survival = std::min(max_component(throughput), 0.95f);
+					if (u_roulette >= survival)
+					{
+						break;
+					}
+					throughput *= 1 / survival;
+				}
+				else if (max_component(throughput) <= 0)
+				{
+					break;
+				}
+
+				float a, b;
+				sampler.get(pair + 2, a, b);
+				const float radius = std::sqrt(a);
+				const float phi = 2 * c_pi * b;
+				float3 tangent, bitangent;
+				basis(normal, tangent, bitangent);
+				const float3 bounce = tangent * (radius * std::cos(phi)) + bitangent * (radius * std::sin(phi))
+					+ normal * std::sqrt(std::max(0.0f, 1 - a));
+				r.origin = origin;
+				r.tmin = 0;
+				r.direction = bounce;
+				r.tmax = FLT_MAX;
+			}
+			return radiance;
+		}
+	}
+}
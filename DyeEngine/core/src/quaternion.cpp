@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <quaternion.hpp>
+
+namespace Dye
+{
+	namespace
+	{
+		struct nlerp_op
+		{
+			quatx8 operator () (const quatx8 &from, const quatx8 &to, const float8 &t) const
+			{
+				return nlerp(from, to, t);
+			}
+		};
+
+		struct slerp_op
+		{
+			quatx8 operator () (const quatx8 &from, const quatx8 &to, const float8 &t) const
+			{
+				return slerp(from, to, t);
+			}
+		};
+
+		// up to 8 quaternions into one packet, the missing lanes are identity
+		quatx8 load_quats(const quat *src, size_t count)
+		{
+			quatx8 result;
+			for (size_t i = 0; i != count; ++i)
+			{
+				result.x[i] = src[i].x;
+				result.y[i] = src[i].y;
+				result.z[i] = src[i].z;
+				result.w[i] = src[i].w;
+			}
+			return result;
+		}
+
+		void store_quats(const quatx8 &src, quat *dst, size_t count)
+		{
+			for (size_t i = 0; i != count; ++i)
+			{
+				dst[i] = quat(src.x[i], src.y[i], src.z[i], src.w[i]);
+			}
+		}
+
+		// t is read with the given stride, 0 repeats the first weight
+		template<typename Lerp>
+		void blend(const Lerp &lerp, const quat *from, const quat *to,
+			const float *t, size_t t_stride, quat *out, size_t n)
+		{
+			int num_packets = static_cast<int>((n + c_packet_width - 1) / c_packet_width);
+
+			#pragma omp parallel for if (num_packets > 512)
+			for (int p = 0; p < num_packets; ++p)
+			{
+				size_t begin = p * c_packet_width;
+				size_t count = std::min(c_packet_width, n - begin);
+
+				float8 weight(t[0]);
+				for (size_t i = 0; i != count && t_stride != 0; ++i)
+				{
+					weight[i] = t[(begin + i) * t_stride];
+				}
+
+				quatx8 q = lerp(load_quats(from + begin, count), load_quats(to + begin, count), weight);
+				store_quats(q, out + begin, count);
+			}
+		}
+	}
+
+	void nlerp(const quat *from, const quat *to, const float *t, quat *out, size_t n)
+	{
+		blend(nlerp_op(), from, to, t, 1, out, n);
+	}
+
+	void slerp(const quat *from, const quat *to, const float *t, quat *out, size_t n)
+	{
+		blend(slerp_op(), from, to, t, 1, out, n);
+	}
+
+	void nlerp(const quat *from, const quat *to, float t, quat *out, size_t n)
+	{
+		blend(nlerp_op(), from, to, &t, 0, out, n);
+	}
+
+	void slerp(const quat *from, const quat *to, float t, quat *out, size_t n)
+	{
+		blend(slerp_op(), from, to, &t, 0, out, n);
+	}
+}
@@ -0,0 +1,417 @@
+#include <float.h>
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+#include <intersect.hpp>
+#include <ray_marcher.hpp>
+
+namespace Dye
+{
+	namespace Render
+	{
+		using namespace Graphics;
+
+		namespace
+		{
+			// the pixels of a packet, 4 across and 2 down
+			const size_t c_packet_columns = 4;
+			const size_t c_packet_rows = 2;
+
+			// the share of the light that is not directional
+			const float c_ambient = 0.15f;
+
+			int bits(int mask)
+			{
+				int count = 0;
+				for (; mask; mask &= mask - 1)
+				{
+					++count;
+				}
+				return count;
+			}
+
+			// the part [entry, exit] of [tmin, FLT_MAX] of the ray inside the
+			// box, false if none
+			bool clip(const aabb &box, const float3 &origin, const float3 &direction, float tmin, float &entry,
+				float &exit)
+			{
+				const float3 inv = reciprocal(direction);
+				float x0 = (box.lower.x - origin.x) * inv.x;
+				float x1 = (box.upper.x - origin.x) * inv.x;
+				float y0 = (box.lower.y - origin.y) * inv.y;
+				float y1 = (box.upper.y - origin.y) * inv.y;
+				float z0 = (box.lower.z - origin.z) * inv.z;
+				float z1 = (box.upper.z - origin.z) * inv.z;
+				entry = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), tmin));
+				exit = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::max(z0, z1));
+				return entry <= exit;
+			}
+
+			// a mask of the lanes that pass through the box
+			float8 clip(const aabb &box, const float3x8 &origin, const float3x8 &direction, const float8 &tmin,
+				float8 &entry, float8 &exit)
+			{
+				const float3x8 inv = reciprocal(direction);
+				float8 x0 = (float8(box.lower.x) - origin.x) * inv.x;
+				float8 x1 = (float8(box.upper.x) - origin.x) * inv.x;
+				float8 y0 = (float8(box.lower.y) - origin.y) * inv.y;
+				float8 y1 = (float8(box.upper.y) - origin.y) * inv.y;
+				float8 z0 = (float8(box.lower.z) - origin.z) * inv.z;
+				float8 z1 = (float8(box.upper.z) - origin.z) * inv.z;
+				entry = max(max(min(x0, x1), min(y0, y1)), max(min(z0, z1), tmin));
+				exit = min(min(max(x0, x1), max(y0, y1)), max(z0, z1));
+				return entry <= exit;
+			}
+
+			// the gradient of the distance around p by the tetrahedron of
+			// offsets (1, -1, -1), (-1, -1, 1), (-1, 1, -1) and (1, 1, 1)
+			float3 gradient(const IRayMarchable &geometry, const float3 &p, float h)
+			{
+				const float f0 = geometry.distance(float3(p.x + h, p.y - h, p.z - h));
+				const float f1 = geometry.distance(float3(p.x - h, p.y - h, p.z + h));
+				const float f2 = geometry.distance(float3(p.x - h, p.y + h, p.z - h));
+				const float f3 = geometry.distance(float3(p.x + h, p.y + h, p.z + h));
+				return float3(f0 - f1 - f2 + f3, -f0 - f1 + f2 + f3, -f0 + f1 - f2 + f3);
+			}
+
+			float3x8 gradient(const IRayMarchable &geometry, const float3x8 &p, const float8 &h)
+			{
+				const float8 f0 = geometry.distance(float3x8(p.x + h, p.y - h, p.z - h));
+				const float8 f1 = geometry.distance(float3x8(p.x - h, p.y - h, p.z + h));
+				const float8 f2 = geometry.distance(float3x8(p.x - h, p.y + h, p.z - h));
+				const float8 f3 = geometry.distance(float3x8(p.x + h, p.y + h, p.z + h));
+				return float3x8(f0 - f1 - f2 + f3, -f0 - f1 + f2 + f3, -f0 + f1 - f2 + f3);
+			}
+		}
+
+		RayMarcher::RayMarcher(const IRayMarchable &geometry, size_t width, size_t height)
+			: m_geometry(&geometry), m_width(width), m_height(height), m_pixel_angle(0), m_near(0), m_far(0),
+			m_cone_start(((width + c_cone_cell - 1) / c_cone_cell) * ((height + c_cone_cell - 1) / c_cone_cell)),
+			m_depth(width * height), m_rgb(width * height * 3)
+		{
+			camera view;
+			view.eye = float3(0, 0, -1);
+			view.target = float3(0, 0, 0);
+			view.up = float3(0, 1, 0);
+			view.fov = 3.14159265f / 3;
+			set_camera(view);
+		}
+
+		void RayMarcher::set_camera(const camera &view)
+		{
+			m_camera = view;
+			m_frame = make_frame(view, m_width, m_height);
+			m_pixel_angle = 2 * std::tan(view.fov * 0.5f) / (m_height == 0 ? 1 : m_height);
+		}
+
+		march_stats RayMarcher::render()
+		{
+			// no pixel ray reaches into the bounds before near or leaves them
+			// after far, all of them measured from the eye
+			const aabb box = m_geometry->bounds();
+			const float3 eye = m_camera.eye;
+			const float3 closest(std::min(std::max(eye.x, box.lower.x), box.upper.x),
+				std::min(std::max(eye.y, box.lower.y), box.upper.y),
+				std::min(std::max(eye.z, box.lower.z), box.upper.z));
+			const float3 to_closest = closest - eye;
+			m_near = to_closest.length();
+			m_far = 0;
+			for (int corner = 0; corner != 8; ++corner)
+			{
+				const float3 p((corner & 1) ? box.upper.x : box.lower.x, (corner & 2) ? box.upper.y : box.lower.y,
+					(corner & 4) ? box.upper.z : box.lower.z);
+				const float3 to = p - eye;
+				m_far = std::max(m_far, to.length());
+			}
+
+			const size_t columns = cone_columns();
+			const int cells = static_cast<int>(columns * cone_rows());
+			size_t rays = 0;
+			size_t hits = 0;
+			size_t steps = 0;
+			size_t cone_steps = 0;
+			const double start = omp_get_wtime();
+
+			if (m_settings.cones)
+			{
+				#pragma omp parallel for schedule(dynamic, 1) reduction(+ : cone_steps)
+				for (int cell = 0; cell < cells; ++cell)
+				{
+					march_stats own = { 0, 0, 0, 0, 0 };
+					m_cone_start[cell] = march_cone(cell % columns, cell / columns, own);
+					cone_steps += own.cone_steps;
+				}
+			}
+			else
+			{
+				std::fill(m_cone_start.begin(), m_cone_start.end(), 0.0f);
+			}
+
+			// the cells differ in cost, so they go to whichever thread is free
+			#pragma omp parallel for schedule(dynamic, 1) reduction(+ : rays, hits, steps)
+			for (int cell = 0; cell < cells; ++cell)
+			{
+				march_stats own = { 0, 0, 0, 0, 0 };
+				render_cell(cell, own);
+				rays += own.rays;
+				hits += own.hits;
+				steps += own.steps;
+			}
+
+			march_stats stats = { rays, hits, steps, cone_steps, omp_get_wtime() - start };
+			return stats;
+		}
+
+		float3 RayMarcher::direction(float x, float y) const
+		{
+			const float sx = x / m_width * 2 - 1;
+			const float sy = y / m_height * 2 - 1;
+			const float3 d = m_frame.forward + m_frame.right * sx + m_frame.down * sy;
+			return normalize(d);
+		}
+
+		float RayMarcher::march_cone(size_t column, size_t row, march_stats &stats) const
+		{
+			const float x0 = static_cast<float>(column * c_cone_cell);
+			const float y0 = static_cast<float>(row * c_cone_cell);
+			const float x1 = static_cast<float>(std::min((column + 1) * c_cone_cell, m_width));
+			const float y1 = static_cast<float>(std::min((row + 1) * c_cone_cell, m_height));
+
+			// the axis through the middle of the cell, and the slope that
+			// takes in the rays through the centers of its corner pixels
+			const float3 axis = direction((x0 + x1) * 0.5f, (y0 + y1) * 0.5f);
+			float cos_angle = 1;
+			const float corners[4][2] = { { x0, y0 }, { x1 - 1, y0 }, { x0, y1 - 1 }, { x1 - 1, y1 - 1 } };
+			for (int k = 0; k != 4; ++k)
+			{
+				cos_angle = std::min(cos_angle, dot(axis, direction(corners[k][0] + 0.5f, corners[k][1] + 0.5f)));
+			}
+			const float slope = std::sqrt(std::max(0.0f, 1 - cos_angle * cos_angle)) / cos_angle;
+
+			// a pixel ray at t lies in the cone no further along the axis
+			// than t, so the cone covers it up to where it stopped. nothing
+			// is nearer than the bounds, which a ray at the rim of the cone
+			// reaches first, that much less along the axis
+			const float epsilon = m_settings.hit_scale * m_pixel_angle;
+			float t = m_near * cos_angle;
+			for (int step = 0; step != m_settings.max_steps; ++step)
+			{
+				if (t > m_far)
+				{
+					return FLT_MAX;
+				}
+				const float3 p = m_camera.eye + axis * t;
+				const float d = m_geometry->distance(p);
+				++stats.cone_steps;
+
+				// the ball around the axis clears the cone from t on as long
+				// as it reaches past the rim, moving both as t grows
+				const float radius = slope * t;
+				if (d - radius <= epsilon * t)
+				{
+					break;
+				}
+				t += (d - radius) / (1 + slope);
+			}
+			return t;
+		}
+
+		void RayMarcher::render_cell(size_t cell, march_stats &stats)
+		{
+			const size_t columns = cone_columns();
+			const size_t x0 = cell % columns * c_cone_cell;
+			const size_t y0 = cell / columns * c_cone_cell;
+			const size_t x1 = std::min(x0 + c_cone_cell, m_width);
+			const size_t y1 = std::min(y0 + c_cone_cell, m_height);
+			const float start = m_cone_start[cell];
+
+			if (start == FLT_MAX)
+			{
+				for (size_t y = y0; y != y1; ++y)
+				{
+					for (size_t x = x0; x != x1; ++x)
+					{
+						const size_t pixel = y * m_width + x;
+						m_depth[pixel] = FLT_MAX;
+						m_rgb[pixel * 3] = m_settings.sky.x;
+						m_rgb[pixel * 3 + 1] = m_settings.sky.y;
+						m_rgb[pixel * 3 + 2] = m_settings.sky.z;
+						++stats.rays;
+					}
+				}
+				return;
+			}
+
+			if (m_settings.packets)
+			{
+				for (size_t y = y0; y < y1; y += c_packet_rows)
+				{
+					for (size_t x = x0; x < x1; x += c_packet_columns)
+					{
+						march_packet(x, y, start, stats);
+					}
+				}
+			}
+			else
+			{
+				for (size_t y = y0; y != y1; ++y)
+				{
+					for (size_t x = x0; x != x1; ++x)
+					{
+						march_single(x, y, start, stats);
+					}
+				}
+			}
+		}
+
+		float3 RayMarcher::shade(const float3 &normal) const
+		{
+			const float3 light = normalize(m_settings.light);
+			const float diffuse = std::max(0.0f, dot(normal, light));
+			return m_settings.albedo * (c_ambient + (1 - c_ambient) * diffuse);
+		}
+
+		void RayMarcher::march_single(size_t x, size_t y, float start, march_stats &stats)
+		{
+			const IRayMarchable &geometry = *m_geometry;
+			const float3 origin = m_camera.eye;
+			const float3 dir = direction(x + 0.5f, y + 0.5f);
+			const float epsilon = m_settings.hit_scale * m_pixel_angle;
+			const size_t pixel = y * m_width + x;
+			++stats.rays;
+
+			float hit = FLT_MAX;
+			float entry, exit;
+			if (clip(geometry.bounds(), origin, dir, start, entry, exit))
+			{
+				float t = entry;
+				float previous_t = entry;
+				float previous_d = 0;
+				float relaxation = m_settings.relaxation;
+				for (int step = 0; step != m_settings.max_steps; ++step)
+				{
+					const float d = geometry.distance(origin + dir * t);
+					++stats.steps;
+
+					// the balls of the last step and this one leave a gap that
+					// the surface may pass through: back to the plain step
+					if (relaxation > 1 && d + previous_d < t - previous_t)
+					{
+						t = previous_t + previous_d;
+						relaxation = 1;
+						continue;
+					}
+					if (d < epsilon * t)
+					{
+						hit = t;
+						break;
+					}
+					previous_t = t;
+					previous_d = d;
+					t += relaxation * d;
+					if (t > exit)
+					{
+						break;
+					}
+				}
+			}
+
+			m_depth[pixel] = hit;
+			float3 colour = m_settings.sky;
+			if (hit != FLT_MAX)
+			{
+				const float3 p = origin + dir * hit;
+				colour = shade(normalize(gradient(geometry, p, std::max(epsilon * hit, 1e-6f))));
+				++stats.hits;
+			}
+			m_rgb[pixel * 3] = colour.x;
+			m_rgb[pixel * 3 + 1] = colour.y;
+			m_rgb[pixel * 3 + 2] = colour.z;
+		}
+
+		void RayMarcher::march_packet(size_t x0, size_t y0, float start, march_stats &stats)
+		{
+			const IRayMarchable &geometry = *m_geometry;
+			const float3 eye = m_camera.eye;
+			const float3x8 origin(float8(eye.x), float8(eye.y), float8(eye.z));
+			const float8 epsilon(m_settings.hit_scale * m_pixel_angle);
+
+			// the lanes past the edge of the image take no part
+			size_t pixels[c_packet_width];
+			float8 valid;
+			float3x8 dir;
+			for (size_t i = 0; i != c_packet_width; ++i)
+			{
+				const size_t x = x0 + i % c_packet_columns;
+				const size_t y = y0 + i / c_packet_columns;
+				const bool inside = x < m_width && y < m_height;
+				const float3 d = direction(x + 0.5f, y + 0.5f);
+				pixels[i] = inside ? y * m_width + x : 0;
+				valid[i] = inside ? 1.0f : 0.0f;
+				dir.x[i] = d.x;
+				dir.y[i] = d.y;
+				dir.z[i] = d.z;
+			}
+			valid = valid != float8(0.0f);
+			stats.rays += bits(movemask(valid));
+
+			float8 entry, exit;
+			float8 active = valid & clip(geometry.bounds(), origin, dir, float8(start), entry, exit);
+			float8 t = entry;
+			float8 previous_t = entry;
+			float8 previous_d(0.0f);
+			float8 relaxation(m_settings.relaxation);
+			float8 hit(FLT_MAX);
+			for (int step = 0; step != m_settings.max_steps && any(active); ++step)
+			{
+				const float3x8 p(origin.x + dir.x * t, origin.y + dir.y * t, origin.z + dir.z * t);
+				const float8 d = geometry.distance(p);
+				stats.steps += bits(movemask(active));
+
+				const float8 gap = active & (relaxation > float8(1.0f)) & (d + previous_d < t - previous_t);
+				t = select(gap, previous_t + previous_d, t);
+				relaxation = select(gap, float8(1.0f), relaxation);
+
+				const float8 stepping = andnot(gap, active);
+				const float8 arrived = stepping & (d < epsilon * t);
+				hit = select(arrived, t, hit);
+
+				const float8 moving = andnot(arrived, stepping);
+				previous_t = select(moving, t, previous_t);
+				previous_d = select(moving, d, previous_d);
+				t = select(moving, madd(relaxation, d, t), t);
+				active = andnot(arrived | (moving & (t > exit)), active);
+			}
+
+			// the normals of all lanes at once, the misses at the eye
+			const float8 hits = hit != float8(FLT_MAX);
+			const float8 at = select(hits, hit, float8(0.0f));
+			const float3x8 p(origin.x + dir.x * at, origin.y + dir.y * at, origin.z + dir.z * at);
+			float3x8 normal;
+			if (any(hits))
+			{
+				normal = gradient(geometry, p, max(epsilon * at, float8(1e-6f)));
+			}
+
+			const int valid_lanes = movemask(valid);
+			for (size_t i = 0; i != c_packet_width; ++i)
+			{
+				if (!(valid_lanes & (1 << i)))
+				{
+					continue;
+				}
+				const size_t pixel = pixels[i];
+				m_depth[pixel] = hit[i];
+				float3 colour = m_settings.sky;
+				if (hit[i] != FLT_MAX)
+				{
+					colour = shade(normalize(float3(normal.x[i], normal.y[i], normal.z[i])));
+					++stats.hits;
+				}
+				m_rgb[pixel * 3] = colour.x;
+				m_rgb[pixel * 3 + 1] = colour.y;
+				m_rgb[pixel * 3 + 2] = colour.z;
+			}
+		}
+	}
+}
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <scalar_grid.hpp>
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		ScalarGrid::ScalarGrid()
+			: m_origin(0, 0, 0), m_spacing(1)
+		{
+			m_count[0] = m_count[1] = m_count[2] = 0;
+		}
+
+		ScalarGrid::ScalarGrid(const float *values, const float3 &origin, float spacing, size_t nx, size_t ny, size_t nz)
+		{
+			assign(values, origin, spacing, nx, ny, nz);
+		}
+
+		void ScalarGrid::assign(const float *values, const float3 &origin, float spacing, size_t nx, size_t ny, size_t nz)
+		{
+			m_values.assign(values, values + nx * ny * nz);
+			m_origin = origin;
+			m_spacing = spacing;
+			m_count[0] = nx;
+			m_count[1] = ny;
+			m_count[2] = nz;
+		}
+
+		void ScalarGrid::assign(const IScalarField &field, const float3 &origin, float spacing,
+			size_t nx, size_t ny, size_t nz)
+		{
+			const lattice grid = { origin, spacing, { 0, 0, 0 }, { nx, ny, nz } };
+			m_values.resize(grid.size());
+			if (!m_values.empty())
+			{
+				field.sample_grid(grid, &m_values[0]);
+			}
+			m_origin = origin;
+			m_spacing = spacing;
+			m_count[0] = nx;
+			m_count[1] = ny;
+			m_count[2] = nz;
+		}
+
+		void ScalarGrid::sample_grid(const lattice &grid, float *out) const
+		{
+			if (grid.size() == 0)
+			{
+				return;
+			}
+			if (m_values.empty())
+			{
+				std::fill(out, out + grid.size(), 0.0f);
+				return;
+			}
+
+			// the interpolation is separable: the two points and the weight
+			// of the second along each axis, for each index of the lattice
+			const bool aligned = grid.spacing == m_spacing && grid.origin.x == m_origin.x
+				&& grid.origin.y == m_origin.y && grid.origin.z == m_origin.z;
+			std::vector<size_t> lower[3], upper[3];
+			std::vector<float> weight[3];
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				const size_t count = grid.count[axis];
+				const size_t last = m_count[axis] - 1;
+				lower[axis].resize(count);
+				upper[axis].resize(count);
+				weight[axis].resize(count);
+				for (size_t i = 0; i != count; ++i)
+				{
+					const int index = grid.first[axis] + static_cast<int>(i);
+					if (aligned)
+					{
+						lower[axis][i] = upper[axis][i] = static_cast<size_t>(std::min(std::max(index, 0),
+							static_cast<int>(last)));
+						weight[axis][i] = 0;
+						continue;
+					}
+					const float at = std::min(std::max((grid.coordinate(axis, index) - m_origin[axis]) / m_spacing, 0.0f),
+						static_cast<float>(last));
+					const size_t below = std::min(static_cast<size_t>(at), last);
+					lower[axis][i] = below;
+					upper[axis][i] = std::min(below + 1, last);
+					weight[axis][i] = at - below;
+				}
+			}
+
+			const size_t row = m_count[0];
+			const size_t slice = m_count[0] * m_count[1];
+			for (size_t k = 0; k != grid.count[2]; ++k)
+			{
+				const float wz = weight[2][k];
+				const float *z0 = &m_values[0] + lower[2][k] * slice;
+				const float *z1 = &m_values[0] + upper[2][k] * slice;
+				for (size_t j = 0; j != grid.count[1]; ++j)
+				{
+					const float wy = weight[1][j];
+					const float *p00 = z0 + lower[1][j] * row;
+					const float *p01 = z0 + upper[1][j] * row;
+					const float *p10 = z1 + lower[1][j] * row;
+					const float *p11 = z1 + upper[1][j] * row;
+					float *target = out + (k * grid.count[1] + j) * grid.count[0];
+					if (aligned)
+					{
+						for (size_t i = 0; i != grid.count[0]; ++i)
+						{
+							target[i] = p00[lower[0][i]];
+						}
+						continue;
+					}
+					for (size_t i = 0; i != grid.count[0]; ++i)
+					{
+						const size_t x0 = lower[0][i];
+						const size_t x1 = upper[0][i];
+						const float wx = weight[0][i];
+						const float a = p00[x0] + (p00[x1] - p00[x0]) * wx;
+						const float b = p01[x0] + (p01[x1] - p01[x0]) * wx;
+						const float c = p10[x0] + (p10[x1] - p10[x0]) * wx;
+						const float d = p11[x0] + (p11[x1] - p11[x0]) * wx;
+						const float e = a + (b - a) * wy;
+						const float f = c + (d - c) * wy;
+						target[i] = e + (f - e) * wz;
+					}
+				}
+			}
+		}
+	}
+}
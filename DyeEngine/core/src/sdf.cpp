@@ -0,0 +1,1258 @@
+#include <float.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <sdf.hpp>
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		namespace
+		{
+			//////////////////////////////////////////////////////////////////////////
+			// the lanes: one float, or a packet of 8
+			//////////////////////////////////////////////////////////////////////////
+			inline float lane_min(float a, float b) { return std::min(a, b); }
+			inline float lane_max(float a, float b) { return std::max(a, b); }
+			inline float lane_abs(float a) { return std::abs(a); }
+			inline float lane_sqrt(float a) { return std::sqrt(a); }
+			inline float lane_square(float a) { return a * a; }
+
+			// as round(float8), ties to even
+			inline float lane_round(float a)
+			{
+				const float big = 8388608.0f;
+				if (!(std::abs(a) < big))
+				{
+					return a;
+				}
+				const float magic = a < 0 ? -big : big;
+				return (a + magic) - magic;
+			}
+
+			inline float8 lane_min(const float8 &a, const float8 &b) { return min(a, b); }
+			inline float8 lane_max(const float8 &a, const float8 &b) { return max(a, b); }
+			inline float8 lane_abs(const float8 &a) { return abs(a); }
+			inline float8 lane_sqrt(const float8 &a) { return sqrt(a); }
+			inline float8 lane_round(const float8 &a) { return round(a); }
+			inline float8 lane_square(const float8 &a) { return a * a; }
+
+			//////////////////////////////////////////////////////////////////////////
+			// intervals as lanes: each operation gives a range its result stays
+			// in for operands anywhere in theirs
+			//////////////////////////////////////////////////////////////////////////
+			inline sdf_interval operator + (const sdf_interval &a, const sdf_interval &b)
+			{
+				return sdf_interval(a.lower + b.lower, a.upper + b.upper);
+			}
+
+			inline sdf_interval operator - (const sdf_interval &a, const sdf_interval &b)
+			{
+				return sdf_interval(a.lower - b.upper, a.upper - b.lower);
+			}
+
+			inline sdf_interval operator - (const sdf_interval &a)
+			{
+				return sdf_interval(-a.upper, -a.lower);
+			}
+
+			inline sdf_interval operator * (const sdf_interval &a, const sdf_interval &b)
+			{
+				const float ll = a.lower * b.lower;
+				const float lu = a.lower * b.upper;
+				const float ul = a.upper * b.lower;
+				const float uu = a.upper * b.upper;
+				return sdf_interval(std::min(std::min(ll, lu), std::min(ul, uu)), std::max(std::max(ll, lu), std::max(ul, uu)));
+			}
+
+			inline sdf_interval lane_min(const sdf_interval &a, const sdf_interval &b)
+			{
+				return sdf_interval(std::min(a.lower, b.lower), std::min(a.upper, b.upper));
+			}
+
+			inline sdf_interval lane_max(const sdf_interval &a, const sdf_interval &b)
+			{
+				return sdf_interval(std::max(a.lower, b.lower), std::max(a.upper, b.upper));
+			}
+
+			inline sdf_interval lane_abs(const sdf_interval &a)
+			{
+				if (a.lower >= 0)
+				{
+					return a;
+				}
+				if (a.upper <= 0)
+				{
+					return -a;
+				}
+				return sdf_interval(0, std::max(-a.lower, a.upper));
+			}
+
+			inline sdf_interval lane_sqrt(const sdf_interval &a)
+			{
+				return sdf_interval(std::sqrt(std::max(a.lower, 0.0f)), std::sqrt(std::max(a.upper, 0.0f)));
+			}
+
+			inline sdf_interval lane_round(const sdf_interval &a)
+			{
+				return sdf_interval(lane_round(a.lower), lane_round(a.upper));
+			}
+
+			// tighter than a * a, which does not know both are the same
+			inline sdf_interval lane_square(const sdf_interval &a)
+			{
+				const sdf_interval b = lane_abs(a);
+				return sdf_interval(b.lower * b.lower, b.upper * b.upper);
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			// the operations, shared by the tree and the interpreter, with the
+			// constants of their instruction as k
+			//////////////////////////////////////////////////////////////////////////
+			template<typename Lane>
+			Lane repeat_coordinate(const Lane &a, const float *k)
+			{
+				const Lane cell = lane_min(lane_max(lane_round(a * Lane(k[1])), Lane(-k[2])), Lane(k[2]));
+				return a - Lane(k[0]) * cell;
+			}
+
+			template<typename Lane>
+			Lane sphere_distance(const Lane &x, const Lane &y, const Lane &z, const float *k)
+			{
+				return lane_sqrt(lane_square(x) + lane_square(y) + lane_square(z)) - Lane(k[0]);
+			}
+
+			template<typename Lane>
+			Lane box_distance(const Lane &x, const Lane &y, const Lane &z, const float *k)
+			{
+				const Lane zero(0.0f);
+				const Lane qx = lane_abs(x) - Lane(k[0]);
+				const Lane qy = lane_abs(y) - Lane(k[1]);
+				const Lane qz = lane_abs(z) - Lane(k[2]);
+				const Lane ox = lane_max(qx, zero);
+				const Lane oy = lane_max(qy, zero);
+				const Lane oz = lane_max(qz, zero);
+				return lane_sqrt(lane_square(ox) + lane_square(oy) + lane_square(oz)) + lane_min(lane_max(qx, lane_max(qy, qz)), zero);
+			}
+
+			template<typename Lane>
+			Lane torus_distance(const Lane &x, const Lane &y, const Lane &z, const float *k)
+			{
+				const Lane ring = lane_sqrt(lane_square(x) + lane_square(z)) - Lane(k[0]);
+				return lane_sqrt(lane_square(ring) + lane_square(y)) - Lane(k[1]);
+			}
+
+			template<typename Lane>
+			Lane cylinder_distance(const Lane &x, const Lane &y, const Lane &z, const float *k)
+			{
+				const Lane zero(0.0f);
+				const Lane side = lane_sqrt(lane_square(x) + lane_square(z)) - Lane(k[0]);
+				const Lane cap = lane_abs(y) - Lane(k[1]);
+				const Lane os = lane_max(side, zero);
+				const Lane oc = lane_max(cap, zero);
+				return lane_min(lane_max(side, cap), zero) + lane_sqrt(lane_square(os) + lane_square(oc));
+			}
+
+			template<typename Lane>
+			Lane plane_distance(const Lane &x, const Lane &y, const Lane &z, const float *k)
+			{
+				return x * Lane(k[0]) + y * Lane(k[1]) + z * Lane(k[2]) - Lane(k[3]);
+			}
+
+			// the polynomial smooth minimum (quilez), at most k / 4 under
+			// the minimum where a and b are within k
+			template<typename Lane>
+			Lane smooth_min(const Lane &a, const Lane &b, const float *k)
+			{
+				const Lane h = lane_max(Lane(k[0]) - lane_abs(a - b), Lane(0.0f)) * Lane(k[1]);
+				return lane_min(a, b) - lane_square(h) * Lane(k[0] * 0.25f);
+			}
+
+			// the operands and constants of each opcode
+			const unsigned int c_operand_counts[sdf_opcode_count] = { 0, 1, 1, 1, 3, 3, 3, 3, 3, 2, 2, 2, 2 };
+			const unsigned int c_constant_counts[sdf_opcode_count] = { 1, 1, 1, 3, 1, 3, 2, 2, 4, 0, 0, 0, 2 };
+			const unsigned int c_max_constants = 4;
+
+			// one instruction on single floats, for the folding
+			float execute(unsigned int op, float a, float b, float c, const float *k)
+			{
+				switch (op)
+				{
+				case sdf_op_constant: return k[0];
+				case sdf_op_offset: return a - k[0];
+				case sdf_op_multiply: return a * k[0];
+				case sdf_op_repeat: return repeat_coordinate(a, k);
+				case sdf_op_sphere: return sphere_distance(a, b, c, k);
+				case sdf_op_box: return box_distance(a, b, c, k);
+				case sdf_op_torus: return torus_distance(a, b, c, k);
+				case sdf_op_cylinder: return cylinder_distance(a, b, c, k);
+				case sdf_op_plane: return plane_distance(a, b, c, k);
+				case sdf_op_min: return std::min(a, b);
+				case sdf_op_max: return std::max(a, b);
+				case sdf_op_difference: return std::max(a, -b);
+				case sdf_op_smooth_min: return smooth_min(a, b, k);
+				}
+				return 0;
+			}
+
+			// the repetition over a range of cells: all of one cell from the
+			// middle ones, and the parts of the first and the last in range
+			sdf_interval repeat_range(const sdf_interval &a, const float *k)
+			{
+				const float first = std::min(std::max(lane_round(a.lower * k[1]), -k[2]), k[2]);
+				const float last = std::min(std::max(lane_round(a.upper * k[1]), -k[2]), k[2]);
+				if (first == last)
+				{
+					return sdf_interval(a.lower - k[0] * first, a.upper - k[0] * first);
+				}
+				const float half = k[0] * 0.5f;
+				return sdf_interval(std::min(a.lower - k[0] * first, -half), std::max(a.upper - k[0] * last, half));
+			}
+
+			unsigned int float_bits(float f)
+			{
+				unsigned int u;
+				memcpy(&u, &f, sizeof(u));
+				return u;
+			}
+
+			aabb unbounded()
+			{
+				aabb box = { float3(-FLT_MAX, -FLT_MAX, -FLT_MAX), float3(FLT_MAX, FLT_MAX, FLT_MAX) };
+				return box;
+			}
+
+			aabb nothing()
+			{
+				aabb box = { float3(FLT_MAX, FLT_MAX, FLT_MAX), float3(-FLT_MAX, -FLT_MAX, -FLT_MAX) };
+				return box;
+			}
+
+			bool is_empty(const aabb &box)
+			{
+				return box.lower.x > box.upper.x || box.lower.y > box.upper.y || box.lower.z > box.upper.z;
+			}
+
+			aabb symmetric(float x, float y, float z)
+			{
+				aabb box = { float3(-x, -y, -z), float3(x, y, z) };
+				return box;
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			// compiler
+			//////////////////////////////////////////////////////////////////////////
+
+			// the point's coordinates, values 0 to 2
+			const unsigned int c_input = sdf_opcode_count;
+
+			struct value
+			{
+				unsigned int op;
+				unsigned int operands[3];
+				float k[c_max_constants];
+			};
+
+			value input(unsigned int axis)
+			{
+				value v = { c_input, { axis, 0, 0 }, { 0, 0, 0, 0 } };
+				return v;
+			}
+
+			class compiler
+			{
+			public:
+				explicit compiler(const SdfTree &tree)
+					: m_tree(tree), m_sizes(tree.size(), 0)
+				{
+					for (unsigned int axis = 0; axis != 3; ++axis)
+					{
+						m_values.push_back(input(axis));
+					}
+				}
+
+				const std::vector<value> &values() const { return m_values; }
+
+				// the distance of the subtree of node at the point x, y, z
+				unsigned int lower(unsigned int node, unsigned int x, unsigned int y, unsigned int z)
+				{
+					const sdf_node &n = m_tree.node(node);
+					const float *p = n.parameters;
+					switch (n.type)
+					{
+					case sdf_constant:
+						return constant(p[0]);
+					case sdf_sphere:
+						return emit(sdf_op_sphere, x, y, z, p);
+					case sdf_box:
+						return emit(sdf_op_box, x, y, z, p);
+					case sdf_torus:
+						return emit(sdf_op_torus, x, y, z, p);
+					case sdf_cylinder:
+						return emit(sdf_op_cylinder, x, y, z, p);
+					case sdf_plane:
+						return emit(sdf_op_plane, x, y, z, p);
+					case sdf_union:
+						return lower_pair(sdf_op_min, n, x, y, z, 0);
+					case sdf_intersection:
+						return lower_pair(sdf_op_max, n, x, y, z, 0);
+					case sdf_difference:
+						return lower_pair(sdf_op_difference, n, x, y, z, 0);
+					case sdf_smooth_union:
+					{
+						const float k[2] = { p[0], 1 / p[0] };
+						return lower_pair(sdf_op_smooth_min, n, x, y, z, k);
+					}
+					case sdf_translate:
+						return lower(n.a, offset(x, p[0]), offset(y, p[1]), offset(z, p[2]));
+					case sdf_scale:
+					{
+						const float inverse = 1 / p[0];
+						const unsigned int d = lower(n.a, multiply(x, inverse), multiply(y, inverse),
+							multiply(z, inverse));
+						return multiply(d, p[0]);
+					}
+					case sdf_repeat:
+						return lower(n.a, repeat(x, p[0], p[3]), repeat(y, p[1], p[4]), repeat(z, p[2], p[5]));
+					}
+					return constant(FLT_MAX);
+				}
+
+			private:
+				// the operand with the larger subtree goes first, while few
+				// registers are taken
+				unsigned int lower_pair(unsigned int op, const sdf_node &n, unsigned int x, unsigned int y,
+					unsigned int z, const float *k)
+				{
+					unsigned int a, b;
+					if (size(n.b) > size(n.a))
+					{
+						b = lower(n.b, x, y, z);
+						a = lower(n.a, x, y, z);
+					}
+					else
+					{
+						a = lower(n.a, x, y, z);
+						b = lower(n.b, x, y, z);
+					}
+					return emit(op, a, b, 0, k);
+				}
+
+				unsigned int size(unsigned int node)
+				{
+					if (m_sizes[node] == 0)
+					{
+						const sdf_node &n = m_tree.node(node);
+						unsigned int total = 1;
+						if (n.type >= sdf_union && n.type <= sdf_smooth_union)
+						{
+							total += size(n.a) + size(n.b);
+						}
+						else if (n.type >= sdf_translate)
+						{
+							total += size(n.a);
+						}
+						m_sizes[node] = total;
+					}
+					return m_sizes[node];
+				}
+
+				unsigned int constant(float number)
+				{
+					const float k[1] = { number };
+					return emit(sdf_op_constant, 0, 0, 0, k);
+				}
+
+				unsigned int offset(unsigned int a, float by)
+				{
+					const float k[1] = { by };
+					return emit(sdf_op_offset, a, 0, 0, k);
+				}
+
+				unsigned int multiply(unsigned int a, float by)
+				{
+					const float k[1] = { by };
+					return emit(sdf_op_multiply, a, 0, 0, k);
+				}
+
+				unsigned int repeat(unsigned int a, float spacing, float limit)
+				{
+					if (spacing == 0)
+					{
+						return a;
+					}
+					const float k[3] = { spacing, 1 / spacing, limit };
+					return emit(sdf_op_repeat, a, 0, 0, k);
+				}
+
+				bool is_constant(unsigned int v) const
+				{
+					return m_values[v].op == sdf_op_constant;
+				}
+
+				// whether v is a constant at least, or at most, as far as
+				// the empty shape
+				bool is_far(unsigned int v) const
+				{
+					return is_constant(v) && m_values[v].k[0] >= FLT_MAX;
+				}
+
+				bool is_far_inside(unsigned int v) const
+				{
+					return is_constant(v) && m_values[v].k[0] <= -FLT_MAX;
+				}
+
+				unsigned int emit(unsigned int op, unsigned int a, unsigned int b, unsigned int c, const float *k)
+				{
+					const unsigned int operands = c_operand_counts[op];
+					const unsigned int constants = c_constant_counts[op];
+					value v = { op, { a, b, c }, { 0, 0, 0, 0 } };
+					for (unsigned int i = operands; i != 3; ++i)
+					{
+						v.operands[i] = 0;
+					}
+					for (unsigned int i = 0; i != constants; ++i)
+					{
+						v.k[i] = k[i];
+					}
+
+					// operands that do not depend on the point fold
+					bool folds = operands != 0;
+					float number[3] = { 0, 0, 0 };
+					for (unsigned int i = 0; i != operands; ++i)
+					{
+						folds = folds && is_constant(v.operands[i]);
+						number[i] = m_values[v.operands[i]].k[0];
+					}
+					if (folds)
+					{
+						return constant(execute(op, number[0], number[1], number[2], v.k));
+					}
+
+					// identities, and branches the empty shape decides
+					switch (op)
+					{
+					case sdf_op_offset:
+						if (v.k[0] == 0)
+						{
+							return a;
+						}
+						if (m_values[a].op == sdf_op_offset)
+						{
+							return offset(m_values[a].operands[0], m_values[a].k[0] + v.k[0]);
+						}
+						break;
+					case sdf_op_multiply:
+						if (v.k[0] == 1)
+						{
+							return a;
+						}
+						if (m_values[a].op == sdf_op_multiply)
+						{
+							return multiply(m_values[a].operands[0], m_values[a].k[0] * v.k[0]);
+						}
+						break;
+					case sdf_op_min:
+					case sdf_op_smooth_min:
+						if (is_far(a) || is_far_inside(b))
+						{
+							return b;
+						}
+						if (is_far(b) || is_far_inside(a))
+						{
+							return a;
+						}
+						if (op == sdf_op_min && a == b)
+						{
+							return a;
+						}
+						break;
+					case sdf_op_max:
+						if (is_far_inside(a) || is_far(b))
+						{
+							return b;
+						}
+						if (is_far_inside(b) || is_far(a) || a == b)
+						{
+							return a;
+						}
+						break;
+					case sdf_op_difference:
+						if (is_far(b) || is_far(a))
+						{
+							return a;
+						}
+						if (is_far_inside(b))
+						{
+							return constant(FLT_MAX);
+						}
+						break;
+					}
+
+					// the same operation on the same operands is the same value;
+					// the order of a min or max does not matter
+					if ((op == sdf_op_min || op == sdf_op_max || op == sdf_op_smooth_min) && v.operands[0] > v.operands[1])
+					{
+						std::swap(v.operands[0], v.operands[1]);
+					}
+					std::vector<unsigned int> key;
+					key.push_back(op);
+					key.insert(key.end(), v.operands, v.operands + 3);
+					for (unsigned int i = 0; i != constants; ++i)
+					{
+						key.push_back(float_bits(v.k[i]));
+					}
+					std::map<std::vector<unsigned int>, unsigned int>::const_iterator found = m_known.find(key);
+					if (found != m_known.end())
+					{
+						return found->second;
+					}
+					const unsigned int index = static_cast<unsigned int>(m_values.size());
+					m_values.push_back(v);
+					m_known[key] = index;
+					return index;
+				}
+
+				const SdfTree &m_tree;
+				std::vector<unsigned int> m_sizes;
+				std::vector<value> m_values;
+				std::map<std::vector<unsigned int>, unsigned int> m_known;
+			};
+
+			// the value out as instructions on registers: the dead values
+			// dropped, and each register reused once its value is last read.
+			// false if more than c_sdf_registers are needed
+			bool assemble(const std::vector<value> &values, unsigned int out, std::vector<sdf_instruction> &code,
+				std::vector<float> &constants, unsigned int &registers, unsigned int &result)
+			{
+				const size_t n = values.size();
+
+				// the values the result depends on, and the last reads of each
+				std::vector<bool> live(n, false);
+				std::vector<size_t> last(n, 0);
+				live[out] = true;
+				last[out] = n;
+				for (size_t i = n; i-- != 0; )
+				{
+					if (!live[i] || values[i].op == c_input)
+					{
+						continue;
+					}
+					for (unsigned int j = 0; j != c_operand_counts[values[i].op]; ++j)
+					{
+						const unsigned int operand = values[i].operands[j];
+						live[operand] = true;
+						last[operand] = std::max(last[operand], i);
+					}
+				}
+
+				// the point arrives in registers 0 to 2, which are free once read
+				std::vector<unsigned int> assigned(n, 0);
+				bool taken[c_sdf_registers] = { false };
+				for (unsigned int axis = 0; axis != 3; ++axis)
+				{
+					assigned[axis] = axis;
+					taken[axis] = live[axis];
+				}
+
+				code.clear();
+				constants.clear();
+				registers = 3;
+				for (size_t i = 3; i != n; ++i)
+				{
+					if (!live[i])
+					{
+						continue;
+					}
+					const value &v = values[i];
+					const unsigned int operands = c_operand_counts[v.op];
+					for (unsigned int j = 0; j != operands; ++j)
+					{
+						if (last[v.operands[j]] == i)
+						{
+							taken[assigned[v.operands[j]]] = false;
+						}
+					}
+
+					unsigned int target = 0;
+					while (target != c_sdf_registers && taken[target])
+					{
+						++target;
+					}
+					if (target == c_sdf_registers || constants.size() + c_max_constants > 0xffff)
+					{
+						return false;
+					}
+					taken[target] = true;
+					assigned[i] = target;
+					registers = std::max(registers, target + 1);
+
+					sdf_instruction instruction;
+					instruction.op = static_cast<unsigned short>(v.op);
+					instruction.target = static_cast<unsigned short>(target);
+					instruction.a = static_cast<unsigned short>(operands > 0 ? assigned[v.operands[0]] : 0);
+					instruction.b = static_cast<unsigned short>(operands > 1 ? assigned[v.operands[1]] : 0);
+					instruction.c = static_cast<unsigned short>(operands > 2 ? assigned[v.operands[2]] : 0);
+					instruction.constant = static_cast<unsigned short>(constants.size());
+					constants.insert(constants.end(), v.k, v.k + c_constant_counts[v.op]);
+					code.push_back(instruction);
+				}
+				result = assigned[out];
+				return true;
+			}
+
+			// the values of a program: the three of the point, then one per
+			// instruction; out becomes the one of the distance
+			std::vector<value> decompile(const SdfProgram &program, unsigned int &out)
+			{
+				std::vector<value> values;
+				unsigned int holds[c_sdf_registers];
+				for (unsigned int axis = 0; axis != 3; ++axis)
+				{
+					values.push_back(input(axis));
+					holds[axis] = axis;
+				}
+				for (size_t i = 0; i != program.instruction_count(); ++i)
+				{
+					const sdf_instruction &instruction = program.instructions()[i];
+					const unsigned short registers[3] = { instruction.a, instruction.b, instruction.c };
+					value v = { instruction.op, { 0, 0, 0 }, { 0, 0, 0, 0 } };
+					for (unsigned int j = 0; j != c_operand_counts[instruction.op]; ++j)
+					{
+						v.operands[j] = holds[registers[j]];
+					}
+					for (unsigned int j = 0; j != c_constant_counts[instruction.op]; ++j)
+					{
+						v.k[j] = program.constants()[instruction.constant + j];
+					}
+					holds[instruction.target] = static_cast<unsigned int>(values.size());
+					values.push_back(v);
+				}
+				out = holds[program.result()];
+				return values;
+			}
+
+			// the range of each value for the point anywhere in region
+			std::vector<sdf_interval> ranges(const std::vector<value> &values, const aabb &region)
+			{
+				std::vector<sdf_interval> range(values.size());
+				for (size_t i = 0; i != values.size(); ++i)
+				{
+					const value &v = values[i];
+					const sdf_interval &a = range[v.operands[0]];
+					const sdf_interval &b = range[v.operands[1]];
+					const sdf_interval &c = range[v.operands[2]];
+					switch (v.op)
+					{
+					case c_input: range[i] = sdf_interval(region.lower[v.operands[0]], region.upper[v.operands[0]]); break;
+					case sdf_op_constant: range[i] = sdf_interval(v.k[0]); break;
+					case sdf_op_offset: range[i] = a - sdf_interval(v.k[0]); break;
+					case sdf_op_multiply: range[i] = a * sdf_interval(v.k[0]); break;
+					case sdf_op_repeat: range[i] = repeat_range(a, v.k); break;
+					case sdf_op_sphere: range[i] = sphere_distance(a, b, c, v.k); break;
+					case sdf_op_box: range[i] = box_distance(a, b, c, v.k); break;
+					case sdf_op_torus: range[i] = torus_distance(a, b, c, v.k); break;
+					case sdf_op_cylinder: range[i] = cylinder_distance(a, b, c, v.k); break;
+					case sdf_op_plane: range[i] = plane_distance(a, b, c, v.k); break;
+					case sdf_op_min: range[i] = lane_min(a, b); break;
+					case sdf_op_max: range[i] = lane_max(a, b); break;
+					case sdf_op_difference: range[i] = lane_max(a, -b); break;
+					case sdf_op_smooth_min: range[i] = smooth_min(a, b, v.k); break;
+					}
+				}
+				return range;
+			}
+
+			enum sdf_choice
+			{
+				sdf_take_both,
+				sdf_take_a,
+				sdf_take_b,
+				sdf_take_negated_b,
+			};
+
+			// the operand a min, max, difference or smooth min takes, if it
+			// is the same for operands anywhere in a and b
+			sdf_choice choice(unsigned int op, const sdf_interval &a, const sdf_interval &b, const float *k)
+			{
+				switch (op)
+				{
+				case sdf_op_min:
+					return a.upper <= b.lower ? sdf_take_a : b.upper <= a.lower ? sdf_take_b : sdf_take_both;
+				case sdf_op_max:
+					return a.lower >= b.upper ? sdf_take_a : b.lower >= a.upper ? sdf_take_b : sdf_take_both;
+				case sdf_op_difference:
+					return a.lower >= -b.lower ? sdf_take_a : -b.upper >= a.upper ? sdf_take_negated_b : sdf_take_both;
+				case sdf_op_smooth_min:
+					// no blend where they are k apart
+					return a.upper + k[0] <= b.lower ? sdf_take_a : b.upper + k[0] <= a.lower ? sdf_take_b
+						: sdf_take_both;
+				}
+				return sdf_take_both;
+			}
+
+			const char *c_opcode_names[sdf_opcode_count] =
+			{
+				"constant", "offset", "multiply", "repeat",
+				"sphere", "box", "torus", "cylinder", "plane",
+				"min", "max", "difference", "smooth_min",
+			};
+		}
+
+		const char *sdf_opcode_name(sdf_opcode op)
+		{
+			return op < sdf_opcode_count ? c_opcode_names[op] : "unknown";
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// tree
+		//////////////////////////////////////////////////////////////////////////
+		unsigned int SdfTree::add(sdf_node_type type, unsigned int a, unsigned int b, const float *parameters,
+			size_t count)
+		{
+			sdf_node n;
+			n.type = type;
+			n.a = a;
+			n.b = b;
+			for (size_t i = 0; i != 6; ++i)
+			{
+				n.parameters[i] = i < count ? parameters[i] : 0;
+			}
+			m_nodes.push_back(n);
+			return static_cast<unsigned int>(m_nodes.size() - 1);
+		}
+
+		unsigned int SdfTree::constant(float distance)
+		{
+			return add(sdf_constant, 0, 0, &distance, 1);
+		}
+
+		unsigned int SdfTree::empty()
+		{
+			return constant(FLT_MAX);
+		}
+
+		unsigned int SdfTree::sphere(float radius)
+		{
+			return add(sdf_sphere, 0, 0, &radius, 1);
+		}
+
+		unsigned int SdfTree::box(const float3 &half_size)
+		{
+			const float p[3] = { half_size.x, half_size.y, half_size.z };
+			return add(sdf_box, 0, 0, p, 3);
+		}
+
+		unsigned int SdfTree::torus(float ring_radius, float tube_radius)
+		{
+			const float p[2] = { ring_radius, tube_radius };
+			return add(sdf_torus, 0, 0, p, 2);
+		}
+
+		unsigned int SdfTree::cylinder(float radius, float half_height)
+		{
+			const float p[2] = { radius, half_height };
+			return add(sdf_cylinder, 0, 0, p, 2);
+		}
+
+		unsigned int SdfTree::plane(const float3 &normal, float offset)
+		{
+			const float p[4] = { normal.x, normal.y, normal.z, offset };
+			return add(sdf_plane, 0, 0, p, 4);
+		}
+
+		unsigned int SdfTree::merge(unsigned int a, unsigned int b)
+		{
+			return add(sdf_union, a, b, 0, 0);
+		}
+
+		unsigned int SdfTree::intersect(unsigned int a, unsigned int b)
+		{
+			return add(sdf_intersection, a, b, 0, 0);
+		}
+
+		unsigned int SdfTree::subtract(unsigned int a, unsigned int b)
+		{
+			return add(sdf_difference, a, b, 0, 0);
+		}
+
+		unsigned int SdfTree::smooth_merge(unsigned int a, unsigned int b, float k)
+		{
+			return add(sdf_smooth_union, a, b, &k, 1);
+		}
+
+		unsigned int SdfTree::translate(unsigned int child, const float3 &offset)
+		{
+			const float p[3] = { offset.x, offset.y, offset.z };
+			return add(sdf_translate, child, 0, p, 3);
+		}
+
+		unsigned int SdfTree::scale(unsigned int child, float factor)
+		{
+			return add(sdf_scale, child, 0, &factor, 1);
+		}
+
+		unsigned int SdfTree::repeat(unsigned int child, const float3 &spacing, const float3 &limit)
+		{
+			const float p[6] = { spacing.x, spacing.y, spacing.z, limit.x, limit.y, limit.z };
+			return add(sdf_repeat, child, 0, p, 6);
+		}
+
+		float SdfTree::distance(unsigned int node, const float3 &p) const
+		{
+			const sdf_node &n = m_nodes[node];
+			const float *k = n.parameters;
+			switch (n.type)
+			{
+			case sdf_constant:
+				return k[0];
+			case sdf_sphere:
+				return sphere_distance(p.x, p.y, p.z, k);
+			case sdf_box:
+				return box_distance(p.x, p.y, p.z, k);
+			case sdf_torus:
+				return torus_distance(p.x, p.y, p.z, k);
+			case sdf_cylinder:
+				return cylinder_distance(p.x, p.y, p.z, k);
+			case sdf_plane:
+				return plane_distance(p.x, p.y, p.z, k);
+			case sdf_union:
+				return std::min(distance(n.a, p), distance(n.b, p));
+			case sdf_intersection:
+				return std::max(distance(n.a, p), distance(n.b, p));
+			case sdf_difference:
+				return std::max(distance(n.a, p), -distance(n.b, p));
+			case sdf_smooth_union:
+			{
+				const float blend[2] = { k[0], 1 / k[0] };
+				return smooth_min(distance(n.a, p), distance(n.b, p), blend);
+			}
+			case sdf_translate:
+				return distance(n.a, float3(p.x - k[0], p.y - k[1], p.z - k[2]));
+			case sdf_scale:
+			{
+				const float inverse = 1 / k[0];
+				return distance(n.a, float3(p.x * inverse, p.y * inverse, p.z * inverse)) * k[0];
+			}
+			case sdf_repeat:
+			{
+				float3 q = p;
+				for (int axis = 0; axis != 3; ++axis)
+				{
+					if (k[axis] != 0)
+					{
+						const float cell[3] = { k[axis], 1 / k[axis], k[axis + 3] };
+						q[axis] = repeat_coordinate(p[axis], cell);
+					}
+				}
+				return distance(n.a, q);
+			}
+			}
+			return FLT_MAX;
+		}
+
+		aabb SdfTree::bounds(unsigned int node) const
+		{
+			const sdf_node &n = m_nodes[node];
+			const float *k = n.parameters;
+			switch (n.type)
+			{
+			case sdf_constant:
+				return k[0] > 0 ? nothing() : unbounded();
+			case sdf_sphere:
+				return symmetric(k[0], k[0], k[0]);
+			case sdf_box:
+				return symmetric(k[0], k[1], k[2]);
+			case sdf_torus:
+				return symmetric(k[0] + k[1], k[1], k[0] + k[1]);
+			case sdf_cylinder:
+				return symmetric(k[0], k[1], k[0]);
+			case sdf_plane:
+				return unbounded();
+			case sdf_union:
+			case sdf_smooth_union:
+			{
+				const aabb a = bounds(n.a);
+				const aabb b = bounds(n.b);
+				if (is_empty(a) || is_empty(b))
+				{
+					return is_empty(a) ? b : a;
+				}
+
+				// the blend reaches k / 4 further
+				const float grow = n.type == sdf_smooth_union ? k[0] * 0.25f : 0;
+				aabb box;
+				for (int axis = 0; axis != 3; ++axis)
+				{
+					box.lower[axis] = std::min(a.lower[axis], b.lower[axis]) - grow;
+					box.upper[axis] = std::max(a.upper[axis], b.upper[axis]) + grow;
+				}
+				return box;
+			}
+			case sdf_intersection:
+			{
+				const aabb a = bounds(n.a);
+				const aabb b = bounds(n.b);
+				aabb box;
+				for (int axis = 0; axis != 3; ++axis)
+				{
+					box.lower[axis] = std::max(a.lower[axis], b.lower[axis]);
+					box.upper[axis] = std::min(a.upper[axis], b.upper[axis]);
+				}
+				return is_empty(box) ? nothing() : box;
+			}
+			case sdf_difference:
+				return bounds(n.a);
+			case sdf_translate:
+			{
+				aabb box = bounds(n.a);
+				if (!is_empty(box))
+				{
+					const float3 offset(k[0], k[1], k[2]);
+					box.lower += offset;
+					box.upper += offset;
+				}
+				return box;
+			}
+			case sdf_scale:
+			{
+				aabb box = bounds(n.a);
+				if (!is_empty(box))
+				{
+					box.lower *= k[0];
+					box.upper *= k[0];
+				}
+				return box;
+			}
+			case sdf_repeat:
+			{
+				aabb box = bounds(n.a);
+				if (!is_empty(box))
+				{
+					for (int axis = 0; axis != 3; ++axis)
+					{
+						if (k[axis] == 0)
+						{
+							continue;
+						}
+						if (k[axis + 3] >= FLT_MAX)
+						{
+							box.lower[axis] = -FLT_MAX;
+							box.upper[axis] = FLT_MAX;
+						}
+						else
+						{
+							const float reach = k[axis] * k[axis + 3];
+							box.lower[axis] -= reach;
+							box.upper[axis] += reach;
+						}
+					}
+				}
+				return box;
+			}
+			}
+			return unbounded();
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// program
+		//////////////////////////////////////////////////////////////////////////
+		SdfProgram::SdfProgram()
+		{
+			SdfTree tree;
+			compile(tree, tree.empty());
+		}
+
+		bool SdfProgram::compile(const SdfTree &tree, unsigned int root)
+		{
+			compiler c(tree);
+			const unsigned int out = c.lower(root, 0, 1, 2);
+			if (!assemble(c.values(), out, m_code, m_constants, m_registers, m_result))
+			{
+				SdfTree empty_tree;
+				compile(empty_tree, empty_tree.empty());
+				return false;
+			}
+			m_bounds = tree.bounds(root);
+			return true;
+		}
+
+		sdf_interval SdfProgram::evaluate(const aabb &region) const
+		{
+			unsigned int out;
+			const std::vector<value> values = decompile(*this, out);
+			return ranges(values, region)[out];
+		}
+
+		sdf_interval SdfProgram::prune(const aabb &region, SdfProgram &pruned) const
+		{
+			unsigned int out;
+			const std::vector<value> values = decompile(*this, out);
+			const std::vector<sdf_interval> range = ranges(values, region);
+
+			// a choice region decides becomes the operand it takes, which
+			// leaves the other to the dead code
+			std::vector<value> kept(values.begin(), values.begin() + 3);
+			std::vector<unsigned int> renamed(values.size());
+			for (unsigned int i = 0; i != 3; ++i)
+			{
+				renamed[i] = i;
+			}
+			for (size_t i = 3; i != values.size(); ++i)
+			{
+				value v = values[i];
+				for (unsigned int j = 0; j != c_operand_counts[v.op]; ++j)
+				{
+					v.operands[j] = renamed[v.operands[j]];
+				}
+				switch (choice(v.op, range[values[i].operands[0]], range[values[i].operands[1]], v.k))
+				{
+				case sdf_take_a:
+					renamed[i] = v.operands[0];
+					break;
+				case sdf_take_b:
+					renamed[i] = v.operands[1];
+					break;
+				case sdf_take_negated_b:
+				{
+					const value negated = { sdf_op_multiply, { v.operands[1], 0, 0 }, { -1, 0, 0, 0 } };
+					renamed[i] = static_cast<unsigned int>(kept.size());
+					kept.push_back(negated);
+					break;
+				}
+				default:
+					renamed[i] = static_cast<unsigned int>(kept.size());
+					kept.push_back(v);
+					break;
+				}
+			}
+
+			// pruning never takes more registers, but the program stays
+			// whole should it
+			std::vector<sdf_instruction> code;
+			std::vector<float> constants;
+			unsigned int registers;
+			unsigned int result;
+			if (assemble(kept, renamed[out], code, constants, registers, result))
+			{
+				pruned.m_code.swap(code);
+				pruned.m_constants.swap(constants);
+				pruned.m_registers = registers;
+				pruned.m_result = result;
+			}
+			else if (&pruned != this)
+			{
+				pruned = *this;
+			}
+			pruned.m_bounds = region;
+			return range[out];
+		}
+
+		template<typename Lane, size_t Width>
+		void SdfProgram::run(Lane *r) const
+		{
+			const float *pool = constants();
+			const size_t count = m_code.size();
+			for (size_t i = 0; i != count; ++i)
+			{
+				const sdf_instruction &instruction = m_code[i];
+				Lane *t = r + instruction.target * Width;
+				const Lane *a = r + instruction.a * Width;
+				const Lane *b = r + instruction.b * Width;
+				const Lane *c = r + instruction.c * Width;
+				const float *k = pool + instruction.constant;
+				switch (instruction.op)
+				{
+				case sdf_op_constant:
+				{
+					const Lane number(k[0]);
+					for (size_t n = 0; n != Width; ++n) t[n] = number;
+					break;
+				}
+				case sdf_op_offset:
+				{
+					const Lane by(k[0]);
+					for (size_t n = 0; n != Width; ++n) t[n] = a[n] - by;
+					break;
+				}
+				case sdf_op_multiply:
+				{
+					const Lane by(k[0]);
+					for (size_t n = 0; n != Width; ++n) t[n] = a[n] * by;
+					break;
+				}
+				case sdf_op_repeat:
+					for (size_t n = 0; n != Width; ++n) t[n] = repeat_coordinate(a[n], k);
+					break;
+				case sdf_op_sphere:
+					for (size_t n = 0; n != Width; ++n) t[n] = sphere_distance(a[n], b[n], c[n], k);
+					break;
+				case sdf_op_box:
+					for (size_t n = 0; n != Width; ++n) t[n] = box_distance(a[n], b[n], c[n], k);
+					break;
+				case sdf_op_torus:
+					for (size_t n = 0; n != Width; ++n) t[n] = torus_distance(a[n], b[n], c[n], k);
+					break;
+				case sdf_op_cylinder:
+					for (size_t n = 0; n != Width; ++n) t[n] = cylinder_distance(a[n], b[n], c[n], k);
+					break;
+				case sdf_op_plane:
+					for (size_t n = 0; n != Width; ++n) t[n] = plane_distance(a[n], b[n], c[n], k);
+					break;
+				case sdf_op_min:
+					for (size_t n = 0; n != Width; ++n) t[n] = lane_min(a[n], b[n]);
+					break;
+				case sdf_op_max:
+					for (size_t n = 0; n != Width; ++n) t[n] = lane_max(a[n], b[n]);
+					break;
+				case sdf_op_difference:
+					for (size_t n = 0; n != Width; ++n) t[n] = lane_max(a[n], -b[n]);
+					break;
+				case sdf_op_smooth_min:
+					for (size_t n = 0; n != Width; ++n) t[n] = smooth_min(a[n], b[n], k);
+					break;
+				}
+			}
+		}
+
+		float SdfProgram::distance(const float3 &p) const
+		{
+			float r[c_sdf_registers];
+			r[0] = p.x;
+			r[1] = p.y;
+			r[2] = p.z;
+			run<float, 1>(r);
+			return r[m_result];
+		}
+
+		float8 SdfProgram::distance(const float3x8 &p) const
+		{
+			// left unset, float8 would clear all of them
+			DYE_ALIGN(32) float storage[c_sdf_registers * c_packet_width];
+			float8 *r = reinterpret_cast<float8 *>(storage);
+			r[0] = p.x;
+			r[1] = p.y;
+			r[2] = p.z;
+			run<float8, 1>(r);
+			return r[m_result];
+		}
+
+		void SdfProgram::distances(const float *x, const float *y, const float *z, size_t count, float *out) const
+		{
+			// 16 points at a time, the last ones padded with copies
+			const size_t c_batch = 2 * c_packet_width;
+			DYE_ALIGN(32) float storage[c_sdf_registers * c_batch];
+			float8 *r = reinterpret_cast<float8 *>(storage);
+			for (size_t first = 0; first < count; first += c_batch)
+			{
+				const size_t n = std::min(c_batch, count - first);
+				if (n == c_batch)
+				{
+					for (size_t half = 0; half != 2; ++half)
+					{
+						r[half] = float8::load(x + first + half * c_packet_width);
+						r[2 + half] = float8::load(y + first + half * c_packet_width);
+						r[4 + half] = float8::load(z + first + half * c_packet_width);
+					}
+				}
+				else
+				{
+					for (size_t i = 0; i != c_batch; ++i)
+					{
+						const size_t from = first + std::min(i, n - 1);
+						r[i / c_packet_width][i % c_packet_width] = x[from];
+						r[2 + i / c_packet_width][i % c_packet_width] = y[from];
+						r[4 + i / c_packet_width][i % c_packet_width] = z[from];
+					}
+				}
+				run<float8, 2>(r);
+				const float8 *result = r + m_result * 2;
+				if (n == c_batch)
+				{
+					result[0].store(out + first);
+					result[1].store(out + first + c_packet_width);
+				}
+				else
+				{
+					for (size_t i = 0; i != n; ++i)
+					{
+						out[first + i] = result[i / c_packet_width][i % c_packet_width];
+					}
+				}
+			}
+		}
+
+		void SdfProgram::distances(const float3 *points, size_t count, float *out) const
+		{
+			const size_t c_batch = 2 * c_packet_width;
+			float x[c_batch], y[c_batch], z[c_batch];
+			for (size_t first = 0; first < count; first += c_batch)
+			{
+				const size_t n = std::min(c_batch, count - first);
+				for (size_t i = 0; i != n; ++i)
+				{
+					x[i] = points[first + i].x;
+					y[i] = points[first + i].y;
+					z[i] = points[first + i].z;
+				}
+				distances(x, y, z, n, out + first);
+			}
+		}
+
+		void SdfProgram::sample_grid(const lattice &grid, float *out) const
+		{
+			// a row at a time, x running and y and z fixed
+			const size_t nx = grid.count[0];
+			if (grid.size() == 0)
+			{
+				return;
+			}
+			std::vector<float> x(nx), y(nx), z(nx);
+			for (size_t i = 0; i != nx; ++i)
+			{
+				x[i] = grid.coordinate(0, grid.first[0] + static_cast<int>(i));
+			}
+			for (size_t k = 0; k != grid.count[2]; ++k)
+			{
+				std::fill(z.begin(), z.end(), grid.coordinate(2, grid.first[2] + static_cast<int>(k)));
+				for (size_t j = 0; j != grid.count[1]; ++j)
+				{
+					std::fill(y.begin(), y.end(), grid.coordinate(1, grid.first[1] + static_cast<int>(j)));
+					distances(&x[0], &y[0], &z[0], nx, out + (k * grid.count[1] + j) * nx);
+				}
+			}
+		}
+
+		void SdfProgram::sample_grid(const float3 &origin, float spacing, size_t nx, size_t ny, size_t nz,
+			float *out) const
+		{
+			const lattice grid = { origin, spacing, { 0, 0, 0 }, { nx, ny, nz } };
+			sample_grid(grid, out);
+		}
+
+		void SdfProgram::range(const aabb &box, float &lower, float &upper) const
+		{
+			const sdf_interval values = evaluate(box);
+			lower = values.lower;
+			upper = values.upper;
+		}
+
+		float SdfProgram::contact(const float3 &p, float3 &normal, float step) const
+		{
+			// the tetrahedron of offsets (1, -1, -1), (-1, -1, 1), (-1, 1, -1)
+			// and (1, 1, 1) in lanes 0 to 3, and p itself in the others
+			const float sx[8] = { 1, -1, -1, 1, 0, 0, 0, 0 };
+			const float sy[8] = { -1, -1, 1, 1, 0, 0, 0, 0 };
+			const float sz[8] = { -1, 1, -1, 1, 0, 0, 0, 0 };
+			const float3x8 points(float8(p.x) + float8::load(sx) * float8(step),
+				float8(p.y) + float8::load(sy) * float8(step), float8(p.z) + float8::load(sz) * float8(step));
+			const float8 d = distance(points);
+			const float3 gradient(d[0] - d[1] - d[2] + d[3], -d[0] - d[1] + d[2] + d[3], -d[0] + d[1] - d[2] + d[3]);
+			const float length = gradient.length();
+			normal = length > 0 ? gradient / length : float3(0, 0, 0);
+			return d[4];
+		}
+	}
+}
@@ -0,0 +1,410 @@
+#include <float.h>
+#include <algorithm>
+#include <cmath>
+#include <sdf_blocks.hpp>
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		SdfBlocks::SdfBlocks()
+			: m_origin(0, 0, 0), m_cell(1), m_leaf_scale(1.0f / c_sdf_leaf_block)
+		{
+			m_bounds = m_program.bounds();
+			m_leaves[0] = m_leaves[1] = m_leaves[2] = 0;
+		}
+
+		void SdfBlocks::build(const SdfProgram &program, const aabb &box, float cell_size)
+		{
+			m_program = program;
+			m_origin = box.lower;
+			m_cell = cell_size;
+			m_leaf_scale = 1 / (cell_size * c_sdf_leaf_block);
+
+			const aabb inner = program.bounds();
+			unsigned int tops[3];
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				m_bounds.lower[axis] = std::max(box.lower[axis], inner.lower[axis]);
+				m_bounds.upper[axis] = std::min(box.upper[axis], inner.upper[axis]);
+				const float leaves = std::ceil((box.upper[axis] - box.lower[axis]) * m_leaf_scale);
+				m_leaves[axis] = std::max(static_cast<unsigned int>(leaves), 1u);
+				tops[axis] = (m_leaves[axis] * c_sdf_leaf_block + c_sdf_top_block - 1) / c_sdf_top_block;
+			}
+
+			// each top block splits on a thread of its own
+			const int top_count = static_cast<int>(tops[0] * tops[1] * tops[2]);
+			std::vector<std::vector<sdf_block> > blocks(top_count);
+			std::vector<std::vector<SdfProgram> > programs(top_count);
+			#pragma omp parallel for schedule(dynamic, 1)
+			for (int top = 0; top < top_count; ++top)
+			{
+				const unsigned int t = static_cast<unsigned int>(top);
+				const unsigned int cell[3] =
+				{
+					t % tops[0] * c_sdf_top_block,
+					t / tops[0] % tops[1] * c_sdf_top_block,
+					t / (tops[0] * tops[1]) * c_sdf_top_block,
+				};
+				split(m_program, cell, c_sdf_top_block, blocks[top], programs[top]);
+			}
+
+			m_blocks.clear();
+			m_programs.clear();
+			for (int top = 0; top != top_count; ++top)
+			{
+				const unsigned int first = static_cast<unsigned int>(m_programs.size());
+				for (size_t i = 0; i != blocks[top].size(); ++i)
+				{
+					sdf_block block = blocks[top][i];
+					if (block.type != sdf_block_inside)
+					{
+						block.program += first;
+					}
+					m_blocks.push_back(block);
+				}
+				m_programs.insert(m_programs.end(), programs[top].begin(), programs[top].end());
+			}
+
+			// every leaf of the grid to the block over it
+			m_lookup.assign(m_leaves[0] * m_leaves[1] * m_leaves[2], c_no_block);
+			for (size_t i = 0; i != m_blocks.size(); ++i)
+			{
+				const sdf_block &block = m_blocks[i];
+				unsigned int first[3], last[3];
+				for (int axis = 0; axis != 3; ++axis)
+				{
+					first[axis] = block.cell[axis] / c_sdf_leaf_block;
+					last[axis] = std::min((block.cell[axis] + block.size) / c_sdf_leaf_block, m_leaves[axis]);
+				}
+				for (unsigned int z = first[2]; z < last[2]; ++z)
+				{
+					for (unsigned int y = first[1]; y < last[1]; ++y)
+					{
+						for (unsigned int x = first[0]; x < last[0]; ++x)
+						{
+							m_lookup[(z * m_leaves[1] + y) * m_leaves[0] + x] = static_cast<unsigned int>(i);
+						}
+					}
+				}
+			}
+		}
+
+		void SdfBlocks::split(const SdfProgram &parent, const unsigned int *cell, unsigned int size,
+			std::vector<sdf_block> &blocks, std::vector<SdfProgram> &programs) const
+		{
+			const float extent = size * m_cell;
+			aabb region;
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				region.lower[axis] = m_origin[axis] + cell[axis] * m_cell;
+				region.upper[axis] = region.lower[axis] + extent;
+			}
+
+			SdfProgram pruned;
+			sdf_block block;
+			block.cell[0] = cell[0];
+			block.cell[1] = cell[1];
+			block.cell[2] = cell[2];
+			block.size = size;
+			block.range = parent.prune(region, pruned);
+			block.program = c_no_block;
+
+			// a cell of margin, so that the surface blocks hold all the
+			// points near the surface
+			if (block.range.upper < -m_cell)
+			{
+				block.type = sdf_block_inside;
+			}
+			else if (block.range.lower <= m_cell && size > c_sdf_leaf_block)
+			{
+				const unsigned int half = size / 2;
+				for (unsigned int octant = 0; octant != 8; ++octant)
+				{
+					const unsigned int child[3] =
+					{
+						cell[0] + (octant & 1) * half,
+						cell[1] + (octant >> 1 & 1) * half,
+						cell[2] + (octant >> 2) * half,
+					};
+					if (child[0] < m_leaves[0] * c_sdf_leaf_block && child[1] < m_leaves[1] * c_sdf_leaf_block
+						&& child[2] < m_leaves[2] * c_sdf_leaf_block)
+					{
+						split(pruned, child, half, blocks, programs);
+					}
+				}
+				return;
+			}
+			else
+			{
+				block.type = block.range.lower > m_cell ? sdf_block_outside : sdf_block_surface;
+				block.program = static_cast<unsigned int>(programs.size());
+				programs.push_back(pruned);
+			}
+			blocks.push_back(block);
+		}
+
+		unsigned int SdfBlocks::find(const float3 &p) const
+		{
+			const float x = (p.x - m_origin.x) * m_leaf_scale;
+			const float y = (p.y - m_origin.y) * m_leaf_scale;
+			const float z = (p.z - m_origin.z) * m_leaf_scale;
+			if (!(x >= 0 && x < m_leaves[0] && y >= 0 && y < m_leaves[1] && z >= 0 && z < m_leaves[2]))
+			{
+				return c_no_block;
+			}
+			const unsigned int index = (static_cast<unsigned int>(z) * m_leaves[1] + static_cast<unsigned int>(y))
+				* m_leaves[0] + static_cast<unsigned int>(x);
+			return m_lookup[index];
+		}
+
+		float SdfBlocks::bound(const sdf_block &block, const float3 &p) const
+		{
+			float side = FLT_MAX;
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				const float lower = m_origin[axis] + block.cell[axis] * m_cell;
+				const float upper = lower + block.size * m_cell;
+				side = std::min(side, std::min(p[axis] - lower, upper - p[axis]));
+			}
+			side = std::max(side, 0.0f);
+			return block.type == sdf_block_outside ? block.range.lower + side : block.range.upper - side;
+		}
+
+		float SdfBlocks::distance(const float3 &p) const
+		{
+			const unsigned int found = find(p);
+			if (found == c_no_block)
+			{
+				return m_program.distance(p);
+			}
+			const sdf_block &block = m_blocks[found];
+			switch (block.type)
+			{
+			case sdf_block_outside:
+				return std::max(m_programs[block.program].distance(p), bound(block, p));
+			case sdf_block_inside:
+				return bound(block, p);
+			default:
+				return m_programs[block.program].distance(p);
+			}
+		}
+
+		float8 SdfBlocks::distance(const float3x8 &p) const
+		{
+			unsigned int found[c_packet_width];
+			bool same = true;
+			for (size_t i = 0; i != c_packet_width; ++i)
+			{
+				found[i] = find(float3(p.x[i], p.y[i], p.z[i]));
+				same = same && found[i] == found[0];
+			}
+
+			// mostly the lanes share a surface block
+			if (same && (found[0] == c_no_block || m_blocks[found[0]].type == sdf_block_surface))
+			{
+				return found[0] == c_no_block ? m_program.distance(p) : m_programs[m_blocks[found[0]].program].distance(p);
+			}
+
+			// else one run of each program for the lanes in its blocks
+			float8 result;
+			bool done[c_packet_width] = { false };
+			for (size_t i = 0; i != c_packet_width; ++i)
+			{
+				if (done[i])
+				{
+					continue;
+				}
+				if (found[i] != c_no_block && m_blocks[found[i]].type == sdf_block_inside)
+				{
+					result[i] = bound(m_blocks[found[i]], float3(p.x[i], p.y[i], p.z[i]));
+					continue;
+				}
+				const SdfProgram &program = found[i] == c_no_block ? m_program : m_programs[m_blocks[found[i]].program];
+				const float8 d = program.distance(p);
+				for (size_t j = i; j != c_packet_width; ++j)
+				{
+					if (found[j] != found[i])
+					{
+						continue;
+					}
+					result[j] = d[j];
+					if (found[j] != c_no_block && m_blocks[found[j]].type == sdf_block_outside)
+					{
+						result[j] = std::max(d[j], bound(m_blocks[found[j]], float3(p.x[j], p.y[j], p.z[j])));
+					}
+					done[j] = true;
+				}
+			}
+			return result;
+		}
+
+		void SdfBlocks::sample_grid(const lattice &grid, float *out) const
+		{
+			// the points along each axis in runs over the same leaf, or
+			// outside the grid, with the coordinates find() sees
+			std::vector<size_t> starts[3];
+			std::vector<int> leaf[3];
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				for (size_t i = 0; i != grid.count[axis]; ++i)
+				{
+					const float at = (grid.coordinate(axis, grid.first[axis] + static_cast<int>(i)) - m_origin[axis])
+						* m_leaf_scale;
+					const int index = at >= 0 && at < m_leaves[axis] ? static_cast<int>(at) : -1;
+					if (i == 0 || index != leaf[axis].back())
+					{
+						starts[axis].push_back(i);
+						leaf[axis].push_back(index);
+					}
+				}
+				starts[axis].push_back(grid.count[axis]);
+			}
+
+			std::vector<float> values;
+			for (size_t rz = 0; rz + 1 < starts[2].size(); ++rz)
+			{
+				for (size_t ry = 0; ry + 1 < starts[1].size(); ++ry)
+				{
+					for (size_t rx = 0; rx + 1 < starts[0].size(); ++rx)
+					{
+						const size_t run[3] = { rx, ry, rz };
+						lattice part = grid;
+						for (int axis = 0; axis != 3; ++axis)
+						{
+							part.first[axis] += static_cast<int>(starts[axis][run[axis]]);
+							part.count[axis] = starts[axis][run[axis] + 1] - starts[axis][run[axis]];
+						}
+						unsigned int found = c_no_block;
+						if (leaf[0][rx] >= 0 && leaf[1][ry] >= 0 && leaf[2][rz] >= 0)
+						{
+							found = m_lookup[(leaf[2][rz] * m_leaves[1] + leaf[1][ry]) * m_leaves[0] + leaf[0][rx]];
+						}
+
+						// the whole lattice in one leaf goes straight to out
+						const bool whole = part.size() == grid.size();
+						float *target = out;
+						if (!whole)
+						{
+							values.resize(part.size());
+							target = &values[0];
+						}
+						const sdf_block *block = found == c_no_block ? 0 : &m_blocks[found];
+						if (block == 0)
+						{
+							m_program.sample_grid(part, target);
+						}
+						else if (block->type != sdf_block_inside)
+						{
+							m_programs[block->program].sample_grid(part, target);
+						}
+						if (block != 0 && block->type != sdf_block_surface)
+						{
+							size_t n = 0;
+							for (size_t k = 0; k != part.count[2]; ++k)
+							{
+								for (size_t j = 0; j != part.count[1]; ++j)
+								{
+									for (size_t i = 0; i != part.count[0]; ++i, ++n)
+									{
+										const float3 p(part.coordinate(0, part.first[0] + static_cast<int>(i)),
+											part.coordinate(1, part.first[1] + static_cast<int>(j)),
+											part.coordinate(2, part.first[2] + static_cast<int>(k)));
+										target[n] = block->type == sdf_block_inside ? bound(*block, p)
+											: std::max(target[n], bound(*block, p));
+									}
+								}
+							}
+						}
+						if (whole)
+						{
+							return;
+						}
+
+						// else into its place in out, a row at a time
+						for (size_t k = 0; k != part.count[2]; ++k)
+						{
+							for (size_t j = 0; j != part.count[1]; ++j)
+							{
+								const size_t row = ((starts[2][rz] + k) * grid.count[1] + starts[1][ry] + j) * grid.count[0]
+									+ starts[0][rx];
+								std::copy(&values[0] + (k * part.count[1] + j) * part.count[0],
+									&values[0] + (k * part.count[1] + j + 1) * part.count[0], out + row);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		void SdfBlocks::range(const aabb &box, float &lower, float &upper) const
+		{
+			// the leaves box meets, none of them outside the grid
+			unsigned int first[3], last[3];
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				const float from = (box.lower[axis] - m_origin[axis]) * m_leaf_scale;
+				const float to = (box.upper[axis] - m_origin[axis]) * m_leaf_scale;
+				if (!(from >= 0 && to < m_leaves[axis]))
+				{
+					lower = -FLT_MAX;
+					upper = FLT_MAX;
+					return;
+				}
+				first[axis] = static_cast<unsigned int>(from);
+				last[axis] = static_cast<unsigned int>(to);
+			}
+
+			lower = FLT_MAX;
+			upper = -FLT_MAX;
+			for (unsigned int z = first[2]; z <= last[2]; ++z)
+			{
+				for (unsigned int y = first[1]; y <= last[1]; ++y)
+				{
+					for (unsigned int x = first[0]; x <= last[0]; ++x)
+					{
+						const unsigned int found = m_lookup[(z * m_leaves[1] + y) * m_leaves[0] + x];
+						if (found == c_no_block)
+						{
+							lower = -FLT_MAX;
+							upper = FLT_MAX;
+							return;
+						}
+						// the bounds of the blocks outside and inside reach half
+						// their side past the range
+						const sdf_block &block = m_blocks[found];
+						const float half = block.size * m_cell * 0.5f;
+						lower = std::min(lower, block.type == sdf_block_inside ? block.range.upper - half : block.range.lower);
+						upper = std::max(upper, block.type == sdf_block_outside ? std::max(block.range.upper, block.range.lower + half)
+							: block.range.upper);
+					}
+				}
+			}
+		}
+
+		size_t SdfBlocks::count(sdf_block_type type) const
+		{
+			size_t n = 0;
+			for (size_t i = 0; i != m_blocks.size(); ++i)
+			{
+				n += m_blocks[i].type == type;
+			}
+			return n;
+		}
+
+		double SdfBlocks::average_instructions() const
+		{
+			size_t total = 0;
+			size_t surface = 0;
+			for (size_t i = 0; i != m_blocks.size(); ++i)
+			{
+				if (m_blocks[i].type == sdf_block_surface)
+				{
+					total += m_programs[m_blocks[i].program].instruction_count();
+					++surface;
+				}
+			}
+			return surface == 0 ? 0 : static_cast<double>(total) / surface;
+		}
+	}
+}
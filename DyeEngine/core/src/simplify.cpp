@@ -0,0 +1,727 @@
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <mesh.hpp>
+#include <simplify.hpp>
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		namespace
+		{
+			const unsigned int c_invalid = ~0u;
+
+			// a border or seam edge holds its place with a plane through it,
+			// upright on its face, weighted that much over the faces
+			const float c_border_weight = 10.0f;
+
+			// a level that keeps more of the triangles is not worth storing
+			const float c_min_progress = 0.95f;
+
+			// no collapse leaves a triangle thinner than that, twice its area
+			// over the square of its longest edge; on a plane those fold into
+			// lines that face anywhere after rounding
+			const float c_min_sliver = 1e-3f;
+
+			//////////////////////////////////////////////////////////////////////////
+			// quadrics
+			//////////////////////////////////////////////////////////////////////////
+
+			// the weighted sum of squared distances to planes, as the
+			// symmetric 4x4 matrix of the plane equations
+			struct quadric
+			{
+				float a2, b2, c2, d2;
+				float ab, ac, ad, bc, bd, cd;
+				float weight;
+
+				quadric()
+				{
+					memset(this, 0, sizeof(*this));
+				}
+
+				// n normalized, dot(n, p) + d = 0 on the plane
+				void add_plane(const float3 &n, float d, float w)
+				{
+					a2 += w * n.x * n.x;
+					b2 += w * n.y * n.y;
+					c2 += w * n.z * n.z;
+					d2 += w * d * d;
+					ab += w * n.x * n.y;
+					ac += w * n.x * n.z;
+					ad += w * n.x * d;
+					bc += w * n.y * n.z;
+					bd += w * n.y * d;
+					cd += w * n.z * d;
+					weight += w;
+				}
+
+				quadric &operator += (const quadric &rhs)
+				{
+					a2 += rhs.a2; b2 += rhs.b2; c2 += rhs.c2; d2 += rhs.d2;
+					ab += rhs.ab; ac += rhs.ac; ad += rhs.ad;
+					bc += rhs.bc; bd += rhs.bd; cd += rhs.cd;
+					weight += rhs.weight;
+					return *this;
+				}
+
+				// the mean squared distance of p to the planes
+				float error(const float3 &p) const
+				{
+					float x = p.x, y = p.y, z = p.z;
+					float e = a2 * x * x + b2 * y * y + c2 * z * z + d2
+						+ 2 * (ab * x * y + ac * x * z + bc * y * z)
+						+ 2 * (ad * x + bd * y + cd * z);
+					return weight > 0 ? std::max(e, 0.0f) / weight : 0.0f;
+				}
+			};
+
+			// the position of the vertex with -0 made 0
+			void position_key(const float3 &p, unsigned int *key)
+			{
+				memcpy(&key[0], &p.x, sizeof(float));
+				memcpy(&key[1], &p.y, sizeof(float));
+				memcpy(&key[2], &p.z, sizeof(float));
+				for (int i = 0; i != 3; ++i)
+				{
+					key[i] = key[i] == 0x80000000u ? 0 : key[i];
+				}
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			// simplifier
+			//////////////////////////////////////////////////////////////////////////
+
+			// what a vertex may collapse along
+			enum vertex_kind
+			{
+				kind_manifold,	// any edge
+				kind_border,	// its two open edges
+				kind_seam,		// its two seam edges, with its copy
+				kind_locked		// none
+			};
+
+			struct collapse
+			{
+				float cost;
+				unsigned int from;
+				unsigned int to;
+
+				// cheapest first out of a std heap
+				bool operator < (const collapse &rhs) const
+				{
+					return cost > rhs.cost;
+				}
+			};
+
+			// the vertices, their kinds and quadrics are set up once from the
+			// full mesh; the quadrics take in those of the vertices collapsed
+			// into them, so the error grows over all the levels of a chain
+			class simplifier
+			{
+			public:
+				simplifier(const vertex *vertices, size_t vertex_count, const unsigned int *indices, size_t index_count);
+
+				// down to about target_index_count in place, while the error
+				// stays within max_error
+				void reduce(std::vector<unsigned int> &indices, size_t target_index_count, float max_error);
+
+				// the largest collapse so far, in object space
+				float error() const { return std::sqrt(m_error) / m_scale; }
+
+			private:
+				bool pass(std::vector<unsigned int> &indices, size_t target_index_count, float max_cost);
+
+				float cost(unsigned int from, unsigned int to) const;
+				bool flips(unsigned int from, unsigned int to) const;
+				unsigned int seam_partner(unsigned int from, unsigned int to) const;
+
+				// the other copy of a seam vertex
+				unsigned int sibling(unsigned int v) const { return m_next[v]; }
+
+				// whether a triangle runs from a to b, by index or at their
+				// positions, scanning the triangles around a
+				bool has_half_edge(unsigned int a, unsigned int b) const;
+				bool has_position_half_edge(unsigned int a, unsigned int b) const;
+				bool has_edge(unsigned int a, unsigned int b) const { return has_half_edge(a, b) || has_half_edge(b, a); }
+				bool is_border_edge(unsigned int a, unsigned int b) const;
+				bool is_seam_edge(unsigned int a, unsigned int b) const;
+
+				void build_adjacency(const unsigned int *indices, size_t index_count);
+				void classify(const unsigned int *indices, size_t index_count);
+				void build_quadrics(const unsigned int *indices, size_t index_count);
+
+			private:
+				size_t m_vertex_count;
+
+				// in the unit cube around the origin
+				std::vector<float3> m_positions;
+				float m_scale;
+
+				// the first vertex at the same position, and a ring through
+				// all of them
+				std::vector<unsigned int> m_position_ids;
+				std::vector<unsigned int> m_next;
+
+				std::vector<unsigned char> m_kinds;
+				std::vector<quadric> m_quadrics;
+				float m_error;
+
+				// the state of a pass: the triangles around each vertex, and
+				// where each vertex went
+				const unsigned int *m_indices;
+				std::vector<unsigned int> m_offsets;
+				std::vector<unsigned int> m_adjacent;
+				std::vector<unsigned int> m_remap;
+				std::vector<unsigned char> m_locked;
+			};
+
+			simplifier::simplifier(const vertex *vertices, size_t vertex_count, const unsigned int *indices, size_t index_count)
+				: m_vertex_count(vertex_count)
+				, m_positions(vertex_count)
+				, m_scale(1)
+				, m_position_ids(vertex_count)
+				, m_next(vertex_count)
+				, m_kinds(vertex_count, kind_manifold)
+				, m_quadrics(vertex_count)
+				, m_error(0)
+				, m_indices(0)
+			{
+				if (vertex_count == 0)
+				{
+					return;
+				}
+
+				// normalized, so that the quadrics keep their precision in
+				// floats far from the origin
+				float3 lower = vertices[0].pos;
+				float3 upper = vertices[0].pos;
+				for (size_t i = 1; i != vertex_count; ++i)
+				{
+					const float3 &p = vertices[i].pos;
+					lower = float3(std::min(lower.x, p.x), std::min(lower.y, p.y), std::min(lower.z, p.z));
+					upper = float3(std::max(upper.x, p.x), std::max(upper.y, p.y), std::max(upper.z, p.z));
+				}
+				float extent = std::max(upper.x - lower.x, std::max(upper.y - lower.y, upper.z - lower.z));
+				m_scale = extent > 0 ? 1 / extent : 1.0f;
+				float3 center = (lower + upper) * 0.5f;
+				for (size_t i = 0; i != vertex_count; ++i)
+				{
+					float3 offset = vertices[i].pos - center;
+					m_positions[i] = offset * m_scale;
+				}
+
+				// vertices at the same position, as weld_vertices() finds
+				// them but by position alone
+				size_t buckets = 1;
+				while (buckets < vertex_count + vertex_count / 4 + 1)
+				{
+					buckets *= 2;
+				}
+				std::vector<unsigned int> table(buckets, c_invalid);
+				unsigned int key[3];
+				unsigned int other[3];
+				for (size_t i = 0; i != vertex_count; ++i)
+				{
+					position_key(vertices[i].pos, key);
+					unsigned int h = 0x811c9dc5u;
+					for (int k = 0; k != 3; ++k)
+					{
+						h = (h ^ key[k]) * 0x5bd1e995u;
+						h ^= h >> 15;
+					}
+
+					unsigned int v = static_cast<unsigned int>(i);
+					m_position_ids[i] = m_next[i] = v;
+					for (size_t bucket = h & (buckets - 1); ; bucket = (bucket + 1) & (buckets - 1))
+					{
+						unsigned int first = table[bucket];
+						if (first == c_invalid)
+						{
+							table[bucket] = v;
+							break;
+						}
+
+						position_key(vertices[first].pos, other);
+						if (memcmp(key, other, sizeof(key)) == 0)
+						{
+							m_position_ids[i] = first;
+							m_next[i] = m_next[first];
+							m_next[first] = v;
+							break;
+						}
+					}
+				}
+
+				build_adjacency(indices, index_count);
+				classify(indices, index_count);
+				build_quadrics(indices, index_count);
+				m_indices = 0;
+			}
+
+			void simplifier::build_adjacency(const unsigned int *indices, size_t index_count)
+			{
+				m_indices = indices;
+				m_offsets.assign(m_vertex_count + 1, 0);
+				for (size_t i = 0; i != index_count; ++i)
+				{
+					++m_offsets[indices[i] + 1];
+				}
+				for (size_t v = 0; v != m_vertex_count; ++v)
+				{
+					m_offsets[v + 1] += m_offsets[v];
+				}
+				m_adjacent.resize(index_count);
+				std::vector<unsigned int> fill(m_offsets.begin(), m_offsets.end() - 1);
+				for (size_t i = 0; i != index_count; ++i)
+				{
+					m_adjacent[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+				}
+			}
+
+			bool simplifier::has_half_edge(unsigned int a, unsigned int b) const
+			{
+				for (unsigned int i = m_offsets[a]; i != m_offsets[a + 1]; ++i)
+				{
+					const unsigned int *tri = m_indices + m_adjacent[i] * 3;
+					if ((tri[0] == a && tri[1] == b) || (tri[1] == a && tri[2] == b) || (tri[2] == a && tri[0] == b))
+					{
+						return true;
+					}
+				}
+				return false;
+			}
+
+			bool simplifier::has_position_half_edge(unsigned int a, unsigned int b) const
+			{
+				unsigned int target = m_position_ids[b];
+				unsigned int v = a;
+				do
+				{
+					for (unsigned int i = m_offsets[v]; i != m_offsets[v + 1]; ++i)
+					{
+						const unsigned int *tri = m_indices + m_adjacent[i] * 3;
+						int k = tri[0] == v ? 0 : tri[1] == v ? 1 : 2;
+						if (m_position_ids[tri[(k + 1) % 3]] == target)
+						{
+							return true;
+						}
+					}
+					v = m_next[v];
+				}
+				while (v != a);
+				return false;
+			}
+
+			void simplifier::classify(const unsigned int *indices, size_t index_count)
+			{
+				// the open edges leaving and entering each vertex: a border
+				// without a way back at any position, a seam with one at the
+				// position of another copy only
+				std::vector<unsigned char> border_out(m_vertex_count, 0);
+				std::vector<unsigned char> border_in(m_vertex_count, 0);
+				std::vector<unsigned char> seam_out(m_vertex_count, 0);
+				std::vector<unsigned char> seam_in(m_vertex_count, 0);
+				for (size_t i = 0; i != index_count; i += 3)
+				{
+					for (int k = 0; k != 3; ++k)
+					{
+						unsigned int a = indices[i + k];
+						unsigned int b = indices[i + (k + 1) % 3];
+						if (!has_position_half_edge(b, a))
+						{
+							border_out[a] = static_cast<unsigned char>(std::min(border_out[a] + 1, 2));
+							border_in[b] = static_cast<unsigned char>(std::min(border_in[b] + 1, 2));
+						}
+						else if (!has_half_edge(b, a))
+						{
+							seam_out[a] = static_cast<unsigned char>(std::min(seam_out[a] + 1, 2));
+							seam_in[b] = static_cast<unsigned char>(std::min(seam_in[b] + 1, 2));
+						}
+					}
+				}
+
+				for (size_t v = 0; v != m_vertex_count; ++v)
+				{
+					unsigned int s = m_next[v];
+					bool open = border_out[v] != 0 || border_in[v] != 0;
+					bool seam = seam_out[v] != 0 || seam_in[v] != 0;
+					if (s == v)
+					{
+						// a seam that ends here would lose its end to the
+						// attributes of one side
+						if (seam)
+						{
+							m_kinds[v] = kind_locked;
+						}
+						else if (open)
+						{
+							m_kinds[v] = border_out[v] == 1 && border_in[v] == 1 ? kind_border : kind_locked;
+						}
+					}
+					else if (m_next[s] == v && !open && border_out[s] == 0 && border_in[s] == 0)
+					{
+						m_kinds[v] = seam_out[v] == 1 && seam_in[v] == 1 ? kind_seam : kind_locked;
+					}
+					else
+					{
+						m_kinds[v] = kind_locked;
+					}
+				}
+			}
+
+			void simplifier::build_quadrics(const unsigned int *indices, size_t index_count)
+			{
+				for (size_t i = 0; i != index_count; i += 3)
+				{
+					const unsigned int *tri = indices + i;
+					float3 e1 = m_positions[tri[1]] - m_positions[tri[0]];
+					float3 e2 = m_positions[tri[2]] - m_positions[tri[0]];
+					float3 n = cross(e1, e2);
+					float length = n.length();
+					if (length == 0)
+					{
+						continue;
+					}
+					n *= 1 / length;
+
+					// weighted by area
+					float d = -dot(n, m_positions[tri[0]]);
+					for (int k = 0; k != 3; ++k)
+					{
+						m_quadrics[m_position_ids[tri[k]]].add_plane(n, d, length * 0.5f);
+					}
+
+					for (int k = 0; k != 3; ++k)
+					{
+						unsigned int a = tri[k];
+						unsigned int b = tri[(k + 1) % 3];
+						if (has_half_edge(b, a))
+						{
+							continue;
+						}
+
+						float3 edge = m_positions[b] - m_positions[a];
+						float3 side = cross(edge, n);
+						float side_length = side.length();
+						if (side_length == 0)
+						{
+							continue;
+						}
+						side *= 1 / side_length;
+						float side_d = -dot(side, m_positions[a]);
+						float w = c_border_weight * edge.length_sqr();
+						m_quadrics[m_position_ids[a]].add_plane(side, side_d, w);
+						m_quadrics[m_position_ids[b]].add_plane(side, side_d, w);
+					}
+				}
+			}
+
+			bool simplifier::is_border_edge(unsigned int a, unsigned int b) const
+			{
+				return (has_half_edge(a, b) && !has_position_half_edge(b, a))
+					|| (has_half_edge(b, a) && !has_position_half_edge(a, b));
+			}
+
+			bool simplifier::is_seam_edge(unsigned int a, unsigned int b) const
+			{
+				return (has_half_edge(a, b) && !has_half_edge(b, a) && has_position_half_edge(b, a))
+					|| (has_half_edge(b, a) && !has_half_edge(a, b) && has_position_half_edge(a, b));
+			}
+
+			// the copy of to that the copy of from has an edge to
+			unsigned int simplifier::seam_partner(unsigned int from, unsigned int to) const
+			{
+				unsigned int other = sibling(from);
+				unsigned int v = to;
+				do
+				{
+					if (v != to && has_edge(other, v))
+					{
+						return v;
+					}
+					v = m_next[v];
+				}
+				while (v != to);
+				return c_invalid;
+			}
+
+			// the squared error of moving from onto to, or -1 where the kinds
+			// do not allow it
+			float simplifier::cost(unsigned int from, unsigned int to) const
+			{
+				switch (m_kinds[from])
+				{
+				case kind_manifold:
+					break;
+				case kind_border:
+					if (!is_border_edge(from, to))
+					{
+						return -1;
+					}
+					break;
+				case kind_seam:
+					if (!is_seam_edge(from, to) || seam_partner(from, to) == c_invalid)
+					{
+						return -1;
+					}
+					break;
+				default:
+					return -1;
+				}
+
+				quadric q = m_quadrics[m_position_ids[from]];
+				q += m_quadrics[m_position_ids[to]];
+				return q.error(m_positions[to]);
+			}
+
+			// whether a triangle around from turns over, or nearly vanishes, when
+			// from moves to to
+			bool simplifier::flips(unsigned int from, unsigned int to) const
+			{
+				const float3 &target = m_positions[to];
+				for (unsigned int i = m_offsets[from]; i != m_offsets[from + 1]; ++i)
+				{
+					const unsigned int *tri = m_indices + m_adjacent[i] * 3;
+					unsigned int v[3] = { m_remap[tri[0]], m_remap[tri[1]], m_remap[tri[2]] };
+					if (v[0] == to || v[1] == to || v[2] == to || v[0] == v[1] || v[1] == v[2] || v[0] == v[2])
+					{
+						continue;
+					}
+
+					int k = v[0] == from ? 0 : v[1] == from ? 1 : 2;
+					const float3 &p1 = m_positions[v[(k + 1) % 3]];
+					const float3 &p2 = m_positions[v[(k + 2) % 3]];
+					float3 e1 = p1 - m_positions[from];
+					float3 e2 = p2 - m_positions[from];
+					float3 before = cross(e1, e2);
+					float3 f1 = p1 - target;
+					float3 f2 = p2 - target;
+					float3 after = cross(f1, f2);
+					float3 f3 = p2 - p1;
+					float longest = std::max(f1.length_sqr(), std::max(f2.length_sqr(), f3.length_sqr()));
+					if (dot(before, after) <= 0 || after.length_sqr() < c_min_sliver * c_min_sliver * longest * longest)
+					{
+						return true;
+					}
+				}
+				return false;
+			}
+
+			bool simplifier::pass(std::vector<unsigned int> &indices, size_t target_index_count, float max_cost)
+			{
+				const size_t index_count = indices.size();
+				const size_t triangle_count = index_count / 3;
+
+				build_adjacency(&indices[0], index_count);
+
+				m_remap.resize(m_vertex_count);
+				for (size_t v = 0; v != m_vertex_count; ++v)
+				{
+					m_remap[v] = static_cast<unsigned int>(v);
+				}
+				m_locked.assign(m_vertex_count, 0);
+
+				// each edge once, from the side of its first half, in the
+				// cheaper direction
+				std::vector<collapse> heap(index_count);
+				const int n = static_cast<int>(index_count);
+				#pragma omp parallel for if (n > 1 << 16)
+				for (int i = 0; i < n; ++i)
+				{
+					unsigned int a = indices[i];
+					unsigned int b = indices[i - i % 3 + (i + 1) % 3];
+					collapse c = { -1, a, b };
+					if (a < b || !has_half_edge(b, a))
+					{
+						float forward = cost(a, b);
+						float backward = cost(b, a);
+						if (backward >= 0 && (forward < 0 || backward < forward))
+						{
+							c.cost = backward;
+							c.from = b;
+							c.to = a;
+						}
+						else
+						{
+							c.cost = forward;
+						}
+					}
+					heap[i] = c;
+				}
+
+				size_t candidates = 0;
+				for (size_t i = 0; i != index_count; ++i)
+				{
+					if (heap[i].cost >= 0)
+					{
+						heap[candidates++] = heap[i];
+					}
+				}
+				heap.resize(candidates);
+				std::make_heap(heap.begin(), heap.end());
+
+				// the collapses of a pass do not touch each other, so that
+				// their costs and flip tests hold until the next one
+				const size_t goal = (index_count - target_index_count) / 3;
+				size_t removed = 0;
+				while (!heap.empty() && removed < goal)
+				{
+					std::pop_heap(heap.begin(), heap.end());
+					collapse c = heap.back();
+					heap.pop_back();
+					if (c.cost > max_cost)
+					{
+						break;
+					}
+					if (m_locked[c.from] || m_locked[c.to])
+					{
+						continue;
+					}
+
+					unsigned int from[2] = { c.from, c_invalid };
+					unsigned int to[2] = { c.to, c_invalid };
+					if (m_kinds[c.from] == kind_seam)
+					{
+						from[1] = sibling(c.from);
+						to[1] = seam_partner(c.from, c.to);
+						if (to[1] == c_invalid || m_locked[from[1]] || m_locked[to[1]])
+						{
+							continue;
+						}
+					}
+					if (flips(from[0], to[0]) || (from[1] != c_invalid && flips(from[1], to[1])))
+					{
+						continue;
+					}
+
+					for (int k = 0; k != 2 && from[k] != c_invalid; ++k)
+					{
+						for (unsigned int i = m_offsets[from[k]]; i != m_offsets[from[k] + 1]; ++i)
+						{
+							const unsigned int *tri = m_indices + m_adjacent[i] * 3;
+							removed += m_remap[tri[0]] == to[k] || m_remap[tri[1]] == to[k] || m_remap[tri[2]] == to[k];
+						}
+						m_remap[from[k]] = to[k];
+						m_locked[from[k]] = m_locked[to[k]] = 1;
+					}
+
+					// the copies share a quadric
+					m_quadrics[m_position_ids[c.to]] += m_quadrics[m_position_ids[c.from]];
+					m_error = std::max(m_error, c.cost);
+				}
+
+				m_indices = 0;
+				if (removed == 0)
+				{
+					return false;
+				}
+
+				size_t kept = 0;
+				for (size_t i = 0; i != triangle_count; ++i)
+				{
+					unsigned int a = m_remap[indices[i * 3 + 0]];
+					unsigned int b = m_remap[indices[i * 3 + 1]];
+					unsigned int c = m_remap[indices[i * 3 + 2]];
+					if (a != b && b != c && a != c)
+					{
+						indices[kept++] = a;
+						indices[kept++] = b;
+						indices[kept++] = c;
+					}
+				}
+				indices.resize(kept);
+				return true;
+			}
+
+			void simplifier::reduce(std::vector<unsigned int> &indices, size_t target_index_count, float max_error)
+			{
+				float max_scaled = max_error * m_scale;
+				float max_cost = max_scaled * max_scaled;
+				while (indices.size() > target_index_count && pass(indices, target_index_count, max_cost))
+				{
+				}
+			}
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// simplification
+		//////////////////////////////////////////////////////////////////////////
+		size_t simplify(const vertex *vertices, size_t vertex_count,
+			const unsigned int *indices, size_t index_count,
+			size_t target_index_count, unsigned int *out,
+			float max_error, float *error)
+		{
+			std::vector<unsigned int> result(indices, indices + index_count);
+			simplifier s(vertices, vertex_count, indices, index_count);
+			s.reduce(result, target_index_count, max_error);
+
+			std::copy(result.begin(), result.end(), out);
+			if (error)
+			{
+				*error = s.error();
+			}
+			return result.size();
+		}
+
+		void build_lods(const vertex *vertices, size_t vertex_count,
+			const unsigned int *indices, size_t index_count, const lod_options &options,
+			std::vector<unsigned int> &lod_indices, std::vector<mesh_lod> &lods)
+		{
+			lod_indices.assign(indices, indices + index_count);
+			lods.clear();
+			mesh_lod full = { 0, static_cast<unsigned int>(index_count), 0.0f, 0 };
+			lods.push_back(full);
+
+			simplifier s(vertices, vertex_count, indices, index_count);
+			std::vector<unsigned int> level(indices, indices + index_count);
+			std::vector<unsigned int> ordered;
+			while (lods.size() < options.max_levels && level.size() / 3 > options.min_triangles)
+			{
+				size_t before = level.size();
+				size_t target = static_cast<size_t>(before / 3 * options.reduction);
+				s.reduce(level, std::max(target, options.min_triangles) * 3, options.max_error);
+				if (level.empty() || level.size() > before * c_min_progress)
+				{
+					break;
+				}
+
+				ordered.resize(level.size());
+				optimize_vertex_cache(&level[0], level.size(), vertex_count, &ordered[0]);
+				mesh_lod lod = { static_cast<unsigned int>(lod_indices.size()), static_cast<unsigned int>(ordered.size()), s.error(), 0 };
+				lods.push_back(lod);
+				lod_indices.insert(lod_indices.end(), ordered.begin(), ordered.end());
+			}
+		}
+
+		void build_lods(const IMeshable &mesh, const lod_options &options,
+			std::vector<vertex> &vertices, std::vector<unsigned int> &lod_indices, std::vector<mesh_lod> &lods)
+		{
+			vertices.resize(mesh.vertex_count());
+			std::vector<unsigned int> indices(mesh.triangle_count() * 3);
+			if (!vertices.empty())
+			{
+				mesh.get_vertices(0, vertices.size(), &vertices[0]);
+			}
+			if (!indices.empty())
+			{
+				mesh.get_triangles(0, mesh.triangle_count(), &indices[0]);
+			}
+			build_lods(vertices.empty() ? 0 : &vertices[0], vertices.size(),
+				indices.empty() ? 0 : &indices[0], indices.size(), options, lod_indices, lods);
+		}
+
+		size_t select_lod(const mesh_lod *lods, size_t lod_count, float distance, float threshold)
+		{
+			// the errors grow down the chain
+			float tolerance = distance * threshold;
+			size_t level = 0;
+			while (level + 1 < lod_count && lods[level + 1].error <= tolerance)
+			{
+				++level;
+			}
+			return level;
+		}
+	}
+}
@@ -0,0 +1,713 @@
+#include <float.h>
+#include <algorithm>
+#include <cmath>
+#include <sparse_volume.hpp>
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		namespace
+		{
+			// the bytes map the band onto -127 to 127
+			const float c_byte_steps = 127;
+
+			// the corners of a cell from its low one in a brick, x lowest
+			const size_t c_corners[8] =
+			{
+				0, 1, c_brick_points, c_brick_points + 1,
+				c_brick_points * c_brick_points, c_brick_points * c_brick_points + 1,
+				c_brick_points * c_brick_points + c_brick_points, c_brick_points * c_brick_points + c_brick_points + 1,
+			};
+
+			template<typename T>
+			T trilinear(const T *c, const T &wx, const T &wy, const T &wz)
+			{
+				const T x0 = c[0] + (c[1] - c[0]) * wx;
+				const T x1 = c[2] + (c[3] - c[2]) * wx;
+				const T x2 = c[4] + (c[5] - c[4]) * wx;
+				const T x3 = c[6] + (c[7] - c[6]) * wx;
+				const T y0 = x0 + (x1 - x0) * wy;
+				const T y1 = x2 + (x3 - x2) * wy;
+				return y0 + (y1 - y0) * wz;
+			}
+		}
+
+		SparseVolume::SparseVolume()
+			: m_origin(0, 0, 0), m_cell(1), m_band(1), m_precision(volume_float)
+		{
+			// a single tile outside, until built
+			m_box.lower = m_box.upper = float3(0, 0, 0);
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				m_cells[axis] = 1;
+				m_bricks[axis] = 1;
+			}
+			m_map.assign(1, c_tile_outside);
+			m_clearance.assign(1, 255);
+		}
+
+		void SparseVolume::build(const IScalarField &field, const aabb &box, float cell_size, float band,
+			volume_precision precision)
+		{
+			m_origin = box.lower;
+			m_cell = cell_size;
+			m_band = band;
+			m_box = box;
+			m_precision = precision;
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				const float cells = std::ceil((box.upper[axis] - box.lower[axis]) / cell_size);
+				m_cells[axis] = std::max(static_cast<unsigned int>(cells), 1u);
+				m_bricks[axis] = (m_cells[axis] + c_brick_cells - 1) / c_brick_cells;
+			}
+
+			// the points of each brick the band may reach, empty for a tile
+			const int count = static_cast<int>(m_bricks[0] * m_bricks[1] * m_bricks[2]);
+			std::vector<std::vector<float> > values(count);
+			m_map.assign(count, c_tile_outside);
+			#pragma omp parallel for schedule(dynamic, 16)
+			for (int i = 0; i < count; ++i)
+			{
+				const unsigned int b = static_cast<unsigned int>(i);
+				const unsigned int cell[3] =
+				{
+					b % m_bricks[0] * c_brick_cells,
+					b / m_bricks[0] % m_bricks[1] * c_brick_cells,
+					b / (m_bricks[0] * m_bricks[1]) * c_brick_cells,
+				};
+				aabb region;
+				for (int axis = 0; axis != 3; ++axis)
+				{
+					region.lower[axis] = m_origin[axis] + m_cell * cell[axis];
+					region.upper[axis] = m_origin[axis] + m_cell * (cell[axis] + c_brick_cells);
+				}
+				float lower, upper;
+				field.range(region, lower, upper);
+				if (lower > m_band || upper < -m_band)
+				{
+					m_map[i] = lower > m_band ? c_tile_outside : c_tile_inside;
+					continue;
+				}
+
+				const lattice grid =
+				{
+					m_origin, m_cell,
+					{ static_cast<int>(cell[0]), static_cast<int>(cell[1]), static_cast<int>(cell[2]) },
+					{ c_brick_points, c_brick_points, c_brick_points },
+				};
+				std::vector<float> &brick = values[i];
+				brick.resize(c_brick_values);
+				field.sample_grid(grid, &brick[0]);
+				bool near = false;
+				bool below = false;
+				bool above = false;
+				for (size_t j = 0; j != c_brick_values; ++j)
+				{
+					near = near || std::abs(brick[j]) <= m_band;
+					below = below || brick[j] < 0;
+					above = above || brick[j] >= 0;
+				}
+				if (!near && !(below && above))
+				{
+					m_map[i] = below ? c_tile_inside : c_tile_outside;
+					std::vector<float>().swap(brick);
+				}
+			}
+
+			// the bricks kept, in the order of the map
+			m_brick_cells.clear();
+			std::vector<int> kept;
+			for (int i = 0; i != count; ++i)
+			{
+				if (values[i].empty())
+				{
+					continue;
+				}
+				const unsigned int b = static_cast<unsigned int>(i);
+				m_map[i] = static_cast<unsigned int>(kept.size());
+				m_brick_cells.push_back(b % m_bricks[0] * c_brick_cells);
+				m_brick_cells.push_back(b / m_bricks[0] % m_bricks[1] * c_brick_cells);
+				m_brick_cells.push_back(b / (m_bricks[0] * m_bricks[1]) * c_brick_cells);
+				kept.push_back(i);
+			}
+			const size_t total = kept.size() * c_brick_values;
+			m_floats.clear();
+			m_halves.clear();
+			m_bytes.clear();
+			switch (precision)
+			{
+			case volume_half:
+				m_halves.resize(total);
+				break;
+			case volume_byte:
+				m_bytes.resize(total);
+				break;
+			default:
+				m_floats.resize(total);
+				break;
+			}
+			m_brick_ranges.resize(kept.size() * 2);
+
+			const int kept_count = static_cast<int>(kept.size());
+			#pragma omp parallel for schedule(dynamic, 16)
+			for (int k = 0; k < kept_count; ++k)
+			{
+				std::vector<float> &brick = values[kept[k]];
+				const size_t first = k * c_brick_values;
+				for (size_t j = 0; j != c_brick_values; ++j)
+				{
+					const float v = brick[j];
+					switch (precision)
+					{
+					case volume_half:
+						m_halves[first + j] = half(v);
+						break;
+					case volume_byte:
+						m_bytes[first + j] = static_cast<signed char>(
+							std::floor(std::min(std::max(v / m_band, -1.0f), 1.0f) * c_byte_steps + 0.5f));
+						break;
+					default:
+						m_floats[first + j] = v;
+						break;
+					}
+				}
+
+				// the range of the values as they decode
+				decode(k, &brick[0]);
+				m_brick_ranges[k * 2] = *std::min_element(brick.begin(), brick.end());
+				m_brick_ranges[k * 2 + 1] = *std::max_element(brick.begin(), brick.end());
+				std::vector<float>().swap(brick);
+			}
+
+			// the clearance of the tiles outside by two passes over the map,
+			// each taking the neighbours behind it, which count the
+			// chebyshev distance out
+			m_clearance.resize(count);
+			for (int i = 0; i != count; ++i)
+			{
+				m_clearance[i] = m_map[i] == c_tile_outside ? 255 : 0;
+			}
+			for (int pass = 0; pass != 2; ++pass)
+			{
+				const int way = pass == 0 ? 1 : -1;
+				const int nx = static_cast<int>(m_bricks[0]);
+				const int ny = static_cast<int>(m_bricks[1]);
+				const int nz = static_cast<int>(m_bricks[2]);
+				for (int n = 0; n != count; ++n)
+				{
+					const int i = pass == 0 ? n : count - 1 - n;
+					const int x = i % nx;
+					const int y = i / nx % ny;
+					const int z = i / (nx * ny);
+					int clearance = m_clearance[i];
+					for (int dz = -1; dz <= 0 && clearance != 0; ++dz)
+					{
+						for (int dy = -1; dy <= 1; ++dy)
+						{
+							for (int dx = -1; dx <= 1; ++dx)
+							{
+								// the 13 neighbours before this one in the pass
+								if (dz == 0 && (dy > 0 || (dy == 0 && dx >= 0)))
+								{
+									continue;
+								}
+								const int ax = x + dx * way;
+								const int ay = y + dy * way;
+								const int az = z + dz * way;
+								if (ax >= 0 && ax < nx && ay >= 0 && ay < ny && az >= 0 && az < nz)
+								{
+									clearance = std::min(clearance, m_clearance[(az * ny + ay) * nx + ax] + 1);
+								}
+							}
+						}
+					}
+					m_clearance[i] = static_cast<unsigned char>(clearance);
+				}
+			}
+		}
+
+		float SparseVolume::fetch(unsigned int brick, size_t index) const
+		{
+			const size_t at = brick * c_brick_values + index;
+			switch (m_precision)
+			{
+			case volume_half:
+				return m_halves[at];
+			case volume_byte:
+				return m_bytes[at] * (m_band / c_byte_steps);
+			default:
+				return m_floats[at];
+			}
+		}
+
+		void SparseVolume::decode(size_t index, float *out) const
+		{
+			for (size_t i = 0; i != c_brick_values; ++i)
+			{
+				out[i] = fetch(static_cast<unsigned int>(index), i);
+			}
+		}
+
+		void SparseVolume::corners(unsigned int brick, size_t index, float *out) const
+		{
+			const size_t at = brick * c_brick_values + index;
+			for (int i = 0; i != 8; ++i)
+			{
+				switch (m_precision)
+				{
+				case volume_half:
+					out[i] = m_halves[at + c_corners[i]];
+					break;
+				case volume_byte:
+					out[i] = m_bytes[at + c_corners[i]] * (m_band / c_byte_steps);
+					break;
+				default:
+					out[i] = m_floats[at + c_corners[i]];
+					break;
+				}
+			}
+		}
+
+		size_t SparseVolume::memory() const
+		{
+			return (m_map.size() + m_brick_cells.size()) * sizeof(unsigned int) + m_clearance.size()
+				+ m_brick_ranges.size() * sizeof(float)
+				+ m_floats.size() * sizeof(float) + m_halves.size() * sizeof(half) + m_bytes.size();
+		}
+
+		void SparseVolume::locate(const float3 &p, unsigned int *cell, float *weight) const
+		{
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				const float at = std::min(std::max((p[axis] - m_origin[axis]) / m_cell, 0.0f),
+					static_cast<float>(m_cells[axis]));
+				cell[axis] = std::min(static_cast<unsigned int>(at), m_cells[axis] - 1);
+				weight[axis] = at - cell[axis];
+			}
+		}
+
+		float SparseVolume::point(unsigned int x, unsigned int y, unsigned int z) const
+		{
+			const unsigned int bx = std::min(x / c_brick_cells, m_bricks[0] - 1);
+			const unsigned int by = std::min(y / c_brick_cells, m_bricks[1] - 1);
+			const unsigned int bz = std::min(z / c_brick_cells, m_bricks[2] - 1);
+			const unsigned int found = entry(bx, by, bz);
+			if (found >= c_tile_inside)
+			{
+				return tile(found);
+			}
+			const unsigned int lx = x - bx * c_brick_cells;
+			const unsigned int ly = y - by * c_brick_cells;
+			const unsigned int lz = z - bz * c_brick_cells;
+			return fetch(found, (lz * c_brick_points + ly) * c_brick_points + lx);
+		}
+
+		float SparseVolume::value(const float3 &p) const
+		{
+			unsigned int cell[3];
+			float weight[3];
+			locate(p, cell, weight);
+			const unsigned int found = entry(cell[0] / c_brick_cells, cell[1] / c_brick_cells, cell[2] / c_brick_cells);
+			if (found >= c_tile_inside)
+			{
+				return tile(found);
+			}
+			float c[8];
+			corners(found, ((cell[2] % c_brick_cells) * c_brick_points + cell[1] % c_brick_cells) * c_brick_points
+				+ cell[0] % c_brick_cells, c);
+			return trilinear(c, weight[0], weight[1], weight[2]);
+		}
+
+		float8 SparseVolume::value(const float3x8 &p) const
+		{
+			// the corners and weights gathered a lane at a time, and the
+			// interpolation on all 8 at once
+			DYE_ALIGN(32) float c[8][c_packet_width];
+			DYE_ALIGN(32) float w[3][c_packet_width];
+			for (size_t lane = 0; lane != c_packet_width; ++lane)
+			{
+				unsigned int cell[3];
+				float weight[3];
+				locate(float3(p.x[lane], p.y[lane], p.z[lane]), cell, weight);
+				const unsigned int found = entry(cell[0] / c_brick_cells, cell[1] / c_brick_cells, cell[2] / c_brick_cells);
+				float corner[8];
+				if (found >= c_tile_inside)
+				{
+					std::fill(corner, corner + 8, tile(found));
+				}
+				else
+				{
+					corners(found, ((cell[2] % c_brick_cells) * c_brick_points + cell[1] % c_brick_cells) * c_brick_points
+						+ cell[0] % c_brick_cells, corner);
+				}
+				for (int i = 0; i != 8; ++i)
+				{
+					c[i][lane] = corner[i];
+				}
+				w[0][lane] = weight[0];
+				w[1][lane] = weight[1];
+				w[2][lane] = weight[2];
+			}
+			float8 corner[8];
+			for (int i = 0; i != 8; ++i)
+			{
+				corner[i] = float8::load(c[i]);
+			}
+			return trilinear(corner, float8::load(w[0]), float8::load(w[1]), float8::load(w[2]));
+		}
+
+		float3 SparseVolume::normal(const float3 &p) const
+		{
+			// the differences across half a cell each way, in lanes 0 to 5
+			const float step = m_cell * 0.5f;
+			float3x8 points;
+			for (size_t lane = 0; lane != c_packet_width; ++lane)
+			{
+				points.x[lane] = p.x + (lane == 0 ? step : lane == 1 ? -step : 0);
+				points.y[lane] = p.y + (lane == 2 ? step : lane == 3 ? -step : 0);
+				points.z[lane] = p.z + (lane == 4 ? step : lane == 5 ? -step : 0);
+			}
+			const float8 d = value(points);
+			const float3 gradient(d[0] - d[1], d[2] - d[3], d[4] - d[5]);
+			const float length = gradient.length();
+			return length > 0 ? gradient / length : float3(0, 0, 0);
+		}
+
+		void SparseVolume::sample_grid(const lattice &grid, float *out) const
+		{
+			if (grid.size() == 0)
+			{
+				return;
+			}
+
+			// the points of the map itself read as they are
+			if (grid.spacing == m_cell && grid.origin.x == m_origin.x && grid.origin.y == m_origin.y
+				&& grid.origin.z == m_origin.z)
+			{
+				std::vector<unsigned int> index[3];
+				for (int axis = 0; axis != 3; ++axis)
+				{
+					index[axis].resize(grid.count[axis]);
+					for (size_t i = 0; i != grid.count[axis]; ++i)
+					{
+						const int at = grid.first[axis] + static_cast<int>(i);
+						index[axis][i] = static_cast<unsigned int>(std::min(std::max(at, 0), static_cast<int>(m_cells[axis])));
+					}
+				}
+				for (size_t k = 0, n = 0; k != grid.count[2]; ++k)
+				{
+					for (size_t j = 0; j != grid.count[1]; ++j)
+					{
+						for (size_t i = 0; i != grid.count[0]; ++i, ++n)
+						{
+							out[n] = point(index[0][i], index[1][j], index[2][k]);
+						}
+					}
+				}
+				return;
+			}
+
+			// else 8 points at a time
+			float3x8 packet;
+			size_t lanes = 0;
+			size_t n = 0;
+			for (size_t k = 0; k != grid.count[2]; ++k)
+			{
+				const float z = grid.coordinate(2, grid.first[2] + static_cast<int>(k));
+				for (size_t j = 0; j != grid.count[1]; ++j)
+				{
+					const float y = grid.coordinate(1, grid.first[1] + static_cast<int>(j));
+					for (size_t i = 0; i != grid.count[0]; ++i)
+					{
+						packet.x[lanes] = grid.coordinate(0, grid.first[0] + static_cast<int>(i));
+						packet.y[lanes] = y;
+						packet.z[lanes] = z;
+						if (++lanes == c_packet_width)
+						{
+							value(packet).store(out + n);
+							n += c_packet_width;
+							lanes = 0;
+						}
+					}
+				}
+			}
+			if (lanes != 0)
+			{
+				const float8 rest = value(packet);
+				for (size_t i = 0; i != lanes; ++i)
+				{
+					out[n + i] = rest[i];
+				}
+			}
+		}
+
+		void SparseVolume::range(const aabb &box, float &lower, float &upper) const
+		{
+			// the bricks box meets, clamped to the map as the values are
+			const float side = m_cell * c_brick_cells;
+			unsigned int first[3], last[3];
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				const float from = std::max((box.lower[axis] - m_origin[axis]) / side, 0.0f);
+				const float to = std::max((box.upper[axis] - m_origin[axis]) / side, 0.0f);
+				first[axis] = std::min(static_cast<unsigned int>(from), m_bricks[axis] - 1);
+				last[axis] = std::min(static_cast<unsigned int>(to), m_bricks[axis] - 1);
+			}
+			lower = FLT_MAX;
+			upper = -FLT_MAX;
+			for (unsigned int z = first[2]; z <= last[2]; ++z)
+			{
+				for (unsigned int y = first[1]; y <= last[1]; ++y)
+				{
+					for (unsigned int x = first[0]; x <= last[0]; ++x)
+					{
+						const unsigned int found = entry(x, y, z);
+						lower = std::min(lower, found >= c_tile_inside ? tile(found) : brick_lower(found));
+						upper = std::max(upper, found >= c_tile_inside ? tile(found) : brick_upper(found));
+					}
+				}
+			}
+		}
+
+		float SparseVolume::distance(const float3 &p) const
+		{
+			// outside the box the way to it comes first
+			float3 q;
+			float away = 0;
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				q[axis] = std::min(std::max(p[axis], m_box.lower[axis]), m_box.upper[axis]);
+				away += (p[axis] - q[axis]) * (p[axis] - q[axis]);
+			}
+			if (away > 0)
+			{
+				away = std::sqrt(away);
+				return std::max(away, distance(q) - away);
+			}
+
+			// in a tile outside, the way to its sides and across the tiles
+			// beyond them too
+			unsigned int cell[3];
+			float weight[3];
+			locate(p, cell, weight);
+			const unsigned int brick[3] = { cell[0] / c_brick_cells, cell[1] / c_brick_cells, cell[2] / c_brick_cells };
+			const unsigned int at = (brick[2] * m_bricks[1] + brick[1]) * m_bricks[0] + brick[0];
+			if (m_map[at] != c_tile_outside)
+			{
+				return value(p);
+			}
+			float side = FLT_MAX;
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				const float low = m_origin[axis] + m_cell * (brick[axis] * c_brick_cells);
+				const float high = low + m_cell * c_brick_cells;
+				side = std::min(side, std::min(p[axis] - low, high - p[axis]));
+			}
+			return m_band + std::max(side, 0.0f) + (m_clearance[at] - 1) * m_cell * c_brick_cells;
+		}
+
+		float8 SparseVolume::distance(const float3x8 &p) const
+		{
+			// the lanes outside the box or in a tile outside one at a time
+			float8 d = value(p);
+			for (size_t lane = 0; lane != c_packet_width; ++lane)
+			{
+				const float3 q(p.x[lane], p.y[lane], p.z[lane]);
+				bool inside = true;
+				for (int axis = 0; axis != 3; ++axis)
+				{
+					inside = inside && q[axis] >= m_box.lower[axis] && q[axis] <= m_box.upper[axis];
+				}
+				if (!inside || d[lane] == m_band)
+				{
+					d[lane] = distance(q);
+				}
+			}
+			return d;
+		}
+
+		bool SparseVolume::cast(const ray &r, hit *h) const
+		{
+			// the part of the ray in the box
+			float enter = r.tmin;
+			float exit = r.tmax;
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				const float o = r.origin[axis];
+				const float d = r.direction[axis];
+				if (d == 0)
+				{
+					if (o < m_box.lower[axis] || o > m_box.upper[axis])
+					{
+						return false;
+					}
+					continue;
+				}
+				float near = (m_box.lower[axis] - o) / d;
+				float far = (m_box.upper[axis] - o) / d;
+				if (near > far)
+				{
+					std::swap(near, far);
+				}
+				enter = std::max(enter, near);
+				exit = std::min(exit, far);
+			}
+			const float length = r.direction.length();
+			if (!(enter <= exit) || length == 0)
+			{
+				return false;
+			}
+
+			// the brick of the entry point, and the ray parameter of the next
+			// side of the bricks along each axis
+			const float side = m_cell * c_brick_cells;
+			const float step = 0.5f * m_cell / length;
+			int at[3];
+			int direction[3];
+			float next[3];
+			float delta[3];
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				const float o = r.origin[axis];
+				const float d = r.direction[axis];
+				const float u = (o + d * enter - m_origin[axis]) / side;
+				at[axis] = std::min(std::max(static_cast<int>(std::floor(u)), 0), static_cast<int>(m_bricks[axis]) - 1);
+				direction[axis] = d > 0 ? 1 : d < 0 ? -1 : 0;
+				next[axis] = d == 0 ? FLT_MAX : (m_origin[axis] + side * (at[axis] + (d > 0)) - o) / d;
+				delta[axis] = d == 0 ? FLT_MAX : side / std::abs(d);
+			}
+
+			float before = value(r.origin + r.direction * enter);
+			float t_before = enter;
+			for (;;)
+			{
+				const int axis = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+				const float leave = std::min(next[axis], exit);
+				const unsigned int found = entry(at[0], at[1], at[2]);
+				float t_hit = -1;
+				if (found >= c_tile_inside)
+				{
+					// the sign changes on the side of a tile or not at all
+					if ((tile(found) < 0) != (before < 0))
+					{
+						t_hit = enter;
+					}
+					before = tile(found);
+					t_before = leave;
+				}
+				else
+				{
+					for (float t = enter + step; t_hit < 0; t += step)
+					{
+						const float to = std::min(t, leave);
+						const float v = value(r.origin + r.direction * to);
+						if ((v < 0) != (before < 0))
+						{
+							// bisection down to a thousandth of the step
+							float low = t_before;
+							float high = to;
+							for (int i = 0; i != 10; ++i)
+							{
+								const float middle = (low + high) * 0.5f;
+								if ((value(r.origin + r.direction * middle) < 0) == (before < 0))
+								{
+									low = middle;
+								}
+								else
+								{
+									high = middle;
+								}
+							}
+							t_hit = (low + high) * 0.5f;
+						}
+						before = v;
+						t_before = to;
+						if (to >= leave)
+						{
+							break;
+						}
+					}
+				}
+
+				if (t_hit >= 0)
+				{
+					if (h != 0)
+					{
+						h->t = t_hit;
+						h->u = 0;
+						h->v = 0;
+						h->triangle = (at[2] * m_bricks[1] + at[1]) * m_bricks[0] + at[0];
+						h->instance = c_no_hit;
+					}
+					return true;
+				}
+				if (next[axis] >= exit)
+				{
+					return false;
+				}
+				enter = next[axis];
+				at[axis] += direction[axis];
+				if (at[axis] < 0 || at[axis] >= static_cast<int>(m_bricks[axis]))
+				{
+					return false;
+				}
+				next[axis] += delta[axis];
+			}
+		}
+
+		bool SparseVolume::intersect(const ray &r, hit &h) const
+		{
+			return cast(r, &h);
+		}
+
+		bool SparseVolume::occluded(const ray &r) const
+		{
+			return cast(r, 0);
+		}
+
+		void SparseVolume::intersect(const ray8 &r, hit8 &h) const
+		{
+			for (size_t lane = 0; lane != c_packet_width; ++lane)
+			{
+				const ray single =
+				{
+					float3(r.origin.x[lane], r.origin.y[lane], r.origin.z[lane]), r.tmin[lane],
+					float3(r.direction.x[lane], r.direction.y[lane], r.direction.z[lane]), r.tmax[lane],
+				};
+				hit found;
+				if (!(single.tmin <= single.tmax) || !cast(single, &found))
+				{
+					found.t = single.tmax;
+					found.u = 0;
+					found.v = 0;
+					found.triangle = c_no_hit;
+					found.instance = c_no_hit;
+				}
+				h.t[lane] = found.t;
+				h.u[lane] = found.u;
+				h.v[lane] = found.v;
+				h.triangle[lane] = found.triangle;
+				h.instance[lane] = found.instance;
+			}
+		}
+
+		int SparseVolume::occluded(const ray8 &r) const
+		{
+			int bits = 0;
+			for (size_t lane = 0; lane != c_packet_width; ++lane)
+			{
+				const ray single =
+				{
+					float3(r.origin.x[lane], r.origin.y[lane], r.origin.z[lane]), r.tmin[lane],
+					float3(r.direction.x[lane], r.direction.y[lane], r.direction.z[lane]), r.tmax[lane],
+				};
+				if (single.tmin <= single.tmax && cast(single, 0))
+				{
+					bits |= 1 << lane;
+				}
+			}
+			return bits;
+		}
+	}
+}
@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <transform.hpp>
+#include <cpu_dispatch.hpp>
+
+namespace Dye
+{
+	namespace
+	{
+		// number of elements handed to one thread at a time
+		const size_t c_batch_size = 4096;
+
+		template<typename Func>
+		void for_each_batch(size_t n, const Func &func)
+		{
+			int num_batches = static_cast<int>((n + c_batch_size - 1) / c_batch_size);
+
+			#pragma omp parallel for if (num_batches > 1)
+			for (int b = 0; b < num_batches; ++b)
+			{
+				size_t begin = b * c_batch_size;
+				size_t end = std::min(begin + c_batch_size, n);
+				func(begin, end);
+			}
+		}
+
+		// inverse transpose of the upper 3x3 of mat, computed from the
+		// cofactors, padded to a float4x4 with zero translation.
+		float4x4 normal_matrix(const float4x4 &mat)
+		{
+			float3 a0 = mat[0].xyz();
+			float3 a1 = mat[1].xyz();
+			float3 a2 = mat[2].xyz();
+
+			float3 c0 = cross(a1, a2);
+			float3 c1 = cross(a2, a0);
+			float3 c2 = cross(a0, a1);
+			float det_r = 1 / dot(a0, c0);
+
+			return float4x4(
+				c0.x * det_r, c0.y * det_r, c0.z * det_r, 0,
+				c1.x * det_r, c1.y * det_r, c1.z * det_r, 0,
+				c2.x * det_r, c2.y * det_r, c2.z * det_r, 0,
+				0, 0, 0, 1);
+		}
+	}
+
+	void transform(const float4x4 &mat, const float4 *in, float4 *out, size_t n)
+	{
+		const batch_kernels &k = kernels();
+
+		for_each_batch(n, [&](size_t begin, size_t end)
+		{
+			k.transform4(mat.ptr(), in[begin].ptr(), out[begin].ptr(), end - begin);
+		});
+	}
+
+	void transform_points(const float4x4 &mat, const float3 *in, float3 *out, size_t n)
+	{
+		const batch_kernels &k = kernels();
+
+		for_each_batch(n, [&](size_t begin, size_t end)
+		{
+			k.transform3(mat.ptr(), 1, false,
+				(const char *)(in + begin), sizeof(float3),
+				(char *)(out + begin), sizeof(float3), end - begin);
+		});
+	}
+
+	void transform_normals(const float4x4 &mat, const float3 *in, float3 *out, size_t n)
+	{
+		const batch_kernels &k = kernels();
+		float4x4 normal_mat = normal_matrix(mat);
+
+		for_each_batch(n, [&](size_t begin, size_t end)
+		{
+			k.transform3(normal_mat.ptr(), 0, true,
+				(const char *)(in + begin), sizeof(float3),
+				(char *)(out + begin), sizeof(float3), end - begin);
+		});
+	}
+
+	void transform_vertices(const float4x4 &mat, Graphics::vertex *vertices, size_t n)
+	{
+		const batch_kernels &k = kernels();
+		float4x4 normal_mat = normal_matrix(mat);
+
+		for_each_batch(n, [&](size_t begin, size_t end)
+		{
+			char *pos = (char *)&vertices[begin].pos;
+			char *normal = (char *)&vertices[begin].normal;
+			k.transform3(mat.ptr(), 1, false, pos, sizeof(Graphics::vertex), pos, sizeof(Graphics::vertex), end - begin);
+			k.transform3(normal_mat.ptr(), 0, true, normal, sizeof(Graphics::vertex), normal, sizeof(Graphics::vertex), end - begin);
+		});
+	}
+
+	void normalize(const float3 *in, float3 *out, size_t n)
+	{
+		const batch_kernels &k = kernels();
+
+		for_each_batch(n, [&](size_t begin, size_t end)
+		{
+			k.normalize3(in[begin].ptr(), out[begin].ptr(), end - begin);
+		});
+	}
+}
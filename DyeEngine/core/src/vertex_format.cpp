@@ -0,0 +1,475 @@
+#include <algorithm>
+#include <simd_helper.h>
+#include <vertex_format.hpp>
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		namespace
+		{
+			// number of vertices handed to one thread at a time
+			const size_t c_batch_size = 4096;
+
+			template<typename Func>
+			void for_each_batch(size_t n, const Func &func)
+			{
+				int num_batches = static_cast<int>((n + c_batch_size - 1) / c_batch_size);
+
+				#pragma omp parallel for if (num_batches > 1)
+				for (int b = 0; b < num_batches; ++b)
+				{
+					size_t begin = b * c_batch_size;
+					size_t end = std::min(begin + c_batch_size, n);
+					func(begin, end);
+				}
+			}
+
+			// maps the bounds to [0, range] per axis and back
+			struct quantizer
+			{
+				float lower[3];
+				float scale[3];
+				float step[3];
+				float range[3];
+
+				quantizer(const vertex_bounds &bounds, float rx, float ry, float rz)
+				{
+					const float extent[3] = {
+						bounds.upper.x - bounds.lower.x,
+						bounds.upper.y - bounds.lower.y,
+						bounds.upper.z - bounds.lower.z};
+
+					lower[0] = bounds.lower.x;
+					lower[1] = bounds.lower.y;
+					lower[2] = bounds.lower.z;
+					range[0] = rx;
+					range[1] = ry;
+					range[2] = rz;
+					for (size_t i = 0; i != 3; ++i)
+					{
+						scale[i] = extent[i] > 0 ? range[i] / extent[i] : 0;
+						step[i] = extent[i] / range[i];
+					}
+				}
+
+				unsigned int encode(float p, size_t axis) const
+				{
+					float q = std::min(std::max((p - lower[axis]) * scale[axis], 0.0f), range[axis]);
+					return static_cast<unsigned int>(q + 0.5f);
+				}
+
+				float decode(unsigned int q, size_t axis) const
+				{
+					return static_cast<float>(static_cast<int>(q)) * step[axis] + lower[axis];
+				}
+			};
+
+			quantizer quantizer16(const vertex_bounds &bounds)
+			{
+				return quantizer(bounds, 65535, 65535, 65535);
+			}
+
+			quantizer quantizer12(const vertex_bounds &bounds)
+			{
+				return quantizer(bounds, 2047, 2047, 1023);
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			// one vertex, for the tails and the scalar build
+			//////////////////////////////////////////////////////////////////////////
+			void pack_one(const vertex &in, packed_vertex16 &out, const quantizer &q)
+			{
+				out.pos[0] = static_cast<unsigned short>(q.encode(in.pos.x, 0));
+				out.pos[1] = static_cast<unsigned short>(q.encode(in.pos.y, 1));
+				out.pos[2] = static_cast<unsigned short>(q.encode(in.pos.z, 2));
+				out.reserved = 0;
+				oct_encode(in.normal, out.normal[0], out.normal[1]);
+				out.tex[0] = half_from_float(in.tex.x);
+				out.tex[1] = half_from_float(in.tex.y);
+			}
+
+			void pack_one(const vertex &in, packed_vertex12 &out, const quantizer &q)
+			{
+				out.pos = q.encode(in.pos.x, 0) | (q.encode(in.pos.y, 1) << 11) | (q.encode(in.pos.z, 2) << 22);
+				oct_encode(in.normal, out.normal[0], out.normal[1]);
+				out.tex[0] = half_from_float(in.tex.x);
+				out.tex[1] = half_from_float(in.tex.y);
+			}
+
+			void unpack_one(const packed_vertex16 &in, vertex &out, const quantizer &q)
+			{
+				out.pos = float3(q.decode(in.pos[0], 0), q.decode(in.pos[1], 1), q.decode(in.pos[2], 2));
+				out.normal = oct_decode(in.normal[0], in.normal[1]);
+				out.tex = float2(half_to_float(in.tex[0]), half_to_float(in.tex[1]));
+			}
+
+			void unpack_one(const packed_vertex12 &in, vertex &out, const quantizer &q)
+			{
+				out.pos = float3(q.decode(in.pos & 0x7ff, 0), q.decode((in.pos >> 11) & 0x7ff, 1), q.decode(in.pos >> 22, 2));
+				out.normal = oct_decode(in.normal[0], in.normal[1]);
+				out.tex = float2(half_to_float(in.tex[0]), half_to_float(in.tex[1]));
+			}
+
+#if defined(DYE_SIMD_SSE2)
+			//////////////////////////////////////////////////////////////////////////
+			// four vertices per step
+			//
+			// the packed words of four vertices are transposed so that every
+			// register holds one field of all four, the floats of the vertices
+			// likewise with two 4x4 transposes: pos.xyz normal.x | normal.yz tex.
+			//////////////////////////////////////////////////////////////////////////
+			void transpose(__m128i &a, __m128i &b, __m128i &c, __m128i &d)
+			{
+				__m128 fa = _mm_castsi128_ps(a);
+				__m128 fb = _mm_castsi128_ps(b);
+				__m128 fc = _mm_castsi128_ps(c);
+				__m128 fd = _mm_castsi128_ps(d);
+				_MM_TRANSPOSE4_PS(fa, fb, fc, fd);
+				a = _mm_castps_si128(fa);
+				b = _mm_castps_si128(fb);
+				c = _mm_castps_si128(fc);
+				d = _mm_castps_si128(fd);
+			}
+
+			struct fields
+			{
+				__m128 px, py, pz, nx, ny, nz, u, v;
+			};
+
+			void load_vertices(const vertex *in, fields &f)
+			{
+				const float *p = &in[0].pos.x;
+				f.px = _mm_loadu_ps(p);
+				f.py = _mm_loadu_ps(p + 8);
+				f.pz = _mm_loadu_ps(p + 16);
+				f.nx = _mm_loadu_ps(p + 24);
+				f.ny = _mm_loadu_ps(p + 4);
+				f.nz = _mm_loadu_ps(p + 12);
+				f.u = _mm_loadu_ps(p + 20);
+				f.v = _mm_loadu_ps(p + 28);
+				_MM_TRANSPOSE4_PS(f.px, f.py, f.pz, f.nx);
+				_MM_TRANSPOSE4_PS(f.ny, f.nz, f.u, f.v);
+			}
+
+			void store_vertices(fields &f, vertex *out)
+			{
+				float *p = &out[0].pos.x;
+				_MM_TRANSPOSE4_PS(f.px, f.py, f.pz, f.nx);
+				_MM_TRANSPOSE4_PS(f.ny, f.nz, f.u, f.v);
+				_mm_storeu_ps(p, f.px);
+				_mm_storeu_ps(p + 4, f.ny);
+				_mm_storeu_ps(p + 8, f.py);
+				_mm_storeu_ps(p + 12, f.nz);
+				_mm_storeu_ps(p + 16, f.pz);
+				_mm_storeu_ps(p + 20, f.u);
+				_mm_storeu_ps(p + 24, f.nx);
+				_mm_storeu_ps(p + 28, f.v);
+			}
+
+			__m128 splat(const float (&values)[3], size_t axis)
+			{
+				return _mm_set1_ps(values[axis]);
+			}
+
+			__m128i quantize(__m128 p, const quantizer &q, size_t axis)
+			{
+				__m128 t = _mm_mul_ps(_mm_sub_ps(p, splat(q.lower, axis)), splat(q.scale, axis));
+				t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), splat(q.range, axis));
+				return _mm_cvttps_epi32(_mm_add_ps(t, _mm_set1_ps(0.5f)));
+			}
+
+			__m128 dequantize(__m128i i, const quantizer &q, size_t axis)
+			{
+				return _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(i), splat(q.step, axis)), splat(q.lower, axis));
+			}
+
+			__m128 abs(__m128 a)
+			{
+				return _mm_andnot_ps(_mm_set1_ps(-0.0f), a);
+			}
+
+			// b where mask is set, a otherwise
+			__m128 blend(__m128 a, __m128 b, __m128 mask)
+			{
+				return _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b));
+			}
+
+			// oct_encode() of four normals, rounded the same way
+			void oct_encode4(__m128 x, __m128 y, __m128 z, __m128i &sx, __m128i &sy)
+			{
+				const __m128 zero = _mm_setzero_ps();
+				const __m128 one = _mm_set1_ps(1);
+				const __m128 sign = _mm_set1_ps(-0.0f);
+
+				__m128 l1 = _mm_max_ps(_mm_add_ps(_mm_add_ps(abs(x), abs(y)), abs(z)), _mm_set1_ps(1e-30f));
+				__m128 r = _mm_div_ps(one, l1);
+				__m128 u = _mm_mul_ps(x, r);
+				__m128 v = _mm_mul_ps(y, r);
+
+				__m128 fu = _mm_sub_ps(one, abs(v));
+				__m128 fv = _mm_sub_ps(one, abs(u));
+				fu = blend(_mm_or_ps(fu, sign), fu, _mm_cmpge_ps(u, zero));
+				fv = blend(_mm_or_ps(fv, sign), fv, _mm_cmpge_ps(v, zero));
+				__m128 lower = _mm_cmplt_ps(z, zero);
+				u = blend(u, fu, lower);
+				v = blend(v, fv, lower);
+
+				const __m128 limit = _mm_set1_ps(32767);
+				const __m128 bias = _mm_set1_ps(0.5f);
+				u = _mm_mul_ps(_mm_min_ps(_mm_max_ps(u, _mm_sub_ps(zero, one)), one), limit);
+				v = _mm_mul_ps(_mm_min_ps(_mm_max_ps(v, _mm_sub_ps(zero, one)), one), limit);
+				u = _mm_add_ps(u, blend(_mm_sub_ps(zero, bias), bias, _mm_cmpge_ps(u, zero)));
+				v = _mm_add_ps(v, blend(_mm_sub_ps(zero, bias), bias, _mm_cmpge_ps(v, zero)));
+				sx = _mm_cvttps_epi32(u);
+				sy = _mm_cvttps_epi32(v);
+			}
+
+			// oct_decode() of the four snorm16 pairs in the low and high halves of w
+			void oct_decode4(__m128i w, __m128 &x, __m128 &y, __m128 &z)
+			{
+				const __m128 zero = _mm_setzero_ps();
+				const __m128 sign = _mm_set1_ps(-0.0f);
+				const __m128 norm = _mm_set1_ps(1 / 32767.0f);
+				const __m128 minus_one = _mm_set1_ps(-1);
+
+				x = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(w, 16), 16)), norm), minus_one);
+				y = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(w, 16)), norm), minus_one);
+				z = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1), abs(x)), abs(y));
+
+				// x -= copysign(t, x), with +t for x == -0 as in the scalar code
+				__m128 t = _mm_max_ps(_mm_sub_ps(zero, z), zero);
+				x = _mm_sub_ps(x, blend(_mm_or_ps(t, sign), t, _mm_cmpge_ps(x, zero)));
+				y = _mm_sub_ps(y, blend(_mm_or_ps(t, sign), t, _mm_cmpge_ps(y, zero)));
+
+				// rsqrt and a newton step, a few ulp off the exact length
+				__m128 square = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+				__m128 r = _mm_rsqrt_ps(square);
+				r = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), r), _mm_sub_ps(_mm_set1_ps(3), _mm_mul_ps(_mm_mul_ps(square, r), r)));
+				x = _mm_mul_ps(x, r);
+				y = _mm_mul_ps(y, r);
+				z = _mm_mul_ps(z, r);
+			}
+
+#if defined(DYE_SIMD_F16C)
+			// uvs of four vertices from the u | v << 16 words and back
+			void unpack_tex(__m128i w, __m128 &u, __m128 &v)
+			{
+				__m128 lo = _mm_cvtph_ps(w);
+				__m128 hi = _mm_cvtph_ps(_mm_srli_si128(w, 8));
+				u = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+				v = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+			}
+
+			__m128i pack_tex(__m128 u, __m128 v)
+			{
+				__m128i lo = _mm_cvtps_ph(_mm_unpacklo_ps(u, v), 0);
+				__m128i hi = _mm_cvtps_ph(_mm_unpackhi_ps(u, v), 0);
+				return _mm_unpacklo_epi64(lo, hi);
+			}
+#else
+			void unpack_tex(__m128i w, __m128 &u, __m128 &v)
+			{
+				u = half_to_float(_mm_and_si128(w, _mm_set1_epi32(0xffff)));
+				v = half_to_float(_mm_srli_epi32(w, 16));
+			}
+
+			__m128i pack_tex(__m128 u, __m128 v)
+			{
+				return _mm_or_si128(half_from_float(u), _mm_slli_epi32(half_from_float(v), 16));
+			}
+#endif
+
+			// two 16 bit fields per lane
+			__m128i join(__m128i lo, __m128i hi)
+			{
+				return _mm_or_si128(_mm_and_si128(lo, _mm_set1_epi32(0xffff)), _mm_slli_epi32(hi, 16));
+			}
+
+			void pack4(const vertex *in, packed_vertex16 *out, const quantizer &q)
+			{
+				fields f;
+				load_vertices(in, f);
+
+				__m128i sx, sy;
+				oct_encode4(f.nx, f.ny, f.nz, sx, sy);
+
+				__m128i w0 = join(quantize(f.px, q, 0), quantize(f.py, q, 1));
+				__m128i w1 = quantize(f.pz, q, 2);
+				__m128i w2 = join(sx, sy);
+				__m128i w3 = pack_tex(f.u, f.v);
+				transpose(w0, w1, w2, w3);
+
+				__m128i *p = reinterpret_cast<__m128i *>(out);
+				_mm_storeu_si128(p, w0);
+				_mm_storeu_si128(p + 1, w1);
+				_mm_storeu_si128(p + 2, w2);
+				_mm_storeu_si128(p + 3, w3);
+			}
+
+			void pack4(const vertex *in, packed_vertex12 *out, const quantizer &q)
+			{
+				fields f;
+				load_vertices(in, f);
+
+				__m128i sx, sy;
+				oct_encode4(f.nx, f.ny, f.nz, sx, sy);
+
+				__m128i w0 = _mm_or_si128(_mm_or_si128(
+					quantize(f.px, q, 0),
+					_mm_slli_epi32(quantize(f.py, q, 1), 11)),
+					_mm_slli_epi32(quantize(f.pz, q, 2), 22));
+				__m128i w1 = join(sx, sy);
+				__m128i w2 = pack_tex(f.u, f.v);
+				__m128i w3 = _mm_setzero_si128();
+				transpose(w0, w1, w2, w3);
+
+				// the rows are x0 x1 x2 0, shifted together into 48 bytes
+				__m128i *p = reinterpret_cast<__m128i *>(out);
+				_mm_storeu_si128(p, _mm_or_si128(w0, _mm_slli_si128(w1, 12)));
+				_mm_storeu_si128(p + 1, _mm_or_si128(_mm_srli_si128(w1, 4), _mm_slli_si128(w2, 8)));
+				_mm_storeu_si128(p + 2, _mm_or_si128(_mm_srli_si128(w2, 8), _mm_slli_si128(w3, 4)));
+			}
+
+			void unpack4(const packed_vertex16 *in, vertex *out, const quantizer &q)
+			{
+				const __m128i *p = reinterpret_cast<const __m128i *>(in);
+				__m128i w0 = _mm_loadu_si128(p);
+				__m128i w1 = _mm_loadu_si128(p + 1);
+				__m128i w2 = _mm_loadu_si128(p + 2);
+				__m128i w3 = _mm_loadu_si128(p + 3);
+				transpose(w0, w1, w2, w3);
+
+				const __m128i low = _mm_set1_epi32(0xffff);
+				fields f;
+				f.px = dequantize(_mm_and_si128(w0, low), q, 0);
+				f.py = dequantize(_mm_srli_epi32(w0, 16), q, 1);
+				f.pz = dequantize(_mm_and_si128(w1, low), q, 2);
+				oct_decode4(w2, f.nx, f.ny, f.nz);
+				unpack_tex(w3, f.u, f.v);
+				store_vertices(f, out);
+			}
+
+			void unpack4(const packed_vertex12 *in, vertex *out, const quantizer &q)
+			{
+				// 48 bytes shifted apart into rows of x0 x1 x2 and one word of the next
+				const __m128i *p = reinterpret_cast<const __m128i *>(in);
+				__m128i r0 = _mm_loadu_si128(p);
+				__m128i r1 = _mm_loadu_si128(p + 1);
+				__m128i r2 = _mm_loadu_si128(p + 2);
+				__m128i w0 = r0;
+				__m128i w1 = _mm_or_si128(_mm_srli_si128(r0, 12), _mm_slli_si128(r1, 4));
+				__m128i w2 = _mm_or_si128(_mm_srli_si128(r1, 8), _mm_slli_si128(r2, 8));
+				__m128i w3 = _mm_srli_si128(r2, 4);
+				transpose(w0, w1, w2, w3);
+
+				const __m128i mask = _mm_set1_epi32(0x7ff);
+				fields f;
+				f.px = dequantize(_mm_and_si128(w0, mask), q, 0);
+				f.py = dequantize(_mm_and_si128(_mm_srli_epi32(w0, 11), mask), q, 1);
+				f.pz = dequantize(_mm_srli_epi32(w0, 22), q, 2);
+				oct_decode4(w1, f.nx, f.ny, f.nz);
+				unpack_tex(w2, f.u, f.v);
+				store_vertices(f, out);
+			}
+#endif
+
+			template<typename Packed>
+			void pack_range(const vertex *in, Packed *out, size_t n, const quantizer &q)
+			{
+				size_t i = 0;
+#if defined(DYE_SIMD_SSE2)
+				for (; i + 4 <= n; i += 4)
+				{
+					pack4(in + i, out + i, q);
+				}
+#endif
+				for (; i != n; ++i)
+				{
+					pack_one(in[i], out[i], q);
+				}
+			}
+
+			template<typename Packed>
+			void unpack_range(const Packed *in, vertex *out, size_t n, const quantizer &q)
+			{
+				size_t i = 0;
+#if defined(DYE_SIMD_SSE2)
+				for (; i + 4 <= n; i += 4)
+				{
+					unpack4(in + i, out + i, q);
+				}
+#endif
+				for (; i != n; ++i)
+				{
+					unpack_one(in[i], out[i], q);
+				}
+			}
+		}
+
+		vertex_bounds compute_bounds(const vertex *vertices, size_t n)
+		{
+			vertex_bounds bounds;
+			bounds.lower = bounds.upper = n ? vertices[0].pos : float3(0, 0, 0);
+			for (size_t i = 1; i < n; ++i)
+			{
+				const float3 &p = vertices[i].pos;
+				bounds.lower = float3(std::min(bounds.lower.x, p.x), std::min(bounds.lower.y, p.y), std::min(bounds.lower.z, p.z));
+				bounds.upper = float3(std::max(bounds.upper.x, p.x), std::max(bounds.upper.y, p.y), std::max(bounds.upper.z, p.z));
+			}
+			return bounds;
+		}
+
+		void pack(const vertex *in, vertex *out, size_t n, const vertex_bounds &)
+		{
+			if (in != out)
+			{
+				std::copy(in, in + n, out);
+			}
+		}
+
+		void pack(const vertex *in, packed_vertex16 *out, size_t n, const vertex_bounds &bounds)
+		{
+			quantizer q = quantizer16(bounds);
+			for_each_batch(n, [&](size_t begin, size_t end)
+			{
+				pack_range(in + begin, out + begin, end - begin, q);
+			});
+		}
+
+		void pack(const vertex *in, packed_vertex12 *out, size_t n, const vertex_bounds &bounds)
+		{
+			quantizer q = quantizer12(bounds);
+			for_each_batch(n, [&](size_t begin, size_t end)
+			{
+				pack_range(in + begin, out + begin, end - begin, q);
+			});
+		}
+
+		void unpack(const vertex *in, vertex *out, size_t n, const vertex_bounds &)
+		{
+			if (in != out)
+			{
+				std::copy(in, in + n, out);
+			}
+		}
+
+		void unpack(const packed_vertex16 *in, vertex *out, size_t n, const vertex_bounds &bounds)
+		{
+			quantizer q = quantizer16(bounds);
+			for_each_batch(n, [&](size_t begin, size_t end)
+			{
+				unpack_range(in + begin, out + begin, end - begin, q);
+			});
+		}
+
+		void unpack(const packed_vertex12 *in, vertex *out, size_t n, const vertex_bounds &bounds)
+		{
+			quantizer q = quantizer12(bounds);
+			for_each_batch(n, [&](size_t begin, size_t end)
+			{
+				unpack_range(in + begin, out + begin, end - begin, q);
+			});
+		}
+	}
+}
@@ -0,0 +1,194 @@
+#include <string.h>
+#include <algorithm>
+#include <vertex_streams.hpp>
+#include <cpu_dispatch.hpp>
+
+namespace Dye
+{
+	namespace Graphics
+	{
+		namespace
+		{
+			// vertices per block: the block and its streams, 64k each, stay in
+			// the l2 cache of the thread that converts them
+			const size_t c_block_size = 2048;
+
+			const size_t c_stream_align_floats = c_stream_alignment / sizeof(float);
+
+			template<typename Func>
+			void for_each_block(size_t n, const Func &func)
+			{
+				int num_blocks = static_cast<int>((n + c_block_size - 1) / c_block_size);
+
+				#pragma omp parallel for if (num_blocks > 1)
+				for (int b = 0; b < num_blocks; ++b)
+				{
+					size_t begin = b * c_block_size;
+					size_t end = std::min(begin + c_block_size, n);
+					func(begin, end);
+				}
+			}
+		}
+
+		size_t stream_stride(size_t n)
+		{
+			return (n + c_stream_align_floats - 1) / c_stream_align_floats * c_stream_align_floats;
+		}
+
+		size_t streams_byte_size(size_t n)
+		{
+			return stream_count * stream_stride(n) * sizeof(float);
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// view
+		//////////////////////////////////////////////////////////////////////////
+		VertexStreamsView::VertexStreamsView()
+			: m_size(0)
+		{
+			std::fill(m_streams, m_streams + stream_count, static_cast<const float *>(0));
+		}
+
+		VertexStreamsView::VertexStreamsView(const float *const streams[stream_count], size_t n)
+			: m_size(n)
+		{
+			std::copy(streams, streams + stream_count, m_streams);
+		}
+
+		VertexStreamsView::VertexStreamsView(const void *buffer, size_t n)
+			: m_size(n)
+		{
+			const float *base = static_cast<const float *>(buffer);
+			for (size_t s = 0; s != stream_count; ++s)
+			{
+				m_streams[s] = base + s * stream_stride(n);
+			}
+		}
+
+		vertex VertexStreamsView::operator [] (size_t i) const
+		{
+			vertex v;
+			v.pos = float3(m_streams[stream_pos_x][i], m_streams[stream_pos_y][i], m_streams[stream_pos_z][i]);
+			v.normal = float3(m_streams[stream_normal_x][i], m_streams[stream_normal_y][i], m_streams[stream_normal_z][i]);
+			v.tex = float2(m_streams[stream_tex_u][i], m_streams[stream_tex_v][i]);
+			return v;
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// owning streams
+		//////////////////////////////////////////////////////////////////////////
+		VertexStreamsSoA::VertexStreamsSoA()
+			: m_base(0)
+			, m_size(0)
+		{
+		}
+
+		VertexStreamsSoA::VertexStreamsSoA(size_t n)
+			: m_base(0)
+			, m_size(0)
+		{
+			resize(n);
+		}
+
+		VertexStreamsSoA::VertexStreamsSoA(const std::vector<vertex> &vertices)
+			: m_base(0)
+			, m_size(0)
+		{
+			to_soa(vertices, *this);
+		}
+
+		VertexStreamsSoA::VertexStreamsSoA(const VertexStreamsSoA &other)
+			: m_base(0)
+			, m_size(0)
+		{
+			resize(other.m_size);
+			if (m_size)
+			{
+				memcpy(m_base, other.m_base, streams_byte_size(m_size));
+			}
+		}
+
+		VertexStreamsSoA& VertexStreamsSoA::operator = (const VertexStreamsSoA &other)
+		{
+			VertexStreamsSoA copy(other);
+			swap(copy);
+			return *this;
+		}
+
+		void VertexStreamsSoA::resize(size_t n)
+		{
+			// over allocated by one alignment, the base is rounded up into it
+			m_storage.resize(n ? stream_count * stream_stride(n) + c_stream_align_floats : 0);
+			m_size = n;
+			m_base = 0;
+			if (n)
+			{
+				size_t address = reinterpret_cast<size_t>(&m_storage[0]);
+				size_t misalignment = address % c_stream_alignment;
+				m_base = &m_storage[0] + (misalignment ? (c_stream_alignment - misalignment) / sizeof(float) : 0);
+			}
+		}
+
+		void VertexStreamsSoA::swap(VertexStreamsSoA &other)
+		{
+			// the bases point into the buffers, which swap keeps in place
+			m_storage.swap(other.m_storage);
+			std::swap(m_base, other.m_base);
+			std::swap(m_size, other.m_size);
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		// conversion
+		//////////////////////////////////////////////////////////////////////////
+		void to_soa(const vertex *in, size_t n, VertexStreamsSoA &out)
+		{
+			out.resize(n);
+
+			const batch_kernels &k = kernels();
+			float *streams[stream_count];
+			for (size_t s = 0; s != stream_count; ++s)
+			{
+				streams[s] = out.stream(static_cast<vertex_stream>(s));
+			}
+
+			for_each_block(n, [&](size_t begin, size_t end)
+			{
+				float *block[stream_count];
+				for (size_t s = 0; s != stream_count; ++s)
+				{
+					block[s] = streams[s] + begin;
+				}
+				k.aos_to_soa(&in[begin].pos.x, block, end - begin);
+			});
+		}
+
+		void to_soa(const std::vector<vertex> &in, VertexStreamsSoA &out)
+		{
+			to_soa(in.empty() ? 0 : &in[0], in.size(), out);
+		}
+
+		void to_aos(const VertexStreamsView &in, vertex *out)
+		{
+			const batch_kernels &k = kernels();
+
+			for_each_block(in.size(), [&](size_t begin, size_t end)
+			{
+				const float *block[stream_count];
+				for (size_t s = 0; s != stream_count; ++s)
+				{
+					block[s] = in.streams()[s] + begin;
+				}
+				k.soa_to_aos(block, &out[begin].pos.x, end - begin);
+			});
+		}
+
+		void to_aos(const VertexStreamsView &in, std::vector<vertex> &out)
+		{
+			out.resize(in.size());
+			if (!out.empty())
+			{
+				to_aos(in, &out[0]);
+			}
+		}
+	}
+}
@@ -0,0 +1,481 @@
+#include "UnitTest.h"
+#include "bvh.hpp"
+#include "morton.hpp"
+
+#include <float.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace UnitTest;
+using namespace Dye;
+using namespace Dye::Graphics;
+
+namespace
+{
+	float random(unsigned int &seed)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return static_cast<float>(seed >> 8) / (1 << 24);
+	}
+
+	// count small triangles strewn over the unit cube
+	void make_soup(size_t count, std::vector<vertex> &vertices, std::vector<unsigned int> &indices)
+	{
+		unsigned int seed = 777;
+		vertices.resize(count * 3);
+		indices.resize(count * 3);
+		for (size_t t = 0; t != count; ++t)
+		{
+			float3 center(random(seed), random(seed), random(seed));
+			for (int k = 0; k != 3; ++k)
+			{
+				float3 offset(random(seed) - 0.5f, random(seed) - 0.5f, random(seed) - 0.5f);
+				vertices[t * 3 + k].pos = center + offset * 0.1f;
+				vertices[t * 3 + k].normal = float3(0, 0, 1);
+				vertices[t * 3 + k].tex = float2(0, 0);
+				indices[t * 3 + k] = static_cast<unsigned int>(t * 3 + k);
+			}
+		}
+	}
+
+	// rays from outside the cube through it, the direction not normalized
+	void make_rays(size_t count, std::vector<ray> &rays)
+	{
+		unsigned int seed = 4242;
+		rays.resize(count);
+		for (size_t i = 0; i != count; ++i)
+		{
+			float3 from(random(seed) * 3 - 1, random(seed) * 3 - 1, -1);
+			float3 to(random(seed), random(seed), 2);
+			rays[i].origin = from;
+			rays[i].direction = to - from;
+			rays[i].tmin = 0;
+			rays[i].tmax = i % 4 == 0 ? 0.5f : FLT_MAX;
+		}
+	}
+
+	// the closest hit by testing every triangle
+	hit brute_force(const std::vector<vertex> &vertices, const std::vector<unsigned int> &indices, const ray &r)
+	{
+		hit best = { r.tmax, 0, 0, c_no_hit };
+		for (size_t t = 0; t != indices.size() / 3; ++t)
+		{
+			float3 v0 = vertices[indices[t * 3]].pos;
+			float3 e1 = vertices[indices[t * 3 + 1]].pos - v0;
+			float3 e2 = vertices[indices[t * 3 + 2]].pos - v0;
+			float3 p = cross(r.direction, e2);
+			float det = dot(e1, p);
+			if (det == 0)
+			{
+				continue;
+			}
+			float3 s = r.origin - v0;
+			float u = dot(s, p) / det;
+			float3 q = cross(s, e1);
+			float v = dot(r.direction, q) / det;
+			float d = dot(e2, q) / det;
+			if (u >= 0 && v >= 0 && u + v <= 1 && d >= r.tmin && d <= best.t)
+			{
+				hit h = { d, u, v, static_cast<unsigned int>(t) };
+				best = h;
+			}
+		}
+		return best;
+	}
+
+	bool same_hit(const hit &a, const hit &b, float tolerance = 1e-5f)
+	{
+		if (a.triangle == c_no_hit || b.triangle == c_no_hit)
+		{
+			return a.triangle == b.triangle;
+		}
+		return std::abs(a.t - b.t) <= tolerance * a.t;
+	}
+
+	// each triangle in one leaf, each child inside its parent, the first
+	// one next to it
+	bool check_layout(const Bvh &bvh)
+	{
+		std::vector<int> seen(bvh.triangle_count(), 0);
+		const bvh_node *nodes = bvh.nodes();
+		for (size_t i = 0; i != bvh.node_count(); ++i)
+		{
+			const bvh_node &node = nodes[i];
+			if (node.count != 0)
+			{
+				if (node.count > 8)
+				{
+					return false;
+				}
+				for (unsigned int t = node.offset; t != node.offset + node.count; ++t)
+				{
+					++seen[bvh.triangles()[t].index];
+				}
+				continue;
+			}
+
+			if (node.offset <= i + 1 || node.offset >= bvh.node_count() || node.axis >= 3)
+			{
+				return false;
+			}
+			const bvh_node *children[2] = { &nodes[i + 1], &nodes[node.offset] };
+			for (int c = 0; c != 2; ++c)
+			{
+				for (int k = 0; k != 3; ++k)
+				{
+					if (children[c]->lower[k] < node.lower[k] || children[c]->upper[k] > node.upper[k])
+					{
+						return false;
+					}
+				}
+			}
+		}
+		return std::count(seen.begin(), seen.end(), 1) == static_cast<int>(seen.size());
+	}
+
+	unsigned long long interleave(unsigned int x, unsigned int y, unsigned int z, int bits)
+	{
+		unsigned long long code = 0;
+		for (int b = bits - 1; b >= 0; --b)
+		{
+			code = (code << 3) | ((x >> b & 1) << 2) | ((y >> b & 1) << 1) | (z >> b & 1);
+		}
+		return code;
+	}
+}
+
+class BvhTest : public TestFixture<BvhTest>
+{
+public:
+	TEST_FIXTURE( BvhTest )
+	{
+		TEST_CASE(TestLayout);
+		TEST_CASE(TestEmpty);
+		TEST_CASE(TestClosest);
+		TEST_CASE(TestOccluded);
+		TEST_CASE(TestPacket);
+		TEST_CASE(TestBatch);
+		TEST_CASE(TestMorton);
+		TEST_CASE(TestLinear);
+		TEST_CASE(TestRefit);
+		TEST_CASE(TestInstances);
+	}
+
+private:
+	void TestLayout()
+	{
+		ASSERT(sizeof(bvh_node) == 32);
+
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_soup(5000, vertices, indices);
+		Bvh bvh(&vertices[0], vertices.size(), &indices[0], indices.size());
+		ASSERT(bvh.triangle_count() == 5000);
+		ASSERT(check_layout(bvh));
+
+		aabb box = bvh.bounds();
+		ASSERT(box.lower.x < 0 && box.upper.x > 1);
+		ASSERT(bvh.sah_cost() > 1 && bvh.sah_cost() < 100);
+		ASSERT(bvh.built_sah_cost() == bvh.sah_cost());
+	}
+
+	void TestEmpty()
+	{
+		Bvh bvh;
+		ray r = { float3(0, 0, 0), 0, float3(0, 0, 1), FLT_MAX };
+		hit h;
+		ASSERT(!bvh.intersect(r, h) && !bvh.occluded(r));
+		ASSERT(bvh.node_count() == 0 && bvh.sah_cost() == 0);
+
+		ray8 packet;
+		load_packet(&r, 1, packet);
+		hit8 h8;
+		bvh.intersect(packet, h8);
+		ASSERT(h8.triangle[0] == c_no_hit && bvh.occluded(packet) == 0);
+	}
+
+	void TestClosest()
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_soup(3000, vertices, indices);
+		Bvh bvh(&vertices[0], vertices.size(), &indices[0], indices.size());
+
+		std::vector<ray> rays;
+		make_rays(500, rays);
+		int hits = 0;
+		for (size_t i = 0; i != rays.size(); ++i)
+		{
+			hit expected = brute_force(vertices, indices, rays[i]);
+			hit h = { -1, 0, 0, c_no_hit };
+			bool found = bvh.intersect(rays[i], h);
+			ASSERT(found == (expected.triangle != c_no_hit));
+			ASSERT(same_hit(h, expected));
+			hits += found;
+		}
+		ASSERT(hits > 100 && hits < 490);
+	}
+
+	void TestOccluded()
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_soup(3000, vertices, indices);
+		Bvh bvh(&vertices[0], vertices.size(), &indices[0], indices.size());
+
+		std::vector<ray> rays;
+		make_rays(500, rays);
+		for (size_t i = 0; i != rays.size(); ++i)
+		{
+			hit h;
+			ASSERT(bvh.occluded(rays[i]) == bvh.intersect(rays[i], h));
+		}
+	}
+
+	void TestPacket()
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_soup(3000, vertices, indices);
+		Bvh bvh(&vertices[0], vertices.size(), &indices[0], indices.size());
+
+		std::vector<ray> rays;
+		make_rays(504, rays);
+		for (size_t i = 0; i < rays.size(); i += c_packet_width)
+		{
+			// the last packet runs with lanes off
+			size_t count = i + c_packet_width < rays.size() ? c_packet_width : 5;
+			ray8 packet;
+			hit8 result;
+			load_packet(&rays[i], count, packet);
+			bvh.intersect(packet, result);
+			int occluded = bvh.occluded(packet);
+
+			hit hits[c_packet_width];
+			store_packet(result, count, hits);
+			for (size_t k = 0; k != c_packet_width; ++k)
+			{
+				if (k >= count)
+				{
+					ASSERT(result.triangle[k] == c_no_hit && !(occluded & (1 << k)));
+					continue;
+				}
+				hit h = { 0, 0, 0, c_no_hit };
+				bool found = bvh.intersect(rays[i + k], h);
+				ASSERT(same_hit(hits[k], h));
+				ASSERT(found == ((occluded & (1 << k)) != 0));
+			}
+		}
+	}
+
+	void TestBatch()
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_soup(20000, vertices, indices);
+		Bvh bvh(&vertices[0], vertices.size(), &indices[0], indices.size());
+
+		std::vector<ray> rays;
+		make_rays(4001, rays);
+		std::vector<hit> hits(rays.size());
+		bool occluded[4001];
+		bvh.intersect(&rays[0], rays.size(), &hits[0]);
+		bvh.occluded(&rays[0], rays.size(), occluded);
+		for (size_t i = 0; i != rays.size(); ++i)
+		{
+			hit h = { 0, 0, 0, c_no_hit };
+			bool found = bvh.intersect(rays[i], h);
+			ASSERT(same_hit(hits[i], h));
+			ASSERT(occluded[i] == found);
+		}
+	}
+
+	void TestMorton()
+	{
+		ASSERT(morton_code30(1, 0, 0) == 4 && morton_code30(0, 1, 0) == 2 && morton_code30(0, 0, 1) == 1);
+		ASSERT(morton_code30(1023, 1023, 1023) == (1u << 30) - 1);
+		ASSERT(morton_code63(0x1fffff, 0x1fffff, 0x1fffff) == (1ull << 63) - 1);
+		ASSERT(morton_axis(0) == 2 && morton_axis(4) == 1 && morton_axis(62) == 0);
+
+		unsigned int seed = 99;
+		for (int i = 0; i != 1000; ++i)
+		{
+			unsigned int x = static_cast<unsigned int>(random(seed) * (1 << 21));
+			unsigned int y = static_cast<unsigned int>(random(seed) * (1 << 21));
+			unsigned int z = static_cast<unsigned int>(random(seed) * (1 << 21));
+			ASSERT(morton_code63(x, y, z) == interleave(x, y, z, 21));
+			ASSERT(morton_code30(x, y, z) == interleave(x & 1023, y & 1023, z & 1023, 10));
+		}
+	}
+
+	void TestLinear()
+	{
+		// small meshes take 30 bit codes, large ones 63
+		const size_t counts[2] = { 3000, 70000 };
+		for (int c = 0; c != 2; ++c)
+		{
+			std::vector<vertex> vertices;
+			std::vector<unsigned int> indices;
+			make_soup(counts[c], vertices, indices);
+			Bvh sah(&vertices[0], vertices.size(), &indices[0], indices.size());
+			Bvh linear(&vertices[0], vertices.size(), &indices[0], indices.size(), bvh_build_linear);
+			ASSERT(check_layout(linear));
+			ASSERT(linear.sah_cost() >= sah.sah_cost() * 0.9f && linear.sah_cost() < sah.sah_cost() * 2);
+
+			aabb a = sah.bounds();
+			aabb b = linear.bounds();
+			ASSERT(a.lower.x == b.lower.x && a.upper.y == b.upper.y && a.upper.z == b.upper.z);
+
+			std::vector<ray> rays;
+			make_rays(500, rays);
+			for (size_t i = 0; i != rays.size(); ++i)
+			{
+				hit expected = { 0, 0, 0, c_no_hit };
+				if (c == 0)
+				{
+					expected = brute_force(vertices, indices, rays[i]);
+				}
+				else
+				{
+					sah.intersect(rays[i], expected);
+				}
+				hit h = { 0, 0, 0, c_no_hit };
+				linear.intersect(rays[i], h);
+				ASSERT(same_hit(h, expected));
+				ASSERT(linear.occluded(rays[i]) == (expected.triangle != c_no_hit));
+			}
+		}
+	}
+
+	void TestRefit()
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_soup(3000, vertices, indices);
+		Bvh bvh(&vertices[0], vertices.size(), &indices[0], indices.size());
+		float built = bvh.sah_cost();
+
+		// each triangle shifted its own way, which scatters the leaves
+		unsigned int seed = 5;
+		for (size_t t = 0; t != vertices.size() / 3; ++t)
+		{
+			float3 shift(random(seed) - 0.5f, random(seed) - 0.5f, random(seed) - 0.5f);
+			for (int k = 0; k != 3; ++k)
+			{
+				vertices[t * 3 + k].pos += shift * 0.5f;
+			}
+		}
+		bvh.refit(&vertices[0], vertices.size(), &indices[0]);
+		ASSERT(check_layout(bvh));
+		ASSERT(bvh.built_sah_cost() == built && bvh.sah_cost() > built);
+
+		std::vector<ray> rays;
+		make_rays(500, rays);
+		for (size_t i = 0; i != rays.size(); ++i)
+		{
+			hit expected = brute_force(vertices, indices, rays[i]);
+			hit h = { 0, 0, 0, c_no_hit };
+			bvh.intersect(rays[i], h);
+			ASSERT(same_hit(h, expected) && h.triangle == expected.triangle);
+		}
+
+		ray8 packet;
+		hit8 result;
+		load_packet(&rays[0], c_packet_width, packet);
+		bvh.intersect(packet, result);
+		for (size_t k = 0; k != c_packet_width; ++k)
+		{
+			hit expected = brute_force(vertices, indices, rays[k]);
+			ASSERT(result.triangle[k] == expected.triangle && result.instance[k] == c_no_hit);
+		}
+	}
+
+	void TestInstances()
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_soup(2000, vertices, indices);
+		Bvh object(&vertices[0], vertices.size(), &indices[0], indices.size());
+
+		// as it is, turned about z and moved, and halved through a float4x4
+		float c = std::cos(0.7f);
+		float s = std::sin(0.7f);
+		float3x4 turn(c, -s, 0, 1.5f, s, c, 0, -0.5f, 0, 0, 1, 0.5f);
+		float4x4 half(0.5f, 0, 0, 0, 0, 0.5f, 0, 0, 0, 0, 0.5f, 0, 0.25f, 0.5f, 1.5f, 1);
+		InstanceBvh scene;
+		ASSERT(scene.add(&object, float3x4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0)) == 0);
+		ASSERT(scene.add(&object, turn) == 1);
+		ASSERT(scene.add(&object, half) == 2);
+
+		for (int pass = 0; pass != 3; ++pass)
+		{
+			if (pass == 0)
+			{
+				scene.build();
+			}
+			else if (pass == 1)
+			{
+				// moved, with only the top level built again
+				scene.set_transform(0, float3x4(1, 0, 0, 0.2f, 0, 1, 0, 0.1f, 0, 0, 1, 0));
+				scene.build(bvh_build_linear);
+			}
+			else
+			{
+				half[3] = float4(0.25f, 0.3f, 1.4f, 1);
+				scene.set_transform(2, half);
+				scene.refit();
+			}
+
+			// every instance spelled out in world space
+			std::vector<vertex> world;
+			std::vector<unsigned int> world_indices;
+			for (unsigned int i = 0; i != scene.instance_count(); ++i)
+			{
+				for (size_t v = 0; v != vertices.size(); ++v)
+				{
+					vertex w = vertices[v];
+					w.pos = transform_point(scene.instance(i).transform, vertices[v].pos);
+					world.push_back(w);
+				}
+				for (size_t k = 0; k != indices.size(); ++k)
+				{
+					world_indices.push_back(static_cast<unsigned int>(indices[k] + i * vertices.size()));
+				}
+			}
+			aabb box = scene.bounds();
+			ASSERT(box.lower.y < 0 && box.upper.x > 1.5f);
+
+			std::vector<ray> rays;
+			make_rays(504, rays);
+			std::vector<hit> hits(rays.size());
+			scene.intersect(&rays[0], rays.size(), &hits[0]);
+			int found = 0;
+			for (size_t i = 0; i != rays.size(); ++i)
+			{
+				hit expected = brute_force(world, world_indices, rays[i]);
+				hit h = { 0, 0, 0, c_no_hit, c_no_hit };
+				bool any_hit = scene.intersect(rays[i], h);
+				ASSERT(any_hit == (expected.triangle != c_no_hit) && scene.occluded(rays[i]) == any_hit);
+				ASSERT(same_hit(h, expected, 1e-4f) && same_hit(hits[i], expected, 1e-4f));
+				if (any_hit)
+				{
+					ASSERT(h.instance * indices.size() / 3 + h.triangle == expected.triangle);
+					ASSERT(hits[i].instance == h.instance && hits[i].triangle == h.triangle);
+				}
+				found += any_hit;
+			}
+			ASSERT(found > 100);
+
+			ray8 packet;
+			load_packet(&rays[0], c_packet_width, packet);
+			int occluded = scene.occluded(packet);
+			for (size_t k = 0; k != c_packet_width; ++k)
+			{
+				ASSERT(((occluded >> k) & 1) == (hits[k].triangle != c_no_hit));
+			}
+		}
+	}
+};
+
+REGISTER_FIXTURE(BvhTest);
@@ -0,0 +1,104 @@
+#include "UnitTest.h"
+#include "cpu_dispatch.hpp"
+#include "transform.hpp"
+#include "matrix_aux.hpp"
+#include "constant.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace UnitTest;
+using namespace Dye;
+
+class CpuDispatchTest : public TestFixture<CpuDispatchTest>
+{
+public:
+	TEST_FIXTURE( CpuDispatchTest )
+	{
+		TEST_CASE(TestLevels);
+		TEST_CASE(TestKernels);
+	}
+
+private:
+	static float4x4 Matrix()
+	{
+		return float4x4(
+			 2,  0,  1,  0,
+			 0,  0,  3,  0,
+			 0, -1,  0,  0,
+			 5,  6,  7,  1);
+	}
+
+	static bool Near(const float *lhs, const float *rhs, size_t n)
+	{
+		bool equal = true;
+		for (size_t i = 0; i != n; ++i)
+		{
+			equal &= std::abs(lhs[i] - rhs[i]) < 1e-4f * (1 + std::abs(rhs[i]));
+		}
+		return equal;
+	}
+
+	void TestLevels()
+	{
+		cpu_level level;
+		ASSERT(cpu_level_from_name("AVX2", level) && level == cpu_avx2);
+		ASSERT(cpu_level_from_name(cpu_level_name(cpu_sse42), level) && level == cpu_sse42);
+		ASSERT(cpu_level_from_name("avx", level) && level == cpu_avx);
+		ASSERT(!cpu_level_from_name("avx3", level));
+		ASSERT(!cpu_level_from_name("", level));
+
+		ASSERT(active_cpu_level() <= detected_cpu_level());
+		ASSERT(baseline_kernels() != 0);
+	}
+
+	// every level up to the detected one must give the baseline results
+	void TestKernels()
+	{
+		const size_t n = 37;
+		std::vector<float3> points(n);
+		std::vector<float4> points4(n);
+		std::vector<float4x4> mats(n);
+		for (size_t i = 0; i != n; ++i)
+		{
+			points[i] = float3(float(i), float(i) * 0.5f, -float(i));
+			points4[i] = float4(points[i].x, points[i].y, points[i].z, 1);
+			float4x4 scale = float4x4::diag(1, 2, 3, 1) * (1 + 0.1f * i);
+			mats[i] = mul(scale, Matrix());
+		}
+
+		cpu_level initial = active_cpu_level();
+		bool equal = true;
+		for (int l = cpu_scalar; l <= detected_cpu_level(); ++l)
+		{
+			ASSERT_EQUALS(set_cpu_level(static_cast<cpu_level>(l)), static_cast<cpu_level>(l));
+
+			std::vector<float3> p(n), nrm(n), unit(n);
+			std::vector<float4> p4(n);
+			std::vector<float4x4> invs(n);
+			transform_points(Matrix(), &points[0], &p[0], n);
+			transform_normals(Matrix(), &points[0], &nrm[0], n);
+			transform(Matrix(), &points4[0], &p4[0], n);
+			normalize(&points[0], &unit[0], n);
+			inv(&mats[0], &invs[0], n);
+
+			for (size_t i = 0; i != n; ++i)
+			{
+				float4 expected = mul(points4[i], Matrix());
+				float3 direction = points[i] / std::max(points[i].length(), std::sqrt(c_eps));
+				float4x4 identity = mul(mats[i], invs[i]);
+				equal &= Near(p[i].ptr(), expected.ptr(), 3);
+				equal &= Near(p4[i].ptr(), expected.ptr(), 4);
+				equal &= Near(unit[i].ptr(), direction.ptr(), 3);
+				equal &= std::abs(nrm[i].length() - (i == 0 ? 0 : 1)) < 1e-5f;
+				equal &= Near(identity.ptr(), float4x4::identity().ptr(), 16);
+			}
+		}
+		set_cpu_level(initial);
+		ASSERT(equal);
+		ASSERT_EQUALS(active_cpu_level(), initial);
+	}
+};
+
+REGISTER_FIXTURE(CpuDispatchTest);
@@ -0,0 +1,130 @@
+#include "UnitTest.h"
+#include "fast_math.hpp"
+
+#include <cmath>
+
+using namespace UnitTest;
+using namespace Dye;
+
+class FastMathTest : public TestFixture<FastMathTest>
+{
+public:
+	TEST_FIXTURE( FastMathTest )
+	{
+		TEST_CASE(TestReciprocal);
+		TEST_CASE(TestTrigonometric);
+		TEST_CASE(TestExponential);
+		TEST_CASE(TestBatch);
+		TEST_CASE(TestVector);
+	}
+
+private:
+	static bool Near(float value, double expected, double ulp)
+	{
+		double scale = std::fabs(expected) > 1.17549435e-38 ? std::fabs(expected) : 1.17549435e-38;
+		return std::fabs(value - expected) <= ulp * scale * std::ldexp(1.0, -23);
+	}
+
+	void TestReciprocal()
+	{
+		bool equal = true;
+		for (float x = 1.0e-30f; x < 1.0e30f; x *= 1.37f)
+		{
+			equal &= Near(rcp_fast(x), 1.0 / x, 4);
+			equal &= Near(rsqrt_fast(x), 1.0 / std::sqrt(double(x)), 4);
+			equal &= Near(sqrt_fast(x), std::sqrt(double(x)), 4);
+			equal &= Near(rcp_est(x), 1.0 / x, 1 << 12);
+		}
+		ASSERT(equal);
+		ASSERT_EQUALS(sqrt_fast(0.0f), 0.0f);
+	}
+
+	void TestTrigonometric()
+	{
+		bool equal = true;
+		for (float x = -c_pi; x <= c_pi; x += 0.001f)
+		{
+			equal &= std::fabs(sin_fast(x) - std::sin(double(x))) < 2.0e-7;
+			equal &= std::fabs(cos_fast(x) - std::cos(double(x))) < 2.0e-7;
+		}
+		for (float x = -8192.0f; x <= 8192.0f; x += 0.37f)
+		{
+			equal &= std::fabs(sin_fast(x) - std::sin(double(x))) < 1.0e-6;
+			equal &= std::fabs(cos_fast(x) - std::cos(double(x))) < 1.0e-6;
+		}
+		ASSERT(equal);
+	}
+
+	void TestExponential()
+	{
+		bool equal = true;
+		for (float x = -87.0f; x <= 88.0f; x += 0.01f)
+		{
+			equal &= Near(exp_fast(x), std::exp(double(x)), 2);
+		}
+		for (float x = 1.0e-30f; x < 1.0e30f; x *= 1.37f)
+		{
+			equal &= Near(log_fast(x), std::log(double(x)), 2);
+		}
+		for (float x = 1.0e-3f; x < 1.0e3f; x *= 1.1f)
+		{
+			for (float y = -4.0f; y <= 4.0f; y += 0.25f)
+			{
+				equal &= Near(pow_fast(x, y), std::pow(double(x), double(y)), 64);
+			}
+		}
+		ASSERT(equal);
+	}
+
+	void TestBatch()
+	{
+		float8 x;
+		for (size_t i = 0; i != c_packet_width; ++i)
+		{
+			x[i] = float(i) * 1.7f - 5.0f;
+		}
+		float4 x4(x[0], x[1], x[2], x[3]);
+
+		float8 s = sin_fast(x);
+		float8 e = exp_fast(x);
+		float8 l = log_fast(abs(x));
+		float8 p = pow_fast(abs(x), float8(1.5f));
+		float4 c4 = cos_fast(x4);
+		float4 r4 = rsqrt_fast(x4 * x4);
+
+		bool equal = true;
+		for (size_t i = 0; i != c_packet_width; ++i)
+		{
+			equal &= s[i] == sin_fast(x[i]);
+			equal &= e[i] == exp_fast(x[i]);
+			equal &= l[i] == log_fast(std::fabs(x[i]));
+			equal &= p[i] == pow_fast(std::fabs(x[i]), 1.5f);
+		}
+		for (size_t i = 0; i != 4; ++i)
+		{
+			equal &= c4[i] == cos_fast(x[i]);
+			equal &= r4[i] == rsqrt_fast(x[i] * x[i]);
+		}
+		ASSERT(equal);
+	}
+
+	void TestVector()
+	{
+		float3 v(3, -4, 12);
+		float3 n = normalize_fast(v);
+		ASSERT(Near(length_fast(v), 13, 4));
+		ASSERT(Near(n.x, 3.0 / 13, 4) && Near(n.y, -4.0 / 13, 4) && Near(n.z, 12.0 / 13, 4));
+
+		float4 v4(1, 2, 2, 4);
+		ASSERT(Near(length_fast(v4), 5, 4));
+		ASSERT(Near(normalize_fast(v4).w, 0.8, 4));
+
+		float3x8 p(float8(3), float8(-4), float8(12));
+		float3x8 q = normalize_fast(p);
+		float8 len = length_fast(p);
+		ASSERT(q.y[5] == n.y && len[7] == length_fast(v));
+		ASSERT_EQUALS(length_fast(float2(0, 0)), 0.0f);
+	}
+};
+
+REGISTER_FIXTURE(FastMathTest);
@@ -0,0 +1,91 @@
+#include "UnitTest.h"
+#include "fixed.hpp"
+#include "matrix.hpp"
+
+#include <cmath>
+#include <vector>
+
+using namespace UnitTest;
+using namespace Dye;
+
+class FixedTest : public TestFixture<FixedTest>
+{
+public:
+	TEST_FIXTURE( FixedTest )
+	{
+		TEST_CASE(TestArithmetic);
+		TEST_CASE(TestVector);
+		TEST_CASE(TestConvert);
+	}
+
+private:
+	void TestArithmetic()
+	{
+		ASSERT(sizeof(fixed16) == 4);
+		ASSERT(fixed16(1).raw == 0x10000);
+		ASSERT(fixed16(-0.5f).raw == -0x8000);
+
+		fixed16 a = 1.5f;
+		fixed16 b = -2.25;
+		ASSERT(a + b == fixed16(-0.75f));
+		ASSERT(a * b == fixed16(-3.375f));
+		ASSERT(b / a == fixed16(-1.5f));
+		ASSERT(a > b && -a < a && abs(b) == fixed16(2.25f));
+
+		// ties to even on conversion, away from zero on multiplication
+		ASSERT(fixed16(std::ldexp(1.0f, -17)).raw == 0);
+		ASSERT(fixed16(3 * std::ldexp(1.0f, -17)).raw == 2);
+		ASSERT((fixed16::from_raw(1) * fixed16(0.5f)).raw == 1);
+		ASSERT((fixed16::from_raw(-1) * fixed16(0.5f)).raw == -1);
+
+		ASSERT(sqrt(fixed16(2)).raw == 92682);
+		ASSERT(sqrt(fixed16(-1)) == fixed16());
+		ASSERT((fixed16(32767) + fixed16(1)).raw == static_cast<int>(0x80000000u));
+		ASSERT(fixed16(0.25f).to_float() == 0.25f);
+	}
+
+	void TestVector()
+	{
+		fixed3 a(3, 0, 4);
+		fixed3 b(0, 2, 0);
+
+		ASSERT(a.length() == fixed16(5));
+		ASSERT(dot(a, b) == fixed16());
+		ASSERT(abs(normalize(a).z - fixed16(0.8)).raw <= 2);
+
+		fixed3 c = cross(a, b);
+		ASSERT(c.x == fixed16(-8) && c.y == fixed16() && c.z == fixed16(6));
+
+		fixed3 d = a / 2;
+		ASSERT(d.x == fixed16(1.5f) && d.z == fixed16(2));
+
+		matrix_3x3t<fixed16> m = matrix_3x3t<fixed16>::diag(1, 2, 0.5f);
+		fixed3 e = mul(a, m);
+		ASSERT(e.x == fixed16(3) && e.z == fixed16(2));
+	}
+
+	void TestConvert()
+	{
+		const size_t n = 39;
+		std::vector<float> in(n);
+		for (size_t i = 0; i != n; ++i)
+		{
+			in[i] = (float(i) - 20) * 1.37f + std::ldexp(1.0f, -17);
+		}
+
+		std::vector<fixed16> f(n);
+		std::vector<float> back(n);
+		convert(&in[0], &f[0], n);
+		convert(&f[0], &back[0], n);
+
+		bool equal = true;
+		for (size_t i = 0; i != n; ++i)
+		{
+			equal &= f[i] == fixed16(in[i]);
+			equal &= back[i] == f[i].to_float();
+		}
+		ASSERT(equal);
+	}
+};
+
+REGISTER_FIXTURE(FixedTest);
@@ -0,0 +1,102 @@
+#include "UnitTest.h"
+#include "half.hpp"
+#include "matrix.hpp"
+#include "cpu_dispatch.hpp"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace UnitTest;
+using namespace Dye;
+
+class HalfTest : public TestFixture<HalfTest>
+{
+public:
+	TEST_FIXTURE( HalfTest )
+	{
+		TEST_CASE(TestArithmetic);
+		TEST_CASE(TestVector);
+		TEST_CASE(TestConvert);
+	}
+
+private:
+	void TestArithmetic()
+	{
+		ASSERT(sizeof(half) == 2);
+		ASSERT(half().bits == 0);
+		ASSERT(half(1.5f).bits == 0x3e00);
+
+		half a = 1.5f;
+		half b = -0.25f;
+		ASSERT(a + b == 1.25f);
+		ASSERT(a * b == -0.375f);
+
+		// every operation rounds to a half
+		half c = 1;
+		c += half(std::ldexp(1.0f, -11));
+		ASSERT(c == 1.0f);
+		c /= 3;
+		ASSERT(c.bits == half_from_float(1.0f / 3));
+
+		ASSERT(abs(b) == 0.25f);
+		ASSERT(sqrt(half(4)) == 2.0f);
+		ASSERT(half(70000.0f) == std::numeric_limits<float>::infinity());
+	}
+
+	void TestVector()
+	{
+		half3 a(3, 0, 4);
+		half3 b(0, 2, 0);
+
+		ASSERT(a.length() == 5.0f);
+		ASSERT(dot(a, b) == 0.0f);
+		ASSERT(std::abs(normalize(a).x - 0.6f) < 1e-3f);
+
+		half3 c = cross(a, b);
+		ASSERT(c.x == -8.0f && c.y == 0.0f && c.z == 6.0f);
+
+		half3 d = a + b * 2.0f;
+		ASSERT(d.x == 3.0f && d.y == 4.0f && d.z == 4.0f);
+
+		matrix_3x3t<half> m = matrix_3x3t<half>::diag(1, 2, 0.5f);
+		half3 e = mul(a, m);
+		ASSERT(e.x == 3.0f && e.y == 0.0f && e.z == 2.0f);
+	}
+
+	// every level up to the detected one rounds like the scalar conversion
+	void TestConvert()
+	{
+		const size_t n = 1027;
+		std::vector<float> in(n);
+		for (size_t i = 0; i != n; ++i)
+		{
+			in[i] = std::ldexp(1.0f + 0.37f * i, static_cast<int>(i % 48) - 28) * (i % 3 ? 1 : -1);
+		}
+		in[5] = std::numeric_limits<float>::infinity();
+		in[6] = 1 + std::ldexp(1.0f, -11);
+		in[7] = std::ldexp(1.0f, -24);
+
+		cpu_level initial = active_cpu_level();
+		bool equal = true;
+		for (int l = cpu_scalar; l <= detected_cpu_level(); ++l)
+		{
+			set_cpu_level(static_cast<cpu_level>(l));
+
+			std::vector<half> h(n);
+			std::vector<float> back(n);
+			convert(&in[0], &h[0], n);
+			convert(&h[0], &back[0], n);
+
+			for (size_t i = 0; i != n; ++i)
+			{
+				equal &= h[i].bits == half_from_float(in[i]);
+				equal &= back[i] == half_to_float(h[i].bits);
+			}
+		}
+		set_cpu_level(initial);
+		ASSERT(equal);
+	}
+};
+
+REGISTER_FIXTURE(HalfTest);
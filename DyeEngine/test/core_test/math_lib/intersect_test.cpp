@@ -0,0 +1,366 @@
+#include "UnitTest.h"
+#include "intersect.hpp"
+
+#include <float.h>
+#include <cmath>
+
+using namespace UnitTest;
+using namespace Dye;
+using namespace Dye::Graphics;
+
+namespace
+{
+	float random(unsigned int &seed)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return static_cast<float>(seed >> 8) / (1 << 24);
+	}
+
+	float3 random_point(unsigned int &seed)
+	{
+		return float3(random(seed) * 2 - 1, random(seed) * 2 - 1, random(seed) * 2 - 1);
+	}
+
+	bool close(float a, float b)
+	{
+		return std::abs(a - b) <= 1e-4f * (1 + std::abs(a));
+	}
+
+	// rays from a shell around the unit cube towards points in it, so that
+	// every direction comes up
+	ray random_ray(unsigned int &seed)
+	{
+		float3 to = random_point(seed);
+		float3 from = random_point(seed);
+		from = from * (3 / std::sqrt(dot(from, from)));
+		ray r = { from, 0, to - from, random(seed) < 0.25f ? 0.5f : FLT_MAX };
+		return r;
+	}
+
+	void set_lane(float3x8 &v, size_t lane, const float3 &p)
+	{
+		v.x[lane] = p.x;
+		v.y[lane] = p.y;
+		v.z[lane] = p.z;
+	}
+
+	// away from the edges, where either answer is right
+	bool inside(float u, float v)
+	{
+		return u > 1e-3f && v > 1e-3f && 1 - u - v > 1e-3f;
+	}
+}
+
+class IntersectTest : public TestFixture<IntersectTest>
+{
+public:
+	TEST_FIXTURE( IntersectTest )
+	{
+		TEST_CASE(TestBox);
+		TEST_CASE(TestBoxes);
+		TEST_CASE(TestTriangles);
+		TEST_CASE(TestWatertight);
+		TEST_CASE(TestSpheres);
+	}
+
+private:
+	void TestBox()
+	{
+		const float3 lower(-1, -1, -1);
+		const float3 upper(1, 1, 1);
+		float entry;
+
+		float3 origin(-3, 0, 0);
+		float3 direction(1, 0, 0);
+		ASSERT(intersect_box(lower, upper, origin, reciprocal(direction), 0, FLT_MAX, entry) && entry == 2);
+		ASSERT(!intersect_box(lower, upper, origin, reciprocal(direction), 0, 1.5f, entry));
+
+		// parallel to the slabs, inside and outside of them
+		origin = float3(-3, 0.5f, 0.5f);
+		ASSERT(intersect_box(lower, upper, origin, reciprocal(direction), 0, FLT_MAX, entry));
+		origin = float3(-3, 1.5f, 0.5f);
+		ASSERT(!intersect_box(lower, upper, origin, reciprocal(direction), 0, FLT_MAX, entry));
+
+		// from inside the entry is tmin
+		origin = float3(0, 0, 0);
+		direction = float3(0.3f, -1, 0.2f);
+		ASSERT(intersect_box(lower, upper, origin, reciprocal(direction), 0.25f, FLT_MAX, entry) && entry == 0.25f);
+	}
+
+	void TestBoxes()
+	{
+		unsigned int seed = 11;
+		aabb4 boxes4;
+		aabb8 boxes8;
+		float3 lower[8];
+		float3 upper[8];
+		for (size_t b = 0; b != 8; ++b)
+		{
+			float3 a = random_point(seed);
+			float3 size(random(seed), random(seed), random(seed));
+			lower[b] = a * 0.75f;
+			upper[b] = lower[b] + size;
+			set_lane(boxes8.lower, b, lower[b]);
+			set_lane(boxes8.upper, b, upper[b]);
+			for (int k = 0; b < 4 && k != 3; ++k)
+			{
+				boxes4.lower[k][b] = lower[b][k];
+				boxes4.upper[k][b] = upper[b][k];
+			}
+		}
+
+		int total = 0;
+		for (int i = 0; i != 256; ++i)
+		{
+			ray r[8];
+			ray8 packet;
+			for (size_t lane = 0; lane != 8; ++lane)
+			{
+				r[lane] = random_ray(seed);
+			}
+			load_packet(r, 8, packet);
+			const float3x8 inv8 = reciprocal(packet.direction);
+
+			const float3 inv = reciprocal(r[0].direction);
+			float entries4[4];
+			float8 entries8;
+			int bits4 = intersect_boxes(boxes4, r[0].origin, inv, r[0].tmin, r[0].tmax, entries4);
+			int bits8 = intersect_boxes(boxes8, r[0].origin, inv, r[0].tmin, r[0].tmax, entries8);
+			for (size_t b = 0; b != 8; ++b)
+			{
+				float entry;
+				bool single = intersect_box(lower[b], upper[b], r[0].origin, inv, r[0].tmin, r[0].tmax, entry);
+				total += single;
+				ASSERT(((bits8 >> b) & 1) == static_cast<int>(single));
+				ASSERT(!single || entries8[b] == entry);
+				ASSERT(b >= 4 || ((bits4 >> b) & 1) == static_cast<int>(single));
+				ASSERT(b >= 4 || !single || entries4[b] == entry);
+
+				float8 packet_entry;
+				int lanes = movemask(intersect_box(lower[b], upper[b], packet.origin, inv8, packet.tmin, packet.tmax,
+					packet_entry));
+				for (size_t lane = 0; lane != 8; ++lane)
+				{
+					bool one = intersect_box(lower[b], upper[b], r[lane].origin, reciprocal(r[lane].direction),
+						r[lane].tmin, r[lane].tmax, entry);
+					ASSERT(((lanes >> lane) & 1) == static_cast<int>(one));
+					ASSERT(!one || packet_entry[lane] == entry);
+				}
+			}
+		}
+		ASSERT(total > 100);
+	}
+
+	void TestTriangles()
+	{
+		unsigned int seed = 23;
+		int hits = 0;
+		for (int i = 0; i != 256; ++i)
+		{
+			triangle8 tris;
+			float3 v[8][3];
+			for (size_t b = 0; b != 8; ++b)
+			{
+				v[b][0] = random_point(seed);
+				v[b][1] = random_point(seed);
+				v[b][2] = random_point(seed);
+				set_lane(tris.v0, b, v[b][0]);
+				set_lane(tris.v1, b, v[b][1]);
+				set_lane(tris.v2, b, v[b][2]);
+			}
+			ray r[8];
+			ray8 packet;
+			for (size_t lane = 0; lane != 8; ++lane)
+			{
+				r[lane] = random_ray(seed);
+			}
+			load_packet(r, 8, packet);
+			const ray_shear shear = watertight_shear(r[0].direction);
+			const ray_shear8 shear8 = watertight_shear(packet.direction);
+
+			float8 t8, u8, v8, wt8, wu8, wv8;
+			int bits = intersect_triangles(tris, r[0].origin, r[0].direction, r[0].tmin, r[0].tmax, t8, u8, v8);
+			int wbits = intersect_triangles(tris, r[0].origin, shear, r[0].tmin, r[0].tmax, wt8, wu8, wv8);
+			for (size_t b = 0; b != 8; ++b)
+			{
+				float t, u, w, wt, wu, ww;
+				bool mt = intersect_triangle(v[b][0], v[b][1], v[b][2], r[0].origin, r[0].direction,
+					r[0].tmin, r[0].tmax, t, u, w);
+				bool wat = intersect_triangle(v[b][0], v[b][1], v[b][2], r[0].origin, shear,
+					r[0].tmin, r[0].tmax, wt, wu, ww);
+				hits += mt;
+
+				// the two methods agree but at the edges
+				if (mt && inside(u, w))
+				{
+					ASSERT(wat && close(t, wt) && close(u, wu) && close(w, ww));
+				}
+				if (wat && inside(wu, ww))
+				{
+					ASSERT(mt);
+				}
+
+				// each 8 wide form as its single one
+				if (mt && inside(u, w))
+				{
+					ASSERT(((bits >> b) & 1) && close(t, t8[b]) && close(u, u8[b]) && close(w, v8[b]));
+				}
+				if (wat && inside(wu, ww))
+				{
+					ASSERT(((wbits >> b) & 1) && close(wt, wt8[b]) && close(wu, wu8[b]) && close(ww, wv8[b]));
+				}
+				if (!mt && !wat)
+				{
+					ASSERT(!((bits >> b) & 1) || !inside(u8[b], v8[b]));
+					ASSERT(!((wbits >> b) & 1) || !inside(wu8[b], wv8[b]));
+				}
+
+				// and the packets
+				float8 pt, pu, pv, wpt, wpu, wpv;
+				int lanes = movemask(intersect_triangle(v[b][0], v[b][1], v[b][2], packet.origin, packet.direction,
+					packet.tmin, packet.tmax, pt, pu, pv));
+				int wlanes = movemask(intersect_triangle(v[b][0], v[b][1], v[b][2], packet.origin, shear8,
+					packet.tmin, packet.tmax, wpt, wpu, wpv));
+				for (size_t lane = 0; lane != 8; ++lane)
+				{
+					bool one = intersect_triangle(v[b][0], v[b][1], v[b][2], r[lane].origin, r[lane].direction,
+						r[lane].tmin, r[lane].tmax, t, u, w);
+					if (one && inside(u, w))
+					{
+						ASSERT(((lanes >> lane) & 1) && close(t, pt[lane]));
+					}
+					one = intersect_triangle(v[b][0], v[b][1], v[b][2], r[lane].origin,
+						watertight_shear(r[lane].direction), r[lane].tmin, r[lane].tmax, wt, wu, ww);
+					if (one && inside(wu, ww))
+					{
+						ASSERT(((wlanes >> lane) & 1) && close(wt, wpt[lane]) && close(wu, wpu[lane]));
+					}
+				}
+			}
+		}
+		ASSERT(hits > 50);
+	}
+
+	void TestWatertight()
+	{
+		// a flat fan of triangles around a vertex off the grid, tilted;
+		// rays through the common vertex and the points along the shared
+		// edges must hit at least one of them
+		const size_t sides = 7;
+		const float3 center(0.1f, 0.2f, 0.3f);
+		float3 rim[sides];
+		for (size_t s = 0; s != sides; ++s)
+		{
+			float a = 6.2831853f * s / sides;
+			float x = std::cos(a) * (1 + 0.3f * s / sides);
+			float y = std::sin(a) * (1 + 0.3f * s / sides);
+			rim[s] = center + float3(x, y, 0.37f * x - 0.21f * y);
+		}
+		triangle8 fan;
+		for (size_t k = 0; k != 8; ++k)
+		{
+			set_lane(fan.v0, k, center);
+			set_lane(fan.v1, k, rim[k % sides]);
+			set_lane(fan.v2, k, rim[(k + 1) % sides]);
+		}
+
+		unsigned int seed = 31;
+		int missed = 0;
+		for (int i = 0; i != 2000; ++i)
+		{
+			size_t s = i % sides;
+			float f = i < 2000 / 8 ? 0 : random(seed) * 0.9f;
+			float3 target = center + (rim[s] - center) * f;
+			float3 from = random_point(seed) * 3.0f;
+			from.z = from.z < 0 ? from.z - 1 : from.z + 1;
+			const float3 direction = target - from;
+			const ray_shear shear = watertight_shear(direction);
+
+			// the same ray in every lane of a packet
+			ray r = { from, 0, direction, FLT_MAX };
+			ray rays[8] = { r, r, r, r, r, r, r, r };
+			ray8 packet;
+			load_packet(rays, 8, packet);
+			const ray_shear8 shear8 = watertight_shear(packet.direction);
+
+			bool single = false;
+			int lanes = 0;
+			for (size_t k = 0; k != sides; ++k)
+			{
+				float t, u, v;
+				single |= intersect_triangle(center, rim[k], rim[(k + 1) % sides], from, shear, 0, FLT_MAX, t, u, v);
+				float8 t8, u8, v8;
+				lanes |= movemask(intersect_triangle(center, rim[k], rim[(k + 1) % sides], packet.origin, shear8,
+					packet.tmin, packet.tmax, t8, u8, v8));
+			}
+			float8 t8, u8, v8;
+			bool wide = intersect_triangles(fan, from, shear, 0, FLT_MAX, t8, u8, v8) != 0;
+			missed += !single || !wide || lanes != 0xff;
+		}
+		ASSERT(missed == 0);
+	}
+
+	void TestSpheres()
+	{
+		float t;
+		const float3 center(1, 2, 3);
+
+		ASSERT(intersect_sphere(center, 0.5f, float3(1, 2, 0), float3(0, 0, 2), 0, FLT_MAX, t) && t == 1.25f);
+		ASSERT(!intersect_sphere(center, 0.5f, float3(1, 2, 0), float3(0, 0, 2), 0, 1, t));
+		ASSERT(!intersect_sphere(center, 0.5f, float3(1.6f, 2, 0), float3(0, 0, 1), 0, FLT_MAX, t));
+		ASSERT(!intersect_sphere(center, 0.5f, float3(1, 2, 0), float3(0, 0, -1), 0, FLT_MAX, t));
+
+		// from inside the far side
+		ASSERT(intersect_sphere(center, 0.5f, center, float3(0, 1, 0), 0, FLT_MAX, t) && close(t, 0.5f));
+
+		// a small sphere far from the origin still comes out close
+		const float3 distant(0, 0, 10000);
+		ASSERT(intersect_sphere(distant, 0.01f, float3(0.001f, 0, 0), float3(0, 0, 1), 0, FLT_MAX, t));
+		ASSERT(std::abs(t - (10000 - std::sqrt(0.01f * 0.01f - 0.001f * 0.001f))) < 2e-3f);
+
+		unsigned int seed = 47;
+		int hits = 0;
+		for (int i = 0; i != 256; ++i)
+		{
+			sphere8 spheres;
+			float3 centers[8];
+			float radii[8];
+			for (size_t b = 0; b != 8; ++b)
+			{
+				centers[b] = random_point(seed);
+				radii[b] = 0.05f + random(seed) * 0.5f;
+				set_lane(spheres.center, b, centers[b]);
+				spheres.radius[b] = radii[b];
+			}
+			ray r[8];
+			ray8 packet;
+			for (size_t lane = 0; lane != 8; ++lane)
+			{
+				r[lane] = random_ray(seed);
+			}
+			load_packet(r, 8, packet);
+
+			float8 t8;
+			int bits = intersect_spheres(spheres, r[0].origin, r[0].direction, r[0].tmin, r[0].tmax, t8);
+			for (size_t b = 0; b != 8; ++b)
+			{
+				bool one = intersect_sphere(centers[b], radii[b], r[0].origin, r[0].direction, r[0].tmin, r[0].tmax, t);
+				hits += one;
+				ASSERT(((bits >> b) & 1) == static_cast<int>(one) && (!one || close(t, t8[b])));
+
+				float8 pt;
+				int lanes = movemask(intersect_sphere(centers[b], radii[b], packet.origin, packet.direction,
+					packet.tmin, packet.tmax, pt));
+				for (size_t lane = 0; lane != 8; ++lane)
+				{
+					one = intersect_sphere(centers[b], radii[b], r[lane].origin, r[lane].direction,
+						r[lane].tmin, r[lane].tmax, t);
+					ASSERT(((lanes >> lane) & 1) == static_cast<int>(one) && (!one || close(t, pt[lane])));
+				}
+			}
+		}
+		ASSERT(hits > 100);
+	}
+};
+
+REGISTER_FIXTURE(IntersectTest);
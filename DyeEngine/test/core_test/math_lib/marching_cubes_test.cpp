@@ -0,0 +1,267 @@
+#include "UnitTest.h"
+#include "marching_cubes.hpp"
+#include "scalar_grid.hpp"
+#include "sdf_blocks.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+using namespace UnitTest;
+using namespace Dye;
+using namespace Dye::Graphics;
+using namespace Dye::Render;
+
+namespace
+{
+	float next(unsigned int &seed)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// every edge of every triangle is met once the other way round, so that
+	// the surface is closed and turns one way, and no triangle repeats one
+	bool closed(const std::vector<unsigned int> &indices)
+	{
+		std::vector<std::pair<unsigned int, unsigned int> > edges;
+		for (size_t i = 0; i != indices.size(); i += 3)
+		{
+			for (size_t e = 0; e != 3; ++e)
+			{
+				edges.push_back(std::make_pair(indices[i + e], indices[i + (e + 1) % 3]));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		for (size_t i = 0; i != edges.size(); ++i)
+		{
+			if (i > 0 && edges[i] == edges[i - 1])
+			{
+				return false;
+			}
+			if (!std::binary_search(edges.begin(), edges.end(), std::make_pair(edges[i].second, edges[i].first)))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// random values with the points on the sides of the grid outside
+	std::vector<float> noise(size_t nx, size_t ny, size_t nz, unsigned int seed)
+	{
+		std::vector<float> values(nx * ny * nz);
+		for (size_t k = 0, n = 0; k != nz; ++k)
+		{
+			for (size_t j = 0; j != ny; ++j)
+			{
+				for (size_t i = 0; i != nx; ++i, ++n)
+				{
+					const bool side = i == 0 || j == 0 || k == 0 || i == nx - 1 || j == ny - 1 || k == nz - 1;
+					values[n] = side ? 1 : next(seed) * 2 - 1;
+				}
+			}
+		}
+		return values;
+	}
+}
+
+class MarchingCubesTest : public TestFixture<MarchingCubesTest>
+{
+public:
+	TEST_FIXTURE( MarchingCubesTest )
+	{
+		TEST_CASE(TestNoise);
+		TEST_CASE(TestSphere);
+		TEST_CASE(TestGrid);
+		TEST_CASE(TestBlocks);
+	}
+
+private:
+	void TestNoise()
+	{
+		// every case comes up in noise, over chunks of every kind: a closed
+		// surface with a vertex per edge it crosses, whatever the chunks
+		const size_t nx = 41, ny = 18, nz = 35;
+		const std::vector<float> values = noise(nx, ny, nz, 7);
+		const ScalarGrid grid(&values[0], float3(0, 0, 0), 1, nx, ny, nz);
+		MarchingCubes cubes(grid, float3(0, 0, 0), 1, nx - 1, ny - 1, nz - 1);
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		const mc_stats stats = cubes.extract(vertices, indices);
+		ASSERT(stats.chunks == 3 * 2 * 3 && stats.surface_chunks == stats.chunks);
+		ASSERT(stats.vertices == vertices.size() && stats.triangles * 3 == indices.size());
+		ASSERT(closed(indices));
+
+		size_t crossings = 0;
+		for (size_t k = 0; k != nz; ++k)
+		{
+			for (size_t j = 0; j != ny; ++j)
+			{
+				for (size_t i = 0; i != nx; ++i)
+				{
+					const size_t n = (k * ny + j) * nx + i;
+					crossings += i + 1 < nx && (values[n] < 0) != (values[n + 1] < 0);
+					crossings += j + 1 < ny && (values[n] < 0) != (values[n + nx] < 0);
+					crossings += k + 1 < nz && (values[n] < 0) != (values[n + nx * ny] < 0);
+				}
+			}
+		}
+		ASSERT(vertices.size() == crossings);
+
+		// each vertex on its edge, where the values cross 0
+		for (size_t i = 0; i != vertices.size(); ++i)
+		{
+			const float3 &p = vertices[i].pos;
+			int whole = 0;
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				whole += p[axis] == std::floor(p[axis]);
+			}
+			ASSERT(whole >= 2);
+		}
+	}
+
+	void TestSphere()
+	{
+		SdfTree tree;
+		SdfProgram program;
+		ASSERT(program.compile(tree, tree.sphere(1)));
+		const size_t cells = 40;
+		const float cell = 3.0f / cells;
+		MarchingCubes cubes(program, float3(-1.5f, -1.5f, -1.5f), cell, cells, cells, cells);
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		const mc_stats stats = cubes.extract(vertices, indices);
+		ASSERT(stats.chunks == 27 && stats.surface_chunks > 0 && stats.surface_chunks < 27);
+		ASSERT(closed(indices));
+
+		// a sphere: 2 for the euler characteristic, the edges being 3 / 2
+		// of the triangles
+		const long euler = static_cast<long>(vertices.size()) - static_cast<long>(indices.size() / 2)
+			+ static_cast<long>(indices.size() / 3);
+		ASSERT(euler == 2);
+
+		for (size_t i = 0; i != vertices.size(); ++i)
+		{
+			const float3 &p = vertices[i].pos;
+			ASSERT(std::abs(p.length() - 1) < 0.01f);
+			ASSERT(dot(vertices[i].normal, p) > 0.99f);
+		}
+
+		// turning counter-clockwise seen from outside
+		for (size_t i = 0; i != indices.size(); i += 3)
+		{
+			const float3 &a = vertices[indices[i]].pos;
+			const float3 &b = vertices[indices[i + 1]].pos;
+			const float3 &c = vertices[indices[i + 2]].pos;
+			const float3 ab = b - a;
+			const float3 ac = c - a;
+			const float3 middle = a + b + c;
+			ASSERT(dot(cross(ab, ac), middle) >= 0);
+		}
+
+		// the shell between two values
+		cubes.set_iso(-0.5f);
+		Mesh inner;
+		cubes.extract(inner);
+		ASSERT(inner.triangle_count() > 0 && inner.triangle_count() < indices.size() / 3);
+		ASSERT(std::abs(inner.vertices()[0].pos.length() - 0.5f) < 0.01f);
+	}
+
+	void TestGrid()
+	{
+		// a field sampled into a grid and read back in cells of the grid
+		// gives the same surface as the field
+		SdfTree tree;
+		SdfProgram program;
+		ASSERT(program.compile(tree, tree.torus(1, 0.3f)));
+		const float3 origin(-1.5f, -0.5f, -1.5f);
+		const float cell = 0.05f;
+		ScalarGrid grid;
+		grid.assign(program, origin, cell, 61, 21, 61);
+		ASSERT(grid.count(0) == 61 && std::abs(grid.values()[0] - program.distance(origin)) < 1e-5f);
+
+		std::vector<vertex> vertices[2];
+		std::vector<unsigned int> indices[2];
+		const IScalarField *fields[2] = { &program, &grid };
+		for (int i = 0; i != 2; ++i)
+		{
+			MarchingCubes cubes(*fields[i], origin, cell, 60, 20, 60);
+			cubes.extract(vertices[i], indices[i]);
+		}
+		ASSERT(vertices[0].size() == vertices[1].size() && indices[0] == indices[1]);
+		ASSERT(closed(indices[0]));
+
+		// between the points the grid interpolates, and beyond them it
+		// clamps
+		float out[2];
+		const lattice between = { origin + float3(0.025f, 0, 0), cell, { 0, 0, 0 }, { 1, 1, 1 } };
+		grid.sample_grid(between, out);
+		ASSERT(std::abs(out[0] - (grid.values()[0] + grid.values()[1]) / 2) < 1e-5f);
+		const lattice beyond = { origin, cell, { -3, 0, 0 }, { 2, 1, 1 } };
+		grid.sample_grid(beyond, out);
+		ASSERT(out[0] == grid.values()[0] && out[1] == grid.values()[0]);
+	}
+
+	void TestBlocks()
+	{
+		// the blocks give the same surface as the whole program, sampling
+		// the leaves with their pruned programs
+		SdfTree tree;
+		unsigned int root = tree.empty();
+		for (int i = 0; i != 6; ++i)
+		{
+			const float3 at(std::sin(i * 1.3f) * 2, std::cos(i * 2.1f), std::cos(i * 0.7f) * 2);
+			const unsigned int shape = i % 2 == 0 ? tree.box(float3(0.4f, 0.5f, 0.3f))
+				: tree.smooth_merge(tree.sphere(0.5f), tree.torus(0.6f, 0.15f), 0.2f);
+			root = tree.merge(root, tree.translate(shape, at));
+		}
+		SdfProgram program;
+		ASSERT(program.compile(tree, root));
+		const aabb box = { float3(-4, -4, -4), float3(4, 4, 4) };
+		const float cell = 0.0625f;
+		SdfBlocks blocks;
+		blocks.build(program, box, cell);
+		ASSERT(blocks.count(sdf_block_surface) < blocks.block_count());
+
+		// the lattice of a chunk across leaves of every kind
+		const lattice part = { box.lower, cell, { 30, 40, 50 }, { 19, 19, 19 } };
+		std::vector<float> whole(part.size()), pruned(part.size());
+		program.sample_grid(part, &whole[0]);
+		blocks.sample_grid(part, &pruned[0]);
+		for (size_t k = 0, n = 0; k != part.count[2]; ++k)
+		{
+			for (size_t j = 0; j != part.count[1]; ++j)
+			{
+				for (size_t i = 0; i != part.count[0]; ++i, ++n)
+				{
+					const float3 p(part.coordinate(0, part.first[0] + static_cast<int>(i)),
+						part.coordinate(1, part.first[1] + static_cast<int>(j)),
+						part.coordinate(2, part.first[2] + static_cast<int>(k)));
+					ASSERT(std::abs(pruned[n] - blocks.distance(p)) < 1e-5f);
+					ASSERT((pruned[n] < 0) == (whole[n] < 0));
+				}
+			}
+		}
+
+		std::vector<vertex> vertices[2];
+		std::vector<unsigned int> indices[2];
+		const IScalarField *fields[2] = { &program, &blocks };
+		for (int i = 0; i != 2; ++i)
+		{
+			MarchingCubes cubes(*fields[i], box.lower, cell, 128, 128, 128);
+			cubes.extract(vertices[i], indices[i]);
+		}
+		ASSERT(!indices[0].empty() && indices[0] == indices[1]);
+		for (size_t i = 0; i != vertices[0].size(); ++i)
+		{
+			const float3 d = vertices[0][i].pos - vertices[1][i].pos;
+			ASSERT(d.length() < 1e-5f);
+		}
+		ASSERT(closed(indices[0]));
+	}
+};
+
+REGISTER_FIXTURE(MarchingCubesTest);
@@ -0,0 +1,213 @@
+#include "UnitTest.h"
+#include "matrix_aux.hpp"
+
+#include <cmath>
+
+using namespace UnitTest;
+using namespace Dye;
+
+class MatrixAuxTest : public TestFixture<MatrixAuxTest>
+{
+public:
+	TEST_FIXTURE( MatrixAuxTest )
+	{
+		TEST_CASE(TestDeterminant);
+		TEST_CASE(TestInversion);
+		TEST_CASE(TestAffineInversion);
+		TEST_CASE(TestBatchInversion);
+		TEST_CASE(TestDecomposition);
+		TEST_CASE(TestEigen);
+		TEST_CASE(TestBatchDecomposition);
+	}
+
+private:
+	static bool IsIdentity(const float4x4 &mat)
+	{
+		float4x4 identity = float4x4::identity();
+		bool equal = true;
+		for (size_t i = 0; i != 16; ++i)
+		{
+			equal &= std::abs(mat.ptr()[i] - identity.ptr()[i]) < 1e-4f;
+		}
+		return equal;
+	}
+
+	static bool Near(const float3x3 &lhs, const float3x3 &rhs, float eps)
+	{
+		bool equal = true;
+		for (size_t i = 0; i != 9; ++i)
+		{
+			equal &= std::abs(lhs.ptr()[i] - rhs.ptr()[i]) < eps;
+		}
+		return equal;
+	}
+
+	static bool IsRotation(const float3x3 &mat)
+	{
+		return Near(mul(mat, trans(mat)), float3x3::identity(), 1e-5f) && std::abs(det(mat) - 1) < 1e-5f;
+	}
+
+	// a rotation, a shear, a reflection and a singular matrix
+	static float3x3 Sample(size_t i)
+	{
+		switch (i % 4)
+		{
+		case 0: return float3x3(0.36f, 0.48f, -0.8f, -0.8f, 0.6f, 0, 0.48f, 0.64f, 0.6f);
+		case 1: return float3x3(2, 1, 0.5f, 0, 3, 1, 0.25f, 0, 1);
+		case 2: return float3x3(-1, 2, 0, 3, 1, 1, 0, -2, 4) * (1 + 0.1f * i);
+		default: return float3x3(1, 2, 3, 2, 4, 6, 1, 0, 1);
+		}
+	}
+
+	static bool CheckSvd(const float3x3 &mat, const float3x3 &u, const float3 &s, const float3x3 &v)
+	{
+		// equal singular values may come out of order by rounding
+		float3x3 rebuilt = mul(mul(u, float3x3::diag(s.x, s.y, s.z)), trans(v));
+		return Near(rebuilt, mat, 1e-4f * s.x) && IsRotation(u) && IsRotation(v)
+			&& s.x + 1e-5f * s.x >= s.y && s.y + 1e-5f * s.x >= std::abs(s.z);
+	}
+
+	static float4x4 Affine()
+	{
+		float c = std::cos(0.5f);
+		float s = std::sin(0.5f);
+		return float4x4(
+			 c, s, 0, 0,
+			-s, c, 0, 0,
+			 0, 0, 1, 0,
+			 3, 4, 5, 1);
+	}
+
+	void TestDeterminant()
+	{
+		ASSERT_EQUALS(det(float2x2(1, 2, 3, 4)), -2.0f);
+		ASSERT_EQUALS(det(float3x3(2, 0, 0, 0, 3, 0, 1, 1, 4)), 24.0f);
+		ASSERT_EQUALS(det(float4x4(1, 2, 3, 4, 5, 6, 7, 8, 2, 6, 4, 8, 3, 1, 1, 2)), 72.0f);
+	}
+
+	void TestInversion()
+	{
+		float2x2 mat0(1, 2, 3, 4);
+		float2x2 mat1 = mul(mat0, inv(mat0));
+		ASSERT_EQUALS(mat1[0][0], 1.0f);
+		ASSERT_EQUALS(mat1[0][1], 0.0f);
+
+		float3x3 mat2(2, 0, 1, 1, 3, 0, 1, 1, 4);
+		float3x3 mat3 = mul(inv(mat2), mat2);
+		ASSERT_EQUALS(mat3[1][1], 1.0f);
+		ASSERT_EQUALS(mat3[2][0], 0.0f);
+
+		float4x4 mat4(1, 2, 3, 4, 5, 6, 7, 8, 2, 6, 4, 8, 3, 1, 1, 2);
+		ASSERT(IsIdentity(mul(mat4, inv(mat4))));
+		ASSERT(IsIdentity(mul(inv(mat4), mat4)));
+	}
+
+	void TestAffineInversion()
+	{
+		float4x4 mat0 = Affine();
+		ASSERT(IsIdentity(mul(mat0, inv_orthonormal(mat0))));
+
+		float4x4 mat1 = mul(float4x4::diag(2, 3, 0.5f, 1), mat0);
+		ASSERT(IsIdentity(mul(mat1, inv_affine(mat1))));
+		ASSERT(IsIdentity(mul(inv_affine(mat1), mat1)));
+
+		float3x4 aff(mat1);
+		ASSERT(IsIdentity(mul(aff, inv(aff)).to_4x4()));
+		ASSERT(IsIdentity(mul(inv(aff).to_4x4(), mat1)));
+	}
+
+	void TestBatchInversion()
+	{
+		float4x4 mats[3] = {Affine(), float4x4::diag(1, 2, 4, 8), float4x4(1, 2, 3, 4, 5, 6, 7, 8, 2, 6, 4, 8, 3, 1, 1, 2)};
+		float4x4 invs[3];
+		inv(mats, invs, 3);
+
+		bool equal = true;
+		for (size_t i = 0; i != 3; ++i)
+		{
+			equal &= IsIdentity(mul(mats[i], invs[i]));
+		}
+		ASSERT(equal);
+	}
+
+	void TestDecomposition()
+	{
+		bool equal = true;
+		for (size_t i = 0; i != 4; ++i)
+		{
+			float3x3 mat = Sample(i);
+			float3x3 u, v;
+			float3 s;
+			svd(mat, u, s, v);
+			equal &= CheckSvd(mat, u, s, v);
+			equal &= (s.z < 0) == (det(mat) < -1e-4f);
+
+			float3x3 r, sym;
+			polar(mat, r, sym);
+			equal &= IsRotation(r) && Near(sym, trans(sym), 1e-5f) && Near(mul(r, sym), mat, 1e-4f * s.x);
+		}
+		ASSERT(equal);
+
+		// the rotation is its own polar factor
+		float3x3 r, sym;
+		polar(Sample(0), r, sym);
+		ASSERT(Near(r, Sample(0), 1e-5f) && Near(sym, float3x3::identity(), 1e-5f));
+	}
+
+	void TestEigen()
+	{
+		float3x3 cov(4, 1, 2, 1, 3, 0, 2, 0, 5);
+		float3x3 vectors;
+		float3 values;
+		eig_sym(cov, values, vectors);
+		ASSERT(IsRotation(vectors));
+		ASSERT(values.x >= values.y && values.y >= values.z);
+		ASSERT(Near(mul(mul(vectors, float3x3::diag(values.x, values.y, values.z)), trans(vectors)), cov, 1e-4f));
+
+		// repeated eigenvalues
+		eig_sym(float3x3::diag(2, 7, 2), values, vectors);
+		ASSERT(IsRotation(vectors));
+		ASSERT(std::abs(values.x - 7) < 1e-5f && std::abs(values.y - 2) < 1e-5f && std::abs(values.z - 2) < 1e-5f);
+	}
+
+	void TestBatchDecomposition()
+	{
+		const size_t n = 21;
+		float3x3 mats[n];
+		float3x3 covs[n];
+		for (size_t i = 0; i != n; ++i)
+		{
+			mats[i] = Sample(i);
+			covs[i] = mul(trans(mats[i]), mats[i]);
+		}
+
+		float3x3 u[n], v[n], r[n], sym[n], vectors[n];
+		float3 s[n], values[n];
+		svd(mats, u, s, v, n);
+		polar(mats, r, sym, n);
+		polar(mats, r, 0, n);
+		eig_sym(covs, values, vectors, n);
+
+		bool equal = true;
+		for (size_t i = 0; i != n; ++i)
+		{
+			float3x3 ui, vi, ri, symi, vectorsi;
+			float3 si, valuesi;
+			svd(mats[i], ui, si, vi);
+			polar(mats[i], ri, symi);
+			eig_sym(covs[i], valuesi, vectorsi);
+
+			// the singular and eigen vectors of repeated values are arbitrary,
+			// compare what is unique
+			float tolerance = 1e-5f * si.x;
+			equal &= CheckSvd(mats[i], u[i], s[i], v[i]);
+			equal &= std::abs(s[i].y - si.y) < tolerance && std::abs(s[i].z - si.z) < tolerance;
+			equal &= Near(r[i], ri, 1e-5f) && Near(sym[i], symi, tolerance);
+			equal &= IsRotation(vectors[i]) && Near(mul(mul(vectors[i], float3x3::diag(values[i].x, values[i].y, values[i].z)), trans(vectors[i])), covs[i], 1e-5f * values[i].x);
+			equal &= std::abs(values[i].y - valuesi.y) < 1e-5f * valuesi.x && std::abs(values[i].z - valuesi.z) < 1e-5f * valuesi.x;
+		}
+		ASSERT(equal);
+	}
+};
+
+REGISTER_FIXTURE(MatrixAuxTest);
@@ -13,6 +13,8 @@ public:
 		TEST_CASE(TestConstructor);
 		TEST_CASE(TestMemberFunc);
 		TEST_CASE(TestOperator);
+		TEST_CASE(TestMultiplication);
+		TEST_CASE(TestAffine);
 		TEST_CASE(TestOther);
 	}
 
@@ -67,6 +69,65 @@ private:
 		ASSERT_EQUALS(mat8[1][1], -1);
 	}
 
+	void TestMultiplication()
+	{
+		float4x4 mat1(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16);
+		float4x4 mat2 = mul(mat1, mat1);
+		ASSERT_EQUALS(mat2[0][0], 90);
+		ASSERT_EQUALS(mat2[1][2], 254);
+		ASSERT_EQUALS(mat2[3][3], 600);
+
+		float4x4 mat3 = trans(mat1);
+		ASSERT_EQUALS(mat3[0][3], 13);
+		ASSERT_EQUALS(mat3[2][1], 7);
+
+		float4 vec1(1, 0, -1, 2);
+		float4 vec2 = mul(mat1, vec1);
+		float4 vec3 = mul(vec1, mat1);
+		ASSERT_EQUALS(vec2.y, 14);
+		ASSERT_EQUALS(vec3.y, 20);
+	}
+
+	void TestAffine()
+	{
+		float4x4 mat1(
+			 0, 1, 0, 0,
+			-2, 0, 0, 0,
+			 0, 0, 3, 0,
+			 4, 5, 6, 1);
+		float4x4 mat2(
+			 1, 0, 0, 0,
+			 0, 0, 1, 0,
+			 0,-1, 0, 0,
+			 7, 8, 9, 1);
+
+		float3x4 aff1(mat1);
+		float3x4 aff2(mat2);
+		ASSERT_EQUALS(aff1[0][3], 4);
+		ASSERT_EQUALS(aff1[1][0], 1);
+
+		float4x4 mat3 = mul(mat1, mat2);
+		float4x4 mat4 = mul(aff1, aff2).to_4x4();
+		bool equal = true;
+		for (size_t i = 0; i != 16; ++i)
+		{
+			equal &= mat3.ptr()[i] == mat4.ptr()[i];
+		}
+		ASSERT(equal);
+
+		float3 point(1, 2, 3);
+		float3 vec1 = transform_point(aff1, point);
+		float3 vec2 = transform_vector(aff1, point);
+		float4 vec3 = mul(float4(1, 2, 3, 1), mat1);
+		float4 vec4 = mul(float4(1, 2, 3, 0), mat1);
+		ASSERT(vec1.x == vec3.x && vec1.y == vec3.y && vec1.z == vec3.z);
+		ASSERT(vec2.x == vec4.x && vec2.y == vec4.y && vec2.z == vec4.z);
+
+		float3x4 aff3 = mul(float3x4::translation(float3(1, 2, 3)), float3x4::identity());
+		ASSERT_EQUALS(transform_point(aff3, float3(0, 0, 0)).z, 3);
+		ASSERT_EQUALS(aff3.linear()[1][1], 1);
+	}
+
 	void TestOther()
 	{
 		float4x4 mat1 = float4x4::diag(1, 2, 3, 4);
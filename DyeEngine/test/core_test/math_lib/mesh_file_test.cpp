@@ -0,0 +1,142 @@
+#include "UnitTest.h"
+#include "mesh_file.hpp"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+using namespace UnitTest;
+using namespace Dye;
+using namespace Dye::Graphics;
+
+class MeshFileTest : public TestFixture<MeshFileTest>
+{
+public:
+	TEST_FIXTURE( MeshFileTest )
+	{
+		TEST_CASE(TestRoundTrip);
+		TEST_CASE(TestEmpty);
+		TEST_CASE(TestRejected);
+	}
+
+private:
+	static const char *path() { return "mesh_file_test.dmesh"; }
+
+	// a fan around the first vertex
+	static void make_mesh(std::vector<vertex> &vertices, std::vector<unsigned int> &indices, size_t n)
+	{
+		vertices.resize(n);
+		for (size_t i = 0; i != n; ++i)
+		{
+			float f = static_cast<float>(i);
+			vertices[i].pos = float3(f, -2 * f, 0.5f);
+			vertices[i].normal = float3(0, 0, 1);
+			vertices[i].tex = float2(f / n, 1);
+		}
+		indices.clear();
+		for (unsigned int i = 1; i + 1 < n; ++i)
+		{
+			indices.push_back(0);
+			indices.push_back(i);
+			indices.push_back(i + 1);
+		}
+	}
+
+	static std::vector<char> read_file()
+	{
+		std::vector<char> bytes;
+		FILE *file = fopen(path(), "rb");
+		int c;
+		while ((c = fgetc(file)) != EOF)
+		{
+			bytes.push_back(static_cast<char>(c));
+		}
+		fclose(file);
+		return bytes;
+	}
+
+	static void write_file(const std::vector<char> &bytes)
+	{
+		FILE *file = fopen(path(), "wb");
+		fwrite(&bytes[0], 1, bytes.size(), file);
+		fclose(file);
+	}
+
+	void TestRoundTrip()
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_mesh(vertices, indices, 19);
+		mesh_lod lods[2] = { { 0, 51, 0.0f, 0 }, { 0, 9, 0.25f, 0 } };
+
+		ASSERT(write_mesh_file(path(), &vertices[0], vertices.size(), &indices[0], indices.size(), lods, 2) == mesh_file_ok);
+
+		MeshFile mesh;
+		ASSERT(mesh.open(path()) == mesh_file_ok);
+		ASSERT(mesh.is_open());
+		ASSERT(mesh.vertex_count() == 19 && mesh.index_count() == 51 && mesh.lod_count() == 2);
+		ASSERT(reinterpret_cast<size_t>(mesh.vertices()) % c_mesh_file_alignment == 0);
+		ASSERT(reinterpret_cast<size_t>(mesh.indices()) % c_mesh_file_alignment == 0);
+
+		ASSERT(memcmp(mesh.vertices(), &vertices[0], vertices.size() * sizeof(vertex)) == 0);
+		ASSERT(memcmp(mesh.indices(), &indices[0], indices.size() * sizeof(unsigned int)) == 0);
+		ASSERT(mesh.lods()[1].index_count == 9 && mesh.lods()[1].error == 0.25f);
+
+		vertex_bounds bounds = mesh.bounds();
+		ASSERT(bounds.lower.x == 0 && bounds.lower.y == -36 && bounds.lower.z == 0.5f);
+		ASSERT(bounds.upper.x == 18 && bounds.upper.y == 0 && bounds.upper.z == 0.5f);
+
+		mesh.close();
+		ASSERT(!mesh.is_open() && mesh.vertices() == 0 && mesh.vertex_count() == 0);
+		remove(path());
+	}
+
+	void TestEmpty()
+	{
+		ASSERT(write_mesh_file(path(), 0, 0, 0, 0, 0, 0) == mesh_file_ok);
+
+		MeshFile mesh;
+		ASSERT(mesh.open(path()) == mesh_file_ok);
+		ASSERT(mesh.vertices() == 0 && mesh.indices() == 0 && mesh.lods() == 0);
+		ASSERT(mesh.byte_size() == c_mesh_file_header_size);
+		mesh.close();
+		remove(path());
+	}
+
+	void TestRejected()
+	{
+		MeshFile mesh;
+		ASSERT(mesh.open("no_such_file.dmesh") == mesh_file_cannot_open);
+
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_mesh(vertices, indices, 7);
+		write_mesh_file(path(), &vertices[0], vertices.size(), &indices[0], indices.size(), 0, 0);
+		const std::vector<char> bytes = read_file();
+
+		std::vector<char> changed = bytes;
+		changed[0] = 'X';
+		write_file(changed);
+		ASSERT(mesh.open(path()) == mesh_file_bad_format);
+
+		changed = bytes;
+		++changed[offsetof(mesh_file_header, version)];
+		write_file(changed);
+		ASSERT(mesh.open(path()) == mesh_file_bad_version);
+
+		changed = bytes;
+		changed.resize(bytes.size() - 4);
+		write_file(changed);
+		ASSERT(mesh.open(path()) == mesh_file_truncated);
+
+		changed.resize(16);
+		write_file(changed);
+		ASSERT(mesh.open(path()) == mesh_file_truncated);
+		ASSERT(!mesh.is_open());
+
+		remove(path());
+	}
+};
+
+REGISTER_FIXTURE(MeshFileTest);
@@ -0,0 +1,265 @@
+#include "UnitTest.h"
+#include "mesh.hpp"
+
+#include <algorithm>
+#include <vector>
+
+using namespace UnitTest;
+using namespace Dye;
+using namespace Dye::Graphics;
+
+namespace
+{
+	struct triangle
+	{
+		unsigned int v[3];
+
+		bool operator < (const triangle &rhs) const
+		{
+			return std::lexicographical_compare(v, v + 3, rhs.v, rhs.v + 3);
+		}
+
+		bool operator == (const triangle &rhs) const
+		{
+			return std::equal(v, v + 3, rhs.v);
+		}
+	};
+
+	// the triangles of a list, each rotated to start at its smallest index
+	std::vector<triangle> triangles(const unsigned int *indices, size_t index_count)
+	{
+		std::vector<triangle> result(index_count / 3);
+		for (size_t t = 0; t != result.size(); ++t)
+		{
+			const unsigned int *tri = indices + t * 3;
+			int first = static_cast<int>(std::min_element(tri, tri + 3) - tri);
+			for (int k = 0; k != 3; ++k)
+			{
+				result[t].v[k] = tri[(first + k) % 3];
+			}
+		}
+		std::sort(result.begin(), result.end());
+		return result;
+	}
+
+	// n by n vertices on a bumpy sheet, the triangles shuffled
+	void make_grid(size_t n, std::vector<vertex> &vertices, std::vector<unsigned int> &indices)
+	{
+		vertices.resize(n * n);
+		for (size_t y = 0; y != n; ++y)
+		{
+			for (size_t x = 0; x != n; ++x)
+			{
+				vertex &v = vertices[y * n + x];
+				v.pos = float3(static_cast<float>(x), static_cast<float>(y), static_cast<float>((x * 7 + y * 3) % 5));
+				v.normal = float3(0, 0, 1);
+				v.tex = float2(static_cast<float>(x) / n, static_cast<float>(y) / n);
+			}
+		}
+
+		std::vector<triangle> quads;
+		for (unsigned int y = 0; y + 1 < n; ++y)
+		{
+			for (unsigned int x = 0; x + 1 < n; ++x)
+			{
+				unsigned int a = static_cast<unsigned int>(y * n + x);
+				unsigned int b = a + 1;
+				unsigned int c = a + static_cast<unsigned int>(n);
+				unsigned int d = c + 1;
+				triangle t0 = { { a, b, d } };
+				triangle t1 = { { a, d, c } };
+				quads.push_back(t0);
+				quads.push_back(t1);
+			}
+		}
+
+		unsigned int seed = 12345;
+		for (size_t i = quads.size(); i > 1; --i)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			std::swap(quads[i - 1], quads[(seed >> 8) % i]);
+		}
+
+		indices.clear();
+		for (size_t i = 0; i != quads.size(); ++i)
+		{
+			indices.insert(indices.end(), quads[i].v, quads[i].v + 3);
+		}
+	}
+}
+
+class MeshTest : public TestFixture<MeshTest>
+{
+public:
+	TEST_FIXTURE( MeshTest )
+	{
+		TEST_CASE(TestWeld);
+		TEST_CASE(TestAcmr);
+		TEST_CASE(TestVertexCache);
+		TEST_CASE(TestOverdraw);
+		TEST_CASE(TestVertexFetch);
+		TEST_CASE(TestMesh);
+		TEST_CASE(TestWideIndices);
+	}
+
+private:
+	void TestWeld()
+	{
+		vertex v[5];
+		for (int i = 0; i != 5; ++i)
+		{
+			v[i].pos = float3(1, 2, 3);
+			v[i].normal = float3(0, 0, 1);
+			v[i].tex = float2(0.5f, 0.5f);
+		}
+		v[1].normal.x = -0.0f;
+		v[2].tex.y = 0.25f;
+		v[4].pos.z = 4;
+
+		unsigned int remap[5];
+		ASSERT(weld_vertices(v, 5, remap) == 3);
+		ASSERT(remap[0] == 0 && remap[1] == 0 && remap[2] == 1 && remap[3] == 0 && remap[4] == 2);
+
+		remap_vertices(v, 5, remap, v);
+		ASSERT(v[1].tex.y == 0.25f && v[2].pos.z == 4);
+
+		unsigned int indices[3] = { 4, 3, 2 };
+		remap_indices(indices, 3, remap);
+		ASSERT(indices[0] == 2 && indices[1] == 0 && indices[2] == 1);
+	}
+
+	void TestAcmr()
+	{
+		// a strip shares two vertices per triangle after the first
+		unsigned int strip[] = { 0, 1, 2, 1, 3, 2, 2, 3, 4, 3, 5, 4 };
+		ASSERT(compute_acmr(strip, 12, 6) == 1.5f);
+
+		// the cache forgets vertex 0 after 3 more
+		unsigned int fifo[] = { 0, 1, 2, 3, 4, 5, 0, 1, 2 };
+		ASSERT(compute_acmr(fifo, 9, 6, 6) == 2.0f);
+		ASSERT(compute_acmr(fifo, 9, 6, 3) == 3.0f);
+		ASSERT(compute_acmr(0, 0, 0) == 0);
+	}
+
+	void TestVertexCache()
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_grid(64, vertices, indices);
+
+		std::vector<unsigned int> ordered(indices.size());
+		optimize_vertex_cache(&indices[0], indices.size(), vertices.size(), &ordered[0]);
+
+		ASSERT(triangles(&ordered[0], ordered.size()) == triangles(&indices[0], indices.size()));
+		ASSERT(compute_acmr(&indices[0], indices.size(), vertices.size()) > 2.0f);
+		ASSERT(compute_acmr(&ordered[0], ordered.size(), vertices.size()) < 0.8f);
+	}
+
+	void TestOverdraw()
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_grid(64, vertices, indices);
+
+		std::vector<unsigned int> ordered(indices.size());
+		std::vector<unsigned int> clustered(indices.size());
+		optimize_vertex_cache(&indices[0], indices.size(), vertices.size(), &ordered[0]);
+		optimize_overdraw(&ordered[0], ordered.size(), &vertices[0], vertices.size(), &clustered[0]);
+
+		ASSERT(triangles(&clustered[0], clustered.size()) == triangles(&indices[0], indices.size()));
+		float before = compute_acmr(&ordered[0], ordered.size(), vertices.size());
+		float after = compute_acmr(&clustered[0], clustered.size(), vertices.size());
+		ASSERT(after < before * 1.2f);
+	}
+
+	void TestVertexFetch()
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_grid(8, vertices, indices);
+		std::vector<unsigned int> original = indices;
+
+		// one vertex is not referenced
+		vertices.push_back(vertices[0]);
+		std::vector<vertex> fetched(vertices.size());
+		size_t count = optimize_vertex_fetch(&indices[0], indices.size(), &vertices[0], vertices.size(), &fetched[0]);
+		ASSERT(count < vertices.size());
+
+		unsigned int next = 0;
+		bool in_order = true;
+		bool same = true;
+		for (size_t i = 0; i != indices.size(); ++i)
+		{
+			in_order &= indices[i] <= next;
+			next = std::max(next, indices[i] + 1);
+			same &= fetched[indices[i]].pos.x == vertices[original[i]].pos.x
+				&& fetched[indices[i]].pos.y == vertices[original[i]].pos.y;
+		}
+		ASSERT(in_order && same && next == count);
+	}
+
+	void TestMesh()
+	{
+		std::vector<vertex> grid;
+		std::vector<unsigned int> indices;
+		make_grid(32, grid, indices);
+
+		// a triangle soup, three vertices per triangle
+		std::vector<vertex> soup(indices.size());
+		std::vector<unsigned int> soup_indices(indices.size());
+		for (size_t i = 0; i != indices.size(); ++i)
+		{
+			soup[i] = grid[indices[i]];
+			soup_indices[i] = static_cast<unsigned int>(i);
+		}
+
+		Mesh mesh(&soup[0], soup.size(), &soup_indices[0], soup_indices.size());
+		ASSERT(!mesh.wide_indices() && mesh.indices16() != 0 && mesh.indices32() == 0);
+		ASSERT(mesh.triangle_count() == indices.size() / 3);
+
+		mesh_report report = mesh.optimize();
+		ASSERT(report.vertices_before == soup.size());
+		ASSERT(report.vertices_after == grid.size());
+		ASSERT(mesh.vertex_count() == grid.size());
+		ASSERT(report.acmr_before == 3.0f);
+		ASSERT(report.acmr_after < 0.9f);
+
+		// through the interface, the same triangles by position
+		const IMeshable &meshable = mesh;
+		std::vector<vertex> vertices(meshable.vertex_count());
+		std::vector<unsigned int> optimized(meshable.triangle_count() * 3);
+		meshable.get_vertices(0, vertices.size(), &vertices[0]);
+		meshable.get_triangles(0, meshable.triangle_count(), &optimized[0]);
+		ASSERT(optimized.size() == indices.size());
+
+		float sum = 0;
+		float expected = 0;
+		for (size_t i = 0; i != indices.size(); ++i)
+		{
+			sum += vertices[optimized[i]].pos.x + vertices[optimized[i]].pos.y * 64;
+			expected += grid[indices[i]].pos.x + grid[indices[i]].pos.y * 64;
+		}
+		ASSERT(sum == expected);
+
+		Mesh copy(meshable);
+		ASSERT(copy.vertex_count() == mesh.vertex_count() && copy.index(7) == mesh.index(7));
+	}
+
+	void TestWideIndices()
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_grid(257, vertices, indices);
+
+		Mesh mesh(&vertices[0], vertices.size(), &indices[0], indices.size());
+		ASSERT(mesh.wide_indices() && mesh.indices32() != 0 && mesh.indices16() == 0);
+		ASSERT(mesh.index(5) == indices[5]);
+
+		mesh_report report = mesh.optimize();
+		ASSERT(mesh.wide_indices());
+		ASSERT(report.vertices_after == vertices.size());
+		ASSERT(report.acmr_after < report.acmr_before);
+	}
+};
+
+REGISTER_FIXTURE(MeshTest);
@@ -0,0 +1,149 @@
+#include "UnitTest.h"
+#include "packet.hpp"
+
+using namespace UnitTest;
+using namespace Dye;
+
+class PacketTest : public TestFixture<PacketTest>
+{
+public:
+	TEST_FIXTURE( PacketTest )
+	{
+		TEST_CASE(TestArithmetic);
+		TEST_CASE(TestMask);
+		TEST_CASE(TestVector);
+		TEST_CASE(TestMultiplication);
+	}
+
+private:
+	static float8 Iota(float start)
+	{
+		float8 result;
+		for (size_t i = 0; i != c_packet_width; ++i)
+		{
+			result[i] = start + float(i);
+		}
+		return result;
+	}
+
+	void TestArithmetic()
+	{
+		float8 a = Iota(1);
+		float8 b(2);
+
+		float8 c = (a + b) * b - a / b;
+		bool equal = true;
+		for (size_t i = 0; i != c_packet_width; ++i)
+		{
+			float x = float(i) + 1;
+			equal &= c[i] == (x + 2) * 2 - x / 2;
+		}
+		ASSERT(equal);
+
+		float8 d = sqrt(a * a);
+		float8 e = abs(-a);
+		equal = true;
+		for (size_t i = 0; i != c_packet_width; ++i)
+		{
+			equal &= d[i] == a[i] && e[i] == a[i];
+		}
+		ASSERT(equal);
+
+		const float values[8] = { -2.5f, -1.7f, -0.2f, 0.5f, 1.5f, 2.49f, 1e9f, -16777215.0f };
+		const float rounded[8] = { -2, -2, 0, 0, 2, 2, 1e9f, -16777215.0f };
+		float8 r = round(float8::load(values));
+		equal = true;
+		for (size_t i = 0; i != c_packet_width; ++i)
+		{
+			equal &= r[i] == rounded[i];
+		}
+		ASSERT(equal);
+	}
+
+	void TestMask()
+	{
+		float8 a = Iota(0);
+
+		ASSERT_EQUALS(movemask(a < float8(3)), 0x07);
+		ASSERT_EQUALS(movemask(a >= float8(6)), 0xc0);
+		ASSERT_EQUALS(movemask(a == float8(4)), 0x10);
+		ASSERT(any(a > float8(6)));
+		ASSERT(!all(a > float8(6)));
+		ASSERT(all(a != float8(-1)));
+
+		float8 s = select(a < float8(4), a, float8(-1));
+		bool equal = true;
+		for (size_t i = 0; i != c_packet_width; ++i)
+		{
+			equal &= s[i] == (i < 4 ? float(i) : -1.0f);
+		}
+		ASSERT(equal);
+	}
+
+	void TestVector()
+	{
+		float3 src[c_packet_width];
+		for (size_t i = 0; i != c_packet_width; ++i)
+		{
+			src[i] = float3(float(i), 1, -2);
+		}
+
+		float3x8 p = load_packet(src);
+		float3x8 q = cross(p, float3x8(0, 0, 1));
+		float8 d = dot(p, p);
+		float3x8 n = normalize(p);
+
+		float3 dst[c_packet_width];
+		store_packet(q, dst);
+
+		int indices[c_packet_width] = {7, 6, 5, 4, 3, 2, 1, 0};
+		float3x8 g = gather_packet(src, indices);
+
+		bool equal = true;
+		for (size_t i = 0; i != c_packet_width; ++i)
+		{
+			float3 v = src[i];
+			float3 c = cross(v, float3(0, 0, 1));
+			float3 u = normalize(v);
+			equal &= dst[i].x == c.x && dst[i].y == c.y && dst[i].z == c.z;
+			equal &= d[i] == dot(v, v);
+			equal &= std::abs(n.x[i] - u.x) < 1e-6f && std::abs(n.y[i] - u.y) < 1e-6f && std::abs(n.z[i] - u.z) < 1e-6f;
+			equal &= g.x[i] == float(7 - i);
+		}
+		ASSERT(equal);
+	}
+
+	void TestMultiplication()
+	{
+		float4x4 mat(
+			 2,  0,  0,  0,
+			 0,  0,  3,  0,
+			 0, -1,  0,  0,
+			 5,  6,  7,  1);
+
+		float4 src[c_packet_width];
+		for (size_t i = 0; i != c_packet_width; ++i)
+		{
+			src[i] = float4(float(i), 2, 3, 1);
+		}
+
+		float4 row[c_packet_width];
+		float4 col[c_packet_width];
+		store_packet(mul(load_packet(src), mat), row);
+		store_packet(mul(mat, load_packet(src)), col);
+
+		bool equal = true;
+		for (size_t i = 0; i != c_packet_width; ++i)
+		{
+			float4 r = mul(src[i], mat);
+			float4 c = mul(mat, src[i]);
+			for (size_t j = 0; j != 4; ++j)
+			{
+				equal &= row[i][j] == r[j] && col[i][j] == c[j];
+			}
+		}
+		ASSERT(equal);
+	}
+};
+
+REGISTER_FIXTURE(PacketTest);
@@ -0,0 +1,264 @@
+#include "UnitTest.h"
+#include "path_tracer.hpp"
+
+#include <cmath>
+#include <vector>
+
+using namespace UnitTest;
+using namespace Dye;
+using namespace Dye::Graphics;
+using namespace Dye::Render;
+
+namespace
+{
+	void add_vertex(std::vector<vertex> &vertices, const float3 &p)
+	{
+		vertex v;
+		v.pos = p;
+		v.normal = float3(0, 0, 0);
+		v.tex = float2(0, 0);
+		vertices.push_back(v);
+	}
+
+	// the quad a, b, c, d as two triangles
+	void add_quad(std::vector<vertex> &vertices, std::vector<unsigned int> &indices,
+		const float3 &a, const float3 &b, const float3 &c, const float3 &d)
+	{
+		unsigned int first = static_cast<unsigned int>(vertices.size());
+		add_vertex(vertices, a);
+		add_vertex(vertices, b);
+		add_vertex(vertices, c);
+		add_vertex(vertices, d);
+		const unsigned int quad[6] = { 0, 1, 2, 0, 2, 3 };
+		for (int i = 0; i != 6; ++i)
+		{
+			indices.push_back(first + quad[i]);
+		}
+	}
+
+	// the faces of the cube [-1, 1]^3
+	void make_cube(std::vector<vertex> &vertices, std::vector<unsigned int> &indices)
+	{
+		for (int axis = 0; axis != 3; ++axis)
+		{
+			for (int side = -1; side <= 1; side += 2)
+			{
+				float3 corner[4];
+				const float s[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+				for (int k = 0; k != 4; ++k)
+				{
+					corner[k][axis] = static_cast<float>(side);
+					corner[k][(axis + 1) % 3] = s[k][0];
+					corner[k][(axis + 2) % 3] = s[k][1];
+				}
+				add_quad(vertices, indices, corner[0], corner[1], corner[2], corner[3]);
+			}
+		}
+	}
+
+	camera look(const float3 &eye, const float3 &target, const float3 &up)
+	{
+		camera view;
+		view.eye = eye;
+		view.target = target;
+		view.up = up;
+		view.fov = 1.0f;
+		return view;
+	}
+
+	float3 mean(const PathTracer &tracer)
+	{
+		std::vector<float> image(tracer.width() * tracer.height() * 3);
+		tracer.resolve(&image[0]);
+		float3 sum(0, 0, 0);
+		for (size_t i = 0; i != image.size(); i += 3)
+		{
+			sum += float3(image[i], image[i + 1], image[i + 2]);
+		}
+		return sum * (3.0f / image.size());
+	}
+}
+
+class PathTracerTest : public TestFixture<PathTracerTest>
+{
+public:
+	TEST_FIXTURE( PathTracerTest )
+	{
+		TEST_CASE(TestSobol);
+		TEST_CASE(TestSky);
+		TEST_CASE(TestFurnace);
+		TEST_CASE(TestLight);
+		TEST_CASE(TestRepeatable);
+	}
+
+private:
+	void TestSobol()
+	{
+		// whatever the scramble, 16 points take one cell each of 16 rows,
+		// of 16 columns and of a 4x4 grid
+		const unsigned int scrambles[3] = { 0, 0x12345678u, 0xdeadbeefu };
+		for (int s = 0; s != 3; ++s)
+		{
+			int rows = 0, columns = 0, cells = 0;
+			for (unsigned int i = 0; i != 16; ++i)
+			{
+				float u, v;
+				sobol_2d(i, scrambles[s], u, v);
+				ASSERT(u >= 0 && u < 1 && v >= 0 && v < 1);
+				columns |= 1 << static_cast<int>(u * 16);
+				rows |= 1 << static_cast<int>(v * 16);
+				cells |= 1 << (static_cast<int>(v * 4) * 4 + static_cast<int>(u * 4));
+			}
+			ASSERT(columns == 0xffff && rows == 0xffff && cells == 0xffff);
+		}
+	}
+
+	void TestSky()
+	{
+		// nothing to hit, every sample is the sky
+		PathScene empty;
+		empty.build(0, 0, 0, 0, 0, 0, 0);
+		empty.set_sky(float3(0.25f, 0.5f, 1));
+		PathTracer tracer(empty, 20, 10);
+		path_stats stats = tracer.render_pass();
+		ASSERT(stats.samples == 200 && stats.rays == 200);
+		std::vector<float> image(20 * 10 * 3);
+		tracer.resolve(&image[0]);
+		for (size_t i = 0; i != image.size(); i += 3)
+		{
+			ASSERT(image[i] == 0.25f && image[i + 1] == 0.5f && image[i + 2] == 1);
+		}
+
+		// a wide plane under it reflects its albedo of the sky, every path
+		// bouncing once up
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		add_quad(vertices, indices, float3(-1000, 0, -1000), float3(1000, 0, -1000), float3(1000, 0, 1000),
+			float3(-1000, 0, 1000));
+		const unsigned int triangle_materials[2] = { 0, 0 };
+		material grey = { float3(0.5f, 0.5f, 0.5f), float3(0, 0, 0) };
+		PathScene plane;
+		plane.build(&vertices[0], vertices.size(), &indices[0], indices.size(), triangle_materials, &grey, 1);
+		plane.set_sky(float3(2, 2, 2));
+		PathTracer below(plane, 8, 8);
+		below.set_camera(look(float3(0, 1, 0), float3(0.1f, 0, 0), float3(0, 0, 1)));
+		stats = below.render_pass();
+		ASSERT(stats.rays == 2 * 64);
+		float3 m = mean(below);
+		ASSERT(std::abs(m.x - 1) < 1e-5f && std::abs(m.z - 1) < 1e-5f);
+	}
+
+	void TestFurnace()
+	{
+		// inside a closed box that emits 1 and reflects half, the radiance
+		// is 1 + 0.5 + 0.25 + ... = 2 everywhere
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_cube(vertices, indices);
+		std::vector<unsigned int> triangle_materials(indices.size() / 3, 0);
+		material glow = { float3(0.5f, 0.5f, 0.5f), float3(1, 1, 1) };
+		PathScene box;
+		box.build(&vertices[0], vertices.size(), &indices[0], indices.size(), &triangle_materials[0], &glow, 1);
+		ASSERT(box.emitter_count() == 12);
+
+		PathTracer tracer(box, 16, 16);
+		tracer.set_camera(look(float3(0.2f, -0.1f, 0.3f), float3(1, 0.5f, 0.25f), float3(0, 1, 0)));
+		path_stats total = { 0, 0, 0 };
+		for (int pass = 0; pass != 64; ++pass)
+		{
+			path_stats stats = tracer.render_pass();
+			total.samples += stats.samples;
+			total.rays += stats.rays;
+		}
+		ASSERT(tracer.passes() == 64 && total.samples == 64 * 256);
+
+		// three bounces always, then roulette; each with a shadow ray
+		ASSERT(total.rays > total.samples * 7);
+
+		float3 m = mean(tracer);
+		ASSERT(std::abs(m.x - 2) < 0.05f && std::abs(m.y - 2) < 0.05f);
+	}
+
+	void TestLight()
+	{
+		// a small light high above a white floor, nothing else: the floor
+		// right below it receives its power over pi times the squared
+		// height, times the albedo
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		add_quad(vertices, indices, float3(-10, 0, -10), float3(10, 0, -10), float3(10, 0, 10), float3(-10, 0, 10));
+		const float h = 4;
+		const float s = 0.05f;
+		add_quad(vertices, indices, float3(-s, h, -s), float3(s, h, -s), float3(s, h, s), float3(-s, h, s));
+		const unsigned int triangle_materials[4] = { 0, 0, 1, 1 };
+		const material materials[2] =
+		{
+			{ float3(0.8f, 0.8f, 0.8f), float3(0, 0, 0) },
+			{ float3(0, 0, 0), float3(100, 100, 100) }
+		};
+		PathScene scene;
+		scene.build(&vertices[0], vertices.size(), &indices[0], indices.size(), triangle_materials, materials, 2);
+		ASSERT(scene.emitter_count() == 2);
+
+		// a narrow view of the floor straight below
+		PathTracer tracer(scene, 4, 4);
+		camera view = look(float3(0, 1, 0), float3(0, 0, 0), float3(0, 0, 1));
+		view.fov = 0.01f;
+		tracer.set_camera(view);
+		path_settings direct;
+		direct.max_depth = 1;
+		tracer.set_settings(direct);
+		for (int pass = 0; pass != 16; ++pass)
+		{
+			tracer.render_pass();
+		}
+
+		// radiance = albedo / pi * emission * area / h^2 for a light this small
+		const float expected = 0.8f / 3.14159265f * 100 * (2 * s) * (2 * s) / (h * h);
+		float3 m = mean(tracer);
+		ASSERT(std::abs(m.x - expected) < expected * 0.01f);
+	}
+
+	void TestRepeatable()
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_cube(vertices, indices);
+		std::vector<unsigned int> triangle_materials(indices.size() / 3, 0);
+		for (size_t t = 0; t != 2; ++t)
+		{
+			triangle_materials[t] = 1;
+		}
+		const material materials[2] =
+		{
+			{ float3(0.7f, 0.6f, 0.5f), float3(0, 0, 0) },
+			{ float3(0, 0, 0), float3(5, 5, 5) }
+		};
+		PathScene box;
+		box.build(&vertices[0], vertices.size(), &indices[0], indices.size(), &triangle_materials[0], materials, 2);
+
+		// a pixel depends on its position and the pass only, not on the
+		// thread or the order of the tiles; 37 by 21 leaves partial tiles
+		PathTracer first(box, 37, 21);
+		PathTracer second(box, 37, 21);
+		first.set_camera(look(float3(0.5f, 0.2f, -0.5f), float3(-1, 0, 0.2f), float3(0, 1, 0)));
+		second.set_camera(look(float3(0.5f, 0.2f, -0.5f), float3(-1, 0, 0.2f), float3(0, 1, 0)));
+		for (int pass = 0; pass != 3; ++pass)
+		{
+			first.render_pass();
+			second.render_pass();
+		}
+		first.reset();
+		for (int pass = 0; pass != 3; ++pass)
+		{
+			first.render_pass();
+		}
+		std::vector<float> a(37 * 21 * 3), b(37 * 21 * 3);
+		first.resolve(&a[0]);
+		second.resolve(&b[0]);
+		ASSERT(a == b);
+		ASSERT(mean(first).x > 0);
+	}
+};
+
+REGISTER_FIXTURE(PathTracerTest);
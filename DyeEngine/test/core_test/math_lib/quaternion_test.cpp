@@ -0,0 +1,121 @@
+#include "UnitTest.h"
+#include "quaternion.hpp"
+
+#include <cmath>
+#include <vector>
+
+using namespace UnitTest;
+using namespace Dye;
+
+class QuaternionTest : public TestFixture<QuaternionTest>
+{
+public:
+	TEST_FIXTURE( QuaternionTest )
+	{
+		TEST_CASE(TestRotation);
+		TEST_CASE(TestMatrix);
+		TEST_CASE(TestInterpolation);
+		TEST_CASE(TestBatch);
+	}
+
+private:
+	static bool Near(const float3 &lhs, const float3 &rhs)
+	{
+		return std::abs(lhs.x - rhs.x) < 1e-5f && std::abs(lhs.y - rhs.y) < 1e-5f && std::abs(lhs.z - rhs.z) < 1e-5f;
+	}
+
+	static bool Near(const quat &lhs, const quat &rhs)
+	{
+		// q and -q are the same rotation
+		return std::abs(std::abs(dot(lhs, rhs)) - 1) < 1e-5f;
+	}
+
+	void TestRotation()
+	{
+		quat qz = quat::rotation(float3(0, 0, 1), c_pi / 2);
+		quat qx = quat::rotation(float3(1, 0, 0), c_pi / 2);
+
+		ASSERT(Near(rotate(qz, float3(1, 0, 0)), float3(0, 1, 0)));
+		ASSERT(Near(rotate(qx, float3(0, 1, 0)), float3(0, 0, 1)));
+
+		// qz then qx
+		quat q = mul(qz, qx);
+		ASSERT(Near(rotate(q, float3(1, 0, 0)), float3(0, 0, 1)));
+		ASSERT(Near(rotate(conj(q), float3(0, 0, 1)), float3(1, 0, 0)));
+		ASSERT(Near(mul(q, conj(q)), quat::identity()));
+	}
+
+	void TestMatrix()
+	{
+		quat q = normalize(quat(0.3f, -0.5f, 0.1f, 0.8f));
+		float3x3 m = q.to_3x3();
+		float3 v(1, 2, 3);
+		ASSERT(Near(mul(v, m), rotate(q, v)));
+
+		float4 v4 = mul(float4(v.x, v.y, v.z, 1), q.to_4x4());
+		ASSERT(Near(v4.xyz(), rotate(q, v)));
+		ASSERT_EQUALS(v4.w, 1);
+
+		// every branch of the conversion back
+		quat rotations[4] = {
+			q,
+			quat::rotation(float3(1, 0, 0), 3.0f),
+			quat::rotation(float3(0, 1, 0), 3.0f),
+			quat::rotation(float3(0, 0, 1), 3.0f)};
+
+		bool equal = true;
+		for (size_t i = 0; i != 4; ++i)
+		{
+			equal &= Near(quat::from_matrix(rotations[i].to_3x3()), rotations[i]);
+			equal &= Near(quat::from_matrix(rotations[i].to_4x4()), rotations[i]);
+		}
+		ASSERT(equal);
+	}
+
+	void TestInterpolation()
+	{
+		quat a = quat::rotation(float3(0, 0, 1), 0.2f);
+		quat b = quat::rotation(float3(0, 0, 1), 1.4f);
+
+		ASSERT(Near(slerp(a, b, 0.0f), a));
+		ASSERT(Near(slerp(a, b, 1.0f), b));
+		ASSERT(Near(slerp(a, b, 0.25f), quat::rotation(float3(0, 0, 1), 0.5f)));
+		ASSERT(Near(slerp(a, -b, 0.25f), quat::rotation(float3(0, 0, 1), 0.5f)));
+		ASSERT(Near(nlerp(a, b, 0.5f), quat::rotation(float3(0, 0, 1), 0.8f)));
+		ASSERT(Near(slerp(a, a, 0.5f), a));
+	}
+
+	void TestBatch()
+	{
+		const size_t n = 29;
+		std::vector<quat> from(n);
+		std::vector<quat> to(n);
+		std::vector<float> t(n);
+		for (size_t i = 0; i != n; ++i)
+		{
+			float3 axis = normalize(float3(1, float(i), 2));
+			from[i] = quat::rotation(axis, 0.1f * float(i));
+			to[i] = quat::rotation(axis, 3.0f - 0.1f * float(i));
+			t[i] = float(i) / n;
+		}
+		to[3] = from[3];
+
+		std::vector<quat> s(n);
+		std::vector<quat> l(n);
+		std::vector<quat> h(n);
+		slerp(&from[0], &to[0], &t[0], &s[0], n);
+		nlerp(&from[0], &to[0], &t[0], &l[0], n);
+		slerp(&from[0], &to[0], 0.5f, &h[0], n);
+
+		bool equal = true;
+		for (size_t i = 0; i != n; ++i)
+		{
+			equal &= Near(s[i], slerp(from[i], to[i], t[i]));
+			equal &= Near(l[i], nlerp(from[i], to[i], t[i]));
+			equal &= Near(h[i], slerp(from[i], to[i], 0.5f));
+		}
+		ASSERT(equal);
+	}
+};
+
+REGISTER_FIXTURE(QuaternionTest);
@@ -0,0 +1,234 @@
+#include "UnitTest.h"
+#include "ray_marcher.hpp"
+#include "intersect.hpp"
+
+#include <float.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace UnitTest;
+using namespace Dye;
+using namespace Dye::Graphics;
+using namespace Dye::Render;
+
+namespace
+{
+	// a sphere, over a floor at height floor if any, in bounds of half the
+	// size extent, which may be loose
+	class SphereField : public IRayMarchable
+	{
+	public:
+		SphereField(const float3 &center, float radius, float extent = 0, float floor = -FLT_MAX)
+			: m_center(center), m_radius(radius), m_extent(std::max(extent, radius)), m_floor(floor)
+		{
+		}
+
+		aabb bounds() const
+		{
+			const float3 r(m_extent, m_extent, m_extent);
+			aabb box = { m_center - r, m_center + r };
+			return box;
+		}
+
+		float distance(const float3 &p) const
+		{
+			const float3 to = p - m_center;
+			return std::min(to.length() - m_radius, p.y - m_floor);
+		}
+
+		float8 distance(const float3x8 &p) const
+		{
+			const float8 x = p.x - float8(m_center.x);
+			const float8 y = p.y - float8(m_center.y);
+			const float8 z = p.z - float8(m_center.z);
+			return min(sqrt(x * x + y * y + z * z) - float8(m_radius), p.y - float8(m_floor));
+		}
+
+		float3 m_center;
+		float m_radius;
+		float m_extent;
+		float m_floor;
+	};
+
+	camera look(const float3 &eye, const float3 &target)
+	{
+		camera view;
+		view.eye = eye;
+		view.target = target;
+		view.up = float3(0, 1, 0);
+		view.fov = 1.0f;
+		return view;
+	}
+
+	// pixels whose marched depth differs from the exact one by more than the
+	// hit tolerance allows, and those that hit one way only away from the rim
+	size_t wrong_pixels(const RayMarcher &marcher, const camera &view, const SphereField &sphere, size_t &disagree)
+	{
+		const size_t w = marcher.width();
+		const size_t h = marcher.height();
+		const camera_frame frame = make_frame(view, w, h);
+		const float pixel_angle = 2 * std::tan(view.fov * 0.5f) / h;
+		size_t wrong = 0;
+		disagree = 0;
+		for (size_t y = 0; y != h; ++y)
+		{
+			for (size_t x = 0; x != w; ++x)
+			{
+				const float sx = (x + 0.5f) / w * 2 - 1;
+				const float sy = (y + 0.5f) / h * 2 - 1;
+				const float3 d = normalize(float3(frame.forward + frame.right * sx + frame.down * sy));
+				float t;
+				const bool exact = intersect_sphere(sphere.m_center, sphere.m_radius, view.eye, d, 0, FLT_MAX, t);
+				const float marched = marcher.depth()[y * w + x];
+				if (exact != (marched != FLT_MAX))
+				{
+					// a ray that grazes the rim within the footprint of its
+					// pixel may hit either way
+					const float3 to = sphere.m_center - view.eye;
+					const float along = dot(to, d);
+					const float3 off = to - d * along;
+					if (std::abs(off.length() - sphere.m_radius) > pixel_angle * along)
+					{
+						++disagree;
+					}
+				}
+				else if (exact && std::abs(marched - t) > 2 * pixel_angle * t)
+				{
+					++wrong;
+				}
+			}
+		}
+		return wrong;
+	}
+}
+
+class RayMarcherTest : public TestFixture<RayMarcherTest>
+{
+public:
+	TEST_FIXTURE( RayMarcherTest )
+	{
+		TEST_CASE(TestSphere);
+		TEST_CASE(TestConeStarts);
+		TEST_CASE(TestSteps);
+		TEST_CASE(TestEmpty);
+	}
+
+private:
+	void TestSphere()
+	{
+		// every way of marching finds the sphere where the exact test does;
+		// 37 by 21 leaves partial cells and packets
+		const SphereField sphere(float3(0.2f, -0.1f, 0.3f), 1);
+		const camera view = look(float3(0.5f, 0.8f, -3.5f), float3(0, 0, 0));
+		for (int way = 0; way != 8; ++way)
+		{
+			march_settings settings;
+			settings.packets = (way & 1) != 0;
+			settings.cones = (way & 2) != 0;
+			settings.relaxation = (way & 4) ? march_settings().relaxation : 1.0f;
+			RayMarcher marcher(sphere, 37, 21);
+			marcher.set_camera(view);
+			marcher.set_settings(settings);
+			const march_stats stats = marcher.render();
+			ASSERT(stats.rays == 37 * 21);
+			ASSERT(stats.hits > 50 && stats.hits < stats.rays);
+			ASSERT((stats.cone_steps != 0) == settings.cones);
+
+			size_t disagree;
+			ASSERT(wrong_pixels(marcher, view, sphere, disagree) == 0);
+			ASSERT(disagree == 0);
+
+			// lit from the front left, dark at the back
+			const float *rgb = marcher.image();
+			float brightest = 0;
+			for (size_t i = 0; i != 37 * 21; ++i)
+			{
+				if (marcher.depth()[i] != FLT_MAX)
+				{
+					brightest = std::max(brightest, rgb[i * 3]);
+				}
+				else
+				{
+					ASSERT(rgb[i * 3 + 2] == settings.sky.z);
+				}
+			}
+			ASSERT(brightest > 0.7f && brightest <= 0.8f);
+		}
+	}
+
+	void TestConeStarts()
+	{
+		// no pixel of a cell hits before its cone stopped
+		const SphereField sphere(float3(0, 0, 0), 1.5f);
+		RayMarcher marcher(sphere, 64, 48);
+		marcher.set_camera(look(float3(1, 2, -6), float3(0, 0, 0)));
+		marcher.render();
+		size_t empty = 0;
+		for (size_t y = 0; y != 48; ++y)
+		{
+			for (size_t x = 0; x != 64; ++x)
+			{
+				const float start = marcher.cone_starts()[(y / c_cone_cell) * marcher.cone_columns() + x / c_cone_cell];
+				ASSERT(start <= marcher.depth()[y * 64 + x]);
+				ASSERT(start == FLT_MAX || start > 3);
+			}
+		}
+		for (size_t i = 0; i != marcher.cone_columns() * marcher.cone_rows(); ++i)
+		{
+			empty += marcher.cone_starts()[i] == FLT_MAX;
+		}
+		ASSERT(empty > 0);
+	}
+
+	void TestSteps()
+	{
+		// the relaxation saves steps along the floor, which the rays graze,
+		// and the pre-pass in the empty space of loose bounds
+		const SphereField sphere(float3(0, 0, 0), 1, 4, -1);
+		const camera view = look(float3(0, 0, -5), float3(0, 0, 0));
+		march_settings plain;
+		plain.cones = false;
+		plain.relaxation = 1;
+		march_settings relaxed = plain;
+		relaxed.relaxation = march_settings().relaxation;
+		march_settings coned = relaxed;
+		coned.cones = true;
+
+		march_stats stats[3];
+		const march_settings *settings[3] = { &plain, &relaxed, &coned };
+		for (int i = 0; i != 3; ++i)
+		{
+			RayMarcher marcher(sphere, 64, 64);
+			marcher.set_camera(view);
+			marcher.set_settings(*settings[i]);
+			stats[i] = marcher.render();
+		}
+		ASSERT(stats[0].hits > 1000);
+		for (int i = 1; i != 3; ++i)
+		{
+			ASSERT(std::abs(static_cast<int>(stats[i].hits) - static_cast<int>(stats[0].hits)) <= 4);
+		}
+		ASSERT(stats[1].steps_per_ray() < stats[0].steps_per_ray());
+		ASSERT(stats[2].steps_per_ray() < stats[1].steps_per_ray());
+		ASSERT(stats[2].steps < stats[1].steps);
+	}
+
+	void TestEmpty()
+	{
+		// geometry behind the eye: every cone leaves the bounds at once and
+		// no ray takes a step
+		const SphereField sphere(float3(0, 0, 10), 1);
+		RayMarcher marcher(sphere, 20, 12);
+		marcher.set_camera(look(float3(0, 0, 0), float3(0, 0, -1)));
+		const march_stats stats = marcher.render();
+		ASSERT(stats.rays == 240 && stats.hits == 0);
+		ASSERT(stats.steps == 0 && stats.cone_steps <= 3 * 2 * 2);
+		for (size_t i = 0; i != 240; ++i)
+		{
+			ASSERT(marcher.depth()[i] == FLT_MAX);
+		}
+	}
+};
+
+REGISTER_FIXTURE(RayMarcherTest);
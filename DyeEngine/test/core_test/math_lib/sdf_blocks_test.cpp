@@ -0,0 +1,311 @@
+#include "UnitTest.h"
+#include "sdf_blocks.hpp"
+#include "ray_marcher.hpp"
+
+#include <float.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace UnitTest;
+using namespace Dye;
+using namespace Dye::Graphics;
+using namespace Dye::Render;
+
+namespace
+{
+	// 4 by 4 objects of csg apart from each other in a box from -4 to 4:
+	// boxes without a ball, cylinders blended into spheres and rings
+	unsigned int csg_scene(SdfTree &tree)
+	{
+		unsigned int root = tree.empty();
+		for (int i = 0; i != 16; ++i)
+		{
+			const float3 at(-3 + 2.0f * (i % 4), 0.3f * (i % 3) - 0.3f, -3 + 2.0f * (i / 4));
+			unsigned int shape;
+			if (i % 3 == 0)
+			{
+				shape = tree.subtract(tree.box(float3(0.6f, 0.6f, 0.6f)), tree.sphere(0.75f));
+			}
+			else if (i % 3 == 1)
+			{
+				shape = tree.smooth_merge(tree.cylinder(0.3f, 0.7f), tree.translate(tree.sphere(0.45f),
+					float3(0, 0.6f, 0)), 0.2f);
+			}
+			else
+			{
+				shape = tree.intersect(tree.torus(0.6f, 0.2f), tree.plane(float3(0, 1, 0), 0.1f));
+			}
+			root = tree.merge(root, tree.translate(shape, at));
+		}
+		return root;
+	}
+
+	// balls only, so that the distance is exact outside them
+	unsigned int balls(SdfTree &tree)
+	{
+		unsigned int root = tree.empty();
+		for (int i = 0; i != 12; ++i)
+		{
+			const float3 at(std::sin(i * 1.7f) * 3, std::cos(i * 2.3f) * 2, std::sin(i * 0.9f + 1) * 3);
+			root = tree.merge(root, tree.translate(tree.sphere(0.4f + 0.05f * i), at));
+		}
+		return root;
+	}
+
+	float next(unsigned int &seed)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) * (1.0f / 16777216.0f);
+	}
+
+	float3 inside(const aabb &box, unsigned int &seed)
+	{
+		float3 p;
+		for (int axis = 0; axis != 3; ++axis)
+		{
+			p[axis] = box.lower[axis] + (box.upper[axis] - box.lower[axis]) * next(seed);
+		}
+		return p;
+	}
+
+	aabb cube(const float3 &lower, float size)
+	{
+		aabb box = { lower, lower + float3(size, size, size) };
+		return box;
+	}
+
+	aabb scene_box()
+	{
+		return cube(float3(-4, -4, -4), 8);
+	}
+}
+
+class SdfBlocksTest : public TestFixture<SdfBlocksTest>
+{
+public:
+	TEST_FIXTURE( SdfBlocksTest )
+	{
+		TEST_CASE(TestIntervals);
+		TEST_CASE(TestPrune);
+		TEST_CASE(TestBlocks);
+		TEST_CASE(TestBounds);
+		TEST_CASE(TestMarching);
+	}
+
+private:
+	void TestIntervals()
+	{
+		// the distance at points in a region stays in the range of the region
+		SdfTree tree;
+		const unsigned int root = tree.merge(csg_scene(tree), tree.repeat(tree.torus(0.5f, 0.1f),
+			float3(1.5f, 0, 0), float3(2, 0, 0)));
+		SdfProgram program;
+		ASSERT(program.compile(tree, root));
+		unsigned int seed = 3;
+		for (int i = 0; i != 200; ++i)
+		{
+			const aabb region = cube(inside(scene_box(), seed), 0.05f + next(seed) * 3);
+			const sdf_interval range = program.evaluate(region);
+			ASSERT(range.lower <= range.upper);
+			for (int j = 0; j != 20; ++j)
+			{
+				const float d = program.distance(inside(region, seed));
+				ASSERT(d >= range.lower - 1e-5f && d <= range.upper + 1e-5f);
+			}
+		}
+
+		// outside, inside and through the surface of a ball
+		SdfTree one;
+		const unsigned int ball = one.sphere(1);
+		ASSERT(program.compile(one, ball));
+		ASSERT(program.evaluate(cube(float3(2, -0.5f, -0.5f), 1)).lower > 0.9f);
+		ASSERT(program.evaluate(cube(float3(-0.25f, -0.25f, -0.25f), 0.5f)).upper < -0.5f);
+		const sdf_interval through = program.evaluate(cube(float3(0.5f, -0.5f, -0.5f), 1));
+		ASSERT(through.lower < 0 && through.upper > 0);
+	}
+
+	void TestPrune()
+	{
+		// inside its region the pruned program gives the very same
+		// distances with a fraction of the instructions
+		SdfTree tree;
+		const unsigned int root = csg_scene(tree);
+		SdfProgram program;
+		ASSERT(program.compile(tree, root));
+		unsigned int seed = 5;
+		size_t total = 0;
+		for (int i = 0; i != 100; ++i)
+		{
+			const aabb region = cube(inside(scene_box(), seed), 0.5f);
+			SdfProgram pruned;
+			const sdf_interval range = program.prune(region, pruned);
+			ASSERT(range.lower == program.evaluate(region).lower);
+			ASSERT(pruned.instruction_count() <= program.instruction_count());
+			ASSERT(pruned.bounds().lower.x == region.lower.x);
+			total += pruned.instruction_count();
+			for (int j = 0; j != 10; ++j)
+			{
+				const float3 p = inside(region, seed);
+				ASSERT(pruned.distance(p) == program.distance(p));
+			}
+		}
+		ASSERT(total * 4 < 100 * program.instruction_count());
+
+		// a difference whose second operand decides becomes its negation
+		SdfTree cut;
+		const unsigned int hollow = cut.subtract(cut.sphere(10), cut.sphere(1));
+		ASSERT(program.compile(cut, hollow));
+		SdfProgram pruned = program;
+		pruned.prune(cube(float3(-0.1f, -0.1f, -0.1f), 0.2f), pruned);
+		ASSERT(pruned.instruction_count() == 2);
+		ASSERT(pruned.distance(float3(0, 0.05f, 0)) == program.distance(float3(0, 0.05f, 0)));
+	}
+
+	void TestBlocks()
+	{
+		SdfTree tree;
+		const unsigned int root = csg_scene(tree);
+		SdfProgram program;
+		ASSERT(program.compile(tree, root));
+
+		// 8 / 0.0625 is 128 cells, 2 top blocks and 16 leaves each way
+		SdfBlocks blocks;
+		blocks.build(program, scene_box(), 0.0625f);
+		ASSERT(blocks.leaves(0) == 16 && blocks.leaves(2) == 16);
+		ASSERT(blocks.count(sdf_block_surface) > 0 && blocks.count(sdf_block_outside) > 0);
+		ASSERT(blocks.average_instructions() * 4 < program.instruction_count());
+		size_t large = 0;
+		for (size_t i = 0; i != blocks.block_count(); ++i)
+		{
+			const sdf_block &block = blocks.block(i);
+			ASSERT(block.size >= c_sdf_leaf_block && block.size <= c_sdf_top_block);
+			ASSERT(block.type != sdf_block_surface || block.size == c_sdf_leaf_block);
+			large += block.size > c_sdf_leaf_block;
+		}
+		ASSERT(large > 0);
+
+		// the surface is in the surface blocks only, with the same distances
+		unsigned int seed = 9;
+		for (int i = 0; i != 2000; ++i)
+		{
+			const float3 p = inside(scene_box(), seed);
+			const unsigned int found = blocks.find(p);
+			ASSERT(found != c_no_block);
+			const sdf_block &block = blocks.block(found);
+			const float d = program.distance(p);
+			if (block.type == sdf_block_surface)
+			{
+				ASSERT(blocks.distance(p) == d);
+			}
+			else
+			{
+				ASSERT(block.type == sdf_block_outside ? d > 0.0625f : d < -0.0625f);
+			}
+		}
+		ASSERT(blocks.find(float3(4.5f, 0, 0)) == c_no_block);
+		ASSERT(blocks.distance(float3(4.5f, 0, 0)) == program.distance(float3(4.5f, 0, 0)));
+
+		// a ball large enough to hold blocks whole
+		SdfTree ball;
+		ASSERT(program.compile(ball, ball.sphere(3.5f)));
+		blocks.build(program, scene_box(), 0.0625f);
+		const unsigned int middle = blocks.find(float3(0.1f, 0.1f, 0.1f));
+		ASSERT(blocks.count(sdf_block_inside) > 0 && blocks.block(middle).type == sdf_block_inside);
+		ASSERT(blocks.distance(float3(0.1f, 0.1f, 0.1f)) < -1);
+	}
+
+	void TestBounds()
+	{
+		// outside the balls the distance is exact, and in a block outside
+		// the blocks give a lower bound of it, higher than the range
+		SdfTree tree;
+		const unsigned int root = balls(tree);
+		SdfProgram program;
+		ASSERT(program.compile(tree, root));
+		SdfBlocks blocks;
+		blocks.build(program, scene_box(), 0.125f);
+		unsigned int seed = 11;
+		size_t further = 0;
+		for (int i = 0; i != 2000; ++i)
+		{
+			float3x8 packet;
+			float3 p[c_packet_width];
+			for (size_t j = 0; j != c_packet_width; ++j)
+			{
+				p[j] = inside(scene_box(), seed);
+				packet.x[j] = p[j].x;
+				packet.y[j] = p[j].y;
+				packet.z[j] = p[j].z;
+			}
+			const float8 d = blocks.distance(packet);
+			for (size_t j = 0; j != c_packet_width; ++j)
+			{
+				const sdf_block &block = blocks.block(blocks.find(p[j]));
+				const float exact = program.distance(p[j]);
+				ASSERT(std::abs(d[j] - blocks.distance(p[j])) < 1e-5f);
+				if (block.type == sdf_block_outside)
+				{
+					ASSERT(d[j] >= block.range.lower && d[j] <= exact + 1e-5f);
+					further += d[j] > block.range.lower;
+				}
+			}
+		}
+		ASSERT(further > 0);
+
+		// the range of a box holds the blocks' values in it
+		for (int i = 0; i != 200; ++i)
+		{
+			const float3 a = inside(scene_box(), seed);
+			const float3 b = a + float3(0.3f, 0.2f, 0.4f);
+			const aabb box = { a, b };
+			float lower, upper;
+			blocks.range(box, lower, upper);
+			for (int j = 0; j != 20; ++j)
+			{
+				const float3 p = inside(box, seed);
+				const float d = blocks.distance(p);
+				ASSERT(d >= lower - 1e-5f && d <= upper + 1e-5f);
+			}
+		}
+	}
+
+	void TestMarching()
+	{
+		// the blocks march as the program does, in fewer instructions
+		SdfTree tree;
+		const unsigned int root = csg_scene(tree);
+		SdfProgram program;
+		ASSERT(program.compile(tree, root));
+		program.set_bounds(scene_box());
+		SdfBlocks blocks;
+		blocks.build(program, scene_box(), 0.0625f);
+
+		camera view;
+		view.eye = float3(1, 6, -9);
+		view.target = float3(0, 0, 0);
+		view.up = float3(0, 1, 0);
+		view.fov = 0.9f;
+		const IRayMarchable *geometry[2] = { &program, &blocks };
+		march_stats stats[2];
+		std::vector<float> depth[2];
+		for (int i = 0; i != 2; ++i)
+		{
+			RayMarcher marcher(*geometry[i], 48, 32);
+			marcher.set_camera(view);
+			stats[i] = marcher.render();
+			depth[i].assign(marcher.depth(), marcher.depth() + 48 * 32);
+		}
+		ASSERT(stats[0].hits > 100);
+		ASSERT(std::abs(static_cast<int>(stats[0].hits) - static_cast<int>(stats[1].hits)) <= 4);
+		for (size_t i = 0; i != depth[0].size(); ++i)
+		{
+			if (depth[0][i] != FLT_MAX && depth[1][i] != FLT_MAX)
+			{
+				ASSERT(std::abs(depth[0][i] - depth[1][i]) < 0.05f);
+			}
+		}
+	}
+};
+
+REGISTER_FIXTURE(SdfBlocksTest);
@@ -0,0 +1,361 @@
+#include "UnitTest.h"
+#include "sdf.hpp"
+#include "ray_marcher.hpp"
+
+#include <float.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace UnitTest;
+using namespace Dye;
+using namespace Dye::Graphics;
+using namespace Dye::Render;
+
+namespace
+{
+	// a floor, a grid of spheres on it, a torus blended into a cylinder and
+	// a box with a sphere cut out, in bounds from -8 to 8
+	unsigned int scene(SdfTree &tree)
+	{
+		const unsigned int floor = tree.plane(float3(0, 1, 0), 0);
+		const unsigned int grid = tree.repeat(tree.translate(tree.sphere(0.4f), float3(0, 0.4f, 0)),
+			float3(1.5f, 0, 1.5f), float3(4, 0, 4));
+		const unsigned int ring = tree.smooth_merge(tree.translate(tree.torus(2, 0.5f), float3(0, 0.5f, 0)),
+			tree.cylinder(0.5f, 1.5f), 0.4f);
+		const unsigned int cut = tree.subtract(tree.box(float3(0.6f, 0.6f, 0.6f)), tree.sphere(0.75f));
+		const unsigned int moved = tree.translate(tree.scale(cut, 1.5f), float3(3, 1, -2));
+		return tree.merge(tree.merge(floor, grid), tree.merge(ring, moved));
+	}
+
+	float next(unsigned int &seed)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) * (1.0f / 16777216.0f);
+	}
+
+	std::vector<float3> points(size_t count, float extent)
+	{
+		unsigned int seed = 7;
+		std::vector<float3> result(count);
+		for (size_t i = 0; i != count; ++i)
+		{
+			result[i] = float3((next(seed) * 2 - 1) * extent, (next(seed) * 2 - 1) * extent,
+				(next(seed) * 2 - 1) * extent);
+		}
+		return result;
+	}
+
+	bool close(float a, float b)
+	{
+		return std::abs(a - b) <= 1e-5f * std::max(1.0f, std::abs(a));
+	}
+
+	// the program against the tree, through every way of evaluating it
+	bool agrees(const SdfTree &tree, unsigned int root, const SdfProgram &program)
+	{
+		// 37 points leave a partial batch of 16 and a partial packet
+		const std::vector<float3> p = points(37, 8);
+		std::vector<float> x(p.size()), y(p.size()), z(p.size()), soa(p.size()), aos(p.size());
+		for (size_t i = 0; i != p.size(); ++i)
+		{
+			x[i] = p[i].x;
+			y[i] = p[i].y;
+			z[i] = p[i].z;
+		}
+		program.distances(&x[0], &y[0], &z[0], p.size(), &soa[0]);
+		program.distances(&p[0], p.size(), &aos[0]);
+
+		bool ok = true;
+		for (size_t first = 0; first + c_packet_width <= p.size(); first += c_packet_width)
+		{
+			float3x8 packet;
+			packet.x = float8::load(&x[first]);
+			packet.y = float8::load(&y[first]);
+			packet.z = float8::load(&z[first]);
+			const float8 d = program.distance(packet);
+			for (size_t i = 0; i != c_packet_width; ++i)
+			{
+				ok = ok && close(d[i], tree.distance(root, p[first + i]));
+			}
+		}
+		for (size_t i = 0; i != p.size(); ++i)
+		{
+			const float expected = tree.distance(root, p[i]);
+			ok = ok && close(program.distance(p[i]), expected);
+			ok = ok && close(soa[i], expected) && close(aos[i], expected);
+		}
+		return ok;
+	}
+}
+
+class SdfTest : public TestFixture<SdfTest>
+{
+public:
+	TEST_FIXTURE( SdfTest )
+	{
+		TEST_CASE(TestPrimitives);
+		TEST_CASE(TestScene);
+		TEST_CASE(TestFolding);
+		TEST_CASE(TestDeadBranches);
+		TEST_CASE(TestSharing);
+		TEST_CASE(TestRegisters);
+		TEST_CASE(TestBounds);
+		TEST_CASE(TestGrid);
+		TEST_CASE(TestContact);
+		TEST_CASE(TestMarching);
+	}
+
+private:
+	void TestPrimitives()
+	{
+		SdfTree tree;
+		const unsigned int shapes[] =
+		{
+			tree.sphere(1.5f),
+			tree.box(float3(1, 2, 0.5f)),
+			tree.torus(2, 0.5f),
+			tree.cylinder(1, 2),
+			tree.plane(normalize(float3(1, 2, -1)), 0.5f),
+			tree.intersect(tree.sphere(2), tree.box(float3(1.5f, 1.5f, 1.5f))),
+			tree.repeat(tree.sphere(0.5f), float3(2, 3, 0), float3(FLT_MAX, 1, 0)),
+		};
+		for (size_t i = 0; i != sizeof(shapes) / sizeof(shapes[0]); ++i)
+		{
+			SdfProgram program;
+			ASSERT(program.compile(tree, shapes[i]));
+			ASSERT(agrees(tree, shapes[i], program));
+		}
+
+		// exact where it is easy to say
+		ASSERT(close(tree.distance(shapes[0], float3(0, 3, 0)), 1.5f));
+		ASSERT(close(tree.distance(shapes[1], float3(0, 0, 0)), -0.5f));
+		ASSERT(close(tree.distance(shapes[1], float3(4, 6, 0)), 5));
+		ASSERT(close(tree.distance(shapes[2], float3(2, 0, 0)), -0.5f));
+		ASSERT(close(tree.distance(shapes[3], float3(0, 5, 0)), 3));
+		ASSERT(close(tree.distance(shapes[6], float3(6.2f, 0, 0)), -0.3f));
+		ASSERT(close(tree.distance(shapes[6], float3(0, 9, 0)), 5.5f));
+	}
+
+	void TestScene()
+	{
+		SdfTree tree;
+		const unsigned int root = scene(tree);
+		SdfProgram program;
+		ASSERT(program.compile(tree, root));
+		ASSERT(agrees(tree, root, program));
+
+		// an instruction or a few per node; the floor and the cylinder read
+		// the point as it comes
+		ASSERT(program.instruction_count() <= 24);
+		ASSERT(program.register_count() <= 8);
+	}
+
+	void TestFolding()
+	{
+		// translations that cancel, a scale by one and constants fold away
+		SdfTree tree;
+		const unsigned int inner = tree.translate(tree.sphere(1), float3(1, -2, 0));
+		const unsigned int back = tree.translate(tree.scale(inner, 1), float3(-1, 2, 0));
+		SdfProgram program;
+		ASSERT(program.compile(tree, back));
+		ASSERT(program.instruction_count() == 1);
+		ASSERT(program.instructions()[0].op == sdf_op_sphere);
+
+		// a tree without the point is one constant
+		const unsigned int fixed = tree.smooth_merge(tree.constant(1), tree.constant(1.5f), 1);
+		ASSERT(program.compile(tree, fixed));
+		ASSERT(program.instruction_count() == 1);
+		ASSERT(program.instructions()[0].op == sdf_op_constant);
+		ASSERT(close(program.distance(float3(3, 4, 5)), tree.distance(fixed, float3(0, 0, 0))));
+
+		// the empty program is far away everywhere
+		const SdfProgram nothing;
+		ASSERT(nothing.distance(float3(0, 0, 0)) == FLT_MAX);
+		ASSERT(nothing.bounds().lower.x > nothing.bounds().upper.x);
+	}
+
+	void TestDeadBranches()
+	{
+		// unions with the empty shape, an intersection with everything and
+		// a difference with nothing leave only the sphere
+		SdfTree tree;
+		const unsigned int unused = tree.box(float3(1, 1, 1));
+		const unsigned int sphere = tree.sphere(1);
+		unsigned int root = tree.merge(tree.empty(), tree.translate(tree.empty(), float3(1, 2, 3)));
+		root = tree.merge(sphere, root);
+		root = tree.intersect(root, tree.constant(-FLT_MAX));
+		root = tree.subtract(root, tree.smooth_merge(tree.empty(), tree.empty(), 0.5f));
+		SdfProgram program;
+		ASSERT(program.compile(tree, root));
+		ASSERT(program.instruction_count() == 1);
+		ASSERT(program.instructions()[0].op == sdf_op_sphere);
+		ASSERT(tree.size() > 10 && unused < tree.size());
+		ASSERT(agrees(tree, root, program));
+	}
+
+	void TestSharing()
+	{
+		// one node under two parents, and two equal subtrees, are evaluated
+		// once
+		SdfTree tree;
+		const unsigned int ball = tree.translate(tree.sphere(1), float3(1, 0, 0));
+		const unsigned int twin = tree.translate(tree.sphere(1), float3(1, 0, 0));
+		const unsigned int root = tree.merge(tree.smooth_merge(ball, tree.box(float3(1, 1, 1)), 0.5f),
+			tree.subtract(twin, ball));
+		SdfProgram program;
+		ASSERT(program.compile(tree, root));
+		size_t spheres = 0;
+		size_t offsets = 0;
+		for (size_t i = 0; i != program.instruction_count(); ++i)
+		{
+			spheres += program.instructions()[i].op == sdf_op_sphere;
+			offsets += program.instructions()[i].op == sdf_op_offset;
+		}
+		ASSERT(spheres == 1 && offsets == 1);
+		ASSERT(agrees(tree, root, program));
+	}
+
+	void TestRegisters()
+	{
+		// a chain of 200 unions either way round needs a handful of
+		// registers, the larger side first
+		SdfTree tree;
+		unsigned int left = tree.empty();
+		unsigned int right = tree.empty();
+		for (int i = 0; i != 200; ++i)
+		{
+			const unsigned int ball = tree.translate(tree.sphere(0.3f), float3(i * 0.1f - 10, 0, 0));
+			left = tree.merge(left, ball);
+			right = tree.merge(ball, right);
+		}
+		SdfProgram program;
+		ASSERT(program.compile(tree, left));
+		ASSERT(program.register_count() <= 6);
+		ASSERT(agrees(tree, left, program));
+		ASSERT(program.compile(tree, right));
+		ASSERT(program.register_count() <= 6);
+
+		// a balanced tree of 2^10 leaves needs about one per level
+		std::vector<unsigned int> level;
+		for (int i = 0; i != 1024; ++i)
+		{
+			level.push_back(tree.translate(tree.sphere(0.1f), float3(0, i * 0.01f, 0)));
+		}
+		while (level.size() > 1)
+		{
+			std::vector<unsigned int> up;
+			for (size_t i = 0; i != level.size(); i += 2)
+			{
+				up.push_back(tree.merge(level[i], level[i + 1]));
+			}
+			level.swap(up);
+		}
+		ASSERT(program.compile(tree, level[0]));
+		ASSERT(program.register_count() <= 16);
+		ASSERT(agrees(tree, level[0], program));
+	}
+
+	void TestBounds()
+	{
+		SdfTree tree;
+		const unsigned int root = scene(tree);
+		const aabb open = tree.bounds(root);
+		ASSERT(open.lower.y == -FLT_MAX && open.upper.x == FLT_MAX);
+
+		// the grid of spheres reaches 4 cells each way
+		const unsigned int grid = tree.repeat(tree.sphere(0.4f), float3(1.5f, 0, 1.5f), float3(4, 0, 4));
+		const aabb box = tree.bounds(grid);
+		ASSERT(close(box.lower.x, -6.4f) && close(box.upper.z, 6.4f) && close(box.upper.y, 0.4f));
+
+		// translated, scaled and cut
+		const unsigned int cut = tree.intersect(tree.translate(tree.scale(tree.box(float3(1, 1, 1)), 2), float3(3, 0, 0)),
+			tree.sphere(2));
+		const aabb both = tree.bounds(cut);
+		ASSERT(close(both.lower.x, 1) && close(both.upper.x, 2) && close(both.lower.y, -2));
+
+		// a union with nothing is the other side
+		const aabb one = tree.bounds(tree.merge(tree.empty(), tree.sphere(1)));
+		ASSERT(one.lower.x == -1 && one.upper.z == 1);
+	}
+
+	void TestGrid()
+	{
+		// x fastest, then y, then z
+		SdfTree tree;
+		const unsigned int root = tree.translate(tree.torus(1, 0.3f), float3(0.1f, 0.2f, 0));
+		SdfProgram program;
+		ASSERT(program.compile(tree, root));
+		const size_t nx = 19, ny = 5, nz = 7;
+		const float3 origin(-1.5f, -0.5f, -1.5f);
+		std::vector<float> grid(nx * ny * nz);
+		program.sample_grid(origin, 0.17f, nx, ny, nz, &grid[0]);
+		for (size_t k = 0; k != nz; ++k)
+		{
+			for (size_t j = 0; j != ny; ++j)
+			{
+				for (size_t i = 0; i != nx; ++i)
+				{
+					const float3 p(origin.x + 0.17f * i, origin.y + 0.17f * j, origin.z + 0.17f * k);
+					ASSERT(close(grid[(k * ny + j) * nx + i], tree.distance(root, p)));
+				}
+			}
+		}
+	}
+
+	void TestContact()
+	{
+		SdfTree tree;
+		const unsigned int root = tree.merge(tree.translate(tree.sphere(1), float3(0, 2, 0)),
+			tree.plane(float3(0, 1, 0), 0));
+		SdfProgram program;
+		ASSERT(program.compile(tree, root));
+
+		float3 normal;
+		ASSERT(close(program.contact(float3(0.3f, 2, 0.9f), normal), std::sqrt(0.9f) - 1));
+		ASSERT(std::abs(dot(normal, normalize(float3(0.3f, 0, 0.9f))) - 1) < 1e-3f);
+		ASSERT(std::abs(program.contact(float3(5, -0.25f, 1), normal) + 0.25f) < 1e-5f);
+		ASSERT(std::abs(normal.y - 1) < 1e-3f);
+	}
+
+	void TestMarching()
+	{
+		// the program drives the ray marcher as any distance function does
+		SdfTree tree;
+		const unsigned int root = tree.subtract(tree.box(float3(1, 1, 1)), tree.sphere(1.2f));
+		SdfProgram program;
+		ASSERT(program.compile(tree, root));
+		camera view;
+		view.eye = float3(2, 2.5f, -3);
+		view.target = float3(0, 0, 0);
+		view.up = float3(0, 1, 0);
+		view.fov = 1;
+
+		march_settings single;
+		single.packets = false;
+		march_stats stats[2];
+		std::vector<float> depth[2];
+		for (int i = 0; i != 2; ++i)
+		{
+			RayMarcher marcher(program, 40, 30);
+			marcher.set_camera(view);
+			if (i == 0)
+			{
+				marcher.set_settings(single);
+			}
+			stats[i] = marcher.render();
+			depth[i].assign(marcher.depth(), marcher.depth() + 40 * 30);
+		}
+		ASSERT(stats[0].hits > 100);
+		ASSERT(std::abs(static_cast<int>(stats[0].hits) - static_cast<int>(stats[1].hits)) <= 4);
+		for (size_t i = 0; i != depth[0].size(); ++i)
+		{
+			if (depth[0][i] != FLT_MAX && depth[1][i] != FLT_MAX)
+			{
+				ASSERT(std::abs(depth[0][i] - depth[1][i]) < 0.05f);
+			}
+		}
+	}
+};
+
+REGISTER_FIXTURE(SdfTest);
@@ -0,0 +1,225 @@
+#include "UnitTest.h"
+#include "simplify.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <vector>
+
+using namespace UnitTest;
+using namespace Dye;
+using namespace Dye::Graphics;
+
+namespace
+{
+	// n by n vertices over [0, n - 1] squared, height(x, y) high. with a
+	// seam the column at x = n / 2 is there twice, the copies on the right
+	// having tex.x 1 and the others 0.
+	void make_sheet(size_t n, float bump, bool seam, std::vector<vertex> &vertices, std::vector<unsigned int> &indices)
+	{
+		const size_t middle = n / 2;
+		const size_t columns = seam ? n + 1 : n;
+		vertices.resize(columns * n);
+		for (size_t y = 0; y != n; ++y)
+		{
+			for (size_t c = 0; c != columns; ++c)
+			{
+				size_t x = seam && c > middle ? c - 1 : c;
+				float fx = static_cast<float>(x);
+				float fy = static_cast<float>(y);
+				vertex &v = vertices[y * columns + c];
+				v.pos = float3(fx, fy, bump * std::sin(fx * 0.3f) * std::cos(fy * 0.2f));
+				v.normal = float3(0, 0, 1);
+				v.tex = float2(seam && c > middle ? 1.0f : 0.0f, fy / n);
+			}
+		}
+
+		indices.clear();
+		for (size_t y = 0; y + 1 < n; ++y)
+		{
+			for (size_t x = 0; x + 1 < n; ++x)
+			{
+				size_t c = seam && x >= middle ? x + 1 : x;
+				unsigned int a = static_cast<unsigned int>(y * columns + c);
+				unsigned int b = a + 1;
+				unsigned int d = a + static_cast<unsigned int>(columns);
+				unsigned int e = d + 1;
+				unsigned int quad[6] = { a, b, e, a, e, d };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+	}
+
+	// an edge by the x and y of its ends
+	struct edge
+	{
+		float v[4];
+
+		bool operator < (const edge &rhs) const
+		{
+			return std::lexicographical_compare(v, v + 4, rhs.v, rhs.v + 4);
+		}
+	};
+
+	// the edges that lack a way back at the same positions and do not lie
+	// on the outline of the sheet
+	size_t count_cracks(const std::vector<vertex> &vertices, const unsigned int *indices, size_t index_count, float last)
+	{
+		std::set<edge> edges;
+		for (size_t i = 0; i != index_count; ++i)
+		{
+			const float3 &a = vertices[indices[i]].pos;
+			const float3 &b = vertices[indices[i - i % 3 + (i + 1) % 3]].pos;
+			edge e = { { a.x, a.y, b.x, b.y } };
+			edges.insert(e);
+		}
+
+		size_t cracks = 0;
+		for (std::set<edge>::const_iterator e = edges.begin(); e != edges.end(); ++e)
+		{
+			const float *v = e->v;
+			bool outline = (v[0] == 0 && v[2] == 0) || (v[0] == last && v[2] == last)
+				|| (v[1] == 0 && v[3] == 0) || (v[1] == last && v[3] == last);
+			edge back = { { v[2], v[3], v[0], v[1] } };
+			cracks += !outline && edges.count(back) == 0;
+		}
+		return cracks;
+	}
+}
+
+class SimplifyTest : public TestFixture<SimplifyTest>
+{
+public:
+	TEST_FIXTURE( SimplifyTest )
+	{
+		TEST_CASE(TestFlat);
+		TEST_CASE(TestBorder);
+		TEST_CASE(TestSeam);
+		TEST_CASE(TestErrorLimit);
+		TEST_CASE(TestLodChain);
+		TEST_CASE(TestSelectLod);
+	}
+
+private:
+	void TestFlat()
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_sheet(32, 0, false, vertices, indices);
+
+		// a plane goes down to a few triangles without error
+		std::vector<unsigned int> out(indices.size());
+		float error = -1;
+		size_t count = simplify(&vertices[0], vertices.size(), &indices[0], indices.size(), indices.size() / 20, &out[0], 1e30f, &error);
+		ASSERT(count <= indices.size() / 20 && count > 0 && count % 3 == 0);
+		ASSERT(error >= 0 && error < 1e-3f);
+
+		// facing up still
+		for (size_t i = 0; i != count; i += 3)
+		{
+			float3 e1 = vertices[out[i + 1]].pos - vertices[out[i]].pos;
+			float3 e2 = vertices[out[i + 2]].pos - vertices[out[i]].pos;
+			float3 n = cross(e1, e2);
+			ASSERT(n.z > 0);
+		}
+	}
+
+	void TestBorder()
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_sheet(24, 2, false, vertices, indices);
+
+		std::vector<unsigned int> out(indices.size());
+		size_t count = simplify(&vertices[0], vertices.size(), &indices[0], indices.size(), indices.size() / 8, &out[0]);
+		ASSERT(count < indices.size() / 4);
+
+		// the corners stay and the outline closes
+		float lower = 1e30f;
+		float upper = -1e30f;
+		for (size_t i = 0; i != count; ++i)
+		{
+			lower = std::min(lower, std::min(vertices[out[i]].pos.x, vertices[out[i]].pos.y));
+			upper = std::max(upper, std::max(vertices[out[i]].pos.x, vertices[out[i]].pos.y));
+		}
+		ASSERT(lower == 0 && upper == 23);
+		ASSERT(count_cracks(vertices, &out[0], count, 23) == 0);
+	}
+
+	void TestSeam()
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_sheet(24, 2, true, vertices, indices);
+		ASSERT(count_cracks(vertices, &indices[0], indices.size(), 23) == 0);
+
+		std::vector<unsigned int> out(indices.size());
+		size_t count = simplify(&vertices[0], vertices.size(), &indices[0], indices.size(), indices.size() / 8, &out[0]);
+		ASSERT(count < indices.size() / 4);
+
+		// both sides follow the seam, and keep their own attributes
+		ASSERT(count_cracks(vertices, &out[0], count, 23) == 0);
+		for (size_t i = 0; i != count; i += 3)
+		{
+			float side = vertices[out[i]].tex.x;
+			ASSERT(vertices[out[i + 1]].tex.x == side && vertices[out[i + 2]].tex.x == side);
+		}
+	}
+
+	void TestErrorLimit()
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_sheet(32, 4, false, vertices, indices);
+
+		std::vector<unsigned int> out(indices.size());
+		float loose = 0;
+		float tight = 0;
+		size_t all = simplify(&vertices[0], vertices.size(), &indices[0], indices.size(), 0, &out[0], 1e30f, &loose);
+		size_t some = simplify(&vertices[0], vertices.size(), &indices[0], indices.size(), 0, &out[0], 0.05f, &tight);
+		ASSERT(tight <= 0.05f && tight < loose);
+		ASSERT(some > all && some < indices.size());
+	}
+
+	void TestLodChain()
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		make_sheet(64, 3, true, vertices, indices);
+
+		lod_options options;
+		options.min_triangles = 100;
+		std::vector<unsigned int> lod_indices;
+		std::vector<mesh_lod> lods;
+		build_lods(&vertices[0], vertices.size(), &indices[0], indices.size(), options, lod_indices, lods);
+
+		// a collapse takes up to four triangles, so a level may end a
+		// little below min_triangles
+		ASSERT(lods.size() >= 4 && lods.size() <= options.max_levels);
+		ASSERT(lods[0].first_index == 0 && lods[0].index_count == indices.size() && lods[0].error == 0);
+		for (size_t i = 1; i != lods.size(); ++i)
+		{
+			const mesh_lod &lod = lods[i];
+			ASSERT(lod.first_index == lods[i - 1].first_index + lods[i - 1].index_count);
+			ASSERT(lod.index_count <= std::max<size_t>(lods[i - 1].index_count / 2, options.min_triangles * 3));
+			ASSERT(lod.index_count / 3 + 4 > options.min_triangles);
+			ASSERT(lod.error >= lods[i - 1].error);
+			ASSERT(count_cracks(vertices, &lod_indices[lod.first_index], lod.index_count, 63) == 0);
+		}
+		const mesh_lod &last = lods.back();
+		ASSERT(last.first_index + last.index_count == lod_indices.size());
+		ASSERT(*std::max_element(lod_indices.begin(), lod_indices.end()) < vertices.size());
+	}
+
+	void TestSelectLod()
+	{
+		mesh_lod lods[4] = { { 0, 300, 0, 0 }, { 300, 150, 0.01f, 0 }, { 450, 75, 0.1f, 0 }, { 525, 36, 1, 0 } };
+		ASSERT(select_lod(lods, 4, 1, 0.001f) == 0);
+		ASSERT(select_lod(lods, 4, 10, 0.001f) == 1);
+		ASSERT(select_lod(lods, 4, 100, 0.001f) == 2);
+		ASSERT(select_lod(lods, 4, 1e6f, 0.001f) == 3);
+		ASSERT(select_lod(lods, 1, 1e6f, 0.001f) == 0);
+	}
+};
+
+REGISTER_FIXTURE(SimplifyTest);
@@ -0,0 +1,345 @@
+#include "UnitTest.h"
+#include "sparse_volume.hpp"
+#include "marching_cubes.hpp"
+#include "ray_marcher.hpp"
+#include "scalar_grid.hpp"
+#include "sdf.hpp"
+
+#include <float.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace UnitTest;
+using namespace Dye;
+using namespace Dye::Graphics;
+using namespace Dye::Render;
+
+namespace
+{
+	float next(unsigned int &seed)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) * (1.0f / 16777216.0f);
+	}
+
+	float3 random_point(unsigned int &seed, float extent)
+	{
+		const float x = next(seed) * 2 - 1;
+		const float y = next(seed) * 2 - 1;
+		const float z = next(seed) * 2 - 1;
+		return float3(x, y, z) * extent;
+	}
+
+	// a ball of radius 1 over [-2, 2]^3, the band 2 cells wide
+	const float c_cell = 1.0f / 64;
+	const float c_band = 2 * c_cell;
+
+	void ball(SdfTree &tree, SdfProgram &program)
+	{
+		program.compile(tree, tree.sphere(1));
+	}
+
+	aabb ball_box()
+	{
+		const aabb box = { float3(-2, -2, -2), float3(2, 2, 2) };
+		return box;
+	}
+}
+
+class SparseVolumeTest : public TestFixture<SparseVolumeTest>
+{
+public:
+	TEST_FIXTURE( SparseVolumeTest )
+	{
+		TEST_CASE(TestBuild);
+		TEST_CASE(TestPrecision);
+		TEST_CASE(TestSampler);
+		TEST_CASE(TestMarchingCubes);
+		TEST_CASE(TestRays);
+	}
+
+private:
+	void TestBuild()
+	{
+		SdfTree tree;
+		SdfProgram program;
+		ball(tree, program);
+		SparseVolume volume;
+		volume.build(program, ball_box(), c_cell, c_band);
+		ASSERT(volume.cells(0) == 256 && volume.bricks(2) == 32);
+
+		// the band keeps a few percent of the bricks, at a tenth of the
+		// memory of the dense points at most
+		const size_t bricks = volume.bricks(0) * volume.bricks(1) * volume.bricks(2);
+		const size_t dense = 257 * 257 * 257 * sizeof(float);
+		ASSERT(volume.brick_count() > 0 && volume.brick_count() * 10 < bricks);
+		ASSERT(volume.memory() * 10 < dense);
+
+		// the tiles within and without, and the field in the band
+		ASSERT(volume.value(float3(0, 0, 0)) == -c_band && volume.value(float3(1.9f, 1.9f, 1.9f)) == c_band);
+		unsigned int seed = 3;
+		for (int i = 0; i != 1000; ++i)
+		{
+			const float3 p = normalize(random_point(seed, 1)) * (1 + (next(seed) * 2 - 1) * c_band);
+			ASSERT(std::abs(volume.value(p) - program.distance(p)) < 1e-4f);
+		}
+
+		// each brick kept has the sign change or the band within it
+		for (size_t i = 0; i != volume.brick_count(); ++i)
+		{
+			const float lower = volume.brick_lower(i);
+			const float upper = volume.brick_upper(i);
+			ASSERT(lower <= upper && (lower <= c_band && upper >= -c_band));
+		}
+
+		// the same bricks from the points of a grid, which gives no range
+		// and is sampled everywhere
+		ScalarGrid grid;
+		grid.assign(program, float3(-2, -2, -2), c_cell, 257, 257, 257);
+		SparseVolume sampled;
+		sampled.build(grid, ball_box(), c_cell, c_band);
+		ASSERT(sampled.brick_count() == volume.brick_count());
+		std::vector<float> a(c_brick_values), b(c_brick_values);
+		for (size_t i = 0; i < volume.brick_count(); i += 17)
+		{
+			volume.decode(i, &a[0]);
+			sampled.decode(i, &b[0]);
+			for (size_t j = 0; j != c_brick_values; ++j)
+			{
+				ASSERT(std::abs(a[j] - b[j]) < 1e-5f);
+			}
+		}
+	}
+
+	void TestPrecision()
+	{
+		SdfTree tree;
+		SdfProgram program;
+		ball(tree, program);
+		SparseVolume volumes[3];
+		const volume_precision precisions[3] = { volume_float, volume_half, volume_byte };
+		for (int i = 0; i != 3; ++i)
+		{
+			volumes[i].build(program, ball_box(), c_cell, c_band, precisions[i]);
+			ASSERT(volumes[i].precision() == precisions[i]);
+			ASSERT(volumes[i].brick_count() == volumes[0].brick_count());
+		}
+		ASSERT(volumes[2].memory() < volumes[1].memory() && volumes[1].memory() < volumes[0].memory());
+
+		// halves round by their precision, bytes by a step of the band
+		// where the corners are within it
+		unsigned int seed = 5;
+		for (int i = 0; i != 1000; ++i)
+		{
+			const float3 p = normalize(random_point(seed, 1)) * (1 + (next(seed) * 2 - 1) * c_cell * 0.25f);
+			const float exact = volumes[0].value(p);
+			ASSERT(std::abs(volumes[1].value(p) - exact) < 1e-3f * c_band + 1e-4f);
+			ASSERT(std::abs(volumes[2].value(p) - exact) <= c_band / 254 * 1.01f);
+			if (std::abs(exact) > c_band / 50)
+			{
+				ASSERT((volumes[1].value(p) < 0) == (exact < 0) && (volumes[2].value(p) < 0) == (exact < 0));
+			}
+		}
+	}
+
+	void TestSampler()
+	{
+		SdfTree tree;
+		SdfProgram program;
+		ball(tree, program);
+		SparseVolume volume;
+		volume.build(program, ball_box(), c_cell, c_band, volume_half);
+
+		// 8 points at a time as one at a time, bricks and tiles alike
+		unsigned int seed = 9;
+		for (int i = 0; i != 200; ++i)
+		{
+			float3x8 p;
+			for (size_t lane = 0; lane != c_packet_width; ++lane)
+			{
+				const float3 q = i % 2 == 0 ? random_point(seed, 2.2f)
+					: normalize(random_point(seed, 1)) * (1 + next(seed) * c_band);
+				p.x[lane] = q.x;
+				p.y[lane] = q.y;
+				p.z[lane] = q.z;
+			}
+			const float8 values = volume.value(p);
+			const float8 distances = volume.distance(p);
+			for (size_t lane = 0; lane != c_packet_width; ++lane)
+			{
+				const float3 q(p.x[lane], p.y[lane], p.z[lane]);
+				ASSERT(std::abs(values[lane] - volume.value(q)) < 1e-5f);
+				ASSERT(std::abs(distances[lane] - volume.distance(q)) < 1e-5f);
+			}
+		}
+
+		// a lattice on the points of the map, beyond them too, and one
+		// between them
+		const lattice on = { volume.origin(), c_cell, { 120, 60, -2 }, { 19, 13, 11 } };
+		const lattice between = { float3(0.31f, -0.95f, -0.2f), c_cell * 0.7f, { 0, 0, 0 }, { 21, 9, 5 } };
+		const lattice *grids[2] = { &on, &between };
+		for (int g = 0; g != 2; ++g)
+		{
+			const lattice &grid = *grids[g];
+			std::vector<float> out(grid.size());
+			volume.sample_grid(grid, &out[0]);
+			for (size_t k = 0, n = 0; k != grid.count[2]; ++k)
+			{
+				for (size_t j = 0; j != grid.count[1]; ++j)
+				{
+					for (size_t i = 0; i != grid.count[0]; ++i, ++n)
+					{
+						const float3 p(grid.coordinate(0, grid.first[0] + static_cast<int>(i)),
+							grid.coordinate(1, grid.first[1] + static_cast<int>(j)),
+							grid.coordinate(2, grid.first[2] + static_cast<int>(k)));
+						ASSERT(std::abs(out[n] - volume.value(p)) < 1e-5f);
+					}
+				}
+			}
+		}
+
+		// the range of a box holds the values in it
+		const aabb box = { float3(0.5f, 0.5f, 0.3f), float3(0.7f, 0.65f, 0.6f) };
+		float lower, upper;
+		volume.range(box, lower, upper);
+		ASSERT(lower < 0 && upper > 0);
+		for (int i = 0; i != 500; ++i)
+		{
+			const float3 p(box.lower.x + (box.upper.x - box.lower.x) * next(seed),
+				box.lower.y + (box.upper.y - box.lower.y) * next(seed),
+				box.lower.z + (box.upper.z - box.lower.z) * next(seed));
+			const float v = volume.value(p);
+			ASSERT(v >= lower && v <= upper);
+		}
+		const aabb far = { float3(1.7f, 1.7f, 1.7f), float3(3, 3, 3) };
+		volume.range(far, lower, upper);
+		ASSERT(lower == c_band && upper == c_band);
+	}
+
+	void TestMarchingCubes()
+	{
+		// the same triangles as the program, the chunks clear of the band
+		// skipped
+		SdfTree tree;
+		SdfProgram program;
+		ASSERT(program.compile(tree, tree.torus(1, 0.4f)));
+		const aabb box = { float3(-1.5f, -0.5f, -1.5f), float3(1.5f, 0.5f, 1.5f) };
+		const float cell = 3.0f / 128;
+		SparseVolume volume;
+		volume.build(program, box, cell, 2 * cell);
+
+		std::vector<vertex> vertices[2];
+		std::vector<unsigned int> indices[2];
+		mc_stats stats[2];
+		const IScalarField *fields[2] = { &program, &volume };
+		for (int i = 0; i != 2; ++i)
+		{
+			MarchingCubes cubes(*fields[i], box.lower, cell, 128, volume.cells(1), 128);
+			stats[i] = cubes.extract(vertices[i], indices[i]);
+		}
+		ASSERT(!indices[0].empty() && indices[0] == indices[1]);
+		ASSERT(stats[0].surface_chunks == stats[1].surface_chunks);
+		for (size_t i = 0; i != vertices[0].size(); ++i)
+		{
+			const float3 d = vertices[0][i].pos - vertices[1][i].pos;
+			ASSERT(d.length() < 1e-5f);
+		}
+	}
+
+	void TestRays()
+	{
+		SdfTree tree;
+		SdfProgram program;
+		ball(tree, program);
+		SparseVolume volume;
+		volume.build(program, ball_box(), c_cell, 2 * c_band, volume_half);
+
+		// along an axis onto the ball, past it, and short of it
+		const ray onto = { float3(0, 0, -3), 0, float3(0, 0, 1), FLT_MAX };
+		hit h;
+		ASSERT(volume.intersect(onto, h) && std::abs(h.t - 2) < 1e-3f && volume.occluded(onto));
+		ASSERT(h.triangle != c_no_hit && h.instance == c_no_hit);
+		ASSERT(dot(volume.normal(float3(0, 0, -1)), float3(0, 0, -1)) > 0.999f);
+		const ray past = { float3(0, 1.2f, -3), 0, float3(0, 0, 1), FLT_MAX };
+		const ray short_of = { float3(0, 0, -3), 0, float3(0, 0, 1), 1.9f };
+		ASSERT(!volume.intersect(past, h) && !volume.occluded(past) && !volume.occluded(short_of));
+
+		// from within, out, with a direction not of unit length
+		const ray out = { float3(0.2f, 0, 0), 0, float3(0, 3, 4), FLT_MAX };
+		ASSERT(volume.intersect(out, h));
+		const float3 at = out.origin + out.direction * h.t;
+		ASSERT(std::abs(at.length() - 1) < 1e-3f);
+
+		// packets as the rays one at a time, against the exact ball
+		unsigned int seed = 11;
+		for (int i = 0; i != 16; ++i)
+		{
+			ray8 packet;
+			ray single[c_packet_width];
+			for (size_t lane = 0; lane != c_packet_width; ++lane)
+			{
+				const float3 from = normalize(random_point(seed, 1)) * 3;
+				const float3 to = random_point(seed, 1.2f);
+				const ray r = { from, 0, to - from, lane == 3 ? 0.3f : FLT_MAX };
+				single[lane] = r;
+				packet.origin.x[lane] = r.origin.x;
+				packet.origin.y[lane] = r.origin.y;
+				packet.origin.z[lane] = r.origin.z;
+				packet.direction.x[lane] = r.direction.x;
+				packet.direction.y[lane] = r.direction.y;
+				packet.direction.z[lane] = r.direction.z;
+				packet.tmin[lane] = r.tmin;
+				packet.tmax[lane] = r.tmax;
+			}
+			hit8 hits;
+			volume.intersect(packet, hits);
+			const int blocked = volume.occluded(packet);
+			for (size_t lane = 0; lane != c_packet_width; ++lane)
+			{
+				hit one;
+				const bool found = volume.intersect(single[lane], one);
+				ASSERT(found == (hits.triangle[lane] != c_no_hit) && found == ((blocked >> lane & 1) != 0));
+				if (found)
+				{
+					ASSERT(hits.t[lane] == one.t && hits.triangle[lane] == one.triangle);
+					const float3 p = single[lane].origin + single[lane].direction * one.t;
+					ASSERT(std::abs(p.length() - 1) < 1e-3f);
+				}
+				else
+				{
+					ASSERT(hits.t[lane] == single[lane].tmax);
+				}
+			}
+		}
+
+		// marched as a distance, the depths of the program's but at the rim,
+		// where a ray grazing the ball takes a hit within the tolerance a
+		// step early or late; the band wider than the distance of a hit
+		camera view;
+		view.eye = float3(1, 2, -4);
+		view.target = float3(0, 0, 0);
+		view.up = float3(0, 1, 0);
+		view.fov = 1.0f;
+		RayMarcher marchers[2] = { RayMarcher(program, 96, 64), RayMarcher(volume, 96, 64) };
+		for (int i = 0; i != 2; ++i)
+		{
+			marchers[i].set_camera(view);
+			marchers[i].render();
+		}
+		size_t hits_seen = 0, wrong = 0;
+		for (size_t i = 0; i != 96 * 64; ++i)
+		{
+			const float a = marchers[0].depth()[i];
+			const float b = marchers[1].depth()[i];
+			hits_seen += a != FLT_MAX;
+			if ((a == FLT_MAX) != (b == FLT_MAX) || (a != FLT_MAX && std::abs(a - b) > 0.05f))
+			{
+				++wrong;
+			}
+		}
+		ASSERT(hits_seen > 400 && wrong * 20 < hits_seen);
+	}
+};
+
+REGISTER_FIXTURE(SparseVolumeTest);
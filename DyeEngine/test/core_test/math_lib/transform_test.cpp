@@ -0,0 +1,95 @@
+#include "UnitTest.h"
+#include "transform.hpp"
+
+#include <vector>
+
+using namespace UnitTest;
+using namespace Dye;
+
+class TransformTest : public TestFixture<TransformTest>
+{
+public:
+	TEST_FIXTURE( TransformTest )
+	{
+		TEST_CASE(TestPoints);
+		TEST_CASE(TestNormals);
+		TEST_CASE(TestVertices);
+	}
+
+private:
+	static float4x4 Matrix()
+	{
+		return float4x4(
+			 2,  0,  0,  0,
+			 0,  0,  3,  0,
+			 0, -1,  0,  0,
+			 5,  6,  7,  1);
+	}
+
+	void TestPoints()
+	{
+		const size_t n = 37;
+		std::vector<float3> points(n);
+		for (size_t i = 0; i != n; ++i)
+		{
+			points[i] = float3(float(i), float(i) * 0.5f, -float(i));
+		}
+
+		std::vector<float3> result(n);
+		transform_points(Matrix(), &points[0], &result[0], n);
+		transform_points(Matrix(), &points[0], &points[0], n);
+
+		bool equal = true;
+		for (size_t i = 0; i != n; ++i)
+		{
+			float4 expected = mul(float4(float(i), float(i) * 0.5f, -float(i), 1), Matrix());
+			for (size_t j = 0; j != 3; ++j)
+			{
+				equal &= std::abs(result[i][j] - expected[j]) < 1e-4f;
+				equal &= points[i][j] == result[i][j];
+			}
+		}
+		ASSERT(equal);
+	}
+
+	void TestNormals()
+	{
+		float3 normal(1, 1, 0);
+		float3 tangent(1, -1, 0);
+		normal.normalize();
+
+		float3 result;
+		transform_normals(Matrix(), &normal, &result, 1);
+
+		float4 tangent4 = mul(float4(tangent.x, tangent.y, tangent.z, 0), Matrix());
+		ASSERT_EQUALS(result.length(), 1.0f);
+		ASSERT_EQUALS(dot(result, tangent4.xyz()), 0.0f);
+	}
+
+	void TestVertices()
+	{
+		const size_t n = 9;
+		std::vector<Graphics::vertex> vertices(n);
+		for (size_t i = 0; i != n; ++i)
+		{
+			vertices[i].pos = float3(float(i), 1, 2);
+			vertices[i].normal = float3(0, 0, 1);
+			vertices[i].tex = float2(0.25f, float(i));
+		}
+
+		transform_vertices(Matrix(), &vertices[0], n);
+
+		bool equal = true;
+		for (size_t i = 0; i != n; ++i)
+		{
+			equal &= vertices[i].pos.x == 2 * float(i) + 5;
+			equal &= vertices[i].pos.y == 4;
+			equal &= vertices[i].pos.z == 10;
+			equal &= vertices[i].normal.y == -1;
+			equal &= vertices[i].tex.x == 0.25f && vertices[i].tex.y == float(i);
+		}
+		ASSERT(equal);
+	}
+};
+
+REGISTER_FIXTURE(TransformTest);
@@ -16,6 +16,8 @@ public:
 		TEST_CASE(TestCrossProduct);
 		TEST_CASE(TestPiecewiseProduct);
 		TEST_CASE(TestSwizzle);
+		TEST_CASE(TestNormalize);
+		TEST_CASE(TestExpression);
 		TEST_CASE(TestGeneral);
 	}
 
@@ -92,6 +94,36 @@ private:
 		ASSERT_EQUALS(vec3.z, 2);
 	}
 
+	void TestNormalize()
+	{
+		float4 vec1(3, 5, 7, 9);
+		float4 vec2 = vec1 - float4(3, 5, 7, 5);
+		ASSERT_EQUALS(vec2.w, 4);
+		ASSERT_EQUALS(vec2.length(), 4);
+
+		float4 vec3 = normalize(float4(1, 1, 1, 1));
+		ASSERT_EQUALS(vec3.x, 0.5f);
+		ASSERT_EQUALS(vec3.w, 0.5f);
+		ASSERT_EQUALS(dot(vec3, vec3), 1.0f);
+	}
+
+	void TestExpression()
+	{
+		float3 vec1(1, 2, 3);
+		float3 vec2(0, 1, 0);
+		float3 vec3(4, 4, 4);
+
+		float3 vec4 = vec1 * 2 + vec2 * 3 - vec3;
+		ASSERT_EQUALS(vec4.x, -2);
+		ASSERT_EQUALS(vec4.y, 3);
+		ASSERT_EQUALS(vec4.z, 2);
+
+		vec4 = -(vec1 + vec2) / 2;
+		ASSERT_EQUALS(vec4.y, -1.5f);
+		ASSERT_EQUALS(dot(vec1 - vec2, vec3), 20);
+		ASSERT_EQUALS(normalize(vec3 - vec1 - vec2).length(), 1.0f);
+	}
+
 	void TestGeneral()
 	{
 		float3 vec1(1, 2, 3);
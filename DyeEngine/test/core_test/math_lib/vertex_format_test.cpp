@@ -0,0 +1,184 @@
+#include "UnitTest.h"
+#include "vertex_format.hpp"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace UnitTest;
+using namespace Dye;
+using namespace Dye::Graphics;
+
+class VertexFormatTest : public TestFixture<VertexFormatTest>
+{
+public:
+	TEST_FIXTURE( VertexFormatTest )
+	{
+		TEST_CASE(TestHalf);
+		TEST_CASE(TestOctahedral);
+		TEST_CASE(TestPack16);
+		TEST_CASE(TestPack12);
+		TEST_CASE(TestVertexArray);
+	}
+
+private:
+	static std::vector<vertex> Vertices(size_t n)
+	{
+		std::vector<vertex> vertices(n);
+		for (size_t i = 0; i != n; ++i)
+		{
+			float t = float(i);
+			vertex &v = vertices[i];
+			v.pos = float3(std::sin(t) * 3, 10 + std::cos(t * 0.7f), -2 + 0.01f * t);
+			v.normal = normalize(float3(std::sin(t * 1.3f), std::cos(t * 2.1f), std::sin(t * 0.4f) - 0.3f));
+			v.tex = float2(t / n, 1 - 0.5f * t / n);
+		}
+		// the poles and the folded edge of the octahedron
+		vertices[0].normal = float3(0, 0, 1);
+		vertices[1].normal = float3(0, 0, -1);
+		vertices[2].normal = float3(1, 0, 0);
+		vertices[3].normal = float3(0, -1, 0);
+		return vertices;
+	}
+
+	// the angle between the directions is below 1e-4
+	static bool SameDirection(const float3 &lhs, const float3 &rhs)
+	{
+		return dot(lhs, rhs) > 0 && cross(lhs, rhs).length() < 1e-4f;
+	}
+
+	// largest position error per axis, as a fraction of the bounds
+	static bool Check(const std::vector<vertex> &in, const std::vector<vertex> &out, float3 tolerance)
+	{
+		vertex_bounds bounds = compute_bounds(&in[0], in.size());
+		float3 extent = bounds.upper - bounds.lower;
+
+		bool equal = true;
+		for (size_t i = 0; i != in.size(); ++i)
+		{
+			equal &= std::abs(out[i].pos.x - in[i].pos.x) <= tolerance.x * extent.x;
+			equal &= std::abs(out[i].pos.y - in[i].pos.y) <= tolerance.y * extent.y;
+			equal &= std::abs(out[i].pos.z - in[i].pos.z) <= tolerance.z * extent.z;
+			equal &= SameDirection(out[i].normal, in[i].normal);
+			equal &= std::abs(out[i].normal.length() - 1) < 1e-5f;
+			equal &= std::abs(out[i].tex.x - in[i].tex.x) <= in[i].tex.x / 2048;
+			equal &= std::abs(out[i].tex.y - in[i].tex.y) <= in[i].tex.y / 2048;
+		}
+		return equal;
+	}
+
+	void TestHalf()
+	{
+		ASSERT(half_from_float(1.0f) == 0x3c00);
+		ASSERT(half_from_float(-2.0f) == 0xc000);
+		ASSERT(half_from_float(65504.0f) == 0x7bff);
+		ASSERT(half_from_float(1e6f) == 0x7c00);
+		ASSERT(half_from_float(std::numeric_limits<float>::infinity()) == 0x7c00);
+		ASSERT((half_from_float(std::numeric_limits<float>::quiet_NaN()) & 0x7e00) == 0x7e00);
+
+		// ties to even: 1 + 2^-11 down to 1, 1 + 3 * 2^-11 up to 1 + 2^-9
+		ASSERT(half_from_float(1 + std::ldexp(1.0f, -11)) == 0x3c00);
+		ASSERT(half_from_float(1 + 3 * std::ldexp(1.0f, -11)) == 0x3c02);
+
+		// the smallest denormal
+		ASSERT(half_from_float(std::ldexp(1.0f, -24)) == 0x0001);
+		ASSERT(half_to_float(0x0001) == std::ldexp(1.0f, -24));
+
+		// every finite half survives the round trip
+		bool equal = true;
+		for (unsigned int h = 0; h != 0x10000; ++h)
+		{
+			if ((h & 0x7c00) != 0x7c00)
+			{
+				equal &= half_from_float(half_to_float(static_cast<unsigned short>(h))) == h;
+			}
+		}
+		ASSERT(equal);
+		ASSERT(half_to_float(0x7c00) == std::numeric_limits<float>::infinity());
+		ASSERT(half_to_float(0x7e00) != half_to_float(0x7e00));
+	}
+
+	void TestOctahedral()
+	{
+		bool equal = true;
+		for (int i = 0; i != 200; ++i)
+		{
+			float theta = 0.031f * i;
+			float phi = 0.173f * i;
+			float3 n(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+
+			short x, y;
+			oct_encode(n, x, y);
+			equal &= SameDirection(oct_decode(x, y), n);
+		}
+		ASSERT(equal);
+
+		short x, y;
+		oct_encode(float3(0, 0, -1), x, y);
+		ASSERT(dot(oct_decode(x, y), float3(0, 0, -1)) > 0.99999f);
+	}
+
+	void TestPack16()
+	{
+		// a multiple of 4 plus a tail
+		std::vector<vertex> in = Vertices(39);
+		vertex_bounds bounds = compute_bounds(&in[0], in.size());
+
+		std::vector<packed_vertex16> packed(in.size());
+		std::vector<vertex> out(in.size());
+		pack(&in[0], &packed[0], in.size(), bounds);
+		unpack(&packed[0], &out[0], in.size(), bounds);
+
+		ASSERT(sizeof(packed_vertex16) == 16);
+		ASSERT(Check(in, out, float3(1, 1, 1) / 120000));
+		ASSERT(packed[0].reserved == 0);
+	}
+
+	void TestPack12()
+	{
+		std::vector<vertex> in = Vertices(39);
+		vertex_bounds bounds = compute_bounds(&in[0], in.size());
+
+		std::vector<packed_vertex12> packed(in.size());
+		std::vector<vertex> out(in.size());
+		pack(&in[0], &packed[0], in.size(), bounds);
+		unpack(&packed[0], &out[0], in.size(), bounds);
+
+		ASSERT(sizeof(packed_vertex12) == 12);
+		ASSERT(Check(in, out, float3(1.0f / 4000, 1.0f / 4000, 1.0f / 2000)));
+
+		// the bounds map to the ends of the ranges
+		bool ends = true;
+		for (size_t i = 0; i != in.size(); ++i)
+		{
+			ends &= (in[i].pos.x == bounds.lower.x) == ((packed[i].pos & 0x7ff) == 0);
+			ends &= (in[i].pos.z == bounds.upper.z) == ((packed[i].pos >> 22) == 1023);
+		}
+		ASSERT(ends);
+	}
+
+	void TestVertexArray()
+	{
+		std::vector<vertex> in = Vertices(10000);
+
+		vertex_array<vertex> plain(&in[0], in.size());
+		vertex_array<packed_vertex16> packed16(&in[0], in.size());
+		vertex_array<packed_vertex12> packed12(&in[0], in.size());
+
+		ASSERT(plain.byte_size() == in.size() * 32);
+		ASSERT(packed16.byte_size() == in.size() * 16);
+		ASSERT(packed12.byte_size() == in.size() * 12);
+
+		std::vector<vertex> out(in.size());
+		packed16.decode(0, in.size(), &out[0]);
+		ASSERT(Check(in, out, float3(1, 1, 1) / 120000));
+
+		vertex v = plain[123];
+		ASSERT(v.pos.x == in[123].pos.x && v.normal.y == in[123].normal.y && v.tex.x == in[123].tex.x);
+		v = packed12[9999];
+		ASSERT(std::abs(v.pos.z - in[9999].pos.z) < 1e-3f);
+		ASSERT(packed12.bounds().upper.y == compute_bounds(&in[0], in.size()).upper.y);
+	}
+};
+
+REGISTER_FIXTURE(VertexFormatTest);
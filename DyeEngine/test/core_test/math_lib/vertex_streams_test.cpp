@@ -0,0 +1,140 @@
+#include "UnitTest.h"
+#include "vertex_streams.hpp"
+#include "cpu_dispatch.hpp"
+
+#include <string.h>
+#include <vector>
+
+using namespace UnitTest;
+using namespace Dye;
+using namespace Dye::Graphics;
+
+class VertexStreamsTest : public TestFixture<VertexStreamsTest>
+{
+public:
+	TEST_FIXTURE( VertexStreamsTest )
+	{
+		TEST_CASE(TestLayout);
+		TEST_CASE(TestRoundTrip);
+		TEST_CASE(TestView);
+	}
+
+private:
+	static std::vector<vertex> make_vertices(size_t n)
+	{
+		std::vector<vertex> vertices(n);
+		for (size_t i = 0; i != n; ++i)
+		{
+			float f = static_cast<float>(i);
+			vertices[i].pos = float3(f, f + 0.25f, -f);
+			vertices[i].normal = float3(f * 2, 1 - f, 0.5f);
+			vertices[i].tex = float2(f * 0.125f, 3 + f);
+		}
+		return vertices;
+	}
+
+	static bool same(const vertex &a, const vertex &b)
+	{
+		return a.pos.x == b.pos.x && a.pos.y == b.pos.y && a.pos.z == b.pos.z
+			&& a.normal.x == b.normal.x && a.normal.y == b.normal.y && a.normal.z == b.normal.z
+			&& a.tex.x == b.tex.x && a.tex.y == b.tex.y;
+	}
+
+	void TestLayout()
+	{
+		ASSERT(sizeof(vertex) == stream_count * sizeof(float));
+		ASSERT(stream_stride(0) == 0);
+		ASSERT(stream_stride(1) == 16);
+		ASSERT(stream_stride(17) == 32);
+		ASSERT(streams_byte_size(17) == stream_count * 32 * sizeof(float));
+
+		VertexStreamsSoA soa(37);
+		bool aligned = true;
+		for (int s = 0; s != stream_count; ++s)
+		{
+			aligned &= reinterpret_cast<size_t>(soa.stream(static_cast<vertex_stream>(s))) % c_stream_alignment == 0;
+		}
+		ASSERT(aligned);
+		ASSERT(soa.stream(stream_normal_x) == soa.stream(stream_pos_x) + 3 * stream_stride(37));
+
+		VertexStreamsSoA copy(soa);
+		copy = VertexStreamsSoA(5);
+		ASSERT(copy.size() == 5);
+		ASSERT(reinterpret_cast<size_t>(copy.data()) % c_stream_alignment == 0);
+	}
+
+	void TestRoundTrip()
+	{
+		// a tail on every kernel, and more than one block
+		const size_t sizes[] = { 0, 1, 7, 37, 5003 };
+
+		cpu_level initial = active_cpu_level();
+		bool equal = true;
+		for (int l = cpu_scalar; l <= detected_cpu_level(); ++l)
+		{
+			set_cpu_level(static_cast<cpu_level>(l));
+
+			for (size_t t = 0; t != sizeof(sizes) / sizeof(sizes[0]); ++t)
+			{
+				std::vector<vertex> in = make_vertices(sizes[t]);
+				VertexStreamsSoA soa(in);
+				equal &= soa.size() == in.size();
+
+				for (size_t i = 0; i != in.size(); ++i)
+				{
+					equal &= soa.stream(stream_pos_y)[i] == in[i].pos.y;
+					equal &= soa.stream(stream_normal_z)[i] == in[i].normal.z;
+					equal &= soa.stream(stream_tex_u)[i] == in[i].tex.x;
+				}
+
+				std::vector<vertex> out;
+				to_aos(soa.view(), out);
+				equal &= out.size() == in.size();
+				for (size_t i = 0; i != in.size(); ++i)
+				{
+					equal &= same(out[i], in[i]);
+				}
+			}
+		}
+		set_cpu_level(initial);
+		ASSERT(equal);
+	}
+
+	void TestView()
+	{
+		const size_t n = 21;
+		std::vector<vertex> in = make_vertices(n);
+		VertexStreamsSoA soa(in);
+
+		// as a mapped file would hand it over
+		std::vector<float> buffer(streams_byte_size(n) / sizeof(float) + 16);
+		float *base = &buffer[0];
+		while (reinterpret_cast<size_t>(base) % c_stream_alignment)
+		{
+			++base;
+		}
+		memcpy(base, soa.data(), streams_byte_size(n));
+
+		VertexStreamsView view(base, n);
+		ASSERT(view.size() == n);
+		ASSERT(view.stream(stream_tex_v) == base + stream_tex_v * stream_stride(n));
+		ASSERT(same(view[9], in[9]));
+
+		const float *streams[stream_count];
+		for (int s = 0; s != stream_count; ++s)
+		{
+			streams[s] = view.stream(static_cast<vertex_stream>(s));
+		}
+		std::vector<vertex> out(n);
+		to_aos(VertexStreamsView(streams, n), &out[0]);
+
+		bool equal = true;
+		for (size_t i = 0; i != n; ++i)
+		{
+			equal &= same(out[i], in[i]);
+		}
+		ASSERT(equal);
+	}
+};
+
+REGISTER_FIXTURE(VertexStreamsTest);
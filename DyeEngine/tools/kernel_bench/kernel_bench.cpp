@@ -0,0 +1,385 @@
+// measures the ray intersection kernels of intersect.hpp in millions of
+// ray and primitive pairs tested per second, on one thread.
+//
+//   kernel_bench [<seconds per kernel>]
+//
+// every kernel tests the same random rays through the unit cube against
+// the same random boxes, triangles and spheres in it. a few percent of the
+// pairs hit, about as many as in the leaves a tree descends to.
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <omp.h>
+
+#include <intersect.hpp>
+
+using namespace Dye;
+using namespace Dye::Graphics;
+
+namespace
+{
+	const size_t c_rays = 1024;
+	const size_t c_primitives = 64;
+
+	float random(unsigned int &seed)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return static_cast<float>(seed >> 8) / (1 << 24);
+	}
+
+	float3 random_point(unsigned int &seed)
+	{
+		return float3(random(seed) * 2 - 1, random(seed) * 2 - 1, random(seed) * 2 - 1);
+	}
+
+	void set_lane(float3x8 &v, size_t lane, const float3 &p)
+	{
+		v.x[lane] = p.x;
+		v.y[lane] = p.y;
+		v.z[lane] = p.z;
+	}
+
+	// the 8 wide types in arrays, a vector does not keep their alignment
+	struct scene
+	{
+		std::vector<ray> rays;
+		ray8 packets[c_rays / c_packet_width];
+		std::vector<float3> inv;
+		float3x8 inv8[c_rays / c_packet_width];
+		std::vector<ray_shear> shears;
+		ray_shear8 shears8[c_rays / c_packet_width];
+
+		std::vector<float3> lower;
+		std::vector<float3> upper;
+		aabb4 boxes4[c_primitives / 4];
+		aabb8 boxes8[c_primitives / 8];
+
+		std::vector<float3> v0;
+		std::vector<float3> v1;
+		std::vector<float3> v2;
+		triangle8 triangles8[c_primitives / 8];
+
+		std::vector<float3> centers;
+		std::vector<float> radii;
+		sphere8 spheres8[c_primitives / 8];
+	};
+
+	void make_scene(scene &s)
+	{
+		unsigned int seed = 2024;
+		s.rays.resize(c_rays);
+		s.inv.resize(c_rays);
+		s.shears.resize(c_rays);
+		for (size_t i = 0; i != c_rays; ++i)
+		{
+			float3 from = random_point(seed);
+			from = from * (3 / sqrt(dot(from, from)));
+			float3 to = random_point(seed);
+			ray r = { from, 0, to - from, FLT_MAX };
+			s.rays[i] = r;
+			s.inv[i] = reciprocal(r.direction);
+			s.shears[i] = watertight_shear(r.direction);
+		}
+		for (size_t i = 0; i != c_rays / c_packet_width; ++i)
+		{
+			load_packet(&s.rays[i * c_packet_width], c_packet_width, s.packets[i]);
+			s.inv8[i] = reciprocal(s.packets[i].direction);
+			s.shears8[i] = watertight_shear(s.packets[i].direction);
+		}
+
+		for (size_t i = 0; i != c_primitives; ++i)
+		{
+			float3 center = random_point(seed) * 0.7f;
+			float3 size(random(seed), random(seed), random(seed));
+			s.lower.push_back(center - size * 0.4f);
+			s.upper.push_back(center + size * 0.4f);
+			for (int k = 0; k != 3; ++k)
+			{
+				s.boxes4[i / 4].lower[k][i % 4] = s.lower[i][k];
+				s.boxes4[i / 4].upper[k][i % 4] = s.upper[i][k];
+			}
+			set_lane(s.boxes8[i / 8].lower, i % 8, s.lower[i]);
+			set_lane(s.boxes8[i / 8].upper, i % 8, s.upper[i]);
+
+			s.v0.push_back(center + random_point(seed) * 0.8f);
+			s.v1.push_back(center + random_point(seed) * 0.8f);
+			s.v2.push_back(center + random_point(seed) * 0.8f);
+			set_lane(s.triangles8[i / 8].v0, i % 8, s.v0[i]);
+			set_lane(s.triangles8[i / 8].v1, i % 8, s.v1[i]);
+			set_lane(s.triangles8[i / 8].v2, i % 8, s.v2[i]);
+
+			s.centers.push_back(center);
+			s.radii.push_back(0.1f + random(seed) * 0.3f);
+			set_lane(s.spheres8[i / 8].center, i % 8, center);
+			s.spheres8[i / 8].radius[i % 8] = s.radii[i];
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// kernels
+	//
+	// each runs every ray against every primitive once and returns the
+	// pairs that hit, which also keeps the compiler from dropping the work.
+	//////////////////////////////////////////////////////////////////////////
+	size_t box_single(const scene &s)
+	{
+		size_t found = 0;
+		for (size_t r = 0; r != c_rays; ++r)
+		{
+			for (size_t b = 0; b != c_primitives; ++b)
+			{
+				float entry;
+				found += intersect_box(s.lower[b], s.upper[b], s.rays[r].origin, s.inv[r], 0, FLT_MAX, entry);
+			}
+		}
+		return found;
+	}
+
+	int bits(int mask)
+	{
+		int count = 0;
+		for (; mask; mask &= mask - 1)
+		{
+			++count;
+		}
+		return count;
+	}
+
+	size_t box_1x4(const scene &s)
+	{
+		size_t found = 0;
+		for (size_t r = 0; r != c_rays; ++r)
+		{
+			for (size_t b = 0; b != c_primitives / 4; ++b)
+			{
+				float entries[4];
+				found += bits(intersect_boxes(s.boxes4[b], s.rays[r].origin, s.inv[r], 0, FLT_MAX, entries));
+			}
+		}
+		return found;
+	}
+
+	size_t box_1x8(const scene &s)
+	{
+		size_t found = 0;
+		for (size_t r = 0; r != c_rays; ++r)
+		{
+			for (size_t b = 0; b != c_primitives / 8; ++b)
+			{
+				float8 entries;
+				found += bits(intersect_boxes(s.boxes8[b], s.rays[r].origin, s.inv[r], 0, FLT_MAX, entries));
+			}
+		}
+		return found;
+	}
+
+	size_t box_packet(const scene &s)
+	{
+		size_t found = 0;
+		for (size_t p = 0; p != c_rays / c_packet_width; ++p)
+		{
+			const ray8 &r = s.packets[p];
+			for (size_t b = 0; b != c_primitives; ++b)
+			{
+				float8 entry;
+				found += bits(movemask(intersect_box(s.lower[b], s.upper[b], r.origin, s.inv8[p], r.tmin, r.tmax, entry)));
+			}
+		}
+		return found;
+	}
+
+	size_t triangle_single(const scene &s)
+	{
+		size_t found = 0;
+		for (size_t r = 0; r != c_rays; ++r)
+		{
+			for (size_t i = 0; i != c_primitives; ++i)
+			{
+				float t, u, v;
+				found += intersect_triangle(s.v0[i], s.v1[i], s.v2[i], s.rays[r].origin, s.rays[r].direction,
+					0, FLT_MAX, t, u, v);
+			}
+		}
+		return found;
+	}
+
+	size_t triangle_1x8(const scene &s)
+	{
+		size_t found = 0;
+		for (size_t r = 0; r != c_rays; ++r)
+		{
+			for (size_t i = 0; i != c_primitives / 8; ++i)
+			{
+				float8 t, u, v;
+				found += bits(intersect_triangles(s.triangles8[i], s.rays[r].origin, s.rays[r].direction,
+					0, FLT_MAX, t, u, v));
+			}
+		}
+		return found;
+	}
+
+	size_t triangle_packet(const scene &s)
+	{
+		size_t found = 0;
+		for (size_t p = 0; p != c_rays / c_packet_width; ++p)
+		{
+			const ray8 &r = s.packets[p];
+			for (size_t i = 0; i != c_primitives; ++i)
+			{
+				float8 t, u, v;
+				found += bits(movemask(intersect_triangle(s.v0[i], s.v1[i], s.v2[i], r.origin, r.direction,
+					r.tmin, r.tmax, t, u, v)));
+			}
+		}
+		return found;
+	}
+
+	size_t watertight_single(const scene &s)
+	{
+		size_t found = 0;
+		for (size_t r = 0; r != c_rays; ++r)
+		{
+			for (size_t i = 0; i != c_primitives; ++i)
+			{
+				float t, u, v;
+				found += intersect_triangle(s.v0[i], s.v1[i], s.v2[i], s.rays[r].origin, s.shears[r],
+					0, FLT_MAX, t, u, v);
+			}
+		}
+		return found;
+	}
+
+	size_t watertight_1x8(const scene &s)
+	{
+		size_t found = 0;
+		for (size_t r = 0; r != c_rays; ++r)
+		{
+			for (size_t i = 0; i != c_primitives / 8; ++i)
+			{
+				float8 t, u, v;
+				found += bits(intersect_triangles(s.triangles8[i], s.rays[r].origin, s.shears[r],
+					0, FLT_MAX, t, u, v));
+			}
+		}
+		return found;
+	}
+
+	size_t watertight_packet(const scene &s)
+	{
+		size_t found = 0;
+		for (size_t p = 0; p != c_rays / c_packet_width; ++p)
+		{
+			const ray8 &r = s.packets[p];
+			for (size_t i = 0; i != c_primitives; ++i)
+			{
+				float8 t, u, v;
+				found += bits(movemask(intersect_triangle(s.v0[i], s.v1[i], s.v2[i], r.origin, s.shears8[p],
+					r.tmin, r.tmax, t, u, v)));
+			}
+		}
+		return found;
+	}
+
+	size_t sphere_single(const scene &s)
+	{
+		size_t found = 0;
+		for (size_t r = 0; r != c_rays; ++r)
+		{
+			for (size_t i = 0; i != c_primitives; ++i)
+			{
+				float t;
+				found += intersect_sphere(s.centers[i], s.radii[i], s.rays[r].origin, s.rays[r].direction,
+					0, FLT_MAX, t);
+			}
+		}
+		return found;
+	}
+
+	size_t sphere_1x8(const scene &s)
+	{
+		size_t found = 0;
+		for (size_t r = 0; r != c_rays; ++r)
+		{
+			for (size_t i = 0; i != c_primitives / 8; ++i)
+			{
+				float8 t;
+				found += bits(intersect_spheres(s.spheres8[i], s.rays[r].origin, s.rays[r].direction, 0, FLT_MAX, t));
+			}
+		}
+		return found;
+	}
+
+	size_t sphere_packet(const scene &s)
+	{
+		size_t found = 0;
+		for (size_t p = 0; p != c_rays / c_packet_width; ++p)
+		{
+			const ray8 &r = s.packets[p];
+			for (size_t i = 0; i != c_primitives; ++i)
+			{
+				float8 t;
+				found += bits(movemask(intersect_sphere(s.centers[i], s.radii[i], r.origin, r.direction,
+					r.tmin, r.tmax, t)));
+			}
+		}
+		return found;
+	}
+
+	typedef size_t (*kernel)(const scene &s);
+
+	// repeats the kernel for about the given time
+	void measure(const char *name, kernel k, const scene &s, double seconds)
+	{
+		size_t found = k(s);
+		double start = omp_get_wtime();
+		double elapsed = 0;
+		size_t runs = 0;
+		while (elapsed < seconds)
+		{
+			found += k(s);
+			++runs;
+			elapsed = omp_get_wtime() - start;
+		}
+		const double pairs = static_cast<double>(c_rays) * c_primitives;
+		printf("  %-18s %10.1f m/s, %4.1f%% hit\n", name, pairs * runs / elapsed * 1e-6,
+			100.0 * found / (pairs * (runs + 1)));
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	double seconds = argc == 2 ? atof(argv[1]) : 0.5;
+	if (argc > 2 || seconds <= 0)
+	{
+		fprintf(stderr, "usage: kernel_bench [<seconds per kernel>]\n");
+		return 1;
+	}
+
+	static scene s;
+	make_scene(s);
+
+	printf("boxes\n");
+	measure("single", box_single, s, seconds);
+	measure("1 ray, 4 boxes", box_1x4, s, seconds);
+	measure("1 ray, 8 boxes", box_1x8, s, seconds);
+	measure("8 rays, 1 box", box_packet, s, seconds);
+
+	printf("triangles, moller trumbore\n");
+	measure("single", triangle_single, s, seconds);
+	measure("1 ray, 8 triangles", triangle_1x8, s, seconds);
+	measure("8 rays, 1 triangle", triangle_packet, s, seconds);
+
+	printf("triangles, watertight\n");
+	measure("single", watertight_single, s, seconds);
+	measure("1 ray, 8 triangles", watertight_1x8, s, seconds);
+	measure("8 rays, 1 triangle", watertight_packet, s, seconds);
+
+	printf("spheres\n");
+	measure("single", sphere_single, s, seconds);
+	measure("1 ray, 8 spheres", sphere_1x8, s, seconds);
+	measure("8 rays, 1 sphere", sphere_packet, s, seconds);
+	return 0;
+}
@@ -0,0 +1,617 @@
+// converts text meshes to the mapped mesh file format (see mesh_file.hpp)
+// and measures how long the two take to load.
+//
+//   mesh_tool convert <in.obj> <out.dmesh>
+//   mesh_tool bench <mesh.dmesh> [<mesh.obj>]
+//   mesh_tool trace <mesh.dmesh>
+//   mesh_tool render <mesh.dmesh> [<passes> [<out.pfm>]]
+//
+// wavefront obj is read with positions, normals, uvs and polygons, which
+// are split into fans. corners that share all three indices become one
+// vertex, and corners without a normal get the area weighted normal of
+// their faces. convert welds and reorders the mesh (see mesh.hpp),
+// reports the vertex cache miss ratio before and after, and stores a chain
+// of simplified levels with it (see simplify.hpp). trace builds the sah
+// and the linear bvh over the full level (see bvh.hpp), measures the rays
+// per second of a view from a corner of the bounds through both and times
+// a refit. render path traces the full level on a floor under a square
+// light (see path_tracer.hpp), reports the samples and rays per second and
+// may write the image as a portable float map.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <omp.h>
+
+#include <bvh.hpp>
+#include <mesh.hpp>
+#include <mesh_file.hpp>
+#include <path_tracer.hpp>
+#include <simplify.hpp>
+
+using namespace Dye;
+using namespace Dye::Graphics;
+using namespace Dye::Render;
+
+namespace
+{
+	//////////////////////////////////////////////////////////////////////////
+	// obj reader
+	//////////////////////////////////////////////////////////////////////////
+
+	// 0 based indices of a face corner, -1 where missing
+	struct corner
+	{
+		int pos;
+		int tex;
+		int normal;
+
+		bool operator < (const corner &rhs) const
+		{
+			if (pos != rhs.pos) return pos < rhs.pos;
+			if (tex != rhs.tex) return tex < rhs.tex;
+			return normal < rhs.normal;
+		}
+	};
+
+	bool read_file(const char *path, std::vector<char> &text)
+	{
+		FILE *file = fopen(path, "rb");
+		if (!file)
+		{
+			return false;
+		}
+
+		char buffer[1 << 16];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) != 0)
+		{
+			text.insert(text.end(), buffer, buffer + read);
+		}
+		fclose(file);
+		text.push_back('\0');
+		return true;
+	}
+
+	// one index of a corner, negative ones count back from the end
+	int parse_index(const char *&s, size_t count)
+	{
+		char *end;
+		long index = strtol(s, &end, 10);
+		if (end == s)
+		{
+			return -1;
+		}
+		s = end;
+		return static_cast<int>(index < 0 ? static_cast<long>(count) + index : index - 1);
+	}
+
+	bool parse_corner(const char *&s, const std::vector<float3> &positions, const std::vector<float2> &uvs,
+		const std::vector<float3> &normals, corner &c)
+	{
+		while (*s == ' ' || *s == '\t')
+		{
+			++s;
+		}
+
+		c.pos = parse_index(s, positions.size());
+		c.tex = c.normal = -1;
+		if (c.pos < 0 || c.pos >= static_cast<int>(positions.size()))
+		{
+			return false;
+		}
+
+		if (*s == '/')
+		{
+			++s;
+			if (*s != '/')
+			{
+				c.tex = parse_index(s, uvs.size());
+			}
+			if (*s == '/')
+			{
+				++s;
+				c.normal = parse_index(s, normals.size());
+			}
+		}
+		if (c.tex >= static_cast<int>(uvs.size()))
+		{
+			c.tex = -1;
+		}
+		if (c.normal >= static_cast<int>(normals.size()))
+		{
+			c.normal = -1;
+		}
+		return true;
+	}
+
+	bool read_obj(const char *path, std::vector<vertex> &vertices, std::vector<unsigned int> &indices)
+	{
+		std::vector<char> text;
+		if (!read_file(path, text))
+		{
+			return false;
+		}
+
+		std::vector<float3> positions;
+		std::vector<float2> uvs;
+		std::vector<float3> normals;
+		std::map<corner, unsigned int> corners;
+		std::vector<bool> generated;
+
+		const char *s = &text[0];
+		while (*s)
+		{
+			const char *line = s;
+			while (*s && *s != '\n')
+			{
+				++s;
+			}
+			const char *next = *s ? s + 1 : s;
+
+			char *end;
+			if (line[0] == 'v' && line[1] == ' ')
+			{
+				float x = static_cast<float>(strtod(line + 2, &end));
+				float y = static_cast<float>(strtod(end, &end));
+				float z = static_cast<float>(strtod(end, &end));
+				positions.push_back(float3(x, y, z));
+			}
+			else if (line[0] == 'v' && line[1] == 't' && line[2] == ' ')
+			{
+				float u = static_cast<float>(strtod(line + 3, &end));
+				float v = static_cast<float>(strtod(end, &end));
+				uvs.push_back(float2(u, v));
+			}
+			else if (line[0] == 'v' && line[1] == 'n' && line[2] == ' ')
+			{
+				float x = static_cast<float>(strtod(line + 3, &end));
+				float y = static_cast<float>(strtod(end, &end));
+				float z = static_cast<float>(strtod(end, &end));
+				normals.push_back(float3(x, y, z));
+			}
+			else if (line[0] == 'f' && line[1] == ' ')
+			{
+				std::vector<unsigned int> face;
+				const char *f = line + 2;
+				corner c;
+				while (f < s && parse_corner(f, positions, uvs, normals, c))
+				{
+					std::map<corner, unsigned int>::iterator found = corners.find(c);
+					if (found == corners.end())
+					{
+						vertex v;
+						v.pos = positions[c.pos];
+						v.normal = c.normal >= 0 ? normals[c.normal] : float3(0, 0, 0);
+						v.tex = c.tex >= 0 ? uvs[c.tex] : float2(0, 0);
+						found = corners.insert(std::make_pair(c, static_cast<unsigned int>(vertices.size()))).first;
+						vertices.push_back(v);
+						generated.push_back(c.normal < 0);
+					}
+					face.push_back(found->second);
+				}
+
+				for (size_t i = 1; i + 1 < face.size(); ++i)
+				{
+					unsigned int triangle[3] = { face[0], face[i], face[i + 1] };
+					indices.insert(indices.end(), triangle, triangle + 3);
+
+					// the cross product is twice the area, hence the weighting
+					float3 e1 = vertices[triangle[1]].pos - vertices[triangle[0]].pos;
+					float3 e2 = vertices[triangle[2]].pos - vertices[triangle[0]].pos;
+					float3 n = cross(e1, e2);
+					for (int k = 0; k != 3; ++k)
+					{
+						if (generated[triangle[k]])
+						{
+							vertices[triangle[k]].normal += n;
+						}
+					}
+				}
+			}
+
+			s = next;
+		}
+
+		for (size_t i = 0; i != vertices.size(); ++i)
+		{
+			if (generated[i] && dot(vertices[i].normal, vertices[i].normal) > 0)
+			{
+				vertices[i].normal = normalize(vertices[i].normal);
+			}
+		}
+		return true;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// commands
+	//////////////////////////////////////////////////////////////////////////
+	int convert(const char *in, const char *out)
+	{
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		if (!read_obj(in, vertices, indices))
+		{
+			fprintf(stderr, "cannot read %s\n", in);
+			return 1;
+		}
+
+		Mesh mesh(vertices.empty() ? 0 : &vertices[0], vertices.size(), indices.empty() ? 0 : &indices[0], indices.size());
+		double start = omp_get_wtime();
+		mesh_report report = mesh.optimize();
+		double optimize = omp_get_wtime() - start;
+		printf("%s: %u -> %u vertices, acmr %.3f -> %.3f, %.0f ms\n", in,
+			static_cast<unsigned int>(report.vertices_before), static_cast<unsigned int>(report.vertices_after),
+			report.acmr_before, report.acmr_after, optimize * 1e3);
+
+		vertices.resize(mesh.vertex_count());
+		indices.resize(mesh.index_count());
+		if (!vertices.empty())
+		{
+			mesh.get_vertices(0, vertices.size(), &vertices[0]);
+		}
+		if (!indices.empty())
+		{
+			mesh.get_triangles(0, mesh.triangle_count(), &indices[0]);
+		}
+
+		start = omp_get_wtime();
+		std::vector<unsigned int> lod_indices;
+		std::vector<mesh_lod> lods;
+		build_lods(vertices.empty() ? 0 : &vertices[0], vertices.size(),
+			indices.empty() ? 0 : &indices[0], indices.size(), lod_options(), lod_indices, lods);
+		double simplified = omp_get_wtime() - start;
+		printf("%s: %u levels, %.0f ms\n", in, static_cast<unsigned int>(lods.size()), simplified * 1e3);
+		for (size_t i = 0; i != lods.size(); ++i)
+		{
+			printf("  lod %u %10u triangles, error %g\n", static_cast<unsigned int>(i),
+				lods[i].index_count / 3, lods[i].error);
+		}
+
+		mesh_file_status status = write_mesh_file(out,
+			vertices.empty() ? 0 : &vertices[0], vertices.size(),
+			lod_indices.empty() ? 0 : &lod_indices[0], lod_indices.size(), &lods[0], lods.size());
+		if (status != mesh_file_ok)
+		{
+			fprintf(stderr, "%s: %s\n", out, mesh_file_status_name(status));
+			return 1;
+		}
+
+		printf("%s: %u vertices, %u triangles\n", out,
+			static_cast<unsigned int>(vertices.size()), static_cast<unsigned int>(indices.size() / 3));
+		return 0;
+	}
+
+	int bench(const char *path, const char *obj)
+	{
+		const int c_repeat = 100;
+
+		MeshFile mesh;
+		double start = omp_get_wtime();
+		mesh_file_status status = mesh.open(path);
+		double first_open = omp_get_wtime() - start;
+		if (status != mesh_file_ok)
+		{
+			fprintf(stderr, "%s: %s\n", path, mesh_file_status_name(status));
+			return 1;
+		}
+
+		// every page of the mesh is faulted in, unless the cache has it
+		start = omp_get_wtime();
+		float sum = 0;
+		for (size_t i = 0; i != mesh.vertex_count(); ++i)
+		{
+			sum += mesh.vertices()[i].pos.x;
+		}
+		unsigned int index_sum = 0;
+		for (size_t i = 0; i != mesh.index_count(); ++i)
+		{
+			index_sum += mesh.indices()[i];
+		}
+		double touch = omp_get_wtime() - start;
+
+		double megabytes = mesh.byte_size() / (1024.0 * 1024.0);
+		printf("%s: %.1f mb, %u vertices, %u indices\n", path, megabytes,
+			static_cast<unsigned int>(mesh.vertex_count()), static_cast<unsigned int>(mesh.index_count()));
+		mesh.close();
+
+		start = omp_get_wtime();
+		for (int i = 0; i != c_repeat; ++i)
+		{
+			mesh.open(path);
+			mesh.close();
+		}
+		double open = (omp_get_wtime() - start) / c_repeat;
+
+		printf("  first open      %10.3f ms\n", first_open * 1e3);
+		printf("  open            %10.3f ms\n", open * 1e3);
+		printf("  touch all pages %10.3f ms (%.0f mb/s)\n", touch * 1e3, megabytes / touch);
+
+		if (obj)
+		{
+			std::vector<vertex> vertices;
+			std::vector<unsigned int> indices;
+			start = omp_get_wtime();
+			bool read = read_obj(obj, vertices, indices);
+			double parse = omp_get_wtime() - start;
+			if (read)
+			{
+				printf("  parse obj       %10.3f ms\n", parse * 1e3);
+			}
+		}
+
+		// keeps the sums alive
+		return sum == -1.0f && index_sum == 1 ? 2 : 0;
+	}
+
+
+	// the rays per second through a tree
+	void trace_rates(const Bvh &bvh, const std::vector<ray> &rays, int repeat)
+	{
+		std::vector<hit> hits(rays.size());
+		bool *occluded = new bool[rays.size()];
+
+		const double count = static_cast<double>(rays.size()) * repeat;
+		double start = omp_get_wtime();
+		size_t found = 0;
+		for (int i = 0; i != repeat; ++i)
+		{
+			#pragma omp parallel for reduction(+ : found)
+			for (int j = 0; j < static_cast<int>(rays.size()); ++j)
+			{
+				found += bvh.intersect(rays[j], hits[j]);
+			}
+		}
+		double single = omp_get_wtime() - start;
+
+		start = omp_get_wtime();
+		for (int i = 0; i != repeat; ++i)
+		{
+			bvh.intersect(&rays[0], rays.size(), &hits[0]);
+		}
+		double packet = omp_get_wtime() - start;
+
+		start = omp_get_wtime();
+		for (int i = 0; i != repeat; ++i)
+		{
+			bvh.occluded(&rays[0], rays.size(), occluded);
+		}
+		double any = omp_get_wtime() - start;
+		delete[] occluded;
+
+		printf("  %u of %u rays hit\n", static_cast<unsigned int>(found / repeat), static_cast<unsigned int>(rays.size()));
+		printf("  closest, single %10.1f mrays/s\n", count / single * 1e-6);
+		printf("  closest, packet %10.1f mrays/s\n", count / packet * 1e-6);
+		printf("  any, packet     %10.1f mrays/s\n", count / any * 1e-6);
+	}
+
+	int trace(const char *path)
+	{
+		const int c_size = 1024;
+		const int c_repeat = 4;
+
+		MeshFile mesh;
+		mesh_file_status status = mesh.open(path);
+		if (status != mesh_file_ok)
+		{
+			fprintf(stderr, "%s: %s\n", path, mesh_file_status_name(status));
+			return 1;
+		}
+
+		size_t index_count = mesh.lod_count() != 0 ? mesh.lods()[0].index_count : mesh.index_count();
+		double start = omp_get_wtime();
+		Bvh bvh(mesh.vertices(), mesh.vertex_count(), mesh.indices(), index_count);
+		double build = omp_get_wtime() - start;
+		printf("%s: %u triangles, %u nodes, sah cost %.1f, %d threads\n", path,
+			static_cast<unsigned int>(bvh.triangle_count()), static_cast<unsigned int>(bvh.node_count()),
+			bvh.sah_cost(), omp_get_max_threads());
+		printf("  sah build       %10.3f ms\n", build * 1e3);
+
+		// a pinhole camera near a corner looking at the center, 53 degrees
+		// across, rows of 8 pixels to a packet
+		aabb box = bvh.bounds();
+		float3 center = (box.lower + box.upper) * 0.5f;
+		float3 extent = box.upper - box.lower;
+		float3 eye = center + extent * 0.5f;
+		float3 forward = center - eye;
+		forward.normalize();
+		float3 up(0, 1, 0);
+		float3 right = cross(forward, up);
+		right.normalize();
+		up = cross(right, forward);
+
+		std::vector<ray> rays(c_size * c_size);
+		for (int y = 0; y != c_size; ++y)
+		{
+			for (int x = 0; x != c_size; ++x)
+			{
+				float px = (x + 0.5f) / c_size - 0.5f;
+				float py = 0.5f - (y + 0.5f) / c_size;
+				float3 dx = right * px;
+				float3 dy = up * py;
+				ray &r = rays[y * c_size + x];
+				r.origin = eye;
+				r.direction = forward + dx + dy;
+				r.tmin = 0;
+				r.tmax = 1e30f;
+			}
+		}
+		trace_rates(bvh, rays, c_repeat);
+
+		start = omp_get_wtime();
+		Bvh linear(mesh.vertices(), mesh.vertex_count(), mesh.indices(), index_count, bvh_build_linear);
+		build = omp_get_wtime() - start;
+		printf("  linear build    %10.3f ms, %u nodes, sah cost %.1f\n", build * 1e3,
+			static_cast<unsigned int>(linear.node_count()), linear.sah_cost());
+		trace_rates(linear, rays, c_repeat);
+
+		start = omp_get_wtime();
+		bvh.refit(mesh.vertices(), mesh.vertex_count(), mesh.indices());
+		printf("  refit           %10.3f ms\n", (omp_get_wtime() - start) * 1e3);
+		return 0;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// path tracing
+	//////////////////////////////////////////////////////////////////////////
+	void add_quad(std::vector<vertex> &vertices, std::vector<unsigned int> &indices, const float3 &center,
+		float half_size, const float3 &normal)
+	{
+		const unsigned int first = static_cast<unsigned int>(vertices.size());
+		const float corners[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+		for (int k = 0; k != 4; ++k)
+		{
+			vertex v;
+			v.pos = center + float3(corners[k][0] * half_size, 0, corners[k][1] * half_size);
+			v.normal = normal;
+			v.tex = float2(0, 0);
+			vertices.push_back(v);
+		}
+		const unsigned int quad[6] = { 0, 2, 1, 0, 3, 2 };
+		for (int i = 0; i != 6; ++i)
+		{
+			indices.push_back(first + quad[i]);
+		}
+	}
+
+	// rgb floats with the rows from the bottom, little endian
+	bool write_pfm(const char *path, const float *rgb, size_t width, size_t height)
+	{
+		FILE *file = fopen(path, "wb");
+		if (!file)
+		{
+			return false;
+		}
+		fprintf(file, "PF\n%u %u\n-1.0\n", static_cast<unsigned int>(width), static_cast<unsigned int>(height));
+		bool ok = true;
+		for (size_t y = height; y-- != 0; )
+		{
+			ok = ok && fwrite(rgb + y * width * 3, sizeof(float) * 3, width, file) == width;
+		}
+		return fclose(file) == 0 && ok;
+	}
+
+	int render(const char *path, int passes, const char *out)
+	{
+		const size_t c_size = 512;
+
+		MeshFile mesh;
+		mesh_file_status status = mesh.open(path);
+		if (status != mesh_file_ok)
+		{
+			fprintf(stderr, "%s: %s\n", path, mesh_file_status_name(status));
+			return 1;
+		}
+
+		// the full level, a floor under it and a light above
+		size_t index_count = mesh.lod_count() != 0 ? mesh.lods()[0].index_count : mesh.index_count();
+		if (index_count == 0)
+		{
+			fprintf(stderr, "%s: no triangles\n", path);
+			return 1;
+		}
+		std::vector<vertex> vertices(mesh.vertices(), mesh.vertices() + mesh.vertex_count());
+		std::vector<unsigned int> indices(mesh.indices(), mesh.indices() + index_count);
+		float3 lower = vertices[0].pos;
+		float3 upper = vertices[0].pos;
+		for (size_t i = 0; i != vertices.size(); ++i)
+		{
+			for (int k = 0; k != 3; ++k)
+			{
+				lower[k] = std::min(lower[k], vertices[i].pos[k]);
+				upper[k] = std::max(upper[k], vertices[i].pos[k]);
+			}
+		}
+		const float3 center = (lower + upper) * 0.5f;
+		const float3 extent = upper - lower;
+		const float size = std::max(std::max(extent.x, extent.y), extent.z);
+		add_quad(vertices, indices, float3(center.x, lower.y - size * 0.01f, center.z), size * 2, float3(0, 1, 0));
+		add_quad(vertices, indices, float3(center.x, upper.y + size, center.z), size * 0.15f, float3(0, -1, 0));
+
+		std::vector<unsigned int> triangle_materials(indices.size() / 3, 0);
+		triangle_materials[index_count / 3] = triangle_materials[index_count / 3 + 1] = 1;
+		triangle_materials[index_count / 3 + 2] = triangle_materials[index_count / 3 + 3] = 2;
+		const material materials[3] =
+		{
+			{ float3(0.7f, 0.7f, 0.7f), float3(0, 0, 0) },
+			{ float3(0.5f, 0.45f, 0.4f), float3(0, 0, 0) },
+			{ float3(0, 0, 0), float3(40, 38, 34) }
+		};
+
+		double start = omp_get_wtime();
+		PathScene scene;
+		scene.build(&vertices[0], vertices.size(), &indices[0], indices.size(), &triangle_materials[0], materials, 3);
+		scene.set_sky(float3(0.1f, 0.12f, 0.15f));
+		printf("%s: %u triangles, %u emitters, %d threads\n", path, static_cast<unsigned int>(scene.triangle_count()),
+			static_cast<unsigned int>(scene.emitter_count()), omp_get_max_threads());
+		printf("  scene build     %10.3f ms\n", (omp_get_wtime() - start) * 1e3);
+
+		// the camera of trace, a little higher
+		camera view;
+		view.eye = center + float3(extent.x * 0.9f, extent.y * 0.6f, extent.z * 0.9f);
+		view.target = center;
+		view.up = float3(0, 1, 0);
+		view.fov = 0.9f;
+		PathTracer tracer(scene, c_size, c_size);
+		tracer.set_camera(view);
+
+		path_stats total = { 0, 0, 0 };
+		for (int pass = 0; pass != passes; ++pass)
+		{
+			path_stats stats = tracer.render_pass();
+			total.samples += stats.samples;
+			total.rays += stats.rays;
+			total.seconds += stats.seconds;
+		}
+		printf("  %d passes of %ux%u in 16x16 tiles, %.3f ms each\n", passes, static_cast<unsigned int>(c_size),
+			static_cast<unsigned int>(c_size), total.seconds / passes * 1e3);
+		printf("  samples         %10.3f m/s\n", total.samples / total.seconds * 1e-6);
+		printf("  rays            %10.3f m/s, %.2f per sample\n", total.rays / total.seconds * 1e-6,
+			static_cast<double>(total.rays) / total.samples);
+
+		if (out)
+		{
+			std::vector<float> image(c_size * c_size * 3);
+			tracer.resolve(&image[0]);
+			if (!write_pfm(out, &image[0], c_size, c_size))
+			{
+				fprintf(stderr, "%s: cannot write\n", out);
+				return 1;
+			}
+		}
+		return 0;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc == 4 && strcmp(argv[1], "convert") == 0)
+	{
+		return convert(argv[2], argv[3]);
+	}
+	if ((argc == 3 || argc == 4) && strcmp(argv[1], "bench") == 0)
+	{
+		return bench(argv[2], argc == 4 ? argv[3] : 0);
+	}
+	if (argc == 3 && strcmp(argv[1], "trace") == 0)
+	{
+		return trace(argv[2]);
+	}
+	if (argc >= 3 && argc <= 5 && strcmp(argv[1], "render") == 0)
+	{
+		int passes = argc >= 4 ? atoi(argv[3]) : 16;
+		if (passes > 0)
+		{
+			return render(argv[2], passes, argc == 5 ? argv[4] : 0);
+		}
+	}
+
+	fprintf(stderr, "usage: mesh_tool convert <in.obj> <out.dmesh>\n");
+	fprintf(stderr, "       mesh_tool bench <mesh.dmesh> [<mesh.obj>]\n");
+	fprintf(stderr, "       mesh_tool trace <mesh.dmesh>\n");
+	fprintf(stderr, "       mesh_tool render <mesh.dmesh> [<passes> [<out.pfm>]]\n");
+	return 1;
+}
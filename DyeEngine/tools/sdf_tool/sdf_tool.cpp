@@ -0,0 +1,586 @@
+// renders signed distance scenes on the cpu and reports their cost.
+//
+//   sdf_tool march [<width> <height> [<out.pfm>]]
+//   sdf_tool compile [<points>]
+//   sdf_tool prune [<width> <height> [<cells>]]
+//   sdf_tool mc [<cells> [<out.mesh>]]
+//   sdf_tool volume [<cells>]
+//
+// march renders the demo scene, a floor with rows of spheres and a torus,
+// every way the ray marcher can: single rays or packets, plain or
+// over-relaxed steps, with or without the cone pre-pass. it prints the
+// distance evaluations per ray and the time of each, and writes the last
+// image as a pfm.
+//
+// compile prints the bytecode of the demo scene and times the distances of
+// random points in its bounds on one thread: walking the tree, and the
+// interpreter on 1, 8 and 16 points per instruction.
+//
+// prune splits a city of csg buildings into blocks of cells, 256 along
+// its width by default, and compares the whole program with the pruned
+// ones of the blocks: sampling the corners of the cells of the surface
+// blocks as marching cubes does, and ray marching.
+//
+// mc extracts the surface of the city with marching cubes, in cells 256
+// along its width by default: sampling the whole program, the blocks, and
+// a grid sampled from the blocks beforehand. it writes the mesh as a mesh
+// file if given a path.
+//
+// volume keeps the city in a sparse brick map of cells 256 along its width
+// by default, a band of 4 cells around the surface, as floats, halves and
+// bytes. it prints the memory of each against the dense grid, the error
+// near the surface, and the times of marching cubes and ray marching.
+
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <omp.h>
+
+#include <marching_cubes.hpp>
+#include <mesh_file.hpp>
+#include <ray_marcher.hpp>
+#include <scalar_grid.hpp>
+#include <sdf.hpp>
+#include <sdf_blocks.hpp>
+#include <sparse_volume.hpp>
+
+using namespace Dye;
+using namespace Dye::Graphics;
+using namespace Dye::Render;
+
+namespace
+{
+	//////////////////////////////////////////////////////////////////////////
+	// demo scene
+	//////////////////////////////////////////////////////////////////////////
+
+	// the spheres repeat every c_spacing across the floor, c_rows each way
+	// from the middle
+	const float c_spacing = 1.5f;
+	const float c_rows = 5;
+	const float c_radius = 0.4f;
+
+	// the torus in the middle, lying on the floor
+	const float c_ring = 2.0f;
+	const float c_tube = 0.5f;
+
+	unsigned int demo_scene(SdfTree &tree)
+	{
+		const unsigned int floor = tree.plane(float3(0, 1, 0), 0);
+		const unsigned int grid = tree.repeat(tree.translate(tree.sphere(c_radius), float3(0, c_radius, 0)),
+			float3(c_spacing, 0, c_spacing), float3(c_rows, 0, c_rows));
+		const unsigned int torus = tree.translate(tree.torus(c_ring, c_tube), float3(0, c_tube, 0));
+		return tree.merge(tree.merge(grid, torus), floor);
+	}
+
+	// the demo scene compiled, its floor closed off below the spheres' reach
+	const SdfProgram &demo_program()
+	{
+		static SdfProgram program;
+		if (program.instruction_count() <= 1)
+		{
+			SdfTree tree;
+			program.compile(tree, demo_scene(tree));
+			const float reach = c_spacing * c_rows + c_radius;
+			aabb box = { float3(-reach, -0.1f, -reach), float3(reach, 2 * c_ring, reach) };
+			program.set_bounds(box);
+		}
+		return program;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// city scene
+	//////////////////////////////////////////////////////////////////////////
+
+	// c_blocks by c_blocks buildings of csg every c_street along the floor
+	const int c_blocks = 12;
+	const float c_street = 1.6f;
+
+	unsigned int city_scene(SdfTree &tree)
+	{
+		unsigned int root = tree.plane(float3(0, 1, 0), 0);
+		for (int i = 0; i != c_blocks; ++i)
+		{
+			for (int j = 0; j != c_blocks; ++j)
+			{
+				const float height = 0.4f + 0.15f * ((i * 5 + j * 3) % 7);
+				unsigned int building;
+				switch ((i * 7 + j * 3) % 4)
+				{
+				case 0:
+					// a hollow tower
+					building = tree.translate(tree.subtract(tree.box(float3(0.45f, height, 0.45f)),
+						tree.cylinder(0.25f, height + 0.1f)), float3(0, height, 0));
+					break;
+				case 1:
+					// a dome on a drum
+					building = tree.smooth_merge(tree.translate(tree.cylinder(0.5f, 0.3f), float3(0, 0.3f, 0)),
+						tree.translate(tree.sphere(0.45f), float3(0, 0.6f, 0)), 0.15f);
+					break;
+				case 2:
+					building = tree.translate(tree.torus(0.45f, 0.12f), float3(0, 0.12f, 0));
+					break;
+				default:
+					// a cube with the corners left
+					building = tree.translate(tree.subtract(tree.box(float3(0.5f, 0.5f, 0.5f)), tree.sphere(0.65f)),
+						float3(0, 0.5f, 0));
+					break;
+				}
+				const float3 at((i - (c_blocks - 1) * 0.5f) * c_street, 0, (j - (c_blocks - 1) * 0.5f) * c_street);
+				root = tree.merge(root, tree.translate(building, at));
+			}
+		}
+		return root;
+	}
+
+	bool write_pfm(const char *path, const float *rgb, size_t width, size_t height)
+	{
+		FILE *file = fopen(path, "wb");
+		if (!file)
+		{
+			return false;
+		}
+		fprintf(file, "PF\n%u %u\n-1.0\n", static_cast<unsigned int>(width), static_cast<unsigned int>(height));
+		bool ok = true;
+		for (size_t y = height; y-- != 0; )
+		{
+			ok = ok && fwrite(rgb + y * width * 3, sizeof(float) * 3, width, file) == width;
+		}
+		return fclose(file) == 0 && ok;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// commands
+	//////////////////////////////////////////////////////////////////////////
+	int march(size_t width, size_t height, const char *out)
+	{
+		const SdfProgram &scene = demo_program();
+		camera view;
+		view.eye = float3(0.5f, 4.0f, -11.0f);
+		view.target = float3(0, 0.5f, 0);
+		view.up = float3(0, 1, 0);
+		view.fov = 0.9f;
+
+		RayMarcher marcher(scene, width, height);
+		marcher.set_camera(view);
+		printf("%ux%u, %u threads\n", static_cast<unsigned int>(width), static_cast<unsigned int>(height),
+			static_cast<unsigned int>(omp_get_max_threads()));
+		printf("  %-8s %-8s %-6s %10s %10s %8s %10s\n", "rays", "steps", "cones", "steps/ray", "cone/ray", "ms",
+			"m rays/s");
+		for (int way = 0; way != 8; ++way)
+		{
+			march_settings settings;
+			settings.packets = (way & 1) != 0;
+			settings.relaxation = (way & 2) ? march_settings().relaxation : 1.0f;
+			settings.cones = (way & 4) != 0;
+			marcher.set_settings(settings);
+
+			// the best of a few, the first warms the caches
+			march_stats best = marcher.render();
+			for (int run = 0; run != 3; ++run)
+			{
+				const march_stats stats = marcher.render();
+				if (stats.seconds < best.seconds)
+				{
+					best = stats;
+				}
+			}
+			printf("  %-8s %-8s %-6s %10.2f %10.2f %8.1f %10.2f\n", settings.packets ? "packets" : "single",
+				settings.relaxation > 1 ? "relaxed" : "plain", settings.cones ? "yes" : "no",
+				static_cast<double>(best.steps) / best.rays, static_cast<double>(best.cone_steps) / best.rays,
+				best.seconds * 1e3, best.rays / best.seconds * 1e-6);
+		}
+
+		if (out && !write_pfm(out, marcher.image(), width, height))
+		{
+			fprintf(stderr, "%s: cannot write\n", out);
+			return 1;
+		}
+		return 0;
+	}
+
+	int compile(size_t count)
+	{
+		SdfTree tree;
+		const unsigned int root = demo_scene(tree);
+		SdfProgram program;
+		if (!program.compile(tree, root))
+		{
+			fprintf(stderr, "too many registers\n");
+			return 1;
+		}
+
+		printf("%u nodes, %u instructions, %u registers, result in r%u\n", static_cast<unsigned int>(tree.size()),
+			static_cast<unsigned int>(program.instruction_count()), program.register_count(), program.result());
+		for (size_t i = 0; i != program.instruction_count(); ++i)
+		{
+			const sdf_instruction &instruction = program.instructions()[i];
+			printf("  r%-2u = %-10s r%u r%u r%u\n", instruction.target,
+				sdf_opcode_name(static_cast<sdf_opcode>(instruction.op)), instruction.a, instruction.b, instruction.c);
+		}
+
+		// points spread over the bounds of the scene
+		const aabb box = demo_program().bounds();
+		std::vector<float3> points(count);
+		std::vector<float> x(count), y(count), z(count), out(count);
+		unsigned int seed = 1;
+		for (size_t i = 0; i != count; ++i)
+		{
+			float3 p;
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				const float u = (seed >> 8) * (1.0f / 16777216.0f);
+				p[axis] = box.lower[axis] + (box.upper[axis] - box.lower[axis]) * u;
+			}
+			points[i] = p;
+			x[i] = p.x;
+			y[i] = p.y;
+			z[i] = p.z;
+		}
+
+		// one thread, so that the numbers compare the evaluations alone;
+		// the best of a few runs of each
+		double seconds[4];
+		for (int way = 0; way != 4; ++way)
+		{
+			seconds[way] = DBL_MAX;
+			for (int run = 0; run != 4; ++run)
+			{
+				const double start = omp_get_wtime();
+				if (way == 0)
+				{
+					for (size_t i = 0; i != count; ++i)
+					{
+						out[i] = tree.distance(root, points[i]);
+					}
+				}
+				else if (way == 1)
+				{
+					for (size_t i = 0; i != count; ++i)
+					{
+						out[i] = program.distance(points[i]);
+					}
+				}
+				else if (way == 2)
+				{
+					for (size_t i = 0; i + c_packet_width <= count; i += c_packet_width)
+					{
+						const float3x8 p(float8::load(&x[i]), float8::load(&y[i]), float8::load(&z[i]));
+						program.distance(p).store(&out[i]);
+					}
+				}
+				else
+				{
+					program.distances(&x[0], &y[0], &z[0], count, &out[0]);
+				}
+				seconds[way] = std::min(seconds[way], omp_get_wtime() - start);
+			}
+		}
+
+		const char *names[4] = { "tree walk", "scalar", "8 wide", "16 wide" };
+		printf("%u points\n", static_cast<unsigned int>(count));
+		printf("  %-10s %8s %12s %8s\n", "", "ms", "m points/s", "speedup");
+		for (int i = 0; i != 4; ++i)
+		{
+			printf("  %-10s %8.2f %12.2f %8.2f\n", names[i], seconds[i] * 1e3, count / seconds[i] * 1e-6,
+				seconds[0] / seconds[i]);
+		}
+		return 0;
+	}
+
+	int prune(size_t width, size_t height, size_t cells)
+	{
+		SdfTree tree;
+		SdfProgram program;
+		if (!program.compile(tree, city_scene(tree)))
+		{
+			fprintf(stderr, "too many registers\n");
+			return 1;
+		}
+		const float reach = c_blocks * c_street * 0.5f;
+		const aabb box = { float3(-reach, -0.1f, -reach), float3(reach, 2.0f, reach) };
+		program.set_bounds(box);
+
+		SdfBlocks blocks;
+		const double start = omp_get_wtime();
+		blocks.build(program, box, 2 * reach / cells);
+		const double build = omp_get_wtime() - start;
+		printf("%u instructions, %ux%ux%u leaves of %u cells, built in %.1f ms\n",
+			static_cast<unsigned int>(program.instruction_count()), blocks.leaves(0), blocks.leaves(1), blocks.leaves(2),
+			c_sdf_leaf_block, build * 1e3);
+		printf("  %u outside, %u inside, %u surface with %.1f instructions on average\n",
+			static_cast<unsigned int>(blocks.count(sdf_block_outside)),
+			static_cast<unsigned int>(blocks.count(sdf_block_inside)),
+			static_cast<unsigned int>(blocks.count(sdf_block_surface)), blocks.average_instructions());
+
+		// the corners of the cells of every surface leaf, as marching cubes
+		// samples them, with the whole program and with the pruned ones
+		const size_t c_corners = c_sdf_leaf_block + 1;
+		std::vector<float> samples(c_corners * c_corners * c_corners);
+		double sampling[2];
+		for (int way = 0; way != 2; ++way)
+		{
+			sampling[way] = DBL_MAX;
+			for (int run = 0; run != 3; ++run)
+			{
+				const double begin = omp_get_wtime();
+				for (size_t i = 0; i != blocks.block_count(); ++i)
+				{
+					const sdf_block &block = blocks.block(i);
+					if (block.type != sdf_block_surface)
+					{
+						continue;
+					}
+					const float3 corner(blocks.origin().x + block.cell[0] * blocks.cell_size(),
+						blocks.origin().y + block.cell[1] * blocks.cell_size(),
+						blocks.origin().z + block.cell[2] * blocks.cell_size());
+					const SdfProgram &sampler = way == 0 ? program : blocks.program(block.program);
+					sampler.sample_grid(corner, blocks.cell_size(), c_corners, c_corners, c_corners, &samples[0]);
+				}
+				sampling[way] = std::min(sampling[way], omp_get_wtime() - begin);
+			}
+		}
+		printf("sampling the surface leaves: %.1f ms whole, %.1f ms pruned, %.1fx\n", sampling[0] * 1e3,
+			sampling[1] * 1e3, sampling[0] / sampling[1]);
+
+		camera view;
+		view.eye = float3(2.0f, 7.0f, -14.0f);
+		view.target = float3(0, 0, 0);
+		view.up = float3(0, 1, 0);
+		view.fov = 0.9f;
+		const IRayMarchable *geometry[2] = { &program, &blocks };
+		double seconds[2];
+		for (int way = 0; way != 2; ++way)
+		{
+			RayMarcher marcher(*geometry[way], width, height);
+			marcher.set_camera(view);
+			march_stats best = marcher.render();
+			for (int run = 0; run != 2; ++run)
+			{
+				const march_stats stats = marcher.render();
+				if (stats.seconds < best.seconds)
+				{
+					best = stats;
+				}
+			}
+			seconds[way] = best.seconds;
+			printf("marching %ux%u %s: %u hits, %.2f steps per ray, %.1f ms\n", static_cast<unsigned int>(width),
+				static_cast<unsigned int>(height), way == 0 ? "whole" : "blocks", static_cast<unsigned int>(best.hits),
+				best.steps_per_ray(), best.seconds * 1e3);
+		}
+		printf("  %.1fx\n", seconds[0] / seconds[1]);
+		return 0;
+	}
+
+	int extract(size_t cells, const char *path)
+	{
+		SdfTree tree;
+		SdfProgram program;
+		if (!program.compile(tree, city_scene(tree)))
+		{
+			fprintf(stderr, "too many registers\n");
+			return 1;
+		}
+		const float reach = c_blocks * c_street * 0.5f;
+		const aabb box = { float3(-reach, -0.1f, -reach), float3(reach, 2.0f, reach) };
+		program.set_bounds(box);
+		const float cell = 2 * reach / cells;
+		const size_t height = static_cast<size_t>(std::ceil((box.upper.y - box.lower.y) / cell));
+
+		SdfBlocks blocks;
+		double start = omp_get_wtime();
+		blocks.build(program, box, cell);
+		printf("%ux%ux%u cells, blocks built in %.1f ms\n", static_cast<unsigned int>(cells),
+			static_cast<unsigned int>(height), static_cast<unsigned int>(cells), (omp_get_wtime() - start) * 1e3);
+
+		ScalarGrid grid;
+		start = omp_get_wtime();
+		grid.assign(blocks, box.lower, cell, cells + 1, height + 1, cells + 1);
+		printf("grid sampled from the blocks in %.1f ms, %.1f mb\n", (omp_get_wtime() - start) * 1e3,
+			grid.count(0) * grid.count(1) * grid.count(2) * sizeof(float) / 1048576.0);
+
+		const IScalarField *fields[3] = { &program, &blocks, &grid };
+		const char *names[3] = { "whole", "blocks", "grid" };
+		std::vector<vertex> vertices;
+		std::vector<unsigned int> indices;
+		for (int way = 0; way != 3; ++way)
+		{
+			MarchingCubes cubes(*fields[way], box.lower, cell, cells, height, cells);
+			mc_stats best = cubes.extract(vertices, indices);
+			for (int run = 0; run != 2; ++run)
+			{
+				const mc_stats stats = cubes.extract(vertices, indices);
+				best.seconds = std::min(best.seconds, stats.seconds);
+			}
+			printf("  %-6s %u of %u chunks crossed, %u vertices, %u triangles, %.1f ms, %.1f m cells/s\n", names[way],
+				static_cast<unsigned int>(best.surface_chunks), static_cast<unsigned int>(best.chunks),
+				static_cast<unsigned int>(best.vertices), static_cast<unsigned int>(best.triangles), best.seconds * 1e3,
+				cells * height * cells / best.seconds * 1e-6);
+		}
+
+		if (path != 0 && write_mesh_file(path, vertices.empty() ? 0 : &vertices[0], vertices.size(),
+			indices.empty() ? 0 : &indices[0], indices.size(), 0, 0) != mesh_file_ok)
+		{
+			fprintf(stderr, "cannot write %s\n", path);
+			return 1;
+		}
+		return 0;
+	}
+
+	int volume(size_t cells)
+	{
+		SdfTree tree;
+		SdfProgram program;
+		if (!program.compile(tree, city_scene(tree)))
+		{
+			fprintf(stderr, "too many registers\n");
+			return 1;
+		}
+		const float reach = c_blocks * c_street * 0.5f;
+		const aabb box = { float3(-reach, -0.1f, -reach), float3(reach, 2.0f, reach) };
+		program.set_bounds(box);
+		const float cell = 2 * reach / cells;
+		const float band = 4 * cell;
+		const size_t height = static_cast<size_t>(std::ceil((box.upper.y - box.lower.y) / cell));
+		const double dense = (cells + 1) * (height + 1) * (cells + 1) * sizeof(float) / 1048576.0;
+		printf("%ux%ux%u cells, %.1f mb dense\n", static_cast<unsigned int>(cells), static_cast<unsigned int>(height),
+			static_cast<unsigned int>(cells), dense);
+
+		// the volumes build from the blocks, whose ranges skip the bricks
+		// clear of the band
+		SdfBlocks blocks;
+		blocks.build(program, box, cell);
+
+		// points in the half of the band nearer the surface
+		std::vector<float3> points;
+		unsigned int seed = 1;
+		while (points.size() != 100000)
+		{
+			float3 p;
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				const float u = (seed >> 8) * (1.0f / 16777216.0f);
+				p[axis] = box.lower[axis] + (box.upper[axis] - box.lower[axis]) * u;
+			}
+			if (std::abs(program.distance(p)) < band * 0.5f)
+			{
+				points.push_back(p);
+			}
+		}
+
+		camera view;
+		view.eye = float3(2.0f, 7.0f, -14.0f);
+		view.target = float3(0, 0, 0);
+		view.up = float3(0, 1, 0);
+		view.fov = 0.9f;
+		const volume_precision precisions[3] = { volume_float, volume_half, volume_byte };
+		const char *names[3] = { "float", "half", "byte" };
+		for (int way = 0; way != 3; ++way)
+		{
+			SparseVolume volume;
+			const double start = omp_get_wtime();
+			volume.build(blocks, box, cell, band, precisions[way]);
+			const double build = omp_get_wtime() - start;
+			const double memory = volume.memory() / 1048576.0;
+			printf("  %-5s %u of %u bricks, %.1f mb, %.1fx less, built in %.1f ms\n", names[way],
+				static_cast<unsigned int>(volume.brick_count()), volume.bricks(0) * volume.bricks(1) * volume.bricks(2),
+				memory, dense / memory, build * 1e3);
+
+			double total = 0;
+			float largest = 0;
+			for (size_t i = 0; i != points.size(); ++i)
+			{
+				const float error = std::abs(volume.value(points[i]) - program.distance(points[i]));
+				total += error;
+				largest = std::max(largest, error);
+			}
+			printf("        error %.5f on average, %.5f at most, in cells of %.5f\n", total / points.size(), largest,
+				cell);
+
+			MarchingCubes cubes(volume, box.lower, cell, cells, height, cells);
+			std::vector<vertex> vertices;
+			std::vector<unsigned int> indices;
+			mc_stats best = cubes.extract(vertices, indices);
+			for (int run = 0; run != 2; ++run)
+			{
+				const mc_stats stats = cubes.extract(vertices, indices);
+				best.seconds = std::min(best.seconds, stats.seconds);
+			}
+			RayMarcher marcher(volume, 640, 360);
+			marcher.set_camera(view);
+			march_stats marched = marcher.render();
+			const march_stats again = marcher.render();
+			marched.seconds = std::min(marched.seconds, again.seconds);
+			printf("        marching cubes %u of %u chunks crossed, %u triangles, %.1f ms; marching 640x360 %u hits, "
+				"%.1f ms\n", static_cast<unsigned int>(best.surface_chunks), static_cast<unsigned int>(best.chunks),
+				static_cast<unsigned int>(best.triangles), best.seconds * 1e3, static_cast<unsigned int>(marched.hits),
+				marched.seconds * 1e3);
+		}
+		return 0;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc >= 2 && strcmp(argv[1], "march") == 0 && (argc == 2 || argc == 4 || argc == 5))
+	{
+		const int width = argc >= 4 ? atoi(argv[2]) : 640;
+		const int height = argc >= 4 ? atoi(argv[3]) : 360;
+		if (width > 0 && height > 0)
+		{
+			return march(width, height, argc == 5 ? argv[4] : 0);
+		}
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "compile") == 0 && argc <= 3)
+	{
+		const int count = argc == 3 ? atoi(argv[2]) : 1 << 20;
+		if (count > 0)
+		{
+			return compile(count);
+		}
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "prune") == 0 && (argc == 2 || argc == 4 || argc == 5))
+	{
+		const int width = argc >= 4 ? atoi(argv[2]) : 640;
+		const int height = argc >= 4 ? atoi(argv[3]) : 360;
+		const int cells = argc == 5 ? atoi(argv[4]) : 256;
+		if (width > 0 && height > 0 && cells > 0)
+		{
+			return prune(width, height, cells);
+		}
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "mc") == 0 && argc <= 4)
+	{
+		const int cells = argc >= 3 ? atoi(argv[2]) : 256;
+		if (cells > 0)
+		{
+			return extract(cells, argc == 4 ? argv[3] : 0);
+		}
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "volume") == 0 && argc <= 3)
+	{
+		const int cells = argc == 3 ? atoi(argv[2]) : 256;
+		if (cells > 0)
+		{
+			return volume(cells);
+		}
+	}
+
+	fprintf(stderr,
+		"usage: sdf_tool march [<width> <height> [<out.pfm>]]\n"
+		"       sdf_tool compile [<points>]\n"
+		"       sdf_tool prune [<width> <height> [<cells>]]\n"
+		"       sdf_tool mc [<cells> [<out.mesh>]]\n"
+		"       sdf_tool volume [<cells>]\n");
+	return 1;
+}